@@ -0,0 +1,614 @@
+#include "Array.h"
+
+#include <assert.h>
+
+#include "Reduce.h"
+
+#if red_X86
+#include <immintrin.h>
+#endif // red_X86
+
+/**
+ * @brief adds the lane sums and the remaining ints to the accumulator
+ *
+ * @param lanes partial sums of the vector loop
+ * @param items ints that weren't added by the vector loop
+ * @param count number of the remaining ints
+ * @param acc the accumulator, it is not changed if the sum overflows
+ * @return true the sum fits into int
+ * @return false the sum overflowed
+ */
+_Bool _arrFinishSumInt(const long long lanes[4], const ArrayItem* items, size_t count, long long* acc);
+
+/**
+ * @brief adds the floats or the products of floats that weren't added by
+ * the vector loop to their partial sums
+ *
+ * @param lanes the partial sums
+ * @param a the floats
+ * @param b the second factors, NULL if the floats are summed
+ * @param start index of the first float that wasn't added
+ * @param count number of the floats
+ */
+void _arrFinishFloat(double lanes[4], const ArrayItem* a, const ArrayItem* b, size_t start, size_t count);
+
+/**
+ * @brief checks whether the item should replace the extreme found so far
+ *
+ * @param type V_INT or V_FLOAT
+ * @param x the item
+ * @param m the extreme
+ * @param max if true the largest item is searched
+ * @return true the item is smaller or larger than the extreme
+ * @return false the extreme stays
+ */
+_Bool _arrBetter(VariableType type, ArrayItem x, ArrayItem m, _Bool max);
+
+/**
+ * @brief sums floats or computes dot product, see redSumFloat
+ *
+ * @param acc the accumulator
+ * @param a the floats
+ * @param b the second factors, NULL if the floats are summed
+ * @param count number of the floats
+ * @return double the result
+ */
+double _arrFloat(double acc, const ArrayItem* a, const ArrayItem* b, size_t count);
+
+#if red_X86
+
+/**
+ * @brief sums ints in 4 lanes of two SSE2 registers
+ *
+ * @param items the ints
+ * @param count number of the ints
+ * @param acc the accumulator, it is not changed if the sum overflows
+ * @return true the sum fits into int
+ * @return false the sum overflowed
+ */
+_Bool _arrSumIntSse2(const ArrayItem* items, size_t count, long long* acc);
+
+/**
+ * @brief sums ints in 4 lanes of AVX2 register
+ *
+ * @param items the ints
+ * @param count number of the ints
+ * @param acc the accumulator, it is not changed if the sum overflows
+ * @return true the sum fits into int
+ * @return false the sum overflowed
+ */
+_Bool _arrSumIntAvx2(const ArrayItem* items, size_t count, long long* acc);
+
+/**
+ * @brief sums groups of 4 floats or products of floats in two SSE2 registers
+ *
+ * @param a the floats
+ * @param b the second factors, NULL if the floats are summed
+ * @param count number of the floats
+ * @param lanes the partial sums
+ * @return size_t number of the added floats
+ */
+size_t _arrFloatSse2(const ArrayItem* a, const ArrayItem* b, size_t count, double lanes[4]);
+
+/**
+ * @brief sums groups of 4 floats or products of floats in AVX2 register
+ *
+ * @param a the floats
+ * @param b the second factors, NULL if the floats are summed
+ * @param count number of the floats
+ * @param lanes the partial sums
+ * @return size_t number of the added floats
+ */
+size_t _arrFloatAvx2(const ArrayItem* a, const ArrayItem* b, size_t count, double lanes[4]);
+
+/**
+ * @brief finds the smallest or the largest float in 4 lanes of two SSE2
+ * registers, SSE2 cannot compare ints of 64 bits
+ *
+ * @param items the floats
+ * @param count number of the floats
+ * @param lanes the extremes of the lanes
+ * @param max if true the largest float is found
+ * @return size_t number of the compared items
+ */
+size_t _arrExtremeSse2(const ArrayItem* items, size_t count, ArrayItem lanes[4], _Bool max);
+
+/**
+ * @brief finds the smallest or the largest item in 4 lanes of AVX2 register
+ *
+ * @param type V_INT or V_FLOAT
+ * @param items the items
+ * @param count number of the items
+ * @param lanes the extremes of the lanes
+ * @param max if true the largest item is found
+ * @return size_t number of the compared items
+ */
+size_t _arrExtremeAvx2(VariableType type, const ArrayItem* items, size_t count, ArrayItem lanes[4], _Bool max);
+
+/**
+ * @brief adds ints item by item in SSE2 register
+ *
+ * @param res where to store the sums
+ * @param a first operands
+ * @param b second operands
+ * @param step 1 if b has count items, 0 if its only item is used for all
+ * @param count number of the sums
+ * @param overflow set to true if some sum overflowed
+ * @return size_t number of the computed sums
+ */
+size_t _arrMapIntSse2(ArrayItem* res, const ArrayItem* a, const ArrayItem* b, size_t step, size_t count, _Bool* overflow);
+
+/**
+ * @brief adds ints item by item in AVX2 register
+ *
+ * @param res where to store the sums
+ * @param a first operands
+ * @param b second operands
+ * @param step 1 if b has count items, 0 if its only item is used for all
+ * @param count number of the sums
+ * @param overflow set to true if some sum overflowed
+ * @return size_t number of the computed sums
+ */
+size_t _arrMapIntAvx2(ArrayItem* res, const ArrayItem* a, const ArrayItem* b, size_t step, size_t count, _Bool* overflow);
+
+/**
+ * @brief adds or multiplies floats item by item in SSE2 register
+ *
+ * @param res where to store the results
+ * @param a first operands
+ * @param b second operands
+ * @param step 1 if b has count items, 0 if its only item is used for all
+ * @param count number of the results
+ * @param multiply if true the items are multiplied
+ * @return size_t number of the computed results
+ */
+size_t _arrMapFloatSse2(ArrayItem* res, const ArrayItem* a, const ArrayItem* b, size_t step, size_t count, _Bool multiply);
+
+/**
+ * @brief adds or multiplies floats item by item in AVX2 register
+ *
+ * @param res where to store the results
+ * @param a first operands
+ * @param b second operands
+ * @param step 1 if b has count items, 0 if its only item is used for all
+ * @param count number of the results
+ * @param multiply if true the items are multiplied
+ * @return size_t number of the computed results
+ */
+size_t _arrMapFloatAvx2(ArrayItem* res, const ArrayItem* a, const ArrayItem* b, size_t step, size_t count, _Bool multiply);
+
+#endif // red_X86
+
+Array* arrCreate(Gc* gc, VariableType type, size_t length)
+{
+    assert(type == V_INT || type == V_FLOAT);
+
+    Array* a = gcAlloc(gc, GC_ARRAY, sizeof(Array) + sizeof(ArrayItem) * length);
+    a->type = type;
+    a->length = length;
+    return a;
+}
+
+ArrayItem* arrItems(ArrayView view)
+{
+    return view.items->items + view.offset;
+}
+
+void arrToFloat(ArrayItem* res, const ArrayItem* items, size_t count)
+{
+    for (size_t i = 0; i < count; i++)
+        res[i].decimal = (double)items[i].integer;
+}
+
+_Bool arrSumInt(const ArrayItem* items, size_t count, long long* acc)
+{
+    if (count >= red_VECTOR_MIN)
+    {
+        switch (redIsa())
+        {
+#if red_X86
+        case RED_ISA_AVX2:
+            return _arrSumIntAvx2(items, count, acc);
+        case RED_ISA_SSE2:
+            return _arrSumIntSse2(items, count, acc);
+#endif // red_X86
+        default:
+            break;
+        }
+    }
+
+    long long lanes[4] = { 0 };
+    return _arrFinishSumInt(lanes, items, count, acc);
+}
+
+double arrSumFloat(double acc, const ArrayItem* items, size_t count)
+{
+    return _arrFloat(acc, items, NULL, count);
+}
+
+_Bool arrDotInt(const ArrayItem* a, const ArrayItem* b, size_t count, long long* acc)
+{
+    // there is no vector multiplication of 64 bit ints that would report overflow
+    long long res = *acc;
+    for (size_t i = 0; i < count; i++)
+    {
+        long long product;
+        if (__builtin_mul_overflow(a[i].integer, b[i].integer, &product) || __builtin_add_overflow(res, product, &res))
+            return 0;
+    }
+    *acc = res;
+    return 1;
+}
+
+double arrDotFloat(const ArrayItem* a, const ArrayItem* b, size_t count)
+{
+    return _arrFloat(0, a, b, count);
+}
+
+ArrayItem arrExtreme(VariableType type, const ArrayItem* items, size_t count, _Bool max)
+{
+    assert(count);
+
+    // every lane starts with the first item so that NaN in it wins
+    ArrayItem lanes[4] = { items[0], items[0], items[0], items[0] };
+    size_t done = 0;
+    if (count >= red_VECTOR_MIN)
+    {
+        switch (redIsa())
+        {
+#if red_X86
+        case RED_ISA_AVX2:
+            done = _arrExtremeAvx2(type, items, count, lanes, max);
+            break;
+        case RED_ISA_SSE2:
+            if (type == V_FLOAT)
+                done = _arrExtremeSse2(items, count, lanes, max);
+            break;
+#endif // red_X86
+        default:
+            break;
+        }
+    }
+
+    for (size_t i = done; i < count; i++)
+    {
+        if (_arrBetter(type, items[i], lanes[i % 4], max))
+            lanes[i % 4] = items[i];
+    }
+    for (size_t i = 1; i < 4; i++)
+    {
+        if (_arrBetter(type, lanes[i], lanes[0], max))
+            lanes[0] = lanes[i];
+    }
+    return lanes[0];
+}
+
+_Bool arrMapInt(ArrayItem* res, const ArrayItem* a, const ArrayItem* b, size_t step, size_t count, _Bool multiply)
+{
+    _Bool overflow = 0;
+    size_t done = 0;
+    if (!multiply && count >= red_VECTOR_MIN)
+    {
+        switch (redIsa())
+        {
+#if red_X86
+        case RED_ISA_AVX2:
+            done = _arrMapIntAvx2(res, a, b, step, count, &overflow);
+            break;
+        case RED_ISA_SSE2:
+            done = _arrMapIntSse2(res, a, b, step, count, &overflow);
+            break;
+#endif // red_X86
+        default:
+            break;
+        }
+    }
+
+    for (size_t i = done; i < count; i++)
+    {
+        if (multiply)
+            overflow |= __builtin_mul_overflow(a[i].integer, b[i * step].integer, &res[i].integer);
+        else
+            overflow |= __builtin_add_overflow(a[i].integer, b[i * step].integer, &res[i].integer);
+    }
+    return !overflow;
+}
+
+void arrMapFloat(ArrayItem* res, const ArrayItem* a, const ArrayItem* b, size_t step, size_t count, _Bool multiply)
+{
+    size_t done = 0;
+    if (count >= red_VECTOR_MIN)
+    {
+        switch (redIsa())
+        {
+#if red_X86
+        case RED_ISA_AVX2:
+            done = _arrMapFloatAvx2(res, a, b, step, count, multiply);
+            break;
+        case RED_ISA_SSE2:
+            done = _arrMapFloatSse2(res, a, b, step, count, multiply);
+            break;
+#endif // red_X86
+        default:
+            break;
+        }
+    }
+
+    for (size_t i = done; i < count; i++)
+    {
+        if (multiply)
+            res[i].decimal = a[i].decimal * b[i * step].decimal;
+        else
+            res[i].decimal = a[i].decimal + b[i * step].decimal;
+    }
+}
+
+_Bool _arrBetter(VariableType type, ArrayItem x, ArrayItem m, _Bool max)
+{
+    if (type == V_INT)
+        return max ? x.integer > m.integer : x.integer < m.integer;
+    return max ? x.decimal > m.decimal : x.decimal < m.decimal;
+}
+
+_Bool _arrFinishSumInt(const long long lanes[4], const ArrayItem* items, size_t count, long long* acc)
+{
+    long long res = *acc;
+    for (size_t i = 0; i < 4; i++)
+    {
+        if (__builtin_add_overflow(res, lanes[i], &res))
+            return 0;
+    }
+    for (size_t i = 0; i < count; i++)
+    {
+        if (__builtin_add_overflow(res, items[i].integer, &res))
+            return 0;
+    }
+    *acc = res;
+    return 1;
+}
+
+void _arrFinishFloat(double lanes[4], const ArrayItem* a, const ArrayItem* b, size_t start, size_t count)
+{
+    for (size_t i = start; i < count; i++)
+        lanes[i % 4] += b ? a[i].decimal * b[i].decimal : a[i].decimal;
+}
+
+double _arrFloat(double acc, const ArrayItem* a, const ArrayItem* b, size_t count)
+{
+    if (count < red_REASSOCIATE_MIN)
+    {
+        for (size_t i = 0; i < count; i++)
+            acc += b ? a[i].decimal * b[i].decimal : a[i].decimal;
+        return acc;
+    }
+
+    double lanes[4] = { 0 };
+    size_t done = 0;
+    switch (redIsa())
+    {
+#if red_X86
+    case RED_ISA_AVX2:
+        done = _arrFloatAvx2(a, b, count, lanes);
+        break;
+    case RED_ISA_SSE2:
+        done = _arrFloatSse2(a, b, count, lanes);
+        break;
+#endif // red_X86
+    default:
+        break;
+    }
+    _arrFinishFloat(lanes, a, b, done, count);
+    return acc + ((lanes[0] + lanes[1]) + (lanes[2] + lanes[3]));
+}
+
+#if red_X86
+
+_Bool _arrSumIntSse2(const ArrayItem* items, size_t count, long long* acc)
+{
+    __m128i low = _mm_setzero_si128();
+    __m128i high = _mm_setzero_si128();
+    __m128i overflow = _mm_setzero_si128();
+
+    size_t i = 0;
+    for (; i + 4 <= count; i += 4)
+    {
+        __m128i x = _mm_loadu_si128((const __m128i*)(items + i));
+        __m128i y = _mm_loadu_si128((const __m128i*)(items + i + 2));
+        __m128i sx = _mm_add_epi64(low, x);
+        __m128i sy = _mm_add_epi64(high, y);
+        // the addition overflowed if the result has different sign than both operands
+        overflow = _mm_or_si128(overflow, _mm_and_si128(_mm_xor_si128(low, sx), _mm_xor_si128(x, sx)));
+        overflow = _mm_or_si128(overflow, _mm_and_si128(_mm_xor_si128(high, sy), _mm_xor_si128(y, sy)));
+        low = sx;
+        high = sy;
+    }
+    if (_mm_movemask_pd(_mm_castsi128_pd(overflow)))
+        return 0;
+
+    long long lanes[4];
+    _mm_storeu_si128((__m128i*)lanes, low);
+    _mm_storeu_si128((__m128i*)(lanes + 2), high);
+    return _arrFinishSumInt(lanes, items + i, count - i, acc);
+}
+
+__attribute__((target("avx2")))
+_Bool _arrSumIntAvx2(const ArrayItem* items, size_t count, long long* acc)
+{
+    __m256i sum = _mm256_setzero_si256();
+    __m256i overflow = _mm256_setzero_si256();
+
+    size_t i = 0;
+    for (; i + 4 <= count; i += 4)
+    {
+        __m256i x = _mm256_loadu_si256((const __m256i*)(items + i));
+        __m256i s = _mm256_add_epi64(sum, x);
+        overflow = _mm256_or_si256(overflow, _mm256_and_si256(_mm256_xor_si256(sum, s), _mm256_xor_si256(x, s)));
+        sum = s;
+    }
+    if (_mm256_movemask_pd(_mm256_castsi256_pd(overflow)))
+        return 0;
+
+    long long lanes[4];
+    _mm256_storeu_si256((__m256i*)lanes, sum);
+    return _arrFinishSumInt(lanes, items + i, count - i, acc);
+}
+
+size_t _arrFloatSse2(const ArrayItem* a, const ArrayItem* b, size_t count, double lanes[4])
+{
+    __m128d low = _mm_loadu_pd(lanes);
+    __m128d high = _mm_loadu_pd(lanes + 2);
+
+    size_t i = 0;
+    for (; i + 4 <= count; i += 4)
+    {
+        __m128d x = _mm_loadu_pd(&a[i].decimal);
+        __m128d y = _mm_loadu_pd(&a[i + 2].decimal);
+        if (b)
+        {
+            x = _mm_mul_pd(x, _mm_loadu_pd(&b[i].decimal));
+            y = _mm_mul_pd(y, _mm_loadu_pd(&b[i + 2].decimal));
+        }
+        low = _mm_add_pd(low, x);
+        high = _mm_add_pd(high, y);
+    }
+
+    _mm_storeu_pd(lanes, low);
+    _mm_storeu_pd(lanes + 2, high);
+    return i;
+}
+
+__attribute__((target("avx2")))
+size_t _arrFloatAvx2(const ArrayItem* a, const ArrayItem* b, size_t count, double lanes[4])
+{
+    __m256d acc = _mm256_loadu_pd(lanes);
+
+    size_t i = 0;
+    for (; i + 4 <= count; i += 4)
+    {
+        __m256d x = _mm256_loadu_pd(&a[i].decimal);
+        // multiplication and addition are rounded separately like in the scalar loop
+        if (b)
+            x = _mm256_mul_pd(x, _mm256_loadu_pd(&b[i].decimal));
+        acc = _mm256_add_pd(acc, x);
+    }
+
+    _mm256_storeu_pd(lanes, acc);
+    return i;
+}
+
+size_t _arrExtremeSse2(const ArrayItem* items, size_t count, ArrayItem lanes[4], _Bool max)
+{
+    __m128d low = _mm_set_pd(lanes[1].decimal, lanes[0].decimal);
+    __m128d high = _mm_set_pd(lanes[3].decimal, lanes[2].decimal);
+
+    size_t i = 0;
+    for (; i + 4 <= count; i += 4)
+    {
+        // the item is selected only if it is smaller or larger, like in the scalar loop
+        __m128d x = _mm_loadu_pd(&items[i].decimal);
+        __m128d y = _mm_loadu_pd(&items[i + 2].decimal);
+        low = max ? _mm_max_pd(x, low) : _mm_min_pd(x, low);
+        high = max ? _mm_max_pd(y, high) : _mm_min_pd(y, high);
+    }
+
+    _mm_storeu_pd(&lanes[0].decimal, low);
+    _mm_storeu_pd(&lanes[2].decimal, high);
+    return i;
+}
+
+__attribute__((target("avx2")))
+size_t _arrExtremeAvx2(VariableType type, const ArrayItem* items, size_t count, ArrayItem lanes[4], _Bool max)
+{
+    size_t i = 0;
+    if (type == V_FLOAT)
+    {
+        __m256d m = _mm256_loadu_pd(&lanes[0].decimal);
+        for (; i + 4 <= count; i += 4)
+        {
+            __m256d x = _mm256_loadu_pd(&items[i].decimal);
+            m = max ? _mm256_max_pd(x, m) : _mm256_min_pd(x, m);
+        }
+        _mm256_storeu_pd(&lanes[0].decimal, m);
+        return i;
+    }
+
+    __m256i m = _mm256_loadu_si256((const __m256i*)lanes);
+    for (; i + 4 <= count; i += 4)
+    {
+        __m256i x = _mm256_loadu_si256((const __m256i*)(items + i));
+        __m256i better = max ? _mm256_cmpgt_epi64(x, m) : _mm256_cmpgt_epi64(m, x);
+        m = _mm256_blendv_epi8(m, x, better);
+    }
+    _mm256_storeu_si256((__m256i*)lanes, m);
+    return i;
+}
+
+size_t _arrMapIntSse2(ArrayItem* res, const ArrayItem* a, const ArrayItem* b, size_t step, size_t count, _Bool* overflow)
+{
+    __m128i ovf = _mm_setzero_si128();
+    __m128i scalar = _mm_set1_epi64x(b[0].integer);
+
+    size_t i = 0;
+    for (; i + 2 <= count; i += 2)
+    {
+        __m128i x = _mm_loadu_si128((const __m128i*)(a + i));
+        __m128i y = step ? _mm_loadu_si128((const __m128i*)(b + i)) : scalar;
+        __m128i s = _mm_add_epi64(x, y);
+        ovf = _mm_or_si128(ovf, _mm_and_si128(_mm_xor_si128(x, s), _mm_xor_si128(y, s)));
+        _mm_storeu_si128((__m128i*)(res + i), s);
+    }
+
+    *overflow = _mm_movemask_pd(_mm_castsi128_pd(ovf)) != 0;
+    return i;
+}
+
+__attribute__((target("avx2")))
+size_t _arrMapIntAvx2(ArrayItem* res, const ArrayItem* a, const ArrayItem* b, size_t step, size_t count, _Bool* overflow)
+{
+    __m256i ovf = _mm256_setzero_si256();
+    __m256i scalar = _mm256_set1_epi64x(b[0].integer);
+
+    size_t i = 0;
+    for (; i + 4 <= count; i += 4)
+    {
+        __m256i x = _mm256_loadu_si256((const __m256i*)(a + i));
+        __m256i y = step ? _mm256_loadu_si256((const __m256i*)(b + i)) : scalar;
+        __m256i s = _mm256_add_epi64(x, y);
+        ovf = _mm256_or_si256(ovf, _mm256_and_si256(_mm256_xor_si256(x, s), _mm256_xor_si256(y, s)));
+        _mm256_storeu_si256((__m256i*)(res + i), s);
+    }
+
+    *overflow = _mm256_movemask_pd(_mm256_castsi256_pd(ovf)) != 0;
+    return i;
+}
+
+size_t _arrMapFloatSse2(ArrayItem* res, const ArrayItem* a, const ArrayItem* b, size_t step, size_t count, _Bool multiply)
+{
+    __m128d scalar = _mm_set1_pd(b[0].decimal);
+
+    size_t i = 0;
+    for (; i + 2 <= count; i += 2)
+    {
+        __m128d x = _mm_loadu_pd(&a[i].decimal);
+        __m128d y = step ? _mm_loadu_pd(&b[i].decimal) : scalar;
+        _mm_storeu_pd(&res[i].decimal, multiply ? _mm_mul_pd(x, y) : _mm_add_pd(x, y));
+    }
+    return i;
+}
+
+__attribute__((target("avx2")))
+size_t _arrMapFloatAvx2(ArrayItem* res, const ArrayItem* a, const ArrayItem* b, size_t step, size_t count, _Bool multiply)
+{
+    __m256d scalar = _mm256_set1_pd(b[0].decimal);
+
+    size_t i = 0;
+    for (; i + 4 <= count; i += 4)
+    {
+        __m256d x = _mm256_loadu_pd(&a[i].decimal);
+        __m256d y = step ? _mm256_loadu_pd(&b[i].decimal) : scalar;
+        _mm256_storeu_pd(&res[i].decimal, multiply ? _mm256_mul_pd(x, y) : _mm256_add_pd(x, y));
+    }
+    return i;
+}
+
+#endif // red_X86
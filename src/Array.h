@@ -0,0 +1,142 @@
+#ifndef arr_ARRAY_INCLUDED
+#define arr_ARRAY_INCLUDED
+
+#include <stddef.h>
+
+#include "Gc.h"
+#include "Runtime.h"
+
+/**
+ * @brief item of array, the array decides which member is used
+ *
+ */
+typedef union ArrayItem
+{
+    long long integer;
+    double decimal;
+} ArrayItem;
+
+/**
+ * @brief items of packed array stored one after another, it is immutable
+ * so that the copies and slices can share it
+ *
+ */
+struct Array
+{
+    GcObject header;
+    // V_INT or V_FLOAT
+    VariableType type;
+    size_t length;
+    ArrayItem items[];
+};
+
+/**
+ * @brief creates array, the items are not initialized
+ *
+ * @param gc heap that owns the array
+ * @param type V_INT or V_FLOAT
+ * @param length number of items
+ * @return Array* new instance
+ */
+Array* arrCreate(Gc* gc, VariableType type, size_t length);
+
+/**
+ * @brief returns the first item of the view
+ *
+ * @param view the view
+ * @return ArrayItem* the item
+ */
+ArrayItem* arrItems(ArrayView view);
+
+/**
+ * @brief converts ints to floats
+ *
+ * @param res where to store the floats, may be the same as items
+ * @param items the ints
+ * @param count number of the items
+ */
+void arrToFloat(ArrayItem* res, const ArrayItem* items, size_t count);
+
+/**
+ * @brief adds ints to the accumulator
+ *
+ * @param items the ints
+ * @param count number of the items
+ * @param acc the accumulator, it is not changed if the sum overflows
+ * @return true the sum fits into int
+ * @return false the sum overflowed
+ */
+_Bool arrSumInt(const ArrayItem* items, size_t count, long long* acc);
+
+/**
+ * @brief sums floats, they are grouped the same way as by redSumFloat
+ *
+ * @param acc the accumulator
+ * @param items the floats
+ * @param count number of the items
+ * @return double the sum
+ */
+double arrSumFloat(double acc, const ArrayItem* items, size_t count);
+
+/**
+ * @brief adds the dot product of ints to the accumulator
+ *
+ * @param a first ints
+ * @param b second ints
+ * @param count number of the items of each
+ * @param acc the accumulator, it is not changed if the result overflows
+ * @return true the result fits into int
+ * @return false the result overflowed
+ */
+_Bool arrDotInt(const ArrayItem* a, const ArrayItem* b, size_t count, long long* acc);
+
+/**
+ * @brief computes the dot product of floats, the products are grouped
+ * the same way as the values by redSumFloat
+ *
+ * @param a first floats
+ * @param b second floats
+ * @param count number of the items of each
+ * @return double the dot product
+ */
+double arrDotFloat(const ArrayItem* a, const ArrayItem* b, size_t count);
+
+/**
+ * @brief finds the smallest or the largest item, NaN is never selected
+ * unless it is the first item
+ *
+ * @param type V_INT or V_FLOAT
+ * @param items the items
+ * @param count number of the items, must be at least 1
+ * @param max if true the largest item is found
+ * @return ArrayItem the item
+ */
+ArrayItem arrExtreme(VariableType type, const ArrayItem* items, size_t count, _Bool max);
+
+/**
+ * @brief adds or multiplies ints item by item
+ *
+ * @param res where to store the results, may be the same as a
+ * @param a first operands
+ * @param b second operands
+ * @param step 1 if b has count items, 0 if its only item is used for all
+ * @param count number of the results
+ * @param multiply if true the items are multiplied
+ * @return true all results fit into int
+ * @return false some result overflowed
+ */
+_Bool arrMapInt(ArrayItem* res, const ArrayItem* a, const ArrayItem* b, size_t step, size_t count, _Bool multiply);
+
+/**
+ * @brief adds or multiplies floats item by item
+ *
+ * @param res where to store the results, may be the same as a
+ * @param a first operands
+ * @param b second operands
+ * @param step 1 if b has count items, 0 if its only item is used for all
+ * @param count number of the results
+ * @param multiply if true the items are multiplied
+ */
+void arrMapFloat(ArrayItem* res, const ArrayItem* a, const ArrayItem* b, size_t step, size_t count, _Bool multiply);
+
+#endif // arr_ARRAY_INCLUDED
@@ -0,0 +1,613 @@
+#include "BigInt.h"
+
+#include <assert.h>
+#include <limits.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// largest power of ten that fits into digit, decimal representation is
+// created by this many decimal digits at once
+#define _BIG_DECIMAL_BASE 1000000000
+#define _BIG_DECIMAL_DIGITS 9
+
+/**
+ * @brief allocates number with zero digits
+ *
+ * @param gc heap that owns the number
+ * @param capacity number of digits
+ * @return BigInt* new instance with the length set to capacity
+ */
+BigInt* _bigCreate(Gc* gc, size_t capacity);
+
+/**
+ * @brief removes leading zeros from the number, zero is never negative
+ *
+ * @param b number to trim
+ * @return BigInt* the number
+ */
+BigInt* _bigTrim(BigInt* b);
+
+/**
+ * @brief converts the char to digit
+ *
+ * @param c char to convert
+ * @return int the value of the digit, 36 if it isn't digit
+ */
+int _bigDigit(char c);
+
+/**
+ * @brief compares the magnitudes of two numbers
+ *
+ * @param a digits of the first number without leading zeros
+ * @param an number of digits of a
+ * @param b digits of the second number without leading zeros
+ * @param bn number of digits of b
+ * @return int negative number, zero or positive number if a is smaller,
+ * equal or greater than b
+ */
+int _bigCompareDigits(const uint32_t* a, size_t an, const uint32_t* b, size_t bn);
+
+/**
+ * @brief adds digits to digits
+ *
+ * @param r digits to add to
+ * @param rn number of digits of r
+ * @param a digits to add
+ * @param an number of digits of a, at most rn
+ * @return uint32_t carry out of the last digit of r
+ */
+uint32_t _bigAddTo(uint32_t* r, size_t rn, const uint32_t* a, size_t an);
+
+/**
+ * @brief subtracts digits from digits, r must not be smaller than a
+ *
+ * @param r digits to subtract from
+ * @param rn number of digits of r
+ * @param a digits to subtract
+ * @param an number of digits of a, at most rn
+ */
+void _bigSubtractFrom(uint32_t* r, size_t rn, const uint32_t* a, size_t an);
+
+/**
+ * @brief multiplies digits by the schoolbook method
+ *
+ * @param r set to the product, has an + bn digits
+ * @param a first factor
+ * @param an number of digits of a
+ * @param b second factor
+ * @param bn number of digits of b
+ */
+void _bigMultiplySchool(uint32_t* r, const uint32_t* a, size_t an, const uint32_t* b, size_t bn);
+
+/**
+ * @brief multiplies digits, large factors are split by Karatsuba
+ *
+ * @param r set to the product, has an + bn digits
+ * @param a first factor
+ * @param an number of digits of a
+ * @param b second factor
+ * @param bn number of digits of b
+ */
+void _bigMultiplyDigits(uint32_t* r, const uint32_t* a, size_t an, const uint32_t* b, size_t bn);
+
+/**
+ * @brief divides digits by single digit
+ *
+ * @param q set to the quotient, has an digits, may be the same as a
+ * @param a the dividend
+ * @param an number of digits of a
+ * @param d the divisor, must not be zero
+ * @return uint32_t the remainder
+ */
+uint32_t _bigDivideSmall(uint32_t* q, const uint32_t* a, size_t an, uint32_t d);
+
+/**
+ * @brief divides digits by long division (Knuth's algorithm D)
+ *
+ * @param q set to the quotient, has an - bn + 1 digits
+ * @param rem set to the remainder if it isn't NULL, has bn digits
+ * @param a the dividend without leading zeros
+ * @param an number of digits of a, at least bn
+ * @param b the divisor without leading zeros
+ * @param bn number of digits of b, at least 2
+ */
+void _bigDivideDigits(uint32_t* q, uint32_t* rem, const uint32_t* a, size_t an, const uint32_t* b, size_t bn);
+
+/**
+ * @brief adds or subtracts two numbers
+ *
+ * @param gc heap that owns the result
+ * @param a first number
+ * @param b second number
+ * @param subtract if true b is subtracted
+ * @return BigInt* the result
+ */
+BigInt* _bigAddSigned(Gc* gc, BigInt* a, BigInt* b, _Bool subtract);
+
+BigInt* bigFromInt(Gc* gc, long long value)
+{
+    // the magnitude of the smallest int doesn't fit into int
+    unsigned long long magnitude = value < 0 ? 0ULL - (unsigned long long)value : (unsigned long long)value;
+    BigInt* b = _bigCreate(gc, 2);
+    b->negative = value < 0;
+    b->digits[0] = (uint32_t)magnitude;
+    b->digits[1] = (uint32_t)(magnitude >> 32);
+    return _bigTrim(b);
+}
+
+BigInt* bigParse(Gc* gc, const char* str, int base)
+{
+    assert(str);
+    assert(base >= 2 && base <= 36);
+
+    _Bool negative = *str == '-';
+    str += negative;
+
+    size_t count = 0;
+    while (_bigDigit(str[count]) < base)
+        count++;
+
+    // every digit adds at most 6 bits
+    BigInt* b = _bigCreate(gc, count * 6 / 32 + 1);
+    b->length = 0;
+    for (size_t i = 0; i < count; i++)
+    {
+        uint64_t carry = _bigDigit(str[i]);
+        for (size_t j = 0; j < b->length; j++)
+        {
+            uint64_t t = (uint64_t)b->digits[j] * base + carry;
+            b->digits[j] = (uint32_t)t;
+            carry = t >> 32;
+        }
+        if (carry)
+            b->digits[b->length++] = (uint32_t)carry;
+    }
+    b->negative = negative;
+    return _bigTrim(b);
+}
+
+_Bool bigToInt(BigInt* b, long long* value)
+{
+    if (b->length > 2)
+        return 0;
+
+    unsigned long long magnitude = 0;
+    for (size_t i = b->length; i > 0; i--)
+        magnitude = magnitude << 32 | b->digits[i - 1];
+
+    if (!b->negative)
+    {
+        if (magnitude > LLONG_MAX)
+            return 0;
+        *value = (long long)magnitude;
+        return 1;
+    }
+    if (magnitude > (unsigned long long)LLONG_MAX + 1)
+        return 0;
+    *value = magnitude == (unsigned long long)LLONG_MAX + 1 ? LLONG_MIN : -(long long)magnitude;
+    return 1;
+}
+
+double bigToFloat(BigInt* b)
+{
+    double d = 0;
+    for (size_t i = b->length; i > 0; i--)
+        d = d * 4294967296.0 + b->digits[i - 1];
+    return b->negative ? -d : d;
+}
+
+String bigToString(BigInt* b)
+{
+    if (b->length == 0)
+        return strLit("0");
+
+    uint32_t* rest = malloc(sizeof(uint32_t) * b->length);
+    assert(rest);
+    memcpy(rest, b->digits, sizeof(uint32_t) * b->length);
+    size_t length = b->length;
+
+    // groups of decimal digits, the least significant first, every
+    // digit has less than 10 decimal digits
+    uint32_t* groups = malloc(sizeof(uint32_t) * (b->length * 10 / _BIG_DECIMAL_DIGITS + 1));
+    assert(groups);
+    size_t count = 0;
+    while (length)
+    {
+        groups[count++] = _bigDivideSmall(rest, rest, length, _BIG_DECIMAL_BASE);
+        while (length && rest[length - 1] == 0)
+            length--;
+    }
+
+    char* c = malloc(count * _BIG_DECIMAL_DIGITS + 2);
+    assert(c);
+    size_t pos = 0;
+    if (b->negative)
+        c[pos++] = '-';
+    pos += sprintf(c + pos, "%u", (unsigned)groups[count - 1]);
+    for (size_t i = count - 1; i > 0; i--)
+        pos += sprintf(c + pos, "%09u", (unsigned)groups[i - 1]);
+
+    free(rest);
+    free(groups);
+
+    String str =
+    {
+        .c = c,
+        .length = pos,
+    };
+    return str;
+}
+
+int bigCompare(BigInt* a, BigInt* b)
+{
+    if (a->negative != b->negative)
+        return a->negative ? -1 : 1;
+    int cmp = _bigCompareDigits(a->digits, a->length, b->digits, b->length);
+    return a->negative ? -cmp : cmp;
+}
+
+size_t bigHash(BigInt* b)
+{
+    // FNV-1a over the sign and the digits
+    size_t hash = 14695981039346656037ULL;
+    hash = (hash ^ b->negative) * 1099511628211ULL;
+    for (size_t i = 0; i < b->length; i++)
+        hash = (hash ^ b->digits[i]) * 1099511628211ULL;
+    return hash;
+}
+
+BigInt* bigNegate(Gc* gc, BigInt* b)
+{
+    BigInt* r = _bigCreate(gc, b->length);
+    memcpy(r->digits, b->digits, sizeof(uint32_t) * b->length);
+    r->negative = !b->negative;
+    return _bigTrim(r);
+}
+
+BigInt* bigAdd(Gc* gc, BigInt* a, BigInt* b)
+{
+    return _bigAddSigned(gc, a, b, 0);
+}
+
+BigInt* bigSubtract(Gc* gc, BigInt* a, BigInt* b)
+{
+    return _bigAddSigned(gc, a, b, 1);
+}
+
+BigInt* bigMultiply(Gc* gc, BigInt* a, BigInt* b)
+{
+    if (a->length == 0 || b->length == 0)
+        return _bigTrim(_bigCreate(gc, 0));
+
+    BigInt* r = _bigCreate(gc, a->length + b->length);
+    _bigMultiplyDigits(r->digits, a->digits, a->length, b->digits, b->length);
+    r->negative = a->negative != b->negative;
+    return _bigTrim(r);
+}
+
+BigInt* bigDivide(Gc* gc, BigInt* a, BigInt* b, BigInt** remainder)
+{
+    assert(b->length);
+
+    BigInt* q;
+    BigInt* r = NULL;
+    if (_bigCompareDigits(a->digits, a->length, b->digits, b->length) < 0)
+    {
+        q = _bigCreate(gc, 0);
+        if (remainder)
+        {
+            r = _bigCreate(gc, a->length);
+            memcpy(r->digits, a->digits, sizeof(uint32_t) * a->length);
+        }
+    }
+    else if (b->length == 1)
+    {
+        q = _bigCreate(gc, a->length);
+        uint32_t rem = _bigDivideSmall(q->digits, a->digits, a->length, b->digits[0]);
+        if (remainder)
+        {
+            r = _bigCreate(gc, 1);
+            r->digits[0] = rem;
+        }
+    }
+    else
+    {
+        q = _bigCreate(gc, a->length - b->length + 1);
+        if (remainder)
+            r = _bigCreate(gc, b->length);
+        _bigDivideDigits(q->digits, r ? r->digits : NULL, a->digits, a->length, b->digits, b->length);
+    }
+
+    q->negative = a->negative != b->negative;
+    if (remainder)
+    {
+        r->negative = a->negative;
+        *remainder = _bigTrim(r);
+    }
+    return _bigTrim(q);
+}
+
+BigInt* _bigCreate(Gc* gc, size_t capacity)
+{
+    BigInt* b = gcAlloc(gc, GC_BIGINT, sizeof(BigInt) + sizeof(uint32_t) * capacity);
+    b->negative = 0;
+    b->length = capacity;
+    memset(b->digits, 0, sizeof(uint32_t) * capacity);
+    return b;
+}
+
+BigInt* _bigTrim(BigInt* b)
+{
+    while (b->length && b->digits[b->length - 1] == 0)
+        b->length--;
+    if (b->length == 0)
+        b->negative = 0;
+    return b;
+}
+
+int _bigDigit(char c)
+{
+    if (c >= '0' && c <= '9')
+        return c - '0';
+    if (c >= 'A' && c <= 'Z')
+        return c - 'A' + 10;
+    if (c >= 'a' && c <= 'z')
+        return c - 'a' + 10;
+    return 36;
+}
+
+int _bigCompareDigits(const uint32_t* a, size_t an, const uint32_t* b, size_t bn)
+{
+    if (an != bn)
+        return an < bn ? -1 : 1;
+    for (size_t i = an; i > 0; i--)
+    {
+        if (a[i - 1] != b[i - 1])
+            return a[i - 1] < b[i - 1] ? -1 : 1;
+    }
+    return 0;
+}
+
+uint32_t _bigAddTo(uint32_t* r, size_t rn, const uint32_t* a, size_t an)
+{
+    assert(an <= rn);
+
+    uint64_t carry = 0;
+    size_t i = 0;
+    for (; i < an; i++)
+    {
+        uint64_t t = (uint64_t)r[i] + a[i] + carry;
+        r[i] = (uint32_t)t;
+        carry = t >> 32;
+    }
+    for (; carry && i < rn; i++)
+    {
+        uint64_t t = (uint64_t)r[i] + carry;
+        r[i] = (uint32_t)t;
+        carry = t >> 32;
+    }
+    return (uint32_t)carry;
+}
+
+void _bigSubtractFrom(uint32_t* r, size_t rn, const uint32_t* a, size_t an)
+{
+    assert(an <= rn);
+
+    uint64_t borrow = 0;
+    size_t i = 0;
+    for (; i < an; i++)
+    {
+        uint64_t t = (uint64_t)r[i] - a[i] - borrow;
+        r[i] = (uint32_t)t;
+        borrow = t >> 32 ? 1 : 0;
+    }
+    for (; borrow && i < rn; i++)
+    {
+        uint64_t t = (uint64_t)r[i] - borrow;
+        r[i] = (uint32_t)t;
+        borrow = t >> 32 ? 1 : 0;
+    }
+    assert(!borrow);
+}
+
+void _bigMultiplySchool(uint32_t* r, const uint32_t* a, size_t an, const uint32_t* b, size_t bn)
+{
+    memset(r, 0, sizeof(uint32_t) * (an + bn));
+    for (size_t i = 0; i < an; i++)
+    {
+        uint64_t carry = 0;
+        for (size_t j = 0; j < bn; j++)
+        {
+            uint64_t t = (uint64_t)a[i] * b[j] + r[i + j] + carry;
+            r[i + j] = (uint32_t)t;
+            carry = t >> 32;
+        }
+        r[i + bn] = (uint32_t)carry;
+    }
+}
+
+void _bigMultiplyDigits(uint32_t* r, const uint32_t* a, size_t an, const uint32_t* b, size_t bn)
+{
+    if (an < bn)
+    {
+        const uint32_t* t = a;
+        a = b;
+        b = t;
+        size_t tn = an;
+        an = bn;
+        bn = tn;
+    }
+
+    if (bn < big_KARATSUBA_THRESHOLD)
+    {
+        _bigMultiplySchool(r, a, an, b, bn);
+        return;
+    }
+
+    if (an >= 2 * bn)
+    {
+        // the longer factor is multiplied by parts as long as the shorter one
+        memset(r, 0, sizeof(uint32_t) * (an + bn));
+        uint32_t* part = malloc(sizeof(uint32_t) * 2 * bn);
+        assert(part);
+        for (size_t i = 0; i < an; i += bn)
+        {
+            size_t length = an - i < bn ? an - i : bn;
+            _bigMultiplyDigits(part, a + i, length, b, bn);
+            _bigAddTo(r + i, an + bn - i, part, length + bn);
+        }
+        free(part);
+        return;
+    }
+
+    // with a = a1 * B^m + a0 and b = b1 * B^m + b0:
+    // a * b = a1 * b1 * B^2m + ((a0 + a1) * (b0 + b1) - a0 * b0 - a1 * b1) * B^m + a0 * b0
+    // b is longer than m so b1 isn't empty
+    size_t m = an / 2;
+    _bigMultiplyDigits(r, a, m, b, m);
+    _bigMultiplyDigits(r + 2 * m, a + m, an - m, b + m, bn - m);
+
+    size_t sn = an - m + 1;
+    size_t tn = (bn - m > m ? bn - m : m) + 1;
+    uint32_t* sa = calloc(2 * (sn + tn), sizeof(uint32_t));
+    assert(sa);
+    uint32_t* sb = sa + sn;
+    uint32_t* middle = sb + tn;
+
+    memcpy(sa, a + m, sizeof(uint32_t) * (an - m));
+    sa[sn - 1] = _bigAddTo(sa, sn - 1, a, m);
+    if (bn - m > m)
+    {
+        memcpy(sb, b + m, sizeof(uint32_t) * (bn - m));
+        sb[tn - 1] = _bigAddTo(sb, tn - 1, b, m);
+    }
+    else
+    {
+        memcpy(sb, b, sizeof(uint32_t) * m);
+        sb[tn - 1] = _bigAddTo(sb, tn - 1, b + m, bn - m);
+    }
+
+    _bigMultiplyDigits(middle, sa, sn, sb, tn);
+    _bigSubtractFrom(middle, sn + tn, r, 2 * m);
+    _bigSubtractFrom(middle, sn + tn, r + 2 * m, an + bn - 2 * m);
+
+    // the middle term is shorter than its buffer
+    size_t length = sn + tn;
+    while (length && middle[length - 1] == 0)
+        length--;
+    _bigAddTo(r + m, an + bn - m, middle, length);
+    free(sa);
+}
+
+uint32_t _bigDivideSmall(uint32_t* q, const uint32_t* a, size_t an, uint32_t d)
+{
+    assert(d);
+
+    uint64_t rem = 0;
+    for (size_t i = an; i > 0; i--)
+    {
+        uint64_t t = rem << 32 | a[i - 1];
+        q[i - 1] = (uint32_t)(t / d);
+        rem = t % d;
+    }
+    return (uint32_t)rem;
+}
+
+void _bigDivideDigits(uint32_t* q, uint32_t* rem, const uint32_t* a, size_t an, const uint32_t* b, size_t bn)
+{
+    assert(bn >= 2 && an >= bn);
+
+    // shift both numbers so that the top bit of the divisor is set, then
+    // the estimated quotient digits are off by at most two
+    int shift = 0;
+    while (!(b[bn - 1] << shift & 0x80000000u))
+        shift++;
+
+    uint32_t* v = malloc(sizeof(uint32_t) * (bn + an + 1));
+    assert(v);
+    uint32_t* u = v + bn;
+    for (size_t i = bn - 1; i > 0; i--)
+        v[i] = b[i] << shift | (shift ? b[i - 1] >> (32 - shift) : 0);
+    v[0] = b[0] << shift;
+    u[an] = shift ? a[an - 1] >> (32 - shift) : 0;
+    for (size_t i = an - 1; i > 0; i--)
+        u[i] = a[i] << shift | (shift ? a[i - 1] >> (32 - shift) : 0);
+    u[0] = a[0] << shift;
+
+    const uint64_t base = 1ULL << 32;
+    for (size_t j = an - bn + 1; j > 0; j--)
+    {
+        size_t k = j - 1;
+        uint64_t top = (uint64_t)u[k + bn] << 32 | u[k + bn - 1];
+        uint64_t qhat = top / v[bn - 1];
+        uint64_t rhat = top % v[bn - 1];
+        while (qhat >= base || qhat * v[bn - 2] > (rhat << 32 | u[k + bn - 2]))
+        {
+            qhat--;
+            rhat += v[bn - 1];
+            if (rhat >= base)
+                break;
+        }
+
+        // subtract qhat times the divisor
+        int64_t borrow = 0;
+        int64_t t;
+        for (size_t i = 0; i < bn; i++)
+        {
+            uint64_t p = qhat * v[i];
+            t = (int64_t)u[i + k] - borrow - (int64_t)(p & 0xFFFFFFFFu);
+            u[i + k] = (uint32_t)t;
+            borrow = (int64_t)(p >> 32) - (t >> 32);
+        }
+        t = (int64_t)u[k + bn] - borrow;
+        u[k + bn] = (uint32_t)t;
+
+        // the estimate was one too large, add the divisor back
+        if (t < 0)
+        {
+            qhat--;
+            uint64_t carry = 0;
+            for (size_t i = 0; i < bn; i++)
+            {
+                uint64_t s = (uint64_t)u[i + k] + v[i] + carry;
+                u[i + k] = (uint32_t)s;
+                carry = s >> 32;
+            }
+            u[k + bn] += (uint32_t)carry;
+        }
+        q[k] = (uint32_t)qhat;
+    }
+
+    if (rem)
+    {
+        for (size_t i = 0; i < bn; i++)
+            rem[i] = u[i] >> shift | (shift ? u[i + 1] << (32 - shift) : 0);
+    }
+    free(v);
+}
+
+BigInt* _bigAddSigned(Gc* gc, BigInt* a, BigInt* b, _Bool subtract)
+{
+    _Bool bNegative = b->negative != subtract;
+    if (a->negative == bNegative)
+    {
+        BigInt* longer = a->length >= b->length ? a : b;
+        BigInt* shorter = longer == a ? b : a;
+        BigInt* r = _bigCreate(gc, longer->length + 1);
+        memcpy(r->digits, longer->digits, sizeof(uint32_t) * longer->length);
+        r->digits[longer->length] = _bigAddTo(r->digits, longer->length, shorter->digits, shorter->length);
+        r->negative = a->negative;
+        return _bigTrim(r);
+    }
+
+    // the smaller magnitude is subtracted from the larger one
+    _Bool aLarger = _bigCompareDigits(a->digits, a->length, b->digits, b->length) >= 0;
+    BigInt* larger = aLarger ? a : b;
+    BigInt* smaller = aLarger ? b : a;
+    BigInt* r = _bigCreate(gc, larger->length);
+    memcpy(r->digits, larger->digits, sizeof(uint32_t) * larger->length);
+    _bigSubtractFrom(r->digits, r->length, smaller->digits, smaller->length);
+    r->negative = aLarger ? a->negative : bNegative;
+    return _bigTrim(r);
+}
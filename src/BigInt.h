@@ -0,0 +1,146 @@
+#ifndef big_BIG_INT_INCLUDED
+#define big_BIG_INT_INCLUDED
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "Gc.h"
+#include "String.h"
+
+#ifndef big_KARATSUBA_THRESHOLD
+// numbers with fewer digits than this are multiplied by the schoolbook
+// method, larger ones are split by Karatsuba
+#define big_KARATSUBA_THRESHOLD 32
+#endif // big_KARATSUBA_THRESHOLD
+
+/**
+ * @brief integer of any size, it is immutable so that it can be shared
+ * by all copies of the value
+ *
+ */
+typedef struct BigInt
+{
+    GcObject header;
+    _Bool negative;
+    // number of digits without leading zeros, 0 for zero
+    size_t length;
+    // digits in base 2^32, the least significant first
+    uint32_t digits[];
+} BigInt;
+
+/**
+ * @brief creates bigint with the value of int
+ *
+ * @param gc heap that owns the number, NULL if it is freed with gcFreeObject
+ * @param value the value
+ * @return BigInt* new instance
+ */
+BigInt* bigFromInt(Gc* gc, long long value);
+
+/**
+ * @brief reads number from its digits, reading stops at the first
+ * character that isn't digit of the base
+ *
+ * @param gc heap that owns the number, NULL if it is freed with gcFreeObject
+ * @param str the digits, may start with '-'
+ * @param base base of the digits, between 2 and 36
+ * @return BigInt* new instance
+ */
+BigInt* bigParse(Gc* gc, const char* str, int base);
+
+/**
+ * @brief converts the number to int if it fits
+ *
+ * @param b number to convert
+ * @param value set to the value if it fits
+ * @return true the number fits into int
+ * @return false the number is too large
+ */
+_Bool bigToInt(BigInt* b, long long* value);
+
+/**
+ * @brief converts the number to float, it is infinity if it is too large
+ *
+ * @param b number to convert
+ * @return double the value
+ */
+double bigToFloat(BigInt* b);
+
+/**
+ * @brief creates decimal representation of the number
+ *
+ * @param b number to convert
+ * @return String the digits, must be freed with strFree
+ */
+String bigToString(BigInt* b);
+
+/**
+ * @brief compares two numbers
+ *
+ * @param a first number
+ * @param b second number
+ * @return int negative number, zero or positive number if a is smaller,
+ * equal or greater than b
+ */
+int bigCompare(BigInt* a, BigInt* b);
+
+/**
+ * @brief computes hash of the number
+ *
+ * @param b the number
+ * @return size_t the hash
+ */
+size_t bigHash(BigInt* b);
+
+/**
+ * @brief changes the sign of the number
+ *
+ * @param gc heap that owns the result
+ * @param b the number
+ * @return BigInt* the negated number
+ */
+BigInt* bigNegate(Gc* gc, BigInt* b);
+
+/**
+ * @brief adds two numbers
+ *
+ * @param gc heap that owns the result
+ * @param a first number
+ * @param b second number
+ * @return BigInt* the sum
+ */
+BigInt* bigAdd(Gc* gc, BigInt* a, BigInt* b);
+
+/**
+ * @brief subtracts two numbers
+ *
+ * @param gc heap that owns the result
+ * @param a first number
+ * @param b number subtracted from a
+ * @return BigInt* the difference
+ */
+BigInt* bigSubtract(Gc* gc, BigInt* a, BigInt* b);
+
+/**
+ * @brief multiplies two numbers
+ *
+ * @param gc heap that owns the result
+ * @param a first number
+ * @param b second number
+ * @return BigInt* the product
+ */
+BigInt* bigMultiply(Gc* gc, BigInt* a, BigInt* b);
+
+/**
+ * @brief divides two numbers, the quotient is rounded towards zero and
+ * the remainder has the sign of a like with ints
+ *
+ * @param gc heap that owns the results
+ * @param a the dividend
+ * @param b the divisor, must not be zero
+ * @param remainder set to the remainder if it isn't NULL
+ * @return BigInt* the quotient
+ */
+BigInt* bigDivide(Gc* gc, BigInt* a, BigInt* b, BigInt** remainder);
+
+#endif // big_BIG_INT_INCLUDED
@@ -1,33 +1,389 @@
 #include "BuiltinFunctions.h"
 
 #include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
 #include <assert.h>
+#include <limits.h>
 
 #include "List.h"
 #include "Runtime.h"
 #include "Terminal.h"
+#include "Memo.h"
+#include "BigInt.h"
+#include "Reduce.h"
+#include "Array.h"
+#include "Evaluator.h"
+#include "Pool.h"
+
+/**
+ * @brief call of pmap, pfor or preduce shared by the threads that run it
+ *
+ */
+typedef struct _BifParallel
+{
+    // runtime that called the builtin
+    Runtime* r;
+    // threads that run the call, NULL if it runs on the runtime of the caller
+    Pool* pool;
+    // the called function
+    Function* function;
+    // items of the array, NULL if the items are the ints from 0
+    ArrayItem* items;
+    // V_INT or V_FLOAT
+    VariableType type;
+    size_t count;
+    // pfor: only the exceptions are kept
+    _Bool discard;
+    // pmap and pfor: result of each item, it doesn't reference heap objects
+    Variable* results;
+    // preduce: thread whose locals hold the result of each group
+    size_t* threads;
+    // preduce: position of the result of each group in the locals
+    size_t* slots;
+} _BifParallel;
+
+/**
+ * @brief adds single value to the result of addition, bool, int and float
+ * are promoted as in bifAdd and the other types are ignored
+ *
+ * @param r runtime whose heap owns the bigints
+ * @param res the result so far
+ * @param v the added value
+ */
+void _bifAddValue(Runtime* r, Variable* res, Variable v);
+
+/**
+ * @brief multiplies the result of multiplication by single value, bool,
+ * int and float are promoted as in bifMultiply and the other types are ignored
+ *
+ * @param r runtime whose heap owns the bigints
+ * @param res the result so far
+ * @param v the multiplier
+ */
+void _bifMultiplyValue(Runtime* r, Variable* res, Variable v);
+
+/**
+ * @brief converts int or bigint to bigint
+ *
+ * @param r runtime whose heap owns the new bigint
+ * @param v the value
+ * @return BigInt* the value as bigint
+ */
+BigInt* _bifBig(Runtime* r, Variable v);
+
+/**
+ * @brief converts bool, int, bigint or float to float
+ *
+ * @param v the value
+ * @return double the value as float
+ */
+double _bifFloat(Variable v);
+
+/**
+ * @brief creates int if the bigint fits into int, otherwise bigint
+ *
+ * @param b the value
+ * @return Variable int or bigint variable
+ */
+Variable _bifInteger(BigInt* b);
+
+/**
+ * @brief adds, subtracts or multiplies two ints or bigints, ints are computed
+ * directly and only results that overflow are computed as bigints
+ *
+ * @param r runtime whose heap owns the bigints
+ * @param a first argument
+ * @param b second argument
+ * @param op bigAdd, bigSubtract or bigMultiply
+ * @return Variable the result, int if it fits
+ */
+Variable _bifIntegerOp(Runtime* r, Variable a, Variable b, BigInt* (*op)(Gc* gc, BigInt* a, BigInt* b));
+
+/**
+ * @brief divides two ints or bigints
+ *
+ * @param r runtime whose heap owns the bigints
+ * @param a the dividend
+ * @param b the divisor, must not be zero
+ * @param modulo if true the result is the remainder instead of the quotient
+ * @return Variable the result, int if it fits
+ */
+Variable _bifIntegerDivide(Runtime* r, Variable a, Variable b, _Bool modulo);
+
+/**
+ * @brief compares numbers where at least one is bigint
+ *
+ * @param a first bool, int or bigint
+ * @param b second bool, int or bigint
+ * @return int negative number, zero or positive number if a is smaller,
+ * equal or greater than b
+ */
+int _bifCompareBig(Variable a, Variable b);
+
+/**
+ * @brief compares the two arguments of comparison and frees them,
+ * bool, int and float are compared by their numeric value
+ *
+ * @param par arguments of the comparison
+ * @param equality if true, values that cannot be compared are unequal
+ * @param cmp set to negative number, zero or positive number if the first
+ * argument is smaller, equal or greater than the second
+ * @param err set to the exception if the arguments cannot be compared
+ * @return true the arguments were compared
+ * @return false the arguments cannot be compared
+ */
+_Bool _bifCompare(List par, _Bool equality, int* cmp, Variable* err);
+
+/**
+ * @brief gets statistic of the memoized function that is the only
+ * argument and frees the arguments
+ *
+ * @param par arguments of the statistics builtin
+ * @param hits true for the number of hits, false for the number of misses
+ * @return Variable the statistic or exception if the argument isn't memoized function
+ */
+Variable _bifMemoStat(List par, _Bool hits);
+
+/**
+ * @brief checks the number of arguments of array builtin and that the
+ * first one is array, if they are wrong the arguments are freed
+ *
+ * @param par arguments of the builtin
+ * @param min minimal number of arguments
+ * @param max maximal number of arguments
+ * @param err set to the exception if the arguments are wrong
+ * @return true the arguments are right
+ * @return false the arguments are wrong
+ */
+_Bool _bifArrayArgs(List par, size_t min, size_t max, Variable* err);
+
+/**
+ * @brief reads index argument of array builtin
+ *
+ * @param v the argument
+ * @param limit largest valid index
+ * @param index set to the index
+ * @param err set to the exception if the argument isn't valid index
+ * @return true the index is valid
+ * @return false the argument isn't int or is out of the range
+ */
+_Bool _bifIndex(Variable v, size_t limit, size_t* index, Variable* err);
+
+/**
+ * @brief adds or multiplies array item by item with array or number and
+ * frees the arguments, the result is float array if any operand is float
+ *
+ * @param r runtime whose heap owns the result
+ * @param par the two arguments
+ * @param multiply if true the items are multiplied
+ * @return Variable the new array or exception
+ */
+Variable _bifMap(Runtime* r, List par, _Bool multiply);
+
+/**
+ * @brief finds the smallest or the largest item of array and frees the arguments
+ *
+ * @param par the array
+ * @param max if true the largest item is found
+ * @return Variable the item or exception
+ */
+Variable _bifExtreme(List par, _Bool max);
+
+/**
+ * @brief checks whether two arrays have the same length and their items
+ * are equal by value
+ *
+ * @param a first array
+ * @param b second array
+ * @return true the arrays are equal
+ * @return false the arrays differ
+ */
+_Bool _bifArrayEquals(ArrayView a, ArrayView b);
+
+/**
+ * @brief checks the arguments of parallel builtin and prepares the call,
+ * if they are wrong the arguments are freed
+ *
+ * @param r runtime that called the builtin
+ * @param par function and array or number of items
+ * @param p set to the call
+ * @param err set to the exception if the arguments are wrong
+ * @return true the arguments are right
+ * @return false the arguments are wrong
+ */
+_Bool _bifParallelStart(Runtime* r, List par, _BifParallel* p, Variable* err);
+
+/**
+ * @brief calls action for every index from 0 to count - 1 on the threads
+ * of the pool or one after another on the runtime of the caller
+ *
+ * @param p the call
+ * @param action what to do with each index
+ * @param count number of the indices
+ */
+void _bifParallelRun(_BifParallel* p, PoolAction action, size_t count);
+
+/**
+ * @brief returns the runtime used by the thread
+ *
+ * @param p the call
+ * @param thread index of the thread
+ * @return Runtime* runtime of the thread
+ */
+Runtime* _bifParallelRuntime(_BifParallel* p, size_t thread);
+
+/**
+ * @brief calls the function of parallel builtin on the thread
+ *
+ * @param p the call
+ * @param thread index of the thread
+ * @param par arguments, this takes their ownership
+ * @return Variable result of the function
+ */
+Variable _bifParallelCall(_BifParallel* p, size_t thread, List par);
+
+/**
+ * @brief returns item of parallel builtin
+ *
+ * @param p the call
+ * @param index index of the item
+ * @return Variable int or float
+ */
+Variable _bifItem(_BifParallel* p, size_t index);
+
+/**
+ * @brief calls the function of pmap or pfor with one item and stores the result
+ *
+ * @param context the call
+ * @param thread index of the thread
+ * @param index index of the item
+ */
+void _bifMapItem(void* context, size_t thread, size_t index);
+
+/**
+ * @brief reduces group of consecutive items of preduce from left to right,
+ * the result is stored in the locals of the thread
+ *
+ * @param context the call
+ * @param thread index of the thread
+ * @param group index of the group
+ */
+void _bifReduceGroup(void* context, size_t thread, size_t group);
+
+/**
+ * @brief returns the result of group of preduce
+ *
+ * @param p the call
+ * @param group index of the group
+ * @return Variable* the result in the locals of the thread that computed it
+ */
+Variable* _bifGroup(_BifParallel* p, size_t group);
+
+/**
+ * @brief runs pmap or pfor and frees the arguments
+ *
+ * @param r runtime that called the builtin
+ * @param par function and array or number of items
+ * @param discard if true the results are discarded
+ * @return Variable array of the results, nothing or the exception of the
+ * first item whose call failed
+ */
+Variable _bifParallelMap(Runtime* r, List par, _Bool discard);
+
+/**
+ * @brief copies the heap objects of result of parallel call that belong
+ * to heaps of the threads of the pool to the heap of the runtime
+ *
+ * @param r runtime that started the pool
+ * @param v the result, this takes its ownership
+ * @return Variable the result that can outlive the heaps of the threads
+ */
+Variable _bifTransfer(Runtime* r, Variable v);
+
+/**
+ * @brief adds the builtin functions to the list of global variables
+ *
+ * @param globals where to add the builtins
+ */
+void _bifAddBuiltins(List* globals);
 
 void bifRegisterBuiltins(Runtime* r)
 {
-    listAdd(r->variables, rtCreateFunctionVariable(strLit("print"), rtCreateFunction(bifPrint, listNew(String))), Variable);
-    listAdd(r->variables, rtCreateFunctionVariable(strLit("println"), rtCreateFunction(bifPrintln, listNew(String))), Variable);
-    listAdd(r->variables, rtCreateFunctionVariable(strLit("+"), rtCreateFunction(bifAdd, listNew(String))), Variable);
-    listAdd(r->variables, rtCreateFunctionVariable(strLit("*"), rtCreateFunction(bifMultiply, listNew(String))), Variable);
-    listAdd(r->variables, rtCreateFunctionVariable(strLit("-"), rtCreateFunction(bifSubtract, listNew(String))), Variable);
-    listAdd(r->variables, rtCreateFunctionVariable(strLit("/"), rtCreateFunction(bifDivide, listNew(String))), Variable);
-    listAdd(r->variables, rtCreateFunctionVariable(strLit("%"), rtCreateFunction(bifMod, listNew(String))), Variable);
+    _bifAddBuiltins(&r->variables);
+}
+
+List bifCreateBuiltins(void)
+{
+    List builtins = listNew(Variable);
+    _bifAddBuiltins(&builtins);
+    for (size_t i = 0; i < builtins.length; i++)
+        ((Variable*)listGetP(builtins, i))->constant = 1;
+    return builtins;
+}
+
+void bifFreeBuiltins(List builtins)
+{
+    for (size_t i = 0; i < builtins.length; i++)
+        ((Variable*)listGetP(builtins, i))->constant = 0;
+    listDeepFree(builtins, Variable, v, rtFreeVariable(v));
+}
+
+void _bifAddBuiltins(List* globals)
+{
+    listAdd(*globals, rtCreateFunctionVariable(strLit("print"), rtCreateFunction(bifPrint, listNew(String))), Variable);
+    listAdd(*globals, rtCreateFunctionVariable(strLit("println"), rtCreateFunction(bifPrintln, listNew(String))), Variable);
+    listAdd(*globals, rtCreateFunctionVariable(strLit("+"), rtCreateFunction(bifAdd, listNew(String))), Variable);
+    listAdd(*globals, rtCreateFunctionVariable(strLit("*"), rtCreateFunction(bifMultiply, listNew(String))), Variable);
+    listAdd(*globals, rtCreateFunctionVariable(strLit("-"), rtCreateFunction(bifSubtract, listNew(String))), Variable);
+    listAdd(*globals, rtCreateFunctionVariable(strLit("/"), rtCreateFunction(bifDivide, listNew(String))), Variable);
+    listAdd(*globals, rtCreateFunctionVariable(strLit("%"), rtCreateFunction(bifMod, listNew(String))), Variable);
+    listAdd(*globals, rtCreateFunctionVariable(strLit("="), rtCreateFunction(bifEqual, listNew(String))), Variable);
+    listAdd(*globals, rtCreateFunctionVariable(strLit("<"), rtCreateFunction(bifLess, listNew(String))), Variable);
+    listAdd(*globals, rtCreateFunctionVariable(strLit("<="), rtCreateFunction(bifLessEqual, listNew(String))), Variable);
+    listAdd(*globals, rtCreateFunctionVariable(strLit(">"), rtCreateFunction(bifGreater, listNew(String))), Variable);
+    listAdd(*globals, rtCreateFunctionVariable(strLit(">="), rtCreateFunction(bifGreaterEqual, listNew(String))), Variable);
+    listAdd(*globals, rtCreateFunctionVariable(strLit("memo-hits"), rtCreateFunction(bifMemoHits, listNew(String))), Variable);
+    listAdd(*globals, rtCreateFunctionVariable(strLit("memo-misses"), rtCreateFunction(bifMemoMisses, listNew(String))), Variable);
+    listAdd(*globals, rtCreateFunctionVariable(strLit("array"), rtCreateFunction(bifArray, listNew(String))), Variable);
+    listAdd(*globals, rtCreateFunctionVariable(strLit("len"), rtCreateFunction(bifLen, listNew(String))), Variable);
+    listAdd(*globals, rtCreateFunctionVariable(strLit("get"), rtCreateFunction(bifGet, listNew(String))), Variable);
+    listAdd(*globals, rtCreateFunctionVariable(strLit("slice"), rtCreateFunction(bifSlice, listNew(String))), Variable);
+    listAdd(*globals, rtCreateFunctionVariable(strLit("map+"), rtCreateFunction(bifMapAdd, listNew(String))), Variable);
+    listAdd(*globals, rtCreateFunctionVariable(strLit("map*"), rtCreateFunction(bifMapMultiply, listNew(String))), Variable);
+    listAdd(*globals, rtCreateFunctionVariable(strLit("sum"), rtCreateFunction(bifSum, listNew(String))), Variable);
+    listAdd(*globals, rtCreateFunctionVariable(strLit("dot"), rtCreateFunction(bifDot, listNew(String))), Variable);
+    listAdd(*globals, rtCreateFunctionVariable(strLit("min"), rtCreateFunction(bifMin, listNew(String))), Variable);
+    listAdd(*globals, rtCreateFunctionVariable(strLit("max"), rtCreateFunction(bifMax, listNew(String))), Variable);
+    listAdd(*globals, rtCreateFunctionVariable(strLit("pmap"), rtCreateFunction(bifPmap, listNew(String))), Variable);
+    listAdd(*globals, rtCreateFunctionVariable(strLit("pfor"), rtCreateFunction(bifPfor, listNew(String))), Variable);
+    listAdd(*globals, rtCreateFunctionVariable(strLit("preduce"), rtCreateFunction(bifPreduce, listNew(String))), Variable);
 }
 
-Variable bifPrintln(Function f, Runtime* r, List par)
+Variable bifPrintln(Function* f, Runtime* r, List par)
 {
     assert(r);
     Variable ret = bifPrint(f, r, par);
-    printf("\n");
+    if (ret.type != V_EXCEPTION)
+        fprintf(r->out, "\n");
     return ret;
 }
 
-Variable bifPrint(Function f, Runtime* r, List par)
+Variable bifPrint(Function* f, Runtime* r, List par)
 {
+    // the threads of the pool run only pure functions
+    if (r->worker)
+    {
+        listDeepFree(par, Variable, v, rtFreeVariable(v));
+        return rtException(strLit("SideEffect"), strLit("Parallel function cannot print"));
+    }
+    // cached calls of memoized function would skip the output
+    if (r->memoDepth)
+    {
+        listDeepFree(par, Variable, v, rtFreeVariable(v));
+        return rtException(strLit("SideEffect"), strLit("Memoized function cannot print"));
+    }
+
     ListIterator iterator = liCreate(&par);
     ListIterator* li = &iterator;
 
@@ -39,38 +395,61 @@ Variable bifPrint(Function f, Runtime* r, List par)
         switch (v.type)
         {
         case V_BOOL:
-            printf(v.boolean ? "true" : "false");
+            fprintf(r->out, v.boolean ? "true" : "false");
             break;
         case V_INT:
-            printf("%zu", v.integer);
+            fprintf(r->out, "%lld", (long long)v.integer);
             break;
+        case V_BIGINT:
+        {
+            String str = bigToString(v.big);
+            fprintf(r->out, "%s", str.c);
+            strFree(str);
+            break;
+        }
         case V_FLOAT:
-            printf("%lf", v.decimal);
+            fprintf(r->out, "%lf", v.decimal);
+            break;
+        case V_ARRAY:
+        {
+            ArrayItem* items = arrItems(v.array);
+            fprintf(r->out, "[");
+            for (size_t i = 0; i < v.array.length; i++)
+            {
+                if (i)
+                    fprintf(r->out, " ");
+                if (v.array.items->type == V_INT)
+                    fprintf(r->out, "%lld", items[i].integer);
+                else
+                    fprintf(r->out, "%lf", items[i].decimal);
+            }
+            fprintf(r->out, "]");
             break;
+        }
         case V_CHAR:
-            printf("%c", v.character);
+            fprintf(r->out, "%c", v.character);
             break;
         case V_STRING:
-            printf("%s", v.str.c);
+            fprintf(r->out, "%s", v.str.c);
             break;
         case V_STRUCT:
-            printf("<struct>");
+            fprintf(r->out, "<struct>");
             break;
         case V_FUNCTION:
-            printf("[%s", v.name.c);
-            listForEach(v.function.parameters, String, s, printf(" %s", s.c));
-            printf("]");
+            fprintf(r->out, "[%s", v.name.c);
+            listForEach(v.function.parameters, String, s, fprintf(r->out, " %s", s.c));
+            fprintf(r->out, "]");
             break;
         case V_NOTHING:
-            printf("_");
+            fprintf(r->out, "_");
             break;
         case V_EXCEPTION:
-            printf("<error ");
-            rtPrintException(stdout, v);
-            printf(">");
+            fprintf(r->out, "<error ");
+            rtPrintException(r->out, v);
+            fprintf(r->out, ">");
             break;
         default:
-            printf("<other>");
+            fprintf(r->out, "<other>");
             break;
         }
         rtFreeVariable(v);
@@ -79,139 +458,59 @@ Variable bifPrint(Function f, Runtime* r, List par)
     return rtCreateNothingVariable();
 }
 
-Variable bifAdd(Function f, Runtime* r, List par)
+Variable bifAdd(Function* f, Runtime* r, List par)
 {
-    ListIterator li = liCreate(&par);
+    Variable* args = (Variable*)par.data;
 
     Variable res = rtBoolVariable(0);
 
-    while (liCan(&li))
+    // runs of ints and floats are reduced at once, the other values and
+    // runs of ints that overflow are reduced one by one
+    for (size_t i = 0, run; i < par.length; i += run)
     {
-        Variable v = liGet(&li, Variable);
-        liMove(&li);
-
-        switch (v.type)
+        run = redRun(args + i, par.length - i);
+        long long acc = 0;
+        if (args[i].type == V_INT && res.type != V_FLOAT && redSumInt(args + i, run, &acc))
+            res = _bifIntegerOp(r, res.type == V_BOOL ? rtIntVariable(res.boolean) : res, rtIntVariable(acc), bigAdd);
+        else if (args[i].type == V_FLOAT)
+            res = rtFloatVariable(redSumFloat(_bifFloat(res), args + i, run));
+        else
         {
-        case V_BOOL:
-            switch (res.type)
-            {
-            case V_BOOL:
-                res.boolean += v.boolean;
-                break;
-            case V_INT:
-                res.integer += v.boolean;
-                break;
-            default:
-                res.decimal += v.boolean;
-                break;
-            }
-            break;
-        case V_INT:
-            switch (res.type)
-            {
-            case V_BOOL:
-                res.type = V_INT;
-                res.integer = res.boolean + v.integer;
-                break;
-            case V_INT:
-                res.integer += v.integer;
-                break;
-            default:
-                res.decimal += v.integer;
-                break;
-            }
-            break;
-        case V_FLOAT:
-            switch (res.type)
-            {
-            case V_BOOL:
-                res.type = V_FLOAT;
-                res.decimal = res.boolean + v.decimal;
-                break;
-            case V_INT:
-                res.type = V_FLOAT;
-                res.decimal = res.integer + v.decimal;
-                break;
-            default:
-                res.decimal += v.decimal;
-                break;
-            }
-            break;
-        default:
-            break;
+            for (size_t j = i; j < i + run; j++)
+                _bifAddValue(r, &res, args[j]);
         }
-        rtFreeVariable(v);
     }
+    listDeepFree(par, Variable, v, rtFreeVariable(v));
     return res;
 }
 
-Variable bifMultiply(Function f, Runtime* r, List par)
+Variable bifMultiply(Function* f, Runtime* r, List par)
 {
-    ListIterator li = liCreate(&par);
+    Variable* args = (Variable*)par.data;
 
     Variable res = rtBoolVariable(1);
 
-    while (liCan(&li))
+    // runs of ints and floats are reduced at once, the other values and
+    // runs of ints that overflow are reduced one by one
+    for (size_t i = 0, run; i < par.length; i += run)
     {
-        Variable v = liGet(&li, Variable);
-        liMove(&li);
-
-        switch (v.type)
+        run = redRun(args + i, par.length - i);
+        long long acc = 1;
+        if (args[i].type == V_INT && res.type != V_FLOAT && redProductInt(args + i, run, &acc))
+            res = _bifIntegerOp(r, res.type == V_BOOL ? rtIntVariable(res.boolean) : res, rtIntVariable(acc), bigMultiply);
+        else if (args[i].type == V_FLOAT)
+            res = rtFloatVariable(redProductFloat(_bifFloat(res), args + i, run));
+        else
         {
-        case V_BOOL:
-            switch (res.type)
-            {
-            case V_BOOL:
-                res.boolean *= v.boolean;
-                break;
-            case V_INT:
-                res.integer *= v.boolean;
-                break;
-            default:
-                res.decimal *= v.boolean;
-                break;
-            }
-            break;
-        case V_INT:
-            switch (res.type)
-            {
-            case V_BOOL:
-                res.type = V_INT;
-                res.integer = res.boolean * v.integer;
-                break;
-            case V_INT:
-                res.integer *= v.integer;
-                break;
-            default:
-                res.decimal *= v.integer;
-                break;
-            }
-            break;
-        case V_FLOAT:
-            switch (res.type)
-            {
-            case V_BOOL:
-                res.type = V_FLOAT;
-                res.decimal = res.boolean * v.decimal;
-                break;
-            case V_INT:
-                res.type = V_FLOAT;
-                res.decimal = res.integer * v.decimal;
-                break;
-            default:
-                res.decimal *= v.decimal;
-                break;
-            }
-            break;
-        default:
-            break;
+            for (size_t j = i; j < i + run; j++)
+                _bifMultiplyValue(r, &res, args[j]);
         }
-        rtFreeVariable(v);
     }
+    listDeepFree(par, Variable, v, rtFreeVariable(v));
     return res;
 }
 
-Variable bifSubtract(Function f, Runtime* r, List par)
+Variable bifSubtract(Function* f, Runtime* r, List par)
 {
     if (par.length == 1)
     {
@@ -223,7 +522,8 @@ Variable bifSubtract(Function f, Runtime* r, List par)
             v = rtBoolVariable(!v0.boolean);
             break;
         case V_INT:
-            v = rtIntVariable(-v0.integer);
+        case V_BIGINT:
+            v = _bifIntegerOp(r, rtIntVariable(0), v0, bigSubtract);
             break;
         case V_FLOAT:
             v = rtFloatVariable(-v0.decimal);
@@ -253,7 +553,8 @@ Variable bifSubtract(Function f, Runtime* r, List par)
             v = rtBoolVariable(v0.boolean - v1.boolean);
             break;
         case V_INT:
-            v = rtIntVariable(v0.boolean - v1.integer);
+        case V_BIGINT:
+            v = _bifIntegerOp(r, rtIntVariable(v0.boolean), v1, bigSubtract);
             break;
         case V_FLOAT:
             v = rtFloatVariable(v1.boolean - v1.decimal);
@@ -264,16 +565,18 @@ Variable bifSubtract(Function f, Runtime* r, List par)
         }
         break;
     case V_INT:
+    case V_BIGINT:
         switch (v1.type)
         {
         case V_BOOL:
-            v = rtIntVariable(v0.integer - v1.boolean);
+            v = _bifIntegerOp(r, v0, rtIntVariable(v1.boolean), bigSubtract);
             break;
         case V_INT:
-            v = rtIntVariable(v0.integer - v1.integer);
+        case V_BIGINT:
+            v = _bifIntegerOp(r, v0, v1, bigSubtract);
             break;
         case V_FLOAT:
-            v = rtFloatVariable(v0.integer - v1.decimal);
+            v = rtFloatVariable(_bifFloat(v0) - v1.decimal);
             break;
         default:
             v = rtException(strLit("InvalidType"), strLit("Invalid type of second argument for subtraction"));
@@ -287,7 +590,8 @@ Variable bifSubtract(Function f, Runtime* r, List par)
             v = rtFloatVariable(v0.decimal - v1.boolean);
             break;
         case V_INT:
-            v = rtFloatVariable(v0.decimal - v1.integer);
+        case V_BIGINT:
+            v = rtFloatVariable(v0.decimal - _bifFloat(v1));
             break;
         case V_FLOAT:
             v = rtFloatVariable(v0.decimal - v1.decimal);
@@ -305,7 +609,7 @@ Variable bifSubtract(Function f, Runtime* r, List par)
     return v;
 }
 
-Variable bifDivide(Function f, Runtime* r, List par)
+Variable bifDivide(Function* f, Runtime* r, List par)
 {
     if (par.length != 2)
     {
@@ -319,13 +623,20 @@ Variable bifDivide(Function f, Runtime* r, List par)
     switch (v0.type)
     {
     case V_INT:
+    case V_BIGINT:
         switch (v1.type)
         {
         case V_INT:
-            v = rtIntVariable(v0.integer / v1.integer);
+        case V_BIGINT:
+            if (v1.type == V_INT && v1.integer == 0)
+            {
+                v = rtException(strLit("DivisionByZero"), strLit("Integer division by zero"));
+                break;
+            }
+            v = _bifIntegerDivide(r, v0, v1, 0);
             break;
         case V_FLOAT:
-            v = rtFloatVariable(v0.integer / v1.decimal);
+            v = rtFloatVariable(_bifFloat(v0) / v1.decimal);
             break;
         default:
             v = rtException(strLit("InvalidType"), strLit("Invalid type of second argument for subtraction"));
@@ -336,7 +647,8 @@ Variable bifDivide(Function f, Runtime* r, List par)
         switch (v1.type)
         {
         case V_INT:
-            v = rtFloatVariable(v0.decimal / v1.integer);
+        case V_BIGINT:
+            v = rtFloatVariable(v0.decimal / _bifFloat(v1));
             break;
         case V_FLOAT:
             v = rtFloatVariable(v0.decimal / v1.decimal);
@@ -354,7 +666,7 @@ Variable bifDivide(Function f, Runtime* r, List par)
     return v;
 }
 
-Variable bifMod(Function f, Runtime* r, List par)
+Variable bifMod(Function* f, Runtime* r, List par)
 {
     if (par.length != 2)
     {
@@ -364,13 +676,975 @@ Variable bifMod(Function f, Runtime* r, List par)
 
     Variable v0 = listGet(par, 0, Variable);
     Variable v1 = listGet(par, 1, Variable);
-    if (v0.type != V_INT || v1.type != V_INT)
+    if ((v0.type != V_INT && v0.type != V_BIGINT) || (v1.type != V_INT && v1.type != V_BIGINT))
     {
         listDeepFree(par, Variable, v, rtFreeVariable(v));
         return rtException(strLit("InvalidType"), strLit("Both arguments to modulo must be int"));
     }
 
-    Variable v = rtIntVariable(v0.integer % v1.integer);
+    if (v1.type == V_INT && v1.integer == 0)
+    {
+        listDeepFree(par, Variable, v, rtFreeVariable(v));
+        return rtException(strLit("DivisionByZero"), strLit("Integer modulo by zero"));
+    }
+
+    Variable v = _bifIntegerDivide(r, v0, v1, 1);
+    listDeepFree(par, Variable, v, rtFreeVariable(v));
+    return v;
+}
+
+Variable bifEqual(Function* f, Runtime* r, List par)
+{
+    int cmp;
+    Variable err;
+    if (!_bifCompare(par, 1, &cmp, &err))
+        return err;
+    return rtBoolVariable(cmp == 0);
+}
+
+Variable bifLess(Function* f, Runtime* r, List par)
+{
+    int cmp;
+    Variable err;
+    if (!_bifCompare(par, 0, &cmp, &err))
+        return err;
+    return rtBoolVariable(cmp < 0);
+}
+
+Variable bifLessEqual(Function* f, Runtime* r, List par)
+{
+    int cmp;
+    Variable err;
+    if (!_bifCompare(par, 0, &cmp, &err))
+        return err;
+    return rtBoolVariable(cmp <= 0);
+}
+
+Variable bifGreater(Function* f, Runtime* r, List par)
+{
+    int cmp;
+    Variable err;
+    if (!_bifCompare(par, 0, &cmp, &err))
+        return err;
+    return rtBoolVariable(cmp > 0);
+}
+
+Variable bifGreaterEqual(Function* f, Runtime* r, List par)
+{
+    int cmp;
+    Variable err;
+    if (!_bifCompare(par, 0, &cmp, &err))
+        return err;
+    return rtBoolVariable(cmp >= 0);
+}
+
+Variable bifMemoHits(Function* f, Runtime* r, List par)
+{
+    return _bifMemoStat(par, 1);
+}
+
+Variable bifMemoMisses(Function* f, Runtime* r, List par)
+{
+    return _bifMemoStat(par, 0);
+}
+
+Variable bifArray(Function* f, Runtime* r, List par)
+{
+    Variable* args = (Variable*)par.data;
+
+    VariableType type = V_INT;
+    for (size_t i = 0; i < par.length; i++)
+    {
+        if (args[i].type == V_FLOAT)
+            type = V_FLOAT;
+        else if (args[i].type != V_BOOL && args[i].type != V_INT && args[i].type != V_BIGINT)
+        {
+            listDeepFree(par, Variable, v, rtFreeVariable(v));
+            return rtException(strLit("InvalidType"), strLit("Items of array must be bool, int or float"));
+        }
+    }
+
+    Array* a = arrCreate(&r->gc, type, par.length);
+    for (size_t i = 0; i < par.length; i++)
+    {
+        if (type == V_FLOAT)
+            a->items[i].decimal = _bifFloat(args[i]);
+        else if (args[i].type == V_BIGINT)
+        {
+            listDeepFree(par, Variable, v, rtFreeVariable(v));
+            return rtException(strLit("IntegerOverflow"), strLit("Items of int array must fit into 64 bits"));
+        }
+        else
+            a->items[i].integer = args[i].type == V_INT ? args[i].integer : args[i].boolean;
+    }
+    listDeepFree(par, Variable, v, rtFreeVariable(v));
+    return rtArrayVariable(a, 0, a->length);
+}
+
+Variable bifLen(Function* f, Runtime* r, List par)
+{
+    Variable err;
+    if (!_bifArrayArgs(par, 1, 1, &err))
+        return err;
+
+    Variable v = rtIntVariable((long long)listGet(par, 0, Variable).array.length);
+    listDeepFree(par, Variable, v, rtFreeVariable(v));
+    return v;
+}
+
+Variable bifGet(Function* f, Runtime* r, List par)
+{
+    Variable err;
+    if (!_bifArrayArgs(par, 2, 2, &err))
+        return err;
+
+    ArrayView a = listGet(par, 0, Variable).array;
+    size_t index;
+    _Bool valid = _bifIndex(listGet(par, 1, Variable), a.length, &index, &err);
+    // the length is valid only as end of slice
+    if (valid && index == a.length)
+    {
+        valid = 0;
+        err = rtException(strLit("IndexOutOfRange"), strLit("Index is outside of the array"));
+    }
+    if (!valid)
+    {
+        listDeepFree(par, Variable, v, rtFreeVariable(v));
+        return err;
+    }
+
+    ArrayItem item = arrItems(a)[index];
+    listDeepFree(par, Variable, v, rtFreeVariable(v));
+    return a.items->type == V_INT ? rtIntVariable(item.integer) : rtFloatVariable(item.decimal);
+}
+
+Variable bifSlice(Function* f, Runtime* r, List par)
+{
+    Variable err;
+    if (!_bifArrayArgs(par, 2, 3, &err))
+        return err;
+
+    ArrayView a = listGet(par, 0, Variable).array;
+    size_t start;
+    size_t end = a.length;
+    if (!_bifIndex(listGet(par, 1, Variable), a.length, &start, &err)
+        || (par.length == 3 && !_bifIndex(listGet(par, 2, Variable), a.length, &end, &err)))
+    {
+        listDeepFree(par, Variable, v, rtFreeVariable(v));
+        return err;
+    }
+    if (end < start)
+    {
+        listDeepFree(par, Variable, v, rtFreeVariable(v));
+        return rtException(strLit("IndexOutOfRange"), strLit("End of slice is before its start"));
+    }
+
+    // the slice is view of the same items
+    Variable v = rtArrayVariable(a.items, a.offset + start, end - start);
     listDeepFree(par, Variable, v, rtFreeVariable(v));
     return v;
+}
+
+Variable bifMapAdd(Function* f, Runtime* r, List par)
+{
+    return _bifMap(r, par, 0);
+}
+
+Variable bifMapMultiply(Function* f, Runtime* r, List par)
+{
+    return _bifMap(r, par, 1);
+}
+
+Variable bifSum(Function* f, Runtime* r, List par)
+{
+    Variable err;
+    if (!_bifArrayArgs(par, 1, 1, &err))
+        return err;
+
+    ArrayView a = listGet(par, 0, Variable).array;
+    ArrayItem* items = arrItems(a);
+    listDeepFree(par, Variable, v, rtFreeVariable(v));
+
+    if (a.items->type == V_FLOAT)
+        return rtFloatVariable(arrSumFloat(0, items, a.length));
+
+    long long acc = 0;
+    if (arrSumInt(items, a.length, &acc))
+        return rtIntVariable(acc);
+    // the sum is bigint
+    Variable res = rtIntVariable(0);
+    for (size_t i = 0; i < a.length; i++)
+        res = _bifIntegerOp(r, res, rtIntVariable(items[i].integer), bigAdd);
+    return res;
+}
+
+Variable bifDot(Function* f, Runtime* r, List par)
+{
+    Variable err;
+    if (!_bifArrayArgs(par, 2, 2, &err))
+        return err;
+
+    ArrayView a = listGet(par, 0, Variable).array;
+    ArrayView b = listGet(par, 1, Variable).array;
+    if (listGet(par, 1, Variable).type != V_ARRAY || a.length != b.length)
+    {
+        _Bool array = listGet(par, 1, Variable).type == V_ARRAY;
+        listDeepFree(par, Variable, v, rtFreeVariable(v));
+        if (!array)
+            return rtException(strLit("InvalidType"), strLit("Dot product needs two arrays"));
+        return rtException(strLit("InvalidLength"), strLit("Arrays of dot product must have the same length"));
+    }
+    listDeepFree(par, Variable, v, rtFreeVariable(v));
+
+    ArrayItem* x = arrItems(a);
+    ArrayItem* y = arrItems(b);
+    if (a.items->type == V_INT && b.items->type == V_INT)
+    {
+        long long acc = 0;
+        if (arrDotInt(x, y, a.length, &acc))
+            return rtIntVariable(acc);
+        // the dot product is bigint
+        Variable res = rtIntVariable(0);
+        for (size_t i = 0; i < a.length; i++)
+            res = _bifIntegerOp(r, res, _bifIntegerOp(r, rtIntVariable(x[i].integer), rtIntVariable(y[i].integer), bigMultiply), bigAdd);
+        return res;
+    }
+
+    // the int array is converted to floats
+    ArrayItem* converted = NULL;
+    if (a.items->type == V_INT || b.items->type == V_INT)
+    {
+        converted = malloc(sizeof(ArrayItem) * (a.length ? a.length : 1));
+        assert(converted);
+        arrToFloat(converted, a.items->type == V_INT ? x : y, a.length);
+        if (a.items->type == V_INT)
+            x = converted;
+        else
+            y = converted;
+    }
+    double res = arrDotFloat(x, y, a.length);
+    free(converted);
+    return rtFloatVariable(res);
+}
+
+Variable bifMin(Function* f, Runtime* r, List par)
+{
+    return _bifExtreme(par, 0);
+}
+
+Variable bifMax(Function* f, Runtime* r, List par)
+{
+    return _bifExtreme(par, 1);
+}
+
+Variable bifPmap(Function* f, Runtime* r, List par)
+{
+    return _bifParallelMap(r, par, 0);
+}
+
+Variable bifPfor(Function* f, Runtime* r, List par)
+{
+    return _bifParallelMap(r, par, 1);
+}
+
+Variable bifPreduce(Function* f, Runtime* r, List par)
+{
+    _BifParallel p;
+    Variable err;
+    if (!_bifParallelStart(r, par, &p, &err))
+        return err;
+    if (!p.count)
+    {
+        listDeepFree(par, Variable, v, rtFreeVariable(v));
+        return rtException(strLit("InvalidLength"), strLit("Cannot reduce no items"));
+    }
+
+    // the groups don't depend on the number of threads so the result is
+    // always the same
+    size_t groups = (p.count + bif_REDUCE_GROUP - 1) / bif_REDUCE_GROUP;
+    p.threads = malloc(sizeof(size_t) * groups);
+    p.slots = malloc(sizeof(size_t) * groups);
+    assert(p.threads && p.slots);
+    // the caller runs the call itself if it is thread of the pool
+    size_t mark = r->locals.length;
+    _bifParallelRun(&p, _bifReduceGroup, groups);
+
+    // the results of the groups are reduced from left to right on thread 0,
+    // the other threads don't run so their heaps don't change
+    Runtime* w = _bifParallelRuntime(&p, 0);
+    size_t slot = w->locals.length;
+    listAdd(w->locals, rtCopyVariable(strEmpty(), *_bifGroup(&p, 0)), Variable);
+    for (size_t i = 1; i < groups; i++)
+    {
+        Variable* acc = listGetP(w->locals, slot);
+        Variable* next = _bifGroup(&p, i);
+        if (acc->type == V_EXCEPTION)
+            break;
+        if (next->type == V_EXCEPTION)
+        {
+            Variable copy = rtCopyVariable(strEmpty(), *next);
+            rtFreeVariable(*acc);
+            *acc = copy;
+            break;
+        }
+
+        List args = listNew(Variable);
+        listAdd(args, rtCopyVariable(strEmpty(), *acc), Variable);
+        listAdd(args, rtCopyVariable(strEmpty(), *next), Variable);
+        Variable res = _bifParallelCall(&p, 0, args);
+        // the locals may have moved
+        acc = listGetP(w->locals, slot);
+        rtFreeVariable(*acc);
+        *acc = res;
+    }
+
+    Variable* acc = listGetP(w->locals, slot);
+    Variable res = rtCopyVariable(strCopy(acc->name), *acc);
+    if (p.pool)
+    {
+        res = _bifTransfer(r, res);
+        rtReleaseWorkers(r);
+    }
+    else
+    {
+        for (size_t i = mark; i < r->locals.length; i++)
+            rtFreeVariable(listGet(r->locals, i, Variable));
+        r->locals.length = mark;
+    }
+
+    free(p.threads);
+    free(p.slots);
+    listDeepFree(par, Variable, v, rtFreeVariable(v));
+    return res;
+}
+
+_Bool bifHasSideEffects(const char* name)
+{
+    return strcmp(name, "print") == 0 || strcmp(name, "println") == 0;
+}
+
+Variable _bifMemoStat(List par, _Bool hits)
+{
+    if (par.length != 1)
+    {
+        listDeepFree(par, Variable, v, rtFreeVariable(v));
+        return rtException(strLit("InvalidArgumentCount"), strLit("Memo statistics take exactly one function"));
+    }
+
+    Variable v0 = listGet(par, 0, Variable);
+    if (v0.type != V_FUNCTION || !v0.function.memo)
+    {
+        listDeepFree(par, Variable, v, rtFreeVariable(v));
+        return rtException(strLit("InvalidType"), strLit("Function is not memoized"));
+    }
+
+    Memo* memo = v0.function.memo;
+    Variable v = rtIntVariable((long long)(hits ? memo->hits : memo->misses));
+    listDeepFree(par, Variable, v, rtFreeVariable(v));
+    return v;
+}
+
+_Bool _bifCompare(List par, _Bool equality, int* cmp, Variable* err)
+{
+    if (par.length != 2)
+    {
+        listDeepFree(par, Variable, v, rtFreeVariable(v));
+        *err = rtException(strLit("InvalidArgumentCount"), strLit("Comparison must have two arguments"));
+        return 0;
+    }
+
+    Variable v0 = listGet(par, 0, Variable);
+    Variable v1 = listGet(par, 1, Variable);
+    _Bool n0 = v0.type == V_BOOL || v0.type == V_INT || v0.type == V_FLOAT || v0.type == V_BIGINT;
+    _Bool n1 = v1.type == V_BOOL || v1.type == V_INT || v1.type == V_FLOAT || v1.type == V_BIGINT;
+    _Bool compared = 1;
+    if (n0 && n1)
+    {
+        if (v0.type == V_FLOAT || v1.type == V_FLOAT)
+        {
+            double a = _bifFloat(v0);
+            double b = _bifFloat(v1);
+            *cmp = (a > b) - (a < b);
+        }
+        else if (v0.type == V_BIGINT || v1.type == V_BIGINT)
+            *cmp = _bifCompareBig(v0, v1);
+        else
+        {
+            long long a = v0.type == V_INT ? v0.integer : v0.boolean;
+            long long b = v1.type == V_INT ? v1.integer : v1.boolean;
+            *cmp = (a > b) - (a < b);
+        }
+    }
+    else if (v0.type != v1.type)
+        compared = 0;
+    else
+    {
+        switch (v0.type)
+        {
+        case V_CHAR:
+            *cmp = (v0.character > v1.character) - (v0.character < v1.character);
+            break;
+        case V_STRING:
+            *cmp = strcmp(v0.str.c ? v0.str.c : "", v1.str.c ? v1.str.c : "");
+            break;
+        case V_NOTHING:
+            *cmp = 0;
+            break;
+        case V_ARRAY:
+            // arrays are only equal or unequal
+            compared = equality;
+            *cmp = !_bifArrayEquals(v0.array, v1.array);
+            break;
+        default:
+            compared = 0;
+            break;
+        }
+    }
+    listDeepFree(par, Variable, v, rtFreeVariable(v));
+
+    if (compared)
+        return 1;
+    // values of different kinds are never equal
+    if (equality)
+    {
+        *cmp = 1;
+        return 1;
+    }
+    *err = rtException(strLit("InvalidType"), strLit("The arguments cannot be compared"));
+    return 0;
+}
+
+void _bifAddValue(Runtime* r, Variable* res, Variable v)
+{
+    switch (v.type)
+    {
+    case V_BOOL:
+        switch (res->type)
+        {
+        case V_BOOL:
+            res->boolean += v.boolean;
+            break;
+        case V_INT:
+        case V_BIGINT:
+            *res = _bifIntegerOp(r, *res, rtIntVariable(v.boolean), bigAdd);
+            break;
+        default:
+            res->decimal += v.boolean;
+            break;
+        }
+        break;
+    case V_INT:
+    case V_BIGINT:
+        switch (res->type)
+        {
+        case V_BOOL:
+            *res = _bifIntegerOp(r, rtIntVariable(res->boolean), v, bigAdd);
+            break;
+        case V_INT:
+        case V_BIGINT:
+            *res = _bifIntegerOp(r, *res, v, bigAdd);
+            break;
+        default:
+            res->decimal += _bifFloat(v);
+            break;
+        }
+        break;
+    case V_FLOAT:
+        switch (res->type)
+        {
+        case V_FLOAT:
+            res->decimal += v.decimal;
+            break;
+        default:
+            *res = rtFloatVariable(_bifFloat(*res) + v.decimal);
+            break;
+        }
+        break;
+    default:
+        break;
+    }
+}
+
+void _bifMultiplyValue(Runtime* r, Variable* res, Variable v)
+{
+    switch (v.type)
+    {
+    case V_BOOL:
+        switch (res->type)
+        {
+        case V_BOOL:
+            res->boolean *= v.boolean;
+            break;
+        case V_INT:
+        case V_BIGINT:
+            *res = _bifIntegerOp(r, *res, rtIntVariable(v.boolean), bigMultiply);
+            break;
+        default:
+            res->decimal *= v.boolean;
+            break;
+        }
+        break;
+    case V_INT:
+    case V_BIGINT:
+        switch (res->type)
+        {
+        case V_BOOL:
+            *res = _bifIntegerOp(r, rtIntVariable(res->boolean), v, bigMultiply);
+            break;
+        case V_INT:
+        case V_BIGINT:
+            *res = _bifIntegerOp(r, *res, v, bigMultiply);
+            break;
+        default:
+            res->decimal *= _bifFloat(v);
+            break;
+        }
+        break;
+    case V_FLOAT:
+        switch (res->type)
+        {
+        case V_FLOAT:
+            res->decimal *= v.decimal;
+            break;
+        default:
+            *res = rtFloatVariable(_bifFloat(*res) * v.decimal);
+            break;
+        }
+        break;
+    default:
+        break;
+    }
+}
+
+BigInt* _bifBig(Runtime* r, Variable v)
+{
+    if (v.type == V_BIGINT)
+        return v.big;
+    assert(v.type == V_INT);
+    return bigFromInt(&r->gc, v.integer);
+}
+
+double _bifFloat(Variable v)
+{
+    switch (v.type)
+    {
+    case V_BOOL:
+        return v.boolean;
+    case V_INT:
+        return v.integer;
+    case V_BIGINT:
+        return bigToFloat(v.big);
+    default:
+        return v.decimal;
+    }
+}
+
+Variable _bifInteger(BigInt* b)
+{
+    long long value;
+    if (bigToInt(b, &value))
+        return rtIntVariable(value);
+    return rtBigIntVariable(b);
+}
+
+Variable _bifIntegerOp(Runtime* r, Variable a, Variable b, BigInt* (*op)(Gc* gc, BigInt* a, BigInt* b))
+{
+    if (a.type == V_INT && b.type == V_INT)
+    {
+        long long res;
+        _Bool overflow;
+        if (op == bigAdd)
+            overflow = __builtin_add_overflow(a.integer, b.integer, &res);
+        else if (op == bigSubtract)
+            overflow = __builtin_sub_overflow(a.integer, b.integer, &res);
+        else
+            overflow = __builtin_mul_overflow(a.integer, b.integer, &res);
+        if (!overflow)
+            return rtIntVariable(res);
+    }
+    return _bifInteger(op(&r->gc, _bifBig(r, a), _bifBig(r, b)));
+}
+
+Variable _bifIntegerDivide(Runtime* r, Variable a, Variable b, _Bool modulo)
+{
+    // the only int division that overflows
+    if (a.type == V_INT && b.type == V_INT && (a.integer != LLONG_MIN || b.integer != -1))
+        return rtIntVariable(modulo ? a.integer % b.integer : a.integer / b.integer);
+
+    BigInt* remainder;
+    BigInt* quotient = bigDivide(&r->gc, _bifBig(r, a), _bifBig(r, b), modulo ? &remainder : NULL);
+    return _bifInteger(modulo ? remainder : quotient);
+}
+
+int _bifCompareBig(Variable a, Variable b)
+{
+    if (a.type == V_BIGINT && b.type == V_BIGINT)
+        return bigCompare(a.big, b.big);
+    // bigints don't fit into int so they are larger or smaller than every int
+    if (a.type == V_BIGINT)
+        return a.big->negative ? -1 : 1;
+    return b.big->negative ? 1 : -1;
+}
+
+_Bool _bifArrayArgs(List par, size_t min, size_t max, Variable* err)
+{
+    if (par.length < min || par.length > max)
+    {
+        listDeepFree(par, Variable, v, rtFreeVariable(v));
+        *err = rtException(strLit("InvalidArgumentCount"), strLit("Wrong number of arguments of array function"));
+        return 0;
+    }
+    if (listGet(par, 0, Variable).type != V_ARRAY)
+    {
+        listDeepFree(par, Variable, v, rtFreeVariable(v));
+        *err = rtException(strLit("InvalidType"), strLit("The first argument must be array"));
+        return 0;
+    }
+    return 1;
+}
+
+_Bool _bifIndex(Variable v, size_t limit, size_t* index, Variable* err)
+{
+    if (v.type != V_INT)
+    {
+        *err = rtException(strLit("InvalidType"), strLit("Index must be int"));
+        return 0;
+    }
+    if (v.integer < 0 || (unsigned long long)v.integer > limit)
+    {
+        *err = rtException(strLit("IndexOutOfRange"), strLit("Index is outside of the array"));
+        return 0;
+    }
+    *index = (size_t)v.integer;
+    return 1;
+}
+
+Variable _bifMap(Runtime* r, List par, _Bool multiply)
+{
+    if (par.length != 2)
+    {
+        listDeepFree(par, Variable, v, rtFreeVariable(v));
+        return rtException(strLit("InvalidArgumentCount"), strLit("Map must have two arguments"));
+    }
+
+    // both operations are commutative so the array can be the first operand
+    Variable a = listGet(par, 0, Variable);
+    Variable b = listGet(par, 1, Variable);
+    if (a.type != V_ARRAY)
+    {
+        a = b;
+        b = listGet(par, 0, Variable);
+    }
+    listDeepFree(par, Variable, v, rtFreeVariable(v));
+    if (a.type != V_ARRAY)
+        return rtException(strLit("InvalidType"), strLit("Map needs at least one array"));
+
+    size_t step = b.type == V_ARRAY;
+    ArrayItem scalar;
+    VariableType other;
+    switch (b.type)
+    {
+    case V_ARRAY:
+        if (b.array.length != a.array.length)
+            return rtException(strLit("InvalidLength"), strLit("Mapped arrays must have the same length"));
+        other = b.array.items->type;
+        break;
+    case V_BOOL:
+    case V_INT:
+        scalar.integer = b.type == V_INT ? b.integer : b.boolean;
+        other = V_INT;
+        break;
+    case V_FLOAT:
+        scalar.decimal = b.decimal;
+        other = V_FLOAT;
+        break;
+    case V_BIGINT:
+        if (a.array.items->type == V_INT)
+            return rtException(strLit("IntegerOverflow"), strLit("Items of int array must fit into 64 bits"));
+        scalar.decimal = bigToFloat(b.big);
+        other = V_FLOAT;
+        break;
+    default:
+        return rtException(strLit("InvalidType"), strLit("Array can be mapped only with array or number"));
+    }
+
+    size_t length = a.array.length;
+    VariableType type = a.array.items->type == V_FLOAT || other == V_FLOAT ? V_FLOAT : V_INT;
+    Array* res = arrCreate(&r->gc, type, length);
+    ArrayItem* x = arrItems(a.array);
+    ArrayItem* y = step ? arrItems(b.array) : &scalar;
+
+    if (type == V_INT)
+    {
+        if (!arrMapInt(res->items, x, y, step, length, multiply))
+            return rtException(strLit("IntegerOverflow"), strLit("Items of int array must fit into 64 bits"));
+        return rtArrayVariable(res, 0, length);
+    }
+
+    // at most one operand is int, it is converted in place of the result
+    if (a.array.items->type == V_INT)
+    {
+        arrToFloat(res->items, x, length);
+        x = res->items;
+    }
+    else if (other == V_INT && step)
+    {
+        arrToFloat(res->items, y, length);
+        y = res->items;
+    }
+    else if (other == V_INT)
+        scalar.decimal = (double)scalar.integer;
+    arrMapFloat(res->items, x, y, step, length, multiply);
+    return rtArrayVariable(res, 0, length);
+}
+
+Variable _bifExtreme(List par, _Bool max)
+{
+    Variable err;
+    if (!_bifArrayArgs(par, 1, 1, &err))
+        return err;
+
+    ArrayView a = listGet(par, 0, Variable).array;
+    listDeepFree(par, Variable, v, rtFreeVariable(v));
+    if (!a.length)
+        return rtException(strLit("IndexOutOfRange"), strLit("Array is empty"));
+
+    ArrayItem item = arrExtreme(a.items->type, arrItems(a), a.length, max);
+    return a.items->type == V_INT ? rtIntVariable(item.integer) : rtFloatVariable(item.decimal);
+}
+
+_Bool _bifArrayEquals(ArrayView a, ArrayView b)
+{
+    if (a.length != b.length)
+        return 0;
+
+    ArrayItem* x = arrItems(a);
+    ArrayItem* y = arrItems(b);
+    for (size_t i = 0; i < a.length; i++)
+    {
+        if (a.items->type == V_INT && b.items->type == V_INT)
+        {
+            if (x[i].integer != y[i].integer)
+                return 0;
+            continue;
+        }
+        // ints are compared with floats by their value like numbers
+        double p = a.items->type == V_INT ? (double)x[i].integer : x[i].decimal;
+        double q = b.items->type == V_INT ? (double)y[i].integer : y[i].decimal;
+        if (p != q)
+            return 0;
+    }
+    return 1;
+}
+
+_Bool _bifParallelStart(Runtime* r, List par, _BifParallel* p, Variable* err)
+{
+    if (par.length != 2)
+    {
+        listDeepFree(par, Variable, v, rtFreeVariable(v));
+        *err = rtException(strLit("InvalidArgumentCount"), strLit("Parallel function takes function and array or number of items"));
+        return 0;
+    }
+
+    Variable f = listGet(par, 0, Variable);
+    Variable items = listGet(par, 1, Variable);
+    if (f.type != V_FUNCTION || (items.type != V_ARRAY && items.type != V_INT))
+    {
+        listDeepFree(par, Variable, v, rtFreeVariable(v));
+        *err = rtException(strLit("InvalidType"), strLit("Parallel function takes function and array or number of items"));
+        return 0;
+    }
+    if (items.type == V_INT && items.integer < 0)
+    {
+        listDeepFree(par, Variable, v, rtFreeVariable(v));
+        *err = rtException(strLit("InvalidLength"), strLit("Number of items cannot be negative"));
+        return 0;
+    }
+
+    p->r = r;
+    // parallel call on thread of the pool runs on that thread
+    p->pool = r->worker ? NULL : rtPool(r);
+    p->function = &((Variable*)par.data)->function;
+    p->items = items.type == V_ARRAY ? arrItems(items.array) : NULL;
+    p->type = items.type == V_ARRAY ? items.array.items->type : V_INT;
+    p->count = items.type == V_ARRAY ? items.array.length : (size_t)items.integer;
+    p->discard = 0;
+    p->results = NULL;
+    p->threads = NULL;
+    p->slots = NULL;
+    return 1;
+}
+
+void _bifParallelRun(_BifParallel* p, PoolAction action, size_t count)
+{
+    if (p->pool)
+    {
+        poolRun(p->pool, action, p, count);
+        return;
+    }
+    for (size_t i = 0; i < count; i++)
+        action(p, 0, i);
+}
+
+Runtime* _bifParallelRuntime(_BifParallel* p, size_t thread)
+{
+    return p->pool ? p->r->workers + thread : p->r;
+}
+
+Variable _bifParallelCall(_BifParallel* p, size_t thread, List par)
+{
+    // the caller on thread of the pool holds values the collector doesn't see
+    if (!p->pool)
+        return rtInvokeFunction(p->function, p->r, par);
+    return evCall(p->function, _bifParallelRuntime(p, thread), par);
+}
+
+Variable _bifItem(_BifParallel* p, size_t index)
+{
+    if (!p->items)
+        return rtIntVariable((long long)index);
+    if (p->type == V_INT)
+        return rtIntVariable(p->items[index].integer);
+    return rtFloatVariable(p->items[index].decimal);
+}
+
+void _bifMapItem(void* context, size_t thread, size_t index)
+{
+    _BifParallel* p = context;
+    List args = listNew(Variable);
+    listAdd(args, _bifItem(p, index), Variable);
+    Variable res = _bifParallelCall(p, thread, args);
+
+    // the results outlive the heaps of the threads so they cannot reference
+    // heap objects
+    if (res.type != V_EXCEPTION && (p->discard || (res.type != V_BOOL && res.type != V_INT && res.type != V_FLOAT)))
+    {
+        VariableType type = res.type;
+        rtFreeVariable(res);
+        if (p->discard)
+            res = rtCreateNothingVariable();
+        else if (type == V_BIGINT)
+            res = rtException(strLit("IntegerOverflow"), strLit("Items of int array must fit into 64 bits"));
+        else
+            res = rtException(strLit("InvalidType"), strLit("Results of pmap must be bool, int or float"));
+    }
+    p->results[index] = res;
+}
+
+void _bifReduceGroup(void* context, size_t thread, size_t group)
+{
+    _BifParallel* p = context;
+    Runtime* w = _bifParallelRuntime(p, thread);
+    size_t start = group * bif_REDUCE_GROUP;
+    size_t end = start + bif_REDUCE_GROUP < p->count ? start + bif_REDUCE_GROUP : p->count;
+
+    // the result is in the locals so that the collector sees it
+    size_t slot = w->locals.length;
+    listAdd(w->locals, _bifItem(p, start), Variable);
+    for (size_t i = start + 1; i < end; i++)
+    {
+        Variable* acc = listGetP(w->locals, slot);
+        if (acc->type == V_EXCEPTION)
+            break;
+
+        List args = listNew(Variable);
+        listAdd(args, rtCopyVariable(strEmpty(), *acc), Variable);
+        listAdd(args, _bifItem(p, i), Variable);
+        Variable res = _bifParallelCall(p, thread, args);
+        acc = listGetP(w->locals, slot);
+        rtFreeVariable(*acc);
+        *acc = res;
+    }
+
+    p->threads[group] = thread;
+    p->slots[group] = slot;
+}
+
+Variable* _bifGroup(_BifParallel* p, size_t group)
+{
+    return listGetP(_bifParallelRuntime(p, p->threads[group])->locals, p->slots[group]);
+}
+
+Variable _bifParallelMap(Runtime* r, List par, _Bool discard)
+{
+    _BifParallel p;
+    Variable err;
+    if (!_bifParallelStart(r, par, &p, &err))
+        return err;
+
+    p.discard = discard;
+    p.results = malloc(sizeof(Variable) * (p.count ? p.count : 1));
+    assert(p.results);
+    _bifParallelRun(&p, _bifMapItem, p.count);
+    if (p.pool)
+        rtReleaseWorkers(r);
+    listDeepFree(par, Variable, v, rtFreeVariable(v));
+
+    // the exception of the first failed item is the result
+    size_t failed = 0;
+    VariableType type = V_INT;
+    while (failed < p.count && p.results[failed].type != V_EXCEPTION)
+    {
+        if (p.results[failed].type == V_FLOAT)
+            type = V_FLOAT;
+        failed++;
+    }
+
+    Variable res;
+    if (failed < p.count)
+        res = p.results[failed];
+    else if (discard)
+        res = rtCreateNothingVariable();
+    else
+    {
+        Array* a = arrCreate(&r->gc, type, p.count);
+        for (size_t i = 0; i < p.count; i++)
+        {
+            Variable v = p.results[i];
+            if (type == V_FLOAT)
+                a->items[i].decimal = _bifFloat(v);
+            else
+                a->items[i].integer = v.type == V_INT ? v.integer : v.boolean;
+        }
+        res = rtArrayVariable(a, 0, a->length);
+    }
+
+    for (size_t i = 0; i < p.count; i++)
+    {
+        if (i != failed)
+            rtFreeVariable(p.results[i]);
+    }
+    free(p.results);
+    return res;
+}
+
+Variable _bifTransfer(Runtime* r, Variable v)
+{
+    switch (v.type)
+    {
+    case V_STRING:
+        v.str = gcString(&r->gc, v.str);
+        return v;
+    case V_BIGINT:
+        if (!gcOwns(&r->gc, &v.big->header))
+            v.big = (BigInt*)gcCopy(&r->gc, &v.big->header);
+        return v;
+    case V_ARRAY:
+        if (!gcOwns(&r->gc, &v.array.items->header))
+            v.array.items = (Array*)gcCopy(&r->gc, &v.array.items->header);
+        return v;
+    case V_FUNCTION:
+    case V_THUNK:
+    {
+        // closures may reference anything so they aren't copied
+        GcObject* closure = v.type == V_THUNK ? &v.thunk->header : (GcObject*)v.function.closure;
+        GcObject* memo = v.type == V_THUNK ? NULL : (GcObject*)v.function.memo;
+        if ((!closure || gcOwns(&r->gc, closure)) && (!memo || gcOwns(&r->gc, memo)))
+            return v;
+        rtFreeVariable(v);
+        return rtException(strLit("InvalidType"), strLit("Result of parallel function cannot be function or lazy value created by it"));
+    }
+    default:
+        return v;
+    }
 }
\ No newline at end of file
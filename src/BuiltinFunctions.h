@@ -4,6 +4,12 @@
 #include "Runtime.h"
 #include "List.h"
 
+#ifndef bif_REDUCE_GROUP
+// preduce reduces this many consecutive items on one thread, the groups
+// don't depend on the number of threads
+#define bif_REDUCE_GROUP 16
+#endif // bif_REDUCE_GROUP
+
 /**
  * @brief adds the builtin function to the runtime object
  * 
@@ -11,18 +17,104 @@
  */
 void bifRegisterBuiltins(Runtime* r);
 
-Variable bifPrintln(Function f, Runtime* r, List par);
+/**
+ * @brief creates the global variables with the builtin functions once so
+ * that runtimes can be created from them by rtCreateFrom, the variables are
+ * constants that are never changed so the runtimes may run on any thread
+ *
+ * @return List the builtins, they are freed by bifFreeBuiltins
+ */
+List bifCreateBuiltins(void);
+
+/**
+ * @brief frees the builtins created by bifCreateBuiltins, the runtimes
+ * created from them must be freed first
+ *
+ * @param builtins the builtins
+ */
+void bifFreeBuiltins(List builtins);
+
+Variable bifPrintln(Function* f, Runtime* r, List par);
+
+Variable bifPrint(Function* f, Runtime* r, List par);
+
+Variable bifAdd(Function* f, Runtime* r, List par);
+
+Variable bifMultiply(Function* f, Runtime* r, List par);
+
+Variable bifSubtract(Function* f, Runtime* r, List par);
+
+Variable bifDivide(Function* f, Runtime* r, List par);
+
+Variable bifMod(Function* f, Runtime* r, List par);
+
+Variable bifEqual(Function* f, Runtime* r, List par);
+
+Variable bifLess(Function* f, Runtime* r, List par);
+
+Variable bifLessEqual(Function* f, Runtime* r, List par);
+
+Variable bifGreater(Function* f, Runtime* r, List par);
+
+Variable bifGreaterEqual(Function* f, Runtime* r, List par);
 
-Variable bifPrint(Function f, Runtime* r, List par);
+Variable bifMemoHits(Function* f, Runtime* r, List par);
 
-Variable bifAdd(Function f, Runtime* r, List par);
+Variable bifMemoMisses(Function* f, Runtime* r, List par);
 
-Variable bifMultiply(Function f, Runtime* r, List par);
+Variable bifArray(Function* f, Runtime* r, List par);
 
-Variable bifSubtract(Function f, Runtime* r, List par);
+Variable bifLen(Function* f, Runtime* r, List par);
 
-Variable bifDivide(Function f, Runtime* r, List par);
+Variable bifGet(Function* f, Runtime* r, List par);
 
-Variable bifMod(Function f, Runtime* r, List par);
+Variable bifSlice(Function* f, Runtime* r, List par);
+
+Variable bifMapAdd(Function* f, Runtime* r, List par);
+
+Variable bifMapMultiply(Function* f, Runtime* r, List par);
+
+Variable bifSum(Function* f, Runtime* r, List par);
+
+Variable bifDot(Function* f, Runtime* r, List par);
+
+Variable bifMin(Function* f, Runtime* r, List par);
+
+Variable bifMax(Function* f, Runtime* r, List par);
+
+/**
+ * @brief calls pure function with every item of array or with every int
+ * from 0 to n - 1 on the threads of the pool
+ *
+ * @return Variable array of the results
+ */
+Variable bifPmap(Function* f, Runtime* r, List par);
+
+/**
+ * @brief calls pure function with every item like bifPmap and discards
+ * the results
+ *
+ * @return Variable nothing or the exception of the first failed item
+ */
+Variable bifPfor(Function* f, Runtime* r, List par);
+
+/**
+ * @brief reduces the items by pure associative function, groups of
+ * bif_REDUCE_GROUP items are reduced on the threads of the pool and their
+ * results from left to right
+ *
+ * @return Variable the result
+ */
+Variable bifPreduce(Function* f, Runtime* r, List par);
+
+/**
+ * @brief checks whether builtin function has side effects, such builtins
+ * cannot be called by memoized functions
+ *
+ * @param name name of the builtin
+ * @return true the builtin has side effects
+ * @return false the builtin is pure or there is no such builtin
+ */
+_Bool bifHasSideEffects(const char* name);
 
 #endif // bif_BUILTIN_FUNCTIONS_INCLUDED
\ No newline at end of file
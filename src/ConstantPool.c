@@ -0,0 +1,241 @@
+#include "ConstantPool.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+#include <stdint.h>
+
+#include "Runtime.h"
+#include "ParserTree.h"
+#include "List.h"
+#include "Gc.h"
+#include "BigInt.h"
+
+/**
+ * @brief computes hash of the value
+ *
+ * @param v value to hash
+ * @return size_t the hash
+ */
+size_t _cpHash(Variable v);
+
+/**
+ * @brief checks whether the two values are identical literals
+ *
+ * @param a first value
+ * @param b second value
+ * @return true values are identical
+ * @return false values are different
+ */
+_Bool _cpEquals(Variable a, Variable b);
+
+/**
+ * @brief doubles the size of the hash table
+ *
+ * @param pool pool to resize
+ */
+void _cpGrow(ConstantPool* pool);
+
+/**
+ * @brief links all literals in the node and its childs to the pool
+ *
+ * @param pool pool to add to
+ * @param node node to link
+ */
+void _cpBuildNode(ConstantPool* pool, ParserNode* node);
+
+void cpBuild(ParserTree* tree)
+{
+    if (tree->constants)
+        return;
+
+    ConstantPool* pool = malloc(sizeof(ConstantPool));
+    assert(pool);
+
+    pool->values = listNew(Variable*);
+    pool->tableSize = cp_START_SIZE;
+    pool->table = calloc(pool->tableSize, sizeof(size_t));
+    assert(pool->table);
+
+    for (size_t i = 0; i < tree->nodes.length; i++)
+        _cpBuildNode(pool, listGetP(tree->nodes, i));
+
+    tree->constants = pool;
+}
+
+Variable* cpAdd(ConstantPool* pool, Variable value)
+{
+    // keep the load factor under 1/2
+    if (pool->values.length * 2 >= pool->tableSize)
+        _cpGrow(pool);
+
+    size_t mask = pool->tableSize - 1;
+    size_t i = _cpHash(value) & mask;
+    // table stores index + 1 so that 0 means empty slot
+    for (; pool->table[i]; i = (i + 1) & mask)
+    {
+        Variable* v = listGet(pool->values, pool->table[i] - 1, Variable*);
+        if (_cpEquals(*v, value))
+        {
+            if (value.type == V_STRING)
+                gcFreeString(value.str);
+            if (value.type == V_BIGINT)
+                gcFreeObject(&value.big->header);
+            rtFreeVariable(value);
+            return v;
+        }
+    }
+
+    Variable* v = malloc(sizeof(Variable));
+    assert(v);
+    *v = value;
+    v->constant = 1;
+
+    listAdd(pool->values, v, Variable*);
+    pool->table[i] = pool->values.length;
+    return v;
+}
+
+Variable* cpAddNode(ConstantPool* pool, ParserNode* node)
+{
+    switch (node->type)
+    {
+    case P_VALUE_INTEGER:
+        return node->value = cpAdd(pool, rtIntVariable(node->token->integer));
+    case P_VALUE_BIGINT:
+        return node->value = cpAdd(pool, rtBigIntVariable(bigParse(NULL, node->token->string.c, 10)));
+    case P_VALUE_FLOAT:
+        return node->value = cpAdd(pool, rtFloatVariable(node->token->decimal));
+    case P_VALUE_CHAR:
+        return node->value = cpAdd(pool, rtCharVariable(node->token->character));
+    case P_VALUE_STRING:
+        return node->value = cpAdd(pool, rtStringVariable(gcString(NULL, node->token->string)));
+    case P_VALUE_BOOL:
+        return node->value = cpAdd(pool, rtBoolVariable(node->token->boolean));
+    default:
+        return NULL;
+    }
+}
+
+void cpFree(ConstantPool* pool)
+{
+    if (!pool)
+        return;
+
+    // the strings and bigints aren't owned by any heap
+    listForEach(pool->values, Variable*, v,
+        v->constant = 0;
+        if (v->type == V_STRING)
+            gcFreeString(v->str);
+        if (v->type == V_BIGINT)
+            gcFreeObject(&v->big->header);
+        rtFreeVariable(*v);
+        free(v);
+    );
+    listFree(pool->values);
+    free(pool->table);
+    free(pool);
+}
+
+void _cpBuildNode(ConstantPool* pool, ParserNode* node)
+{
+    List pending = listNew(ParserNode*);
+    listAdd(pending, node, ParserNode*);
+    while (pending.length)
+    {
+        ParserNode* n = listGet(pending, --pending.length, ParserNode*);
+        if (cpAddNode(pool, n))
+            continue;
+
+        for (size_t i = 0; i < n->nodes.length; i++)
+            listAdd(pending, listGetP(n->nodes, i), ParserNode*);
+    }
+    listFree(pending);
+}
+
+size_t _cpHash(Variable v)
+{
+    // FNV-1a over the type and the bytes of the value
+    size_t h = 14695981039346656037ULL;
+    const unsigned char* data;
+    size_t length;
+
+    switch (v.type)
+    {
+    case V_BOOL:
+        data = (const unsigned char*)&v.boolean;
+        length = sizeof(v.boolean);
+        break;
+    case V_INT:
+        data = (const unsigned char*)&v.integer;
+        length = sizeof(v.integer);
+        break;
+    case V_FLOAT:
+        data = (const unsigned char*)&v.decimal;
+        length = sizeof(v.decimal);
+        break;
+    case V_CHAR:
+        data = (const unsigned char*)&v.character;
+        length = sizeof(v.character);
+        break;
+    case V_STRING:
+        data = (const unsigned char*)v.str.c;
+        length = v.str.length;
+        break;
+    case V_BIGINT:
+        data = (const unsigned char*)v.big->digits;
+        length = sizeof(*v.big->digits) * v.big->length;
+        break;
+    default:
+        data = NULL;
+        length = 0;
+        break;
+    }
+
+    h = (h ^ v.type) * 1099511628211ULL;
+    for (size_t i = 0; i < length; i++)
+        h = (h ^ data[i]) * 1099511628211ULL;
+    return h;
+}
+
+_Bool _cpEquals(Variable a, Variable b)
+{
+    if (a.type != b.type)
+        return 0;
+
+    switch (a.type)
+    {
+    case V_BOOL:
+        return a.boolean == b.boolean;
+    case V_INT:
+        return a.integer == b.integer;
+    case V_FLOAT:
+        // compare bits so that -0.0 and 0.0 stay different constants
+        return memcmp(&a.decimal, &b.decimal, sizeof(a.decimal)) == 0;
+    case V_CHAR:
+        return a.character == b.character;
+    case V_STRING:
+        return a.str.length == b.str.length && memcmp(a.str.c, b.str.c, a.str.length) == 0;
+    case V_BIGINT:
+        return bigCompare(a.big, b.big) == 0;
+    default:
+        return 0;
+    }
+}
+
+void _cpGrow(ConstantPool* pool)
+{
+    free(pool->table);
+    pool->tableSize *= 2;
+    pool->table = calloc(pool->tableSize, sizeof(size_t));
+    assert(pool->table);
+
+    size_t mask = pool->tableSize - 1;
+    for (size_t j = 0; j < pool->values.length; j++)
+    {
+        size_t i = _cpHash(*listGet(pool->values, j, Variable*)) & mask;
+        while (pool->table[i])
+            i = (i + 1) & mask;
+        pool->table[i] = j + 1;
+    }
+}
@@ -0,0 +1,59 @@
+#ifndef cp_CONSTANT_POOL_INCLUDED
+#define cp_CONSTANT_POOL_INCLUDED
+
+#include <stddef.h>
+
+#include "Runtime.h"
+#include "ParserTree.h"
+
+#ifndef cp_START_SIZE
+#define cp_START_SIZE 64
+#endif // cp_START_SIZE
+
+/**
+ * @brief owns prebuilt immutable values of all literals in a program,
+ * identical literals share single value
+ *
+ */
+typedef struct ConstantPool
+{
+    List values;
+    size_t* table;
+    size_t tableSize;
+} ConstantPool;
+
+/**
+ * @brief creates constant pool for the tree and links all literal nodes
+ * to their values, does nothing if the tree already has a pool
+ *
+ * @param tree tree to create the pool for
+ */
+void cpBuild(ParserTree* tree);
+
+/**
+ * @brief gets value from the pool that is equal to the given value,
+ * the value is added to the pool if it is not there yet
+ *
+ * @param pool pool to search
+ * @param value value to find, the pool takes its ownership
+ * @return Variable* immutable pooled value
+ */
+Variable* cpAdd(ConstantPool* pool, Variable value);
+
+/**
+ * @brief creates pooled value for the literal in the given node
+ *
+ * @param pool pool where to add the value
+ * @param node literal node
+ * @return Variable* pooled value or NULL if the node is not literal
+ */
+Variable* cpAddNode(ConstantPool* pool, ParserNode* node);
+
+/**
+ * @brief frees the pool with all of its values
+ *
+ * @param pool pool to free
+ */
+void cpFree(ConstantPool* pool);
+
+#endif // cp_CONSTANT_POOL_INCLUDED
@@ -0,0 +1,1312 @@
+#include "Emitter.h"
+
+#include <assert.h>
+#include <math.h>
+#include <stdarg.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "Errors.h"
+#include "List.h"
+#include "Memo.h"
+#include "Runtime.h"
+#include "StringBuilder.h"
+
+/**
+ * @brief C function being emitted, compiled function definition or chunk
+ * of top level expressions
+ *
+ */
+typedef struct _EmitFunction
+{
+    // the body, the prologue is written when the number of temporaries is known
+    StringBuilder code;
+    // index of the layout of the definition or of the chunk
+    size_t index;
+    // the definition, NULL for chunk of top level expressions
+    ParserNode* def;
+    // number of variables of the frame, the temporaries are after the slot
+    // with the closure of the caller
+    size_t size;
+    // number of the temporaries used by the body
+    size_t temps;
+    // number of the declared C variables
+    size_t vars;
+    // indentation of the next line
+    size_t indent;
+    // true if tail call starts the function again
+    _Bool restarts;
+} _EmitFunction;
+
+/**
+ * @brief declared name of global variable with the cache of its index
+ *
+ */
+typedef struct _EmitGlobal
+{
+    String name;
+    size_t index;
+} _EmitGlobal;
+
+/**
+ * @brief state of the translation
+ *
+ */
+typedef struct _Emitter
+{
+    // literals, names, caches of the globals and layouts
+    StringBuilder decls;
+    // the compiled functions
+    StringBuilder functions;
+    // creation and freeing of the literals
+    StringBuilder create;
+    StringBuilder destroy;
+    size_t names;
+    // the names of the global variables, all uses of a name share one cache
+    List globals;
+    // hash table of the indices of globals plus one, 0 for empty entry
+    size_t* table;
+    // number of entries of table, power of two or 0 if it wasn't allocated
+    size_t capacity;
+    size_t constants;
+    size_t layouts;
+    size_t chunks;
+    // nesting of the expression being compiled
+    size_t depth;
+    // name of the source of the tree being compiled
+    const char* filename;
+    Stream* messages;
+    _Bool failed;
+} _Emitter;
+
+/**
+ * @brief operand of arithmetic or comparison computed directly in C
+ *
+ */
+typedef struct _EmitOperand
+{
+    // the literal or the variable that holds the operand
+    char value[64];
+    // V_INT or V_FLOAT for literal, V_NOTHING for variable
+    VariableType literal;
+    // true if the operand is evaluated
+    _Bool evaluated;
+    // true if the evaluated operand is kept in C variable, nothing that may
+    // collect the heap runs before it's used
+    _Bool held;
+    // slot of the operand in the arguments of the call
+    size_t slot;
+} _EmitOperand;
+
+/**
+ * @brief appends formatted text
+ *
+ * @param sb where to append
+ * @param format printf format
+ * @param ... the values
+ */
+void _emitPrintf(StringBuilder* sb, const char* format, ...);
+
+/**
+ * @brief appends formatted text
+ *
+ * @param sb where to append
+ * @param format printf format
+ * @param args the values
+ */
+void _emitVPrintf(StringBuilder* sb, const char* format, va_list args);
+
+/**
+ * @brief appends indented line of code to the function
+ *
+ * @param fn the function
+ * @param format printf format of the line without the new line
+ * @param ... the values
+ */
+void _emitLine(_EmitFunction* fn, const char* format, ...);
+
+/**
+ * @brief appends C string literal
+ *
+ * @param sb where to append
+ * @param c the characters
+ * @param length number of the characters
+ */
+void _emitQuote(StringBuilder* sb, const char* c, size_t length);
+
+/**
+ * @brief declares static String with the name
+ *
+ * @param e the emitter
+ * @param name the name
+ * @return size_t index of the declaration
+ */
+size_t _emitName(_Emitter* e, String name);
+
+/**
+ * @brief declares static String with name of global variable and the
+ * cache of its index, the name is declared once
+ *
+ * @param e the emitter
+ * @param name the name
+ * @return size_t index of the declarations
+ */
+size_t _emitGlobal(_Emitter* e, String name);
+
+/**
+ * @brief finds entry of global variable in the hash table
+ *
+ * @param e the emitter
+ * @param name name of the variable
+ * @return size_t* the entry with the name or empty entry
+ */
+size_t* _emitFindGlobal(_Emitter* e, String name);
+
+/**
+ * @brief returns new name of C variable
+ *
+ * @param fn the function
+ * @param name where to write the name, at least 32 chars
+ */
+void _emitVar(_EmitFunction* fn, char* name);
+
+/**
+ * @brief returns slot of temporary and counts it
+ *
+ * @param fn the function
+ * @param temp index of the temporary
+ * @return size_t the slot
+ */
+size_t _emitTemp(_EmitFunction* fn, size_t temp);
+
+/**
+ * @brief writes C lvalue of local or captured variable
+ *
+ * @param slot the variable
+ * @param out where to write, at least 64 chars
+ */
+void _emitSlot(Slot slot, char* out);
+
+/**
+ * @brief writes C value of int or float literal
+ *
+ * @param v the literal
+ * @param out where to write, at least 64 chars
+ */
+void _emitNumber(Variable* v, char* out);
+
+/**
+ * @brief reports construct that cannot be compiled
+ *
+ * @param e the emitter
+ * @param n the node
+ * @param message what is wrong
+ * @param help how to fix it
+ */
+void _emitError(_Emitter* e, ParserNode* n, const char* message, const char* help);
+
+/**
+ * @brief compiles chunk of top level expressions, the expressions are added
+ * until the code has emit_CHUNK characters
+ *
+ * @param e the emitter
+ * @param nodes the expressions
+ * @param count number of the expressions
+ * @param index set to index of the chunk
+ * @return size_t number of the compiled expressions
+ */
+size_t _emitChunk(_Emitter* e, ParserNode** nodes, size_t count, size_t* index);
+
+/**
+ * @brief appends finished function with its prologue and epilogue
+ *
+ * @param e the emitter
+ * @param fn the function
+ */
+void _emitFinish(_Emitter* e, _EmitFunction* fn);
+
+/**
+ * @brief compiles expression, the code stores its value in C variable
+ *
+ * @param e the emitter
+ * @param fn the function that contains the expression
+ * @param n the expression
+ * @param dest name of the C variable, it takes ownership of the value
+ * @param temp index of the first unused temporary, the temporaries are
+ * nothing again after the code
+ * @param tail true if the value is the result of the function
+ */
+void _emitNode(_Emitter* e, _EmitFunction* fn, ParserNode* n, const char* dest, size_t temp, _Bool tail);
+
+/**
+ * @brief compiles function definition into new C function and the code
+ * that creates it with its captured variables
+ *
+ * @param e the emitter
+ * @param fn the function that contains the definition
+ * @param n the definition
+ * @param dest name of the C variable
+ */
+void _emitDef(_Emitter* e, _EmitFunction* fn, ParserNode* n, const char* dest);
+
+/**
+ * @brief compiles if, and, or and cond, the value that decides the result
+ * is checked for exception first like the evaluator does
+ *
+ * @param e the emitter
+ * @param fn the function
+ * @param n the special form
+ * @param dest name of the C variable
+ * @param temp index of the first unused temporary
+ * @param tail true if the value is the result of the function
+ */
+void _emitBranch(_Emitter* e, _EmitFunction* fn, ParserNode* n, const char* dest, size_t temp, _Bool tail);
+
+/**
+ * @brief compiles function call
+ *
+ * @param e the emitter
+ * @param fn the function
+ * @param n the call
+ * @param dest name of the C variable
+ * @param temp index of the first unused temporary
+ * @param tail true if the value is the result of the function
+ */
+void _emitCall(_Emitter* e, _EmitFunction* fn, ParserNode* n, const char* dest, size_t temp, _Bool tail);
+
+/**
+ * @brief compiles call of arithmetic or comparison builtin with two
+ * arguments, ints and floats are computed directly and other values call
+ * the builtin
+ *
+ * @param e the emitter
+ * @param fn the function
+ * @param n the call
+ * @param dest name of the C variable
+ * @param temp index of the first unused temporary
+ * @param global index of the declarations of the name of the builtin
+ * @param head name of the C variable that points to the called function
+ * @return true the call was compiled
+ * @return false the name isn't of arithmetic or comparison or the call
+ * doesn't have two arguments
+ */
+_Bool _emitArithmetic(_Emitter* e, _EmitFunction* fn, ParserNode* n, const char* dest, size_t temp, size_t global, const char* head);
+
+/**
+ * @brief compiles the arguments of call into their slots
+ *
+ * @param e the emitter
+ * @param fn the function
+ * @param n the call
+ * @param base index of the temporary of the first argument
+ */
+void _emitArgs(_Emitter* e, _EmitFunction* fn, ParserNode* n, size_t base);
+
+/**
+ * @brief compiles argument into its slot
+ *
+ * @param e the emitter
+ * @param fn the function
+ * @param a the argument
+ * @param slot the slot
+ * @param temp index of the first unused temporary
+ */
+void _emitArg(_Emitter* e, _EmitFunction* fn, ParserNode* a, size_t slot, size_t temp);
+
+/**
+ * @brief checks whether evaluating the node can't change any variable
+ *
+ * @param n the node
+ * @return true the node is literal or identifier
+ * @return false the node may change variables
+ */
+_Bool _emitSimple(ParserNode* n);
+
+/**
+ * @brief checks whether the nodes set local variable of the function
+ * that contains them
+ *
+ * @param nodes the nodes
+ * @param start index of the first node to check
+ * @return true some of the nodes sets local variable
+ * @return false no local variable is set
+ */
+_Bool _emitSetsLocal(List nodes, size_t start);
+
+/**
+ * @brief finds the modules in the order in which progRun runs them,
+ * every module is marked before its own imports so that cyclic imports end
+ *
+ * @param p the program
+ * @param seen the marked programs
+ * @param order where to add the modules
+ */
+void _emitOrder(Program* p, List* seen, List* order);
+
+_Bool emitProgram(Program* p, Stream* out, Stream* messages)
+{
+    _Emitter e =
+    {
+        .decls = sbCreate(),
+        .functions = sbCreate(),
+        .create = sbCreate(),
+        .destroy = sbCreate(),
+        .globals = listNew(_EmitGlobal),
+        .messages = messages,
+    };
+
+    List seen = listNew(Program*);
+    List order = listNew(Program*);
+    listAdd(seen, p, Program*);
+    _emitOrder(p, &seen, &order);
+    listAdd(order, p, Program*);
+    listFree(seen);
+
+    // every tree has at least one chunk so that its value is the value of
+    // its last expression even if it is empty
+    List chunks = listNew(size_t);
+    for (size_t i = 0; i < order.length && !e.failed; i++)
+    {
+        ParserTree* tree = &listGet(order, i, Program*)->tree;
+        e.filename = tree->filename;
+        List nodes = listNew(ParserNode*);
+        for (size_t j = 0; j < tree->nodes.length; j++)
+        {
+            ParserNode* n = listGetP(tree->nodes, j);
+            if (n->type != P_NOTHING)
+                listAdd(nodes, n, ParserNode*);
+        }
+        size_t start = 0;
+        do
+        {
+            size_t chunk;
+            start += _emitChunk(&e, (ParserNode**)nodes.data + start, nodes.length - start, &chunk);
+            listAdd(chunks, chunk, size_t);
+        } while (start < nodes.length && !e.failed);
+        listFree(nodes);
+    }
+    listFree(order);
+
+    if (!e.failed)
+    {
+        stPrintf(out, "// compiled by slang --emit-c from %s, build it together with\n", p->filename.c);
+        stPrintf(out, "// the sources of slang except main.c\n");
+        stPrintf(out, "#include <math.h>\n\n#include \"Native.h\"\n\n");
+        stWrite(out, e.decls.buffer, e.decls.length);
+        stPrintf(out, "\n");
+        stWrite(out, e.functions.buffer, e.functions.length);
+
+        stPrintf(out, "static void _constants(_Bool create)\n{\n    if (create)\n    {\n");
+        stWrite(out, e.create.buffer, e.create.length);
+        stPrintf(out, "        return;\n    }\n");
+        stWrite(out, e.destroy.buffer, e.destroy.length);
+        stPrintf(out, "}\n\n");
+
+        stPrintf(out, "static Variable _run(Runtime* r)\n{\n");
+        for (size_t i = 0; i < chunks.length; i++)
+        {
+            size_t chunk = listGet(chunks, i, size_t);
+            if (i == 0)
+            {
+                stPrintf(out, "    Variable res = _t%zu(r);\n", chunk);
+                continue;
+            }
+            stPrintf(out, "    if (res.type == V_EXCEPTION)\n        return res;\n");
+            stPrintf(out, "    natFree(res);\n    res = _t%zu(r);\n", chunk);
+        }
+        stPrintf(out, "    return res;\n}\n\n");
+
+        stPrintf(out, "int main(int argc, char** argv)\n{\n");
+        stPrintf(out, "    return natMain(argc, argv, _run, _constants);\n}\n");
+    }
+
+    listFree(chunks);
+    listFree(e.globals);
+    free(e.table);
+    sbFree(&e.decls);
+    sbFree(&e.functions);
+    sbFree(&e.create);
+    sbFree(&e.destroy);
+    return !e.failed;
+}
+
+void _emitPrintf(StringBuilder* sb, const char* format, ...)
+{
+    va_list args;
+    va_start(args, format);
+    _emitVPrintf(sb, format, args);
+    va_end(args);
+}
+
+void _emitVPrintf(StringBuilder* sb, const char* format, va_list args)
+{
+    char buffer[256];
+    va_list copy;
+    va_copy(copy, args);
+    int length = vsnprintf(buffer, sizeof(buffer), format, args);
+    assert(length >= 0);
+    if ((size_t)length < sizeof(buffer))
+    {
+        sbAppendL(sb, buffer, length);
+        va_end(copy);
+        return;
+    }
+
+    char* large = malloc(length + 1);
+    assert(large);
+    vsnprintf(large, length + 1, format, copy);
+    va_end(copy);
+    sbAppendL(sb, large, length);
+    free(large);
+}
+
+void _emitLine(_EmitFunction* fn, const char* format, ...)
+{
+    for (size_t i = 0; i < fn->indent; i++)
+        sbAppend(&fn->code, "    ");
+
+    va_list args;
+    va_start(args, format);
+    _emitVPrintf(&fn->code, format, args);
+    va_end(args);
+    sbAdd(&fn->code, '\n');
+}
+
+void _emitQuote(StringBuilder* sb, const char* c, size_t length)
+{
+    sbAdd(sb, '"');
+    for (size_t i = 0; i < length; i++)
+    {
+        unsigned char ch = (unsigned char)c[i];
+        // octal escapes have always three digits so that the next
+        // character cannot continue them, ? would start trigraph
+        if (ch == '"' || ch == '\\' || ch == '?' || ch < ' ' || ch > '~')
+            _emitPrintf(sb, "\\%03o", ch);
+        else
+            sbAdd(sb, (char)ch);
+    }
+    sbAdd(sb, '"');
+}
+
+size_t _emitName(_Emitter* e, String name)
+{
+    size_t index = e->names++;
+    if (!name.c)
+    {
+        _emitPrintf(&e->decls, "static String _n%zu = { NULL, 0 };\n", index);
+        return index;
+    }
+    _emitPrintf(&e->decls, "static String _n%zu = { (char*)", index);
+    _emitQuote(&e->decls, name.c, name.length);
+    _emitPrintf(&e->decls, ", %zu };\n", name.length);
+    return index;
+}
+
+size_t _emitGlobal(_Emitter* e, String name)
+{
+    if ((e->globals.length + 1) * 2 > e->capacity)
+    {
+        free(e->table);
+        e->capacity = e->capacity ? e->capacity * 2 : 64;
+        e->table = calloc(e->capacity, sizeof(size_t));
+        assert(e->table);
+        for (size_t i = 0; i < e->globals.length; i++)
+            *_emitFindGlobal(e, listGet(e->globals, i, _EmitGlobal).name) = i + 1;
+    }
+
+    size_t* entry = _emitFindGlobal(e, name);
+    if (*entry)
+        return listGet(e->globals, *entry - 1, _EmitGlobal).index;
+
+    _EmitGlobal g = { .name = name, .index = _emitName(e, name) };
+    _emitPrintf(&e->decls, "static size_t _g%zu;\n", g.index);
+    listAddP(&e->globals, &g);
+    *entry = e->globals.length;
+    return g.index;
+}
+
+size_t* _emitFindGlobal(_Emitter* e, String name)
+{
+    // FNV-1a of the name
+    uint64_t h = 0xcbf29ce484222325ull;
+    for (size_t i = 0; i < name.length; i++)
+        h = (h ^ (unsigned char)name.c[i]) * 0x100000001b3ull;
+
+    size_t mask = e->capacity - 1;
+    for (size_t i = (size_t)h & mask;; i = (i + 1) & mask)
+    {
+        if (!e->table[i])
+            return e->table + i;
+        String other = listGet(e->globals, e->table[i] - 1, _EmitGlobal).name;
+        if (other.length == name.length && memcmp(other.c, name.c, name.length) == 0)
+            return e->table + i;
+    }
+}
+
+void _emitVar(_EmitFunction* fn, char* name)
+{
+    snprintf(name, 32, "_v%zu", fn->vars++);
+}
+
+size_t _emitTemp(_EmitFunction* fn, size_t temp)
+{
+    if (temp + 1 > fn->temps)
+        fn->temps = temp + 1;
+    return fn->size + 1 + temp;
+}
+
+void _emitSlot(Slot slot, char* out)
+{
+    if (slot.type == S_LOCAL)
+        snprintf(out, 64, "natSlot(r, %zu)", slot.index);
+    else
+        snprintf(out, 64, "r->closure->variables[%zu]", slot.index);
+}
+
+void _emitNumber(Variable* v, char* out)
+{
+    if (v->type == V_INT && v->integer == INT64_MIN)
+        snprintf(out, 64, "(-9223372036854775807LL - 1)");
+    else if (v->type == V_INT)
+        snprintf(out, 64, "%lldLL", v->integer);
+    else if (isnan(v->decimal))
+        snprintf(out, 64, "NAN");
+    else if (isinf(v->decimal))
+        snprintf(out, 64, v->decimal > 0 ? "HUGE_VAL" : "(-HUGE_VAL)");
+    else
+        // hexadecimal floats are exact
+        snprintf(out, 64, "%a", v->decimal);
+}
+
+void _emitError(_Emitter* e, ParserNode* n, const char* message, const char* help)
+{
+    e->failed = 1;
+    if (!e->messages)
+        return;
+
+    // the special forms don't have tokens, the position is of their first token
+    List pending = listNew(ParserNode*);
+    listAdd(pending, n, ParserNode*);
+    Token* at = NULL;
+    while (pending.length && !at)
+    {
+        ParserNode* p = listGet(pending, --pending.length, ParserNode*);
+        at = p->token;
+        for (size_t i = p->nodes.length; i > 0; i--)
+            listAdd(pending, listGetP(p->nodes, i - 1), ParserNode*);
+    }
+    listFree(pending);
+
+    if (!at)
+    {
+        stPrintf(e->messages, "Error: %s\n", message);
+        return;
+    }
+    ErrorToken err = errCreateErrorToken(E_ERROR, tokenCreate(T_ERROR, at->pos), message, help);
+    errPrintErrorToken(e->messages, err, e->filename);
+    stPrintf(e->messages, "\n");
+    errFreeErrorToken(err);
+}
+
+size_t _emitChunk(_Emitter* e, ParserNode** nodes, size_t count, size_t* index)
+{
+    _EmitFunction fn =
+    {
+        .code = sbCreate(),
+        .index = e->chunks++,
+        .def = NULL,
+        .size = 0,
+        .indent = 1,
+    };
+
+    // the previous value isn't kept alive while the next one is evaluated
+    size_t i = 0;
+    for (; i < count && !e->failed && (i == 0 || fn.code.length < emit_CHUNK); i++)
+    {
+        _emitLine(&fn, "natFree(res);");
+        _emitLine(&fn, "if (gcShouldCollect(&r->gc))");
+        _emitLine(&fn, "    natCollect(r);");
+        _emitNode(e, &fn, nodes[i], "res", 0, 0);
+        _emitLine(&fn, "if (res.type == V_EXCEPTION)");
+        _emitLine(&fn, "    goto _done;");
+    }
+
+    _emitFinish(e, &fn);
+    sbFree(&fn.code);
+    *index = fn.index;
+    return i;
+}
+
+void _emitFinish(_Emitter* e, _EmitFunction* fn)
+{
+    StringBuilder* out = &e->functions;
+    if (fn->def)
+    {
+        _emitPrintf(out, "static Variable _f%zu(Function* f, Runtime* r, Variable* args, size_t argc)\n{\n", fn->index);
+        _emitPrintf(out, "    size_t caller;\n    Variable res;\n");
+        _emitPrintf(out, "    if (!natEnter(f, r, args, argc, %zu, &caller, &res))\n        return res;\n", fn->temps);
+        if (fn->restarts)
+            _emitPrintf(out, "_start:;\n");
+        sbAppendL(out, fn->code.buffer, fn->code.length);
+        _emitPrintf(out, "    natLeave(r, %zu, caller, &res);\n    return res;\n}\n\n", fn->size);
+        return;
+    }
+
+    _emitPrintf(&e->decls, "static Variable _t%zu(Runtime* r);\n", fn->index);
+    _emitPrintf(out, "static Variable _t%zu(Runtime* r)\n{\n", fn->index);
+    _emitPrintf(out, "    size_t caller;\n    Variable res;\n");
+    _emitPrintf(out, "    if (!natEnter(NULL, r, NULL, 0, %zu, &caller, &res))\n        return res;\n", fn->temps);
+    _emitPrintf(out, "    res = (Variable){ .type = V_NOTHING };\n");
+    sbAppendL(out, fn->code.buffer, fn->code.length);
+    if (fn->code.length)
+        _emitPrintf(out, "_done:\n");
+    _emitPrintf(out, "    natLeave(r, 0, caller, &res);\n    return res;\n}\n\n");
+}
+
+void _emitNode(_Emitter* e, _EmitFunction* fn, ParserNode* n, const char* dest, size_t temp, _Bool tail)
+{
+    if (e->failed)
+        return;
+    if (++e->depth > emit_MAX_NESTING)
+    {
+        _emitError(e, n, "expression is nested too deeply to be compiled to C", "split it into functions");
+        e->depth--;
+        return;
+    }
+
+    char value[64];
+    switch (n->type)
+    {
+    case P_VALUE_INTEGER:
+        _emitNumber(n->value, value);
+        _emitLine(fn, "%s = (Variable){ .type = V_INT, .integer = %s };", dest, value);
+        break;
+    case P_VALUE_FLOAT:
+        _emitNumber(n->value, value);
+        _emitLine(fn, "%s = (Variable){ .type = V_FLOAT, .decimal = %s };", dest, value);
+        break;
+    case P_VALUE_CHAR:
+        _emitLine(fn, "%s = (Variable){ .type = V_CHAR, .character = (char)%d };", dest, (int)n->value->character);
+        break;
+    case P_VALUE_BOOL:
+        _emitLine(fn, "%s = (Variable){ .type = V_BOOL, .boolean = %d };", dest, (int)n->value->boolean);
+        break;
+    case P_VALUE_STRING:
+    case P_VALUE_BIGINT:
+    {
+        // the literals are constants like the ones of the constant pool
+        size_t index = e->constants++;
+        String s = n->type == P_VALUE_STRING ? n->value->str : n->token->string;
+        _emitPrintf(&e->decls, "static Variable _c%zu;\n", index);
+        _emitPrintf(&e->create, "        _c%zu = natConstant(%s, ", index, n->type == P_VALUE_STRING ? "V_STRING" : "V_BIGINT");
+        _emitQuote(&e->create, s.c ? s.c : "", s.length);
+        _emitPrintf(&e->create, ", %zu);\n", s.length);
+        _emitPrintf(&e->destroy, "    natFreeConstant(_c%zu);\n", index);
+        _emitLine(fn, "%s = _c%zu;", dest, index);
+        break;
+    }
+    case P_IDENTIFIER:
+        if (n->slot.type == S_GLOBAL)
+        {
+            size_t global = _emitGlobal(e, n->token->string);
+            _emitLine(fn, "%s = natGet(r, &_g%zu, _n%zu);", dest, global, global);
+            break;
+        }
+        _emitSlot(n->slot, value);
+        _emitLine(fn, "%s = natCopy(&%s);", dest, value);
+        break;
+    case P_VARIABLE_SETTER:
+    case P_FUNCTION_SETTER:
+    {
+        char v[32];
+        _emitVar(fn, v);
+        size_t name = _emitName(e, n->token->string);
+        _emitLine(fn, "{");
+        fn->indent++;
+        _emitLine(fn, "Variable %s;", v);
+        _emitNode(e, fn, listGetP(n->nodes, 0), v, temp, 0);
+        // only the variables of the frame are local, others are global
+        if (n->slot.type == S_LOCAL)
+            _emitLine(fn, "%s = natSetLocal(r, %zu, _n%zu, %s);", dest, n->slot.index, name, v);
+        else
+            _emitLine(fn, "%s = natSet(r, _n%zu, %s);", dest, name, v);
+        fn->indent--;
+        _emitLine(fn, "}");
+        break;
+    }
+    case P_NOTHING:
+    // the modules run before the program that imports them
+    case P_IMPORT:
+        _emitLine(fn, "%s = (Variable){ .type = V_NOTHING };", dest);
+        break;
+    case P_FUNCTION_DEFINITION:
+        _emitDef(e, fn, n, dest);
+        break;
+    case P_MEMO:
+    {
+        // the capacity is optional literal before the definition
+        size_t capacity = memo_DEFAULT_CAPACITY;
+        if (n->nodes.length == 2)
+            capacity = (size_t)listGet(n->nodes, 0, ParserNode).token->integer;
+        _emitDef(e, fn, listGetP(n->nodes, n->nodes.length - 1), dest);
+        _emitLine(fn, "%s.function.memo = memoCreate(&r->gc, %zu);", dest, capacity);
+        break;
+    }
+    case P_LAZY:
+        _emitError(e, n, "lazy value cannot be compiled to C", "run the script with slang");
+        break;
+    case P_IF:
+    case P_AND:
+    case P_OR:
+    case P_COND:
+        _emitBranch(e, fn, n, dest, temp, tail);
+        break;
+    case P_FUNCTION_CALL:
+        _emitCall(e, fn, n, dest, temp, tail);
+        break;
+    default:
+        _emitLine(fn, "%s = rtException(strLit(\"InvalidOperation\"), strLit(\"Cannot evaluate\"));", dest);
+        break;
+    }
+    e->depth--;
+}
+
+void _emitDef(_Emitter* e, _EmitFunction* fn, ParserNode* n, const char* dest)
+{
+    assert(n->frame);
+
+    _EmitFunction def =
+    {
+        .code = sbCreate(),
+        .index = e->layouts++,
+        .def = n,
+        .size = n->frame->size,
+        .indent = 1,
+    };
+
+    // the layout is declared before the body so that the body can
+    // recognize calls of the function itself
+    size_t parameters = n->nodes.length - 1;
+    _emitPrintf(&e->decls, "static Variable _f%zu(Function* f, Runtime* r, Variable* args, size_t argc);\n", def.index);
+    _emitPrintf(&e->decls, "static NatLayout _l%zu = { { .size = %zu, .self = %zu }, _f%zu };\n", def.index, n->frame->size, n->frame->self, def.index);
+    if (parameters)
+    {
+        _emitPrintf(&e->decls, "static const String _p%zu[] =\n{\n", def.index);
+        for (size_t i = 0; i < parameters; i++)
+        {
+            // argument of the _ parameter is ignored
+            ParserNode* p = listGetP(n->nodes, i);
+            if (p->type != P_IDENTIFIER)
+            {
+                _emitPrintf(&e->decls, "    { NULL, 0 },\n");
+                continue;
+            }
+            _emitPrintf(&e->decls, "    { (char*)");
+            _emitQuote(&e->decls, p->token->string.c, p->token->string.length);
+            _emitPrintf(&e->decls, ", %zu },\n", p->token->string.length);
+        }
+        _emitPrintf(&e->decls, "};\n");
+    }
+
+    _emitNode(e, &def, listGetP(n->nodes, n->nodes.length - 1), "res", 0, 1);
+    _emitFinish(e, &def);
+    sbFree(&def.code);
+
+    // the captured variables are always copied to heap allocated closure,
+    // it has the same values as the frame of the creator would have
+    char closure[32];
+    _emitVar(fn, closure);
+    _emitLine(fn, "{");
+    fn->indent++;
+    size_t captures = n->frame->captures.length;
+    if (!captures)
+        _emitLine(fn, "Closure* %s = NULL;", closure);
+    else
+        _emitLine(fn, "Closure* %s = rtCreateClosure(r, %zu);", closure, captures);
+    for (size_t i = 0; i < captures; i++)
+    {
+        char slot[64];
+        _emitSlot(listGet(n->frame->captures, i, Slot), slot);
+        _emitLine(fn, "%s->variables[%zu] = natCopy(&%s);", closure, i, slot);
+    }
+    if (parameters)
+        _emitLine(fn, "%s = natFunction(&_l%zu, %s, _p%zu, %zu);", dest, def.index, closure, def.index, parameters);
+    else
+        _emitLine(fn, "%s = natFunction(&_l%zu, %s, NULL, 0);", dest, def.index, closure);
+    fn->indent--;
+    _emitLine(fn, "}");
+}
+
+void _emitBranch(_Emitter* e, _EmitFunction* fn, ParserNode* n, const char* dest, size_t temp, _Bool tail)
+{
+    // [and] is true, [or] is false and [cond] is nothing
+    size_t count = n->nodes.length;
+    if (count == 0)
+    {
+        if (n->type == P_COND)
+            _emitLine(fn, "%s = (Variable){ .type = V_NOTHING };", dest);
+        else
+            _emitLine(fn, "%s = (Variable){ .type = V_BOOL, .boolean = %d };", dest, n->type == P_AND);
+        return;
+    }
+
+    char v[32];
+    _emitVar(fn, v);
+    if (n->type == P_IF)
+    {
+        _emitLine(fn, "{");
+        fn->indent++;
+        _emitLine(fn, "Variable %s;", v);
+        _emitNode(e, fn, listGetP(n->nodes, 0), v, temp, 0);
+        _emitLine(fn, "if (%s.type == V_EXCEPTION)", v);
+        _emitLine(fn, "    %s = %s;", dest, v);
+        _emitLine(fn, "else if (natTruthy(%s))", v);
+        _emitLine(fn, "{");
+        fn->indent++;
+        _emitLine(fn, "natFree(%s);", v);
+        _emitNode(e, fn, listGetP(n->nodes, 1), dest, temp, tail);
+        fn->indent--;
+        _emitLine(fn, "}");
+        _emitLine(fn, "else");
+        _emitLine(fn, "{");
+        fn->indent++;
+        _emitLine(fn, "natFree(%s);", v);
+        if (count < 3)
+            _emitLine(fn, "%s = (Variable){ .type = V_NOTHING };", dest);
+        else
+            _emitNode(e, fn, listGetP(n->nodes, 2), dest, temp, tail);
+        fn->indent--;
+        _emitLine(fn, "}");
+        fn->indent--;
+        _emitLine(fn, "}");
+        return;
+    }
+
+    // the clauses jump to the end so that long forms aren't nested in C
+    char end[32];
+    snprintf(end, sizeof(end), "_e%zu", fn->vars++);
+    _emitLine(fn, "{");
+    fn->indent++;
+    _emitLine(fn, "Variable %s;", v);
+    if (n->type == P_AND || n->type == P_OR)
+    {
+        // the value that decides the result is the result, the last value
+        // is the result too
+        for (size_t i = 0; i + 1 < count; i++)
+        {
+            _emitNode(e, fn, listGetP(n->nodes, i), v, temp, 0);
+            _emitLine(fn, "if (%s.type == V_EXCEPTION || %snatTruthy(%s))", v, n->type == P_AND ? "!" : "", v);
+            _emitLine(fn, "{");
+            _emitLine(fn, "    %s = %s;", dest, v);
+            _emitLine(fn, "    goto %s;", end);
+            _emitLine(fn, "}");
+            _emitLine(fn, "natFree(%s);", v);
+        }
+        _emitNode(e, fn, listGetP(n->nodes, count - 1), dest, temp, tail);
+    }
+    else
+    {
+        // the childs are the conditions and the values of the clauses
+        for (size_t i = 0; i + 1 < count; i += 2)
+        {
+            _emitNode(e, fn, listGetP(n->nodes, i), v, temp, 0);
+            _emitLine(fn, "if (%s.type == V_EXCEPTION)", v);
+            _emitLine(fn, "{");
+            _emitLine(fn, "    %s = %s;", dest, v);
+            _emitLine(fn, "    goto %s;", end);
+            _emitLine(fn, "}");
+            _emitLine(fn, "if (natTruthy(%s))", v);
+            _emitLine(fn, "{");
+            fn->indent++;
+            _emitLine(fn, "natFree(%s);", v);
+            _emitNode(e, fn, listGetP(n->nodes, i + 1), dest, temp, tail);
+            _emitLine(fn, "goto %s;", end);
+            fn->indent--;
+            _emitLine(fn, "}");
+            _emitLine(fn, "natFree(%s);", v);
+        }
+        _emitLine(fn, "%s = (Variable){ .type = V_NOTHING };", dest);
+    }
+    fn->indent--;
+    _emitLine(fn, "%s:;", end);
+    _emitLine(fn, "}");
+}
+
+void _emitCall(_Emitter* e, _EmitFunction* fn, ParserNode* n, const char* dest, size_t temp, _Bool tail)
+{
+    assert(n->nodes.length > 0);
+
+    ParserNode* head = listGetP(n->nodes, 0);
+    size_t argc = n->nodes.length - 1;
+    char f[32];
+    char slot[64];
+    _emitVar(fn, f);
+    _emitLine(fn, "{");
+    fn->indent++;
+
+    // names are resolved trough the variables the runtime remembers, other
+    // heads are evaluated to the temporary before the arguments
+    _Bool named = head->type == P_IDENTIFIER && head->slot.type == S_GLOBAL;
+    size_t global = 0;
+    size_t base = temp;
+    _Bool temporary = 0;
+    if (named)
+    {
+        global = _emitGlobal(e, head->token->string);
+        _emitLine(fn, "Variable* %s = natGlobal(r, &_g%zu, _n%zu);", f, global, global);
+        _emitLine(fn, "if (natCheck(%s, &%s))", f, dest);
+    }
+    else if (head->type == P_IDENTIFIER && !_emitSetsLocal(n->nodes, 1))
+    {
+        // the arguments cannot change the variable
+        _emitSlot(head->slot, slot);
+        _emitLine(fn, "Variable* %s;", f);
+        _emitLine(fn, "if (natCheck(&%s, &%s))", slot, dest);
+    }
+    else
+    {
+        temporary = 1;
+        base = temp + 1;
+        snprintf(slot, sizeof(slot), "natSlot(r, %zu)", _emitTemp(fn, temp));
+        _emitLine(fn, "Variable* %s;", f);
+        _emitNode(e, fn, head, slot, temp + 1, 0);
+        _emitLine(fn, "if (natCheck(&%s, &%s))", slot, dest);
+    }
+    _emitLine(fn, "{");
+    fn->indent++;
+
+    if (named && _emitArithmetic(e, fn, n, dest, base, global, f))
+    {
+        fn->indent--;
+        _emitLine(fn, "}");
+        fn->indent--;
+        _emitLine(fn, "}");
+        return;
+    }
+
+    _emitArgs(e, fn, n, base);
+    // the locals move and the arguments may change the globals so the
+    // function is found again
+    _Bool simple = 1;
+    for (size_t i = 1; i < n->nodes.length; i++)
+        simple = simple && _emitSimple(listGetP(n->nodes, i));
+    if (!named)
+        _emitLine(fn, "%s = &%s;", f, slot);
+    else if (!simple)
+        _emitLine(fn, "%s = natGlobal(r, &_g%zu, _n%zu);", f, global, global);
+
+    size_t first = argc ? _emitTemp(fn, base) : fn->size + 1 + base;
+    // tail call of the function itself reuses its frame, other calls
+    // recurse on the C stack, memoized calls aren't tail calls
+    if (tail && fn->def && !temporary && argc == fn->def->nodes.length - 1)
+    {
+        _emitLine(fn, "if (%s && %s->type == V_FUNCTION && %s->function.frame == &_l%zu.frame && %s->function.closure == r->closure && !%s->function.memo)", f, f, f, fn->index, f, f);
+        _emitLine(fn, "{");
+        _emitLine(fn, "    natRebind(r, &_l%zu.frame, %zu, %zu);", fn->index, first, argc);
+        _emitLine(fn, "    goto _start;");
+        _emitLine(fn, "}");
+        fn->restarts = 1;
+    }
+    _emitLine(fn, "%s = natCall(r, %s, %zu, %zu);", dest, f, first, argc);
+
+    fn->indent--;
+    _emitLine(fn, "}");
+    if (temporary)
+    {
+        _emitLine(fn, "natFree(%s);", slot);
+        _emitLine(fn, "%s = (Variable){ .type = V_NOTHING };", slot);
+    }
+    fn->indent--;
+    _emitLine(fn, "}");
+}
+
+_Bool _emitArithmetic(_Emitter* e, _EmitFunction* fn, ParserNode* n, const char* dest, size_t temp, size_t global, const char* head)
+{
+    static const struct
+    {
+        const char* name;
+        const char* action;
+        // the int operation, NULL for comparison
+        const char* overflow;
+        // the expressions compute the same value as the builtins do
+        const char* integer;
+        const char* decimal;
+    } operators[] =
+    {
+        { "+", "bifAdd", "__builtin_add_overflow", NULL, "0.0 + %s + %s" },
+        { "-", "bifSubtract", "__builtin_sub_overflow", NULL, "%s - %s" },
+        { "*", "bifMultiply", "__builtin_mul_overflow", NULL, "1.0 * %s * %s" },
+        { "<", "bifLess", NULL, "%s < %s", "%s < %s" },
+        { "<=", "bifLessEqual", NULL, "%s <= %s", "!(%s > %s)" },
+        { ">", "bifGreater", NULL, "%s > %s", "%s > %s" },
+        { ">=", "bifGreaterEqual", NULL, "%s >= %s", "!(%s < %s)" },
+        // NaN is equal to everything because the comparison is neither less
+        // nor greater
+        { "=", "bifEqual", NULL, "%s == %s", NULL },
+    };
+
+    if (n->nodes.length != 3)
+        return 0;
+    String name = listGet(n->nodes, 0, ParserNode).token->string;
+    size_t op = sizeof(operators) / sizeof(*operators);
+    for (size_t i = 0; i < sizeof(operators) / sizeof(*operators); i++)
+    {
+        size_t length = strlen(operators[i].name);
+        if (name.length == length && memcmp(name.c, operators[i].name, length) == 0)
+            op = i;
+    }
+    if (op == sizeof(operators) / sizeof(*operators))
+        return 0;
+
+    // literals are C constants and the variables that the second argument
+    // cannot change are read in place, other arguments are evaluated
+    _EmitOperand operands[2];
+    _Bool ints = 1;
+    _Bool floats = 1;
+    for (size_t i = 0; i < 2; i++)
+    {
+        ParserNode* a = listGetP(n->nodes, i + 1);
+        _EmitOperand* o = operands + i;
+        o->slot = _emitTemp(fn, temp + i);
+        o->literal = V_NOTHING;
+        o->evaluated = 0;
+        o->held = 0;
+        if (a->type == P_VALUE_INTEGER || a->type == P_VALUE_FLOAT)
+        {
+            o->literal = a->value->type;
+            _emitNumber(a->value, o->value);
+            ints = ints && a->type == P_VALUE_INTEGER;
+            floats = floats && a->type == P_VALUE_FLOAT;
+        }
+        else if (a->type == P_IDENTIFIER && a->slot.type != S_GLOBAL && (i == 1 || !_emitSetsLocal(n->nodes, 2)))
+            _emitSlot(a->slot, o->value);
+        else
+        {
+            o->evaluated = 1;
+        }
+    }
+    ParserNode* second = listGetP(n->nodes, 2);
+    operands[0].held = operands[0].evaluated && (!operands[1].evaluated || _emitSimple(second));
+    operands[1].held = operands[1].evaluated;
+
+    for (size_t i = 0; i < 2; i++)
+    {
+        _EmitOperand* o = operands + i;
+        if (!o->evaluated)
+            continue;
+        if (!o->held)
+        {
+            snprintf(o->value, sizeof(o->value), "natSlot(r, %zu)", o->slot);
+            _emitArg(e, fn, listGetP(n->nodes, i + 1), o->slot, temp + i);
+            continue;
+        }
+        _emitVar(fn, o->value);
+        _emitLine(fn, "Variable %s;", o->value);
+        _emitNode(e, fn, listGetP(n->nodes, i + 1), o->value, temp + i, 0);
+    }
+    // the locals move and the arguments may change the globals so the
+    // function is found again
+    if (!_emitSimple(listGetP(n->nodes, 1)) || !_emitSimple(second))
+        _emitLine(fn, "%s = natGlobal(r, &_g%zu, _n%zu);", head, global, global);
+
+    char action[32];
+    _emitVar(fn, action);
+    _emitLine(fn, "_Bool %s = %s && %s->type == V_FUNCTION && %s->function.action == %s;", action, head, head, head, operators[op].action);
+
+    // the int and float values of the operands and the checks of their types
+    char values[2][2][192];
+    char checks[2][512];
+    for (size_t j = 0; j < 2; j++)
+    {
+        snprintf(checks[j], sizeof(checks[j]), "%s", action);
+        for (size_t i = 0; i < 2; i++)
+        {
+            _EmitOperand* o = operands + i;
+            if (o->literal != V_NOTHING)
+            {
+                snprintf(values[j][i], sizeof(values[j][i]), "%s", o->value);
+                continue;
+            }
+            snprintf(values[j][i], sizeof(values[j][i]), "%s.%s", o->value, j ? "decimal" : "integer");
+            size_t length = strlen(checks[j]);
+            snprintf(checks[j] + length, sizeof(checks[j]) - length, " && %s.type == %s", o->value, j ? "V_FLOAT" : "V_INT");
+        }
+    }
+
+    char result[32];
+    char value[1024];
+    _emitVar(fn, result);
+    _Bool started = 0;
+    if (ints && operators[op].overflow)
+    {
+        // overflowing ints become bigints in the builtin
+        _emitLine(fn, "long long %s;", result);
+        _emitLine(fn, "if (%s && !%s(%s, %s, &%s))", checks[0], operators[op].overflow, values[0][0], values[0][1], result);
+        _emitLine(fn, "    %s = (Variable){ .type = V_INT, .integer = %s };", dest, result);
+        started = 1;
+    }
+    else if (ints)
+    {
+        snprintf(value, sizeof(value), operators[op].integer, values[0][0], values[0][1]);
+        _emitLine(fn, "if (%s)", checks[0]);
+        _emitLine(fn, "    %s = (Variable){ .type = V_BOOL, .boolean = %s };", dest, value);
+        started = 1;
+    }
+    if (floats)
+    {
+        const char* a = values[1][0];
+        const char* b = values[1][1];
+        if (operators[op].decimal)
+            snprintf(value, sizeof(value), operators[op].decimal, a, b);
+        else
+            snprintf(value, sizeof(value), "!(%s < %s) && !(%s > %s)", a, b, a, b);
+        _emitLine(fn, "%sif (%s)", started ? "else " : "", checks[1]);
+        if (operators[op].overflow)
+            _emitLine(fn, "    %s = (Variable){ .type = V_FLOAT, .decimal = %s };", dest, value);
+        else
+            _emitLine(fn, "    %s = (Variable){ .type = V_BOOL, .boolean = %s };", dest, value);
+        started = 1;
+    }
+
+    // other values call the builtin or the function that replaced it
+    if (started)
+    {
+        _emitLine(fn, "else");
+        _emitLine(fn, "{");
+        fn->indent++;
+    }
+    for (size_t i = 0; i < 2; i++)
+    {
+        _EmitOperand* o = operands + i;
+        if (o->literal == V_INT)
+            _emitLine(fn, "natSlot(r, %zu) = (Variable){ .type = V_INT, .integer = %s };", o->slot, o->value);
+        else if (o->literal == V_FLOAT)
+            _emitLine(fn, "natSlot(r, %zu) = (Variable){ .type = V_FLOAT, .decimal = %s };", o->slot, o->value);
+        else if (o->held)
+            _emitLine(fn, "natSlot(r, %zu) = %s;", o->slot, o->value);
+        else if (!o->evaluated)
+            _emitLine(fn, "natSlot(r, %zu) = natCopy(&%s);", o->slot, o->value);
+    }
+    _emitLine(fn, "%s = natCall(r, %s, %zu, 2);", dest, head, operands[0].slot);
+    if (started)
+    {
+        fn->indent--;
+        _emitLine(fn, "}");
+    }
+    return 1;
+}
+
+void _emitArgs(_Emitter* e, _EmitFunction* fn, ParserNode* n, size_t base)
+{
+    for (size_t i = 1; i < n->nodes.length; i++)
+    {
+        size_t run = 0;
+        while (i + run < n->nodes.length && _emitSimple(listGetP(n->nodes, i + run)))
+            run++;
+        if (run < 2)
+        {
+            _emitArg(e, fn, listGetP(n->nodes, i), _emitTemp(fn, base + i - 1), base + i - 1);
+            continue;
+        }
+
+        // the simple values don't move the locals so the run of them is
+        // stored trough one pointer
+        char args[32];
+        char dest[64];
+        _emitVar(fn, args);
+        _emitLine(fn, "{");
+        fn->indent++;
+        _emitLine(fn, "Variable* %s = &natSlot(r, %zu);", args, _emitTemp(fn, base + i - 1));
+        for (size_t j = 0; j < run; j++)
+        {
+            snprintf(dest, sizeof(dest), "%s[%zu]", args, j);
+            _emitTemp(fn, base + i + j - 1);
+            _emitNode(e, fn, listGetP(n->nodes, i + j), dest, base + i + j - 1, 0);
+        }
+        fn->indent--;
+        _emitLine(fn, "}");
+        i += run - 1;
+    }
+}
+
+void _emitArg(_Emitter* e, _EmitFunction* fn, ParserNode* a, size_t slot, size_t temp)
+{
+    // the locals may move during the evaluation so complex values are
+    // stored after it, the slot is nothing until then
+    char dest[64];
+    snprintf(dest, sizeof(dest), "natSlot(r, %zu)", slot);
+    if (_emitSimple(a))
+    {
+        _emitNode(e, fn, a, dest, temp, 0);
+        return;
+    }
+
+    char v[32];
+    _emitVar(fn, v);
+    _emitLine(fn, "{");
+    fn->indent++;
+    _emitLine(fn, "Variable %s;", v);
+    _emitNode(e, fn, a, v, temp, 0);
+    _emitLine(fn, "%s = %s;", dest, v);
+    fn->indent--;
+    _emitLine(fn, "}");
+}
+
+_Bool _emitSimple(ParserNode* n)
+{
+    switch (n->type)
+    {
+    case P_VALUE_INTEGER:
+    case P_VALUE_BIGINT:
+    case P_VALUE_FLOAT:
+    case P_VALUE_CHAR:
+    case P_VALUE_STRING:
+    case P_VALUE_BOOL:
+    case P_IDENTIFIER:
+    case P_NOTHING:
+        return 1;
+    default:
+        return 0;
+    }
+}
+
+_Bool _emitSetsLocal(List nodes, size_t start)
+{
+    List pending = listNew(ParserNode*);
+    for (size_t i = start; i < nodes.length; i++)
+        listAdd(pending, listGetP(nodes, i), ParserNode*);
+
+    _Bool sets = 0;
+    while (pending.length && !sets)
+    {
+        ParserNode* n = listGet(pending, --pending.length, ParserNode*);
+        // the definitions set the variables of their own frames
+        if (n->type == P_FUNCTION_DEFINITION || n->type == P_LAZY)
+            continue;
+        if ((n->type == P_VARIABLE_SETTER || n->type == P_FUNCTION_SETTER) && n->slot.type == S_LOCAL)
+            sets = 1;
+        for (size_t i = 0; i < n->nodes.length; i++)
+            listAdd(pending, listGetP(n->nodes, i), ParserNode*);
+    }
+    listFree(pending);
+    return sets;
+}
+
+void _emitOrder(Program* p, List* seen, List* order)
+{
+    for (size_t i = 0; i < p->imports.length; i++)
+    {
+        Program* module = listGet(p->imports, i, Program*);
+        _Bool ran = 0;
+        for (size_t j = 0; j < seen->length && !ran; j++)
+            ran = listGet(*seen, j, Program*) == module;
+        if (ran)
+            continue;
+        listAdd(*seen, module, Program*);
+
+        _emitOrder(module, seen, order);
+        listAdd(*order, module, Program*);
+    }
+}
@@ -0,0 +1,38 @@
+#ifndef emit_EMITTER_INCLUDED
+#define emit_EMITTER_INCLUDED
+
+#include "Program.h"
+#include "Stream.h"
+
+#ifndef emit_MAX_NESTING
+// more deeply nested expressions are not compiled, every level opens up to
+// three blocks and clang limits the nesting of brackets to 256
+#define emit_MAX_NESTING 80
+#endif // emit_MAX_NESTING
+
+#ifndef emit_CHUNK
+// top level expressions are compiled into C functions of about this many
+// characters, the C compilers are slow on very large functions
+#define emit_CHUNK 16384
+#endif // emit_CHUNK
+
+/**
+ * @brief translates the program and the modules it imports into C source
+ * that runs it without the evaluator, every function definition becomes
+ * C function that keeps its values in the frame of the runtime so that the
+ * heap can be collected, the calls of arithmetic and comparison builtins
+ * with two int or float arguments are computed directly in C, the source
+ * includes Native.h and it is compiled together with the sources of slang
+ * except main.c, the executable recognizes the -j and -S options of slang
+ *
+ * @param p the program, the imports must be loaded by modLoad
+ * @param out where to write the C source
+ * @param messages where to print why the program cannot be compiled, may
+ * be NULL
+ * @return true the whole source was written
+ * @return false the program uses lazy values, which need the evaluator,
+ * or it is nested too deeply
+ */
+_Bool emitProgram(Program* p, Stream* out, Stream* messages);
+
+#endif // emit_EMITTER_INCLUDED
@@ -7,151 +7,1541 @@
 #include "Runtime.h"
 #include "DebugTools.h"
 #include "BuiltinFunctions.h"
+#include "Memo.h"
+#include "Reduce.h"
+#include "Jit.h"
+
+typedef enum _EvTaskType
+{
+    // evaluates the next child of function call or applies the function
+    EV_CALL,
+    // evaluates the value of setter or sets the variable
+    EV_SET,
+    // leaves the frame of user function
+    EV_RETURN,
+    // computes the value of thunk and replaces the thunk on the value stack
+    EV_FORCE,
+    // selects the next child of if, and, or and cond by the last value
+    EV_BRANCH,
+    // adds the result of memoized function to its cache
+    EV_MEMO,
+} _EvTaskType;
 
 /**
- * @brief executes function call
- * 
- * @param n node with the function call
+ * @brief pending evaluation step on the work stack
+ *
+ */
+typedef struct _EvTask
+{
+    _EvTaskType type;
+    ParserNode* node;
+    // EV_CALL and EV_SET: index of the next child to evaluate
+    // EV_FORCE: 1 if the evaluation of the thunk has started
+    // EV_BRANCH: index of the child that follows the evaluated one
+    // EV_MEMO: number of arguments
+    size_t index;
+    // EV_RETURN and EV_FORCE: frame of the caller
+    size_t frame;
+    union
+    {
+        // EV_RETURN and EV_FORCE: closure of the caller
+        Closure* closure;
+        // EV_MEMO: cache of the called function
+        Memo* memo;
+    };
+    // EV_RETURN and EV_FORCE: environment of the caller
+    size_t env;
+    // EV_CALL: position of the first argument on the value stack
+    // EV_FORCE: position of the thunk on the value stack
+    size_t base;
+    // EV_CALL: runtime version when the function was resolved
+    size_t version;
+    union
+    {
+        // EV_CALL: the called function if it is not temporary
+        Function* function;
+        // EV_MEMO: copies of the arguments
+        Variable* key;
+    };
+    // EV_CALL: true if the function is owned by head
+    _Bool temporary;
+    // EV_CALL: value of the head if it is temporary function
+    // EV_FORCE: the thunk
+    Variable head;
+} _EvTask;
+
+/**
+ * @brief evaluator state, the work stack replaces the C stack so
+ * the nesting depth is limited only by memory
+ *
+ */
+typedef struct _EvMachine
+{
+    Runtime* r;
+    // pending steps, List of _EvTask
+    List tasks;
+    // results of evaluated nodes, List of Variable
+    List values;
+    // false for evaluators started by builtins, the values their callers
+    // hold aren't visible to the collector
+    _Bool collect;
+} _EvMachine;
+
+/**
+ * @brief creates new evaluator state
+ *
  * @param r runtime context
- * @return Variable call result
+ * @return _EvMachine new machine
+ */
+_EvMachine _evCreateMachine(Runtime* r);
+
+/**
+ * @brief frees the evaluator state
+ *
+ * @param m machine to free
+ */
+void _evFreeMachine(_EvMachine m);
+
+/**
+ * @brief collects the heap of the runtime
+ *
+ * @param m evaluator whose state is the root of the collection
+ */
+void _evCollect(_EvMachine* m);
+
+/**
+ * @brief visits the variables of the runtime and the values and tasks of
+ * the evaluator
+ *
+ * @param gc heap being collected
+ * @param context the evaluator
+ */
+void _evRoots(Gc* gc, void* context);
+
+/**
+ * @brief evaluates node to its value
+ *
+ * @param m machine that evaluates the node
+ * @param n node to evaluate
+ * @return Variable value
+ */
+Variable _evRun(_EvMachine* m, ParserNode* n);
+
+/**
+ * @brief runs the pending tasks above the given position of the work stack
+ *
+ * @param m evaluator state
+ * @param tasks number of tasks that aren't run
+ * @param values number of values below the value of the tasks
+ * @return Variable value computed by the tasks
+ */
+Variable _evFinish(_EvMachine* m, size_t tasks, size_t values);
+
+/**
+ * @brief starts evaluating node, the value is pushed to the value stack
+ * directly or once the pushed tasks complete
+ *
+ * @param m evaluator state
+ * @param n node to evaluate
+ */
+void _evEval(_EvMachine* m, ParserNode* n);
+
+/**
+ * @brief pushes value to the value stack
+ *
+ * @param m evaluator state
+ * @param v value to push
+ */
+void _evPush(_EvMachine* m, Variable v);
+
+/**
+ * @brief removes value from the top of the value stack
+ *
+ * @param m evaluator state
+ * @return Variable the value
  */
-Variable _evCall(ParserNode n, Runtime* r);
+Variable _evPop(_EvMachine* m);
 
 /**
- * @brief sets variable
- * 
- * @param n node with the variable
+ * @brief pushes task to the work stack
+ *
+ * @param m evaluator state
+ * @param t task to push
+ */
+void _evPushTask(_EvMachine* m, _EvTask t);
+
+/**
+ * @brief removes task from the top of the work stack
+ *
+ * @param m evaluator state
+ * @return _EvTask the task
+ */
+_EvTask _evPopTask(_EvMachine* m);
+
+/**
+ * @brief frees all pending tasks and values above the given positions
+ *
+ * @param m evaluator state
+ * @param tasks number of tasks to keep
+ * @param values number of values to keep
+ */
+void _evUnwind(_EvMachine* m, size_t tasks, size_t values);
+
+/**
+ * @brief replaces thunk on the value stack with its value, if the value
+ * isn't known yet, task that computes it is pushed
+ *
+ * @param m evaluator state
+ * @param slot position on the value stack
+ * @return true the value must be computed first
+ * @return false the slot doesn't contain thunk
+ */
+_Bool _evForce(_EvMachine* m, size_t slot);
+
+/**
+ * @brief starts the evaluation of the thunk on top of the work stack
+ * or stores the computed value
+ *
+ * @param m evaluator state
+ */
+void _evForceStep(_EvMachine* m);
+
+/**
+ * @brief finds the variable of resolved identifier
+ *
  * @param r runtime context
- * @return Variable the variable that was set
+ * @param n identifier node
+ * @return Variable* the variable or NULL if global variable doesn't exist
  */
-Variable _evSet(ParserNode n, Runtime* r);
+Variable* _evVariable(Runtime* r, ParserNode* n);
 
 /**
- * @brief evaluates statement
- * 
- * @param n node with the statement to evaluate
+ * @brief finds local or captured variable of the running function
+ *
  * @param r runtime context
- * @return Variable value
+ * @param slot S_LOCAL or S_CAPTURED slot
+ * @return Variable* the variable
+ */
+Variable* _evSlot(Runtime* r, Slot slot);
+
+/**
+ * @brief copies the variables captured by function definition or lazy
+ * expression from the current frame
+ *
+ * @param frame layout of the frame of the definition
+ * @param r runtime context
+ * @return Closure* the captured variables or NULL if there are none
+ */
+Closure* _evCapture(FrameLayout* frame, Runtime* r);
+
+/**
+ * @brief copies the variables captured by function that doesn't escape
+ * to the slots reserved for them in the current frame
+ *
+ * @param frame layout of the frame of the definition
+ * @param r runtime context
+ * @return size_t index of the captured variables in the locals plus one
+ */
+size_t _evCaptureInFrame(FrameLayout* frame, Runtime* r);
+
+/**
+ * @brief creates thunk for the expression of lazy node
+ *
+ * @param n lazy node
+ * @param r runtime context
+ * @return Variable the thunk or literal value
+ */
+Variable _evLazy(ParserNode* n, Runtime* r);
+
+/**
+ * @brief creates new memoized function
+ *
+ * @param n memo node
+ * @param r runtime context
+ * @return Variable new function with empty cache
+ */
+Variable _evMemo(ParserNode* n, Runtime* r);
+
+/**
+ * @brief adds the value on top of the value stack to the cache of the
+ * memoized function on top of the work stack, exceptions aren't cached
+ *
+ * @param m evaluator state
+ */
+void _evMemoStep(_EvMachine* m);
+
+/**
+ * @brief starts evaluating special form that evaluates only some of its
+ * childs (if, and, or, cond)
+ *
+ * @param m evaluator state
+ * @param n node of the special form
+ */
+void _evBranch(_EvMachine* m, ParserNode* n);
+
+/**
+ * @brief decides by the value on top of the value stack which child of
+ * the special form on top of the work stack is evaluated next
+ *
+ * @param m evaluator state
+ */
+void _evBranchStep(_EvMachine* m);
+
+/**
+ * @brief determines whether value is true for conditions
+ *
+ * @param v value to check
+ * @return true the value is not false or nothing
+ * @return false the value is false or nothing
+ */
+_Bool _evTruthy(Variable v);
+
+/**
+ * @brief starts function call
+ *
+ * @param m evaluator state
+ * @param n node with the function call
+ */
+void _evCall(_EvMachine* m, ParserNode* n);
+
+/**
+ * @brief evaluates next argument of the call on top of the work stack
+ * or applies the function if all of them are evaluated
+ *
+ * @param m evaluator state
+ */
+void _evCallStep(_EvMachine* m);
+
+/**
+ * @brief calls the function with the arguments on the value stack
+ *
+ * @param m evaluator state
+ * @param t finished call task
  */
-Variable _evEval(ParserNode n, Runtime* r);
+void _evApply(_EvMachine* m, _EvTask t);
+
+/**
+ * @brief resolves the function called by the node trough its name, global
+ * functions are resolved trough the inline cache in the global slot of the
+ * head, so a hit costs comparison of the node and of the runtime version
+ *
+ * @param n node with the function call
+ * @param r runtime context
+ * @param head set to the value of the head if it is not a function
+ * or if the function is temporary value
+ * @return Function* the called function or NULL if the head is not function
+ */
+Function* _evCallee(ParserNode* n, Runtime* r, Variable* head);
+
+/**
+ * @brief creates the result of call whose head is not function
+ *
+ * @param head the value of the head
+ * @return Variable call result
+ */
+Variable _evNotFunction(Variable head);
+
+/**
+ * @brief records the argument types of builtin arithmetic call and
+ * specializes the node once it has seen the same types enough times
+ *
+ * @param n node with the function call
+ * @param f called function
+ * @param par arguments of the call
+ */
+void _evFeedback(ParserNode* n, Function* f, List par);
+
+/**
+ * @brief executes call node specialized for int or float arithmetic,
+ * the node is deoptimized if the types don't match or the int result
+ * overflows
+ *
+ * @param specialized specialization of the node, other runtimes that share
+ * the tree may change it so it is read only once
+ * @param f called function
+ * @param args evaluated arguments
+ * @param argc number of arguments
+ * @param res set to the result
+ * @return true the call was executed
+ * @return false the node was deoptimized and must be called as generic call
+ */
+_Bool _evArithmetic(ParserNodeType specialized, Function* f, Variable* args, size_t argc, Variable* res);
+
+/**
+ * @brief turns specialized node back into generic function call
+ *
+ * @param n node to deoptimize
+ */
+void _evDeopt(ParserNode* n);
+
+/**
+ * @brief evaluates the value of setter on top of the work stack
+ * or sets the variable if it is evaluated
+ *
+ * @param m evaluator state
+ */
+void _evSetStep(_EvMachine* m);
 
 /**
  * @brief creates new function
- * 
+ *
  * @param n node with the function definition
  * @param r runtime context
  * @return Variable new function
  */
-Variable _evDef(ParserNode n, Runtime* r);
+Variable _evDef(ParserNode* n, Runtime* r);
 
-List evEvaluate(ParserTree tree)
+/**
+ * @brief fills the current frame with the arguments, the other variables
+ * of the frame are nothing
+ *
+ * @param f function whose frame to fill
+ * @param r runtime context
+ * @param args arguments, this takes their ownership
+ * @param argc number of arguments, must be the same as number of parameters
+ */
+void _evBind(Function* f, Runtime* r, Variable* args, size_t argc);
+
+/**
+ * @brief frees all locals in the current frame
+ *
+ * @param r runtime context
+ */
+void _evUnbind(Runtime* r);
+
+/**
+ * @brief frees the current frame and returns to the frame of the caller
+ *
+ * @param r runtime context
+ * @param frame frame of the caller
+ * @param closure closure of the caller
+ * @param env environment of the caller
+ */
+void _evLeave(Runtime* r, size_t frame, Closure* closure, size_t env);
+
+Variable evRun(ParserTree* tree, Runtime* r)
 {
-    ListIterator li = liCreate(&tree.nodes);
-    List errors = listNew(FileSpan);
-    Runtime r = rtCreate(&errors);
-    bifRegisterBuiltins(&r);
+    assert(tree->constants);
+
+    rtReserveGlobals(r, tree->slots);
+    _EvMachine m = _evCreateMachine(r);
+    Variable res = rtCreateNothingVariable();
+    for (size_t i = 0; i < tree->nodes.length; i++)
+    {
+        ParserNode* n = listGetP(tree->nodes, i);
+        if (n->type == P_NOTHING)
+            continue;
+
+        // the previous result isn't kept alive while the next one is evaluated
+        rtFreeVariable(res);
+        // the optimizer may turn top level calls into literals
+        res = _evRun(&m, n);
+        if (res.type == V_EXCEPTION)
+            break;
+    }
+
+    _evFreeMachine(m);
+    return res;
+}
 
-    while (liCan(&li))
+_EvMachine _evCreateMachine(Runtime* r)
+{
+    _EvMachine m =
     {
-        ParserNode n = liGet(&li, ParserNode);
-        liMove(&li);
+        .r = r,
+        .tasks = listNew(_EvTask),
+        .values = listNew(Variable),
+        .collect = 1,
+    };
+    return m;
+}
 
-        Variable v;
+void _evFreeMachine(_EvMachine m)
+{
+    assert(m.tasks.length == 0);
+    listFree(m.tasks);
+    listDeepFree(m.values, Variable, v, rtFreeVariable(v));
+}
 
-        switch (n.type)
+Variable _evRun(_EvMachine* m, ParserNode* n)
+{
+    size_t tasks = m->tasks.length;
+    size_t values = m->values.length;
+
+    _evEval(m, n);
+    return _evFinish(m, tasks, values);
+}
+
+Variable _evFinish(_EvMachine* m, size_t tasks, size_t values)
+{
+    while (m->tasks.length > tasks)
+    {
+        if (m->tasks.length - tasks > ev_MAX_DEPTH)
         {
-        case P_NOTHING:
-            continue;
-        case P_FUNCTION_CALL:
-            v = _evCall(n, &r);
+            _evUnwind(m, tasks, values);
+            return rtException(strLit("StackOverflow"), strLit("Maximum evaluation depth exceeded"));
+        }
+
+        // between the steps all values are on the stacks or in variables
+        if (m->collect && gcShouldCollect(&m->r->gc))
+            _evCollect(m);
+
+        switch (((_EvTask*)listGetP(m->tasks, m->tasks.length - 1))->type)
+        {
+        case EV_CALL:
+            _evCallStep(m);
+            break;
+        case EV_SET:
+            _evSetStep(m);
+            break;
+        case EV_RETURN:
+        {
+            _EvTask t = _evPopTask(m);
+            _evLeave(m->r, t.frame, t.closure, t.env);
+            break;
+        }
+        case EV_FORCE:
+            _evForceStep(m);
             break;
-        case P_FUNCTION_SETTER:
-        case P_VARIABLE_SETTER:
-            v = _evSet(n, &r);
+        case EV_BRANCH:
+            _evBranchStep(m);
+            break;
+        case EV_MEMO:
+            _evMemoStep(m);
             break;
         default:
-            dtExcept("evaluate: unsupported operation");
+            dtExcept("_evRun: invalid task");
+        }
+    }
+
+    assert(m->values.length == values + 1);
+    return _evPop(m);
+}
+
+void _evCollect(_EvMachine* m)
+{
+    gcCollect(&m->r->gc, _evRoots, m);
+}
+
+void _evRoots(Gc* gc, void* context)
+{
+    _EvMachine* m = context;
+    Runtime* r = m->r;
+    // the globals of pool thread are the globals of the main runtime, they
+    // cannot point into its heap because the thread cannot set them and the
+    // other threads read them at the same time
+    if (!r->worker)
+    {
+        for (size_t i = 0; i < r->variables.length; i++)
+            gcVisitVariable(gc, listGetP(r->variables, i));
+    }
+    for (size_t i = 0; i < r->locals.length; i++)
+        gcVisitVariable(gc, listGetP(r->locals, i));
+    r->closure = (Closure*)gcVisitObject(gc, (GcObject*)r->closure);
+    for (size_t i = 0; i < m->values.length; i++)
+        gcVisitVariable(gc, listGetP(m->values, i));
+
+    for (size_t i = 0; i < m->tasks.length; i++)
+    {
+        _EvTask* t = listGetP(m->tasks, i);
+        switch (t->type)
+        {
+        case EV_CALL:
+            if (t->temporary)
+                gcVisitVariable(gc, &t->head);
+            break;
+        case EV_RETURN:
+            t->closure = (Closure*)gcVisitObject(gc, (GcObject*)t->closure);
+            break;
+        case EV_FORCE:
+            gcVisitVariable(gc, &t->head);
+            if (t->index)
+                t->closure = (Closure*)gcVisitObject(gc, (GcObject*)t->closure);
+            break;
+        case EV_MEMO:
+            t->memo = (Memo*)gcVisitObject(gc, (GcObject*)t->memo);
+            for (size_t j = 0; j < t->index; j++)
+                gcVisitVariable(gc, t->key + j);
+            break;
+        default:
+            break;
+        }
+    }
+}
+
+void _evEval(_EvMachine* m, ParserNode* n)
+{
+    switch (n->type)
+    {
+    case P_VALUE_INTEGER:
+    case P_VALUE_BIGINT:
+    case P_VALUE_FLOAT:
+    case P_VALUE_CHAR:
+    case P_VALUE_STRING:
+    case P_VALUE_BOOL:
+        assert(n->value);
+        _evPush(m, *n->value);
+        return;
+    case P_IDENTIFIER:
+    {
+        Variable* v = _evVariable(m->r, n);
+        if (!v)
+        {
+            _evPush(m, rtException(strLit("InvalidName"), strLit("The variable doesn't exist")));
+            return;
+        }
+        // functions keep their name so that they can be printed
+        _evPush(m, rtCopyVariable(v->type == V_FUNCTION ? strCopy(v->name) : strEmpty(), *v));
+        return;
+    }
+    case P_FUNCTION_CALL:
+        _evCall(m, n);
+        return;
+    case P_VARIABLE_SETTER:
+    case P_FUNCTION_SETTER:
+    {
+        _EvTask t = { .type = EV_SET, .node = n, .index = 0 };
+        _evPushTask(m, t);
+        return;
+    }
+    case P_NOTHING:
+    // the module already ran in progRun
+    case P_IMPORT:
+        _evPush(m, rtCreateNothingVariable());
+        return;
+    case P_FUNCTION_DEFINITION:
+        _evPush(m, _evDef(n, m->r));
+        return;
+    case P_LAZY:
+        _evPush(m, _evLazy(n, m->r));
+        return;
+    case P_MEMO:
+        _evPush(m, _evMemo(n, m->r));
+        return;
+    case P_IF:
+    case P_AND:
+    case P_OR:
+    case P_COND:
+        _evBranch(m, n);
+        return;
+    default:
+        _evPush(m, rtException(strLit("InvalidOperation"), strLit("Cannot evaluate")));
+        return;
+    }
+}
+
+void _evPush(_EvMachine* m, Variable v)
+{
+    listAddP(&m->values, &v);
+}
+
+Variable _evPop(_EvMachine* m)
+{
+    assert(m->values.length > 0);
+    return listGet(m->values, --m->values.length, Variable);
+}
+
+void _evPushTask(_EvMachine* m, _EvTask t)
+{
+    listAddP(&m->tasks, &t);
+}
+
+_EvTask _evPopTask(_EvMachine* m)
+{
+    assert(m->tasks.length > 0);
+    return listGet(m->tasks, --m->tasks.length, _EvTask);
+}
+
+void _evUnwind(_EvMachine* m, size_t tasks, size_t values)
+{
+    while (m->tasks.length > tasks)
+    {
+        _EvTask t = _evPopTask(m);
+        if (t.type == EV_RETURN || (t.type == EV_FORCE && t.index))
+            _evLeave(m->r, t.frame, t.closure, t.env);
+        if ((t.type == EV_CALL && t.temporary) || t.type == EV_FORCE)
+            rtFreeVariable(t.head);
+        if (t.type == EV_MEMO)
+        {
+            memoFreeKey(t.key, t.index);
+            m->r->memoDepth--;
+        }
+    }
+
+    while (m->values.length > values)
+        rtFreeVariable(_evPop(m));
+}
+
+void _evCall(_EvMachine* m, ParserNode* node)
+{
+    assert(node->nodes.length > 0);
+
+    _EvTask t =
+    {
+        .type = EV_CALL,
+        .node = node,
+        .index = 0,
+        .base = m->values.length,
+        .version = m->r->version,
+        .function = NULL,
+        .temporary = 0,
+    };
+
+    // names are resolved trough the variables the runtime remembers, other
+    // heads are evaluated as the first child
+    if (listGet(node->nodes, 0, ParserNode).type == P_IDENTIFIER)
+    {
+        Variable head;
+        Function* f = _evCallee(node, m->r, &head);
+        if (!f && head.type == V_THUNK)
+        {
+            // the thunk is forced as if the head was evaluated
+            _evPush(m, head);
+            t.index = 1;
+            _evPushTask(m, t);
+            return;
+        }
+        if (!f)
+        {
+            _evPush(m, _evNotFunction(head));
+            return;
+        }
+
+        t.index = 1;
+        t.temporary = f == &head.function;
+        if (t.temporary)
+            t.head = head;
+        else
+            t.function = f;
+    }
+
+    _evPushTask(m, t);
+}
+
+void _evCallStep(_EvMachine* m)
+{
+    _EvTask* t = listGetP(m->tasks, m->tasks.length - 1);
+
+    // the head was just evaluated
+    if (t->index == 1 && !t->function && !t->temporary)
+    {
+        if (_evForce(m, m->values.length - 1))
+            return;
+        Variable head = _evPop(m);
+        if (head.type != V_FUNCTION)
+        {
+            _evPopTask(m);
+            _evPush(m, _evNotFunction(head));
+            return;
+        }
+        t->temporary = 1;
+        t->head = head;
+    }
+
+    if (t->index < t->node->nodes.length)
+    {
+        // t may move when new task is pushed
+        ParserNode* n = listGetP(t->node->nodes, t->index++);
+        _evEval(m, n);
+        return;
+    }
+
+    _evApply(m, _evPopTask(m));
+}
+
+void _evApply(_EvMachine* m, _EvTask t)
+{
+    Runtime* r = m->r;
+    ParserNode* node = t.node;
+    Function* f = t.temporary ? &t.head.function : t.function;
+    Variable* args = listGetP(m->values, t.base);
+    size_t argc = m->values.length - t.base;
+
+    // the arguments may have changed the variable with the function
+    if (!t.temporary && t.version != r->version)
+    {
+        f = _evCallee(node, r, &t.head);
+        if (!f)
+        {
+            while (m->values.length > t.base)
+                rtFreeVariable(_evPop(m));
+            _evPush(m, _evNotFunction(t.head));
+            return;
+        }
+        t.temporary = f == &t.head.function;
+        t.function = t.temporary ? NULL : f;
+        t.version = r->version;
+    }
+
+    // builtins get the values of thunks, the call is applied again
+    // once all of them are computed
+    if (f->action != evRunFunction)
+    {
+        _Bool pending = 0;
+        for (size_t i = 0; i < argc && !pending; i++)
+            pending = args[i].type == V_THUNK;
+        if (pending)
+        {
+            pending = 0;
+            _evPushTask(m, t);
+            for (size_t i = argc; i > 0; i--)
+                pending |= _evForce(m, t.base + i - 1);
+            if (pending)
+                return;
+            t = _evPopTask(m);
+            args = listGetP(m->values, t.base);
+        }
+    }
+
+    // runtimes that share the tree may specialize the node at any time
+    ParserNodeType specialized = __atomic_load_n(&node->feedback.specialized, __ATOMIC_RELAXED);
+    if (specialized != P_FUNCTION_CALL)
+    {
+        Variable res;
+        if (!t.temporary && _evArithmetic(specialized, f, args, argc, &res))
+        {
+            m->values.length = t.base;
+            _evPush(m, res);
+            return;
+        }
+        if (!r->worker)
+            _evDeopt(node);
+    }
+
+    if (f->action != evRunFunction)
+    {
+        List par = listNew(Variable);
+        for (size_t i = 0; i < argc; i++)
+            listAddP(&par, &args[i]);
+        m->values.length = t.base;
+
+        if (!r->worker)
+            _evFeedback(node, f, par);
+        Variable res = rtInvokeFunction(f, r, par);
+        if (t.temporary)
+            rtFreeVariable(t.head);
+        _evPush(m, res);
+        return;
+    }
+
+    if (argc != f->parameters.length)
+    {
+        while (m->values.length > t.base)
+            rtFreeVariable(_evPop(m));
+        if (t.temporary)
+            rtFreeVariable(t.head);
+        _evPush(m, rtException(strLit("InvalidArgumentCount"), strLit("Number of arguments doesn't match the number of parameters")));
+        return;
+    }
+
+    // hot function runs as machine code, the interpreter runs the call if
+    // the code bails out, memoized function must use its cache
+    Variable res;
+    if (!f->memo && jitEnter(f, r, args, argc, &res))
+    {
+        while (m->values.length > t.base)
+            rtFreeVariable(_evPop(m));
+        if (t.temporary)
+            rtFreeVariable(t.head);
+        _evPush(m, res);
+        return;
+    }
+
+    // memoized function isn't called if the result is cached, otherwise
+    // copies of the arguments wait for the result on the work stack
+    // the threads of the pool cannot change the caches of the other heaps
+    Memo* memo = f->memo && gcOwns(&r->gc, &f->memo->header) && memoCanKey(args, argc) ? f->memo : NULL;
+    if (memo)
+    {
+        Variable* cached = memoFind(memo, args, argc);
+        if (cached)
+        {
+            res = rtCopyVariable(strEmpty(), *cached);
+            while (m->values.length > t.base)
+                rtFreeVariable(_evPop(m));
+            if (t.temporary)
+                rtFreeVariable(t.head);
+            _evPush(m, res);
+            return;
+        }
+    }
+
+    // call in tail position reuses the frame of the caller so that
+    // tail recursion runs in constant space, unless the function keeps
+    // its captured variables in that frame
+    Closure* closure = f->closure;
+    _EvTask* top = m->tasks.length ? listGetP(m->tasks, m->tasks.length - 1) : NULL;
+    if (top && top->type == EV_RETURN && f->env <= r->frame)
+        _evUnbind(r);
+    else
+    {
+        _EvTask ret = { .type = EV_RETURN, .frame = r->frame, .closure = r->closure, .env = r->env };
+        _evPushTask(m, ret);
+        r->frame = r->locals.length;
+    }
+    r->closure = closure;
+    r->env = f->env;
+
+    // the result must be stored, so the calls in the body are not in tail position,
+    // the body and everything it calls cannot print until it is stored
+    if (memo)
+    {
+        _EvTask store = { .type = EV_MEMO, .index = argc, .memo = memo, .key = memoCopyKey(args, argc) };
+        _evPushTask(m, store);
+        r->memoDepth++;
+    }
+
+    ParserNode* body = f->body;
+    _evBind(f, r, args, argc);
+    m->values.length = t.base;
+    if (t.temporary)
+        rtFreeVariable(t.head);
+
+    _evEval(m, body);
+}
+
+_Bool _evForce(_EvMachine* m, size_t slot)
+{
+    Variable* v = listGetP(m->values, slot);
+    while (v->type == V_THUNK)
+    {
+        Thunk* thunk = v->thunk;
+        if (!thunk->forced)
+        {
+            _EvTask t =
+            {
+                .type = EV_FORCE,
+                .index = 0,
+                .base = slot,
+                .head = rtCopyVariable(strEmpty(), *v),
+            };
+            _evPushTask(m, t);
+            return 1;
+        }
+
+        Variable value = rtCopyVariable(strEmpty(), thunk->value);
+        rtFreeVariable(*v);
+        *v = value;
+    }
+    return 0;
+}
+
+void _evForceStep(_EvMachine* m)
+{
+    Runtime* r = m->r;
+    _EvTask* t = listGetP(m->tasks, m->tasks.length - 1);
+    Thunk* thunk = t->head.thunk;
+
+    // the same thunk may have been forced by earlier task
+    if (t->index == 0 && !thunk->forced)
+    {
+        t->index = 1;
+        t->frame = r->frame;
+        t->closure = r->closure;
+        t->env = r->env;
+        r->frame = r->locals.length;
+        r->closure = thunk->closure;
+        r->env = 0;
+        for (size_t i = 0; i < thunk->frame->size; i++)
+            listAdd(r->locals, rtCreateNothingVariable(), Variable);
+        _evEval(m, thunk->node);
+        return;
+    }
+
+    _EvTask force = _evPopTask(m);
+    if (force.index)
+    {
+        Variable value = _evPop(m);
+        _evLeave(r, force.frame, force.closure, force.env);
+        if (!thunk->forced && !gcOwns(&r->gc, &thunk->header))
+        {
+            // the threads of the pool don't change thunks of other heaps,
+            // only this use of the thunk gets the value
+            Variable* slot = listGetP(m->values, force.base);
+            rtFreeVariable(*slot);
+            *slot = value;
+        }
+        else if (!thunk->forced)
+        {
+            thunk->value = value;
+            thunk->forced = 1;
+            gcBarrier(&r->gc, &thunk->header);
+        }
+        else
+            rtFreeVariable(value);
+    }
+
+    // the value itself may be thunk which is forced again
+    _evForce(m, force.base);
+    rtFreeVariable(force.head);
+}
+
+Variable _evLazy(ParserNode* n, Runtime* r)
+{
+    assert(n->nodes.length == 1);
+
+    // literals are already values
+    ParserNode* expr = listGetP(n->nodes, 0);
+    if (expr->value)
+        return *expr->value;
+
+    assert(n->frame);
+    return rtThunkVariable(r, expr, n->frame, _evCapture(n->frame, r));
+}
+
+Variable* _evVariable(Runtime* r, ParserNode* n)
+{
+    if (n->slot.type == S_GLOBAL)
+        return rtFindGlobal(r, n);
+    return _evSlot(r, n->slot);
+}
+
+Variable* _evSlot(Runtime* r, Slot slot)
+{
+    if (slot.type == S_LOCAL)
+        return listGetP(r->locals, r->frame + slot.index);
+
+    // function that doesn't escape has the variables in the frame of its creator
+    if (r->env)
+        return listGetP(r->locals, r->env - 1 + slot.index);
+    assert(r->closure);
+    return r->closure->variables + slot.index;
+}
+
+Closure* _evCapture(FrameLayout* frame, Runtime* r)
+{
+    if (frame->captures.length == 0)
+        return NULL;
+
+    // only functions keep their name so that they can be printed
+    Closure* c = rtCreateClosure(r, frame->captures.length);
+    for (size_t i = 0; i < c->length; i++)
+    {
+        Variable* v = _evSlot(r, listGet(frame->captures, i, Slot));
+        c->variables[i] = rtCopyVariable(v->type == V_FUNCTION ? strCopy(v->name) : strEmpty(), *v);
+    }
+    return c;
+}
+
+size_t _evCaptureInFrame(FrameLayout* frame, Runtime* r)
+{
+    size_t env = r->frame + frame->env - 1;
+    for (size_t i = 0; i < frame->captures.length; i++)
+    {
+        Variable* v = _evSlot(r, listGet(frame->captures, i, Slot));
+        Variable copy = rtCopyVariable(strCopy(v->name), *v);
+        Variable* slot = listGetP(r->locals, env + i);
+        rtFreeVariable(*slot);
+        *slot = copy;
+    }
+    return env + 1;
+}
+
+void _evBranch(_EvMachine* m, ParserNode* n)
+{
+    // [and] is true, [or] is false and [cond] is nothing
+    if (n->nodes.length == 0)
+    {
+        _evPush(m, n->type == P_COND ? rtCreateNothingVariable() : rtBoolVariable(n->type == P_AND));
+        return;
+    }
+
+    // the last value of and and or is the result so it is evaluated
+    // without the task, in the tail position
+    if ((n->type == P_AND || n->type == P_OR) && n->nodes.length == 1)
+    {
+        _evEval(m, listGetP(n->nodes, 0));
+        return;
+    }
+
+    _EvTask t = { .type = EV_BRANCH, .node = n, .index = 1 };
+    _evPushTask(m, t);
+    _evEval(m, listGetP(n->nodes, 0));
+}
+
+void _evBranchStep(_EvMachine* m)
+{
+    // the value decides the branch so the thunk must be computed
+    if (_evForce(m, m->values.length - 1))
+        return;
+
+    // the task is removed before the selected child is evaluated so that
+    // calls in the selected branch are in tail position
+    _EvTask t = _evPopTask(m);
+    ParserNode* n = t.node;
+    Variable v = _evPop(m);
+    if (v.type == V_EXCEPTION)
+    {
+        _evPush(m, v);
+        return;
+    }
+
+    _Bool truthy = _evTruthy(v);
+    ParserNode* next;
+    switch (n->type)
+    {
+    case P_IF:
+        rtFreeVariable(v);
+        if (!truthy && n->nodes.length < 3)
+        {
+            _evPush(m, rtCreateNothingVariable());
+            return;
+        }
+        next = listGetP(n->nodes, truthy ? 1 : 2);
+        break;
+    case P_AND:
+    case P_OR:
+        // the value that decides the result is the result
+        if (truthy != (n->type == P_AND))
+        {
+            _evPush(m, v);
+            return;
         }
-        rtPrintExceptionE(stdout, v);
         rtFreeVariable(v);
+        next = listGetP(n->nodes, t.index);
+        if (++t.index < n->nodes.length)
+            _evPushTask(m, t);
+        break;
+    case P_COND:
+        // the index is the position of the value of the tested clause
+        rtFreeVariable(v);
+        if (truthy)
+        {
+            next = listGetP(n->nodes, t.index);
+            break;
+        }
+        if (t.index + 1 >= n->nodes.length)
+        {
+            _evPush(m, rtCreateNothingVariable());
+            return;
+        }
+        next = listGetP(n->nodes, t.index + 1);
+        t.index += 2;
+        _evPushTask(m, t);
+        break;
+    default:
+        dtExcept("_evBranchStep: node is not special form");
     }
 
-    rtFree(r);
-    return errors;
+    _evEval(m, next);
 }
 
-Variable _evCall(ParserNode node, Runtime* r)
+_Bool _evTruthy(Variable v)
 {
-    assert(node.nodes.length > 0);
+    switch (v.type)
+    {
+    case V_BOOL:
+        return v.boolean;
+    case V_NOTHING:
+        return 0;
+    default:
+        return 1;
+    }
+}
 
-    ListIterator li = liCreate(&node.nodes);
-    ParserNode n = liGet(&li, ParserNode);
-    Variable v = _evEval(n, r);
-    
+Function* _evCallee(ParserNode* node, Runtime* r, Variable* head)
+{
+    ParserNode* h = listGetP(node->nodes, 0);
+    assert(h->type == P_IDENTIFIER);
+
+    // locals move when other function is called so they are copied
+    if (h->slot.type != S_GLOBAL)
+    {
+        *head = rtCopyVariable(strEmpty(), *_evVariable(r, h));
+        return head->type == V_FUNCTION ? &head->function : NULL;
+    }
+
+    // any change of the globals changes the version
+    size_t slot = h->slot.index;
+    GlobalSlot* cache = slot < r->globalCapacity ? r->globals + slot : NULL;
+    if (cache && cache->node == h && cache->version == r->version)
+        return cache->function;
+
+    Variable* v = _evVariable(r, h);
+    if (!v)
+    {
+        *head = rtException(strLit("InvalidName"), strLit("The function doesn't exist"));
+        return NULL;
+    }
+    if (v->type != V_FUNCTION)
+    {
+        *head = rtCopyVariable(strEmpty(), *v);
+        return NULL;
+    }
+
+    // the variable was found trough the slot, so the slot has the node
+    if (slot)
+    {
+        cache = r->globals + slot;
+        cache->version = r->version;
+        cache->function = &v->function;
+    }
+    return &v->function;
+}
+
+Variable _evNotFunction(Variable v)
+{
     switch (v.type)
     {
     case V_NOTHING:
         return rtCreateNothingVariable();
-    case V_FUNCTION:
-        break;
     case V_EXCEPTION:
         return v;
     default:
         rtFreeVariable(v);
         return rtException(strLit("InvalidFunction"), strLit("This is not function"));
     }
+}
+
+void _evFeedback(ParserNode* n, Function* f, List par)
+{
+    // the feedback is only hint, when runtimes that share the tree update
+    // it at the same time some updates are lost but the node stays valid
+    if (n->type != P_FUNCTION_CALL)
+        return;
+    if (__atomic_load_n(&n->feedback.specialized, __ATOMIC_RELAXED) != P_FUNCTION_CALL)
+        return;
+    if (__atomic_load_n(&n->feedback.deopts, __ATOMIC_RELAXED) >= ev_MAX_DEOPTS)
+        return;
+
+    if (f->action != bifAdd && f->action != bifMultiply && f->action != bifSubtract)
+        return;
+    if (par.length == 0 || par.length > ev_SPECIALIZE_MAX_ARGS || (f->action == bifSubtract && par.length > 2))
+        return;
+    // only calls trough name can check that the function didn't change
+    if (listGet(n->nodes, 0, ParserNode).type != P_IDENTIFIER)
+        return;
+
+    VariableType seen = listGet(par, 0, Variable).type;
+    for (size_t i = 0; i < par.length; i++)
+    {
+        if (listGet(par, i, Variable).type != seen)
+            seen = V_NOTHING;
+    }
+    if (seen != V_INT && seen != V_FLOAT)
+    {
+        __atomic_store_n(&n->feedback.hits, 0, __ATOMIC_RELAXED);
+        return;
+    }
+
+    unsigned hits = __atomic_load_n(&n->feedback.hits, __ATOMIC_RELAXED) + 1;
+    if (__atomic_load_n(&n->feedback.seen, __ATOMIC_RELAXED) != (int)seen)
+    {
+        __atomic_store_n(&n->feedback.seen, (int)seen, __ATOMIC_RELAXED);
+        hits = 1;
+    }
+    __atomic_store_n(&n->feedback.hits, hits, __ATOMIC_RELAXED);
+    if (hits < ev_SPECIALIZE_THRESHOLD)
+        return;
+
+    ParserNodeType type;
+    if (f->action == bifAdd)
+        type = seen == V_INT ? P_INT_ADD : P_FLOAT_ADD;
+    else if (f->action == bifMultiply)
+        type = seen == V_INT ? P_INT_MULTIPLY : P_FLOAT_MULTIPLY;
+    else
+        type = seen == V_INT ? P_INT_SUBTRACT : P_FLOAT_SUBTRACT;
+    __atomic_store_n(&n->feedback.specialized, type, __ATOMIC_RELAXED);
+}
+
+_Bool _evArithmetic(ParserNodeType specialized, Function* f, Variable* args, size_t argc, Variable* res)
+{
+    Action action;
+    VariableType type;
+    switch (specialized)
+    {
+    case P_INT_ADD:
+        action = bifAdd;
+        type = V_INT;
+        break;
+    case P_INT_MULTIPLY:
+        action = bifMultiply;
+        type = V_INT;
+        break;
+    case P_INT_SUBTRACT:
+        action = bifSubtract;
+        type = V_INT;
+        break;
+    case P_FLOAT_ADD:
+        action = bifAdd;
+        type = V_FLOAT;
+        break;
+    case P_FLOAT_MULTIPLY:
+        action = bifMultiply;
+        type = V_FLOAT;
+        break;
+    case P_FLOAT_SUBTRACT:
+        action = bifSubtract;
+        type = V_FLOAT;
+        break;
+    default:
+        dtExcept("_evArithmetic: node is not specialized");
+    }
 
-    List par = listNew(Variable);
+    // the name may have been redefined
+    if (f->action != action || argc == 0 || argc > ev_SPECIALIZE_MAX_ARGS)
+        return 0;
+    for (size_t i = 0; i < argc; i++)
+    {
+        if (args[i].type != type)
+            return 0;
+    }
 
-    while (liMove(&li))
-        listAdd(par, _evEval(liGet(&li, ParserNode), r), Variable);
+    // the accumulators start with the same value as in the builtins so
+    // that the results are identical
+    if (type == V_INT)
+    {
+        long long acc = action == bifMultiply;
+        _Bool overflow = 0;
+        if (action == bifAdd)
+            overflow = !redSumInt(args, argc, &acc);
+        else if (action == bifMultiply)
+            overflow = !redProductInt(args, argc, &acc);
+        else
+        {
+            acc = args[0].integer;
+            for (size_t i = 1; i < argc; i++)
+                overflow |= __builtin_sub_overflow(acc, args[i].integer, &acc);
+            if (argc == 1)
+                overflow |= __builtin_sub_overflow(0, acc, &acc);
+        }
+        // the result is bigint, the builtin computes it
+        if (overflow)
+            return 0;
+        *res = rtIntVariable(acc);
+        return 1;
+    }
 
-    return rtInvokeFunction(v.function, r, par);
+    // the same reductions as in the builtins group the floats the same way
+    double acc;
+    if (action == bifAdd)
+        acc = redSumFloat(0, args, argc);
+    else if (action == bifMultiply)
+        acc = redProductFloat(1, args, argc);
+    else
+    {
+        acc = args[0].decimal;
+        for (size_t i = 1; i < argc; i++)
+            acc -= args[i].decimal;
+    }
+    *res = rtFloatVariable(action == bifSubtract && argc == 1 ? -acc : acc);
+    return 1;
 }
 
-Variable _evSet(ParserNode n, Runtime* r)
+void _evDeopt(ParserNode* n)
 {
-    return rtException(strLit("NotSupported"), strLit("set is not yet supported"));
+    __atomic_store_n(&n->feedback.specialized, P_FUNCTION_CALL, __ATOMIC_RELAXED);
+    __atomic_store_n(&n->feedback.hits, 0, __ATOMIC_RELAXED);
+    unsigned deopts = __atomic_load_n(&n->feedback.deopts, __ATOMIC_RELAXED);
+    __atomic_store_n(&n->feedback.deopts, deopts + 1, __ATOMIC_RELAXED);
 }
 
-Variable _evEval(ParserNode n, Runtime* r)
+void _evSetStep(_EvMachine* m)
 {
-    switch (n.type)
+    _EvTask* t = listGetP(m->tasks, m->tasks.length - 1);
+    assert(t->node->nodes.length == 1);
+
+    if (t->index == 0)
     {
-    case P_VALUE_INTEGER:
-        return rtIntVariable(n.token->integer);
-    case P_VALUE_FLOAT:
-        return rtFloatVariable(n.token->decimal);
-    case P_VALUE_CHAR:
-        return rtCharVariable(n.token->character);
-    case P_VALUE_STRING:
-        return rtStringVariable(strCopy(n.token->string));
-    case P_VALUE_BOOL:
-        return rtBoolVariable(n.token->boolean);
-    case P_IDENTIFIER:
+        t->index++;
+        _evEval(m, listGetP(t->node->nodes, 0));
+        return;
+    }
+
+    _EvTask set = _evPopTask(m);
+    Variable v = _evPop(m);
+    if (v.type == V_EXCEPTION)
     {
-        Variable v;
-        String s = strCopy(n.token->string);
-        if (!rtGet(r, s, &v))
-            return rtException(strLit("InvalidName"), strLit("The function doesn't exist"));
-        strFree(s);
-        return v;
+        _evPush(m, v);
+        return;
     }
-    case P_FUNCTION_CALL:
-        return _evCall(n, r);
-    case P_VARIABLE_SETTER:
-    case P_FUNCTION_SETTER:
-        return _evSet(n, r);
-    case P_NOTHING:
-        return rtCreateNothingVariable();
-    case P_FUNCTION_DEFINITION:
-        return _evDef(n, r);
-    default:
-        return rtException(strLit("InvalidOperation"), strLit("Cannot evaluate"));
+
+    if (set.node->slot.type != S_LOCAL && m->r->worker)
+    {
+        rtFreeVariable(v);
+        _evPush(m, rtException(strLit("SideEffect"), strLit("Parallel function cannot set global variable")));
+        return;
+    }
+
+    Variable* var;
+    if (set.node->slot.type == S_LOCAL)
+    {
+        var = listGetP(m->r->locals, m->r->frame + set.node->slot.index);
+        // pooled constants cannot be owned by the frame
+        if (v.constant)
+            v = rtCopyVariable(strEmpty(), v);
+        strFree(v.name);
+        v.name = strCopy(set.node->token->string);
+        rtFreeVariable(*var);
+        *var = v;
+    }
+    else
+        var = rtSetGlobal(m->r, set.node, v);
+    _evPush(m, rtCopyVariable(strEmpty(), *var));
+}
+
+Variable _evDef(ParserNode* n, Runtime* r)
+{
+    assert(n->nodes.length > 0);
+
+    // the last node is the body, all others are parameters
+    List parameters = listNew(String);
+    for (size_t i = 0; i + 1 < n->nodes.length; i++)
+    {
+        ParserNode* p = listGetP(n->nodes, i);
+        // argument of the _ parameter is ignored
+        listAdd(parameters, p->type == P_IDENTIFIER ? strCopy(p->token->string) : strEmpty(), String);
+    }
+
+    assert(n->frame);
+    Function f = rtCreateFunction(evRunFunction, parameters);
+    f.body = listGetP(n->nodes, n->nodes.length - 1);
+    f.frame = n->frame;
+    if (n->frame->env)
+        f.env = _evCaptureInFrame(n->frame, r);
+    else
+        f.closure = _evCapture(n->frame, r);
+    return rtFunctionVariable(f);
+}
+
+Variable _evMemo(ParserNode* n, Runtime* r)
+{
+    // the capacity is optional literal before the definition
+    size_t capacity = memo_DEFAULT_CAPACITY;
+    if (n->nodes.length == 2)
+        capacity = (size_t)listGet(n->nodes, 0, ParserNode).token->integer;
+
+    Variable v = _evDef(listGetP(n->nodes, n->nodes.length - 1), r);
+    v.function.memo = memoCreate(&r->gc, capacity);
+    return v;
+}
+
+void _evMemoStep(_EvMachine* m)
+{
+    _EvTask t = _evPopTask(m);
+    m->r->memoDepth--;
+    Variable* res = listGetP(m->values, m->values.length - 1);
+    if (res->type == V_EXCEPTION)
+        memoFreeKey(t.key, t.index);
+    else
+    {
+        memoAdd(t.memo, t.key, t.index, rtCopyVariable(strEmpty(), *res));
+        gcBarrier(&m->r->gc, &t.memo->header);
+    }
+}
+
+Variable evRunFunction(Function* f, Runtime* r, List par)
+{
+    if (par.length != f->parameters.length)
+    {
+        listDeepFree(par, Variable, v, rtFreeVariable(v));
+        return rtException(strLit("InvalidArgumentCount"), strLit("Number of arguments doesn't match the number of parameters"));
     }
+
+    Variable res;
+    if (!f->memo && jitEnter(f, r, (Variable*)par.data, par.length, &res))
+    {
+        listDeepFree(par, Variable, v, rtFreeVariable(v));
+        return res;
+    }
+
+    size_t frame = r->frame;
+    Closure* closure = r->closure;
+    size_t env = r->env;
+    r->frame = r->locals.length;
+    r->closure = f->closure;
+    r->env = f->env;
+    _evBind(f, r, (Variable*)par.data, par.length);
+    listFree(par);
+
+    _EvMachine m = _evCreateMachine(r);
+    m.collect = 0;
+    res = _evRun(&m, f->body);
+    _evFreeMachine(m);
+
+    _evLeave(r, frame, closure, env);
+    return res;
+}
+
+Variable evCall(Function* f, Runtime* r, List par)
+{
+    assert(r->worker);
+
+    if (f->action != evRunFunction)
+        return rtInvokeFunction(f, r, par);
+    if (par.length != f->parameters.length)
+    {
+        listDeepFree(par, Variable, v, rtFreeVariable(v));
+        return rtException(strLit("InvalidArgumentCount"), strLit("Number of arguments doesn't match the number of parameters"));
+    }
+
+    // the memo caches aren't used on the threads of the pool
+    Variable res;
+    if (jitEnter(f, r, (Variable*)par.data, par.length, &res))
+    {
+        listDeepFree(par, Variable, v, rtFreeVariable(v));
+        return res;
+    }
+
+    size_t frame = r->frame;
+    Closure* closure = r->closure;
+    size_t env = r->env;
+    r->frame = r->locals.length;
+    r->closure = f->closure;
+    r->env = f->env;
+    _evBind(f, r, (Variable*)par.data, par.length);
+    listFree(par);
+
+    // the caller keeps its values in the locals so the heap can be collected
+    _EvMachine m = _evCreateMachine(r);
+    res = _evRun(&m, f->body);
+    _evPush(&m, res);
+    if (_evForce(&m, 0))
+        res = _evFinish(&m, 0, 0);
+    else
+        res = _evPop(&m);
+    _evFreeMachine(m);
+
+    _evLeave(r, frame, closure, env);
+    return res;
+}
+
+void _evBind(Function* f, Runtime* r, Variable* args, size_t argc)
+{
+    assert(argc == f->parameters.length);
+    assert(f->frame && f->frame->size >= argc);
+
+    for (size_t i = 0; i < argc; i++)
+    {
+        Variable v = args[i];
+        // pooled constants cannot be owned by the frame
+        if (v.constant)
+            v = rtCopyVariable(strEmpty(), v);
+        listAdd(r->locals, v, Variable);
+    }
+    for (size_t i = argc; i < f->frame->size; i++)
+        listAdd(r->locals, rtCreateNothingVariable(), Variable);
+
+    // local function that refers to itself gets itself in its frame
+    if (f->frame->self)
+    {
+        Variable self = { .type = V_FUNCTION, .function = *f };
+        Variable* slot = listGetP(r->locals, r->frame + f->frame->self - 1);
+        *slot = rtCopyVariable(strEmpty(), self);
+    }
+}
+
+void _evUnbind(Runtime* r)
+{
+    for (size_t i = r->frame; i < r->locals.length; i++)
+        rtFreeVariable(listGet(r->locals, i, Variable));
+    r->locals.length = r->frame;
 }
 
-Variable _evDef(ParserNode n, Runtime* r)
+void _evLeave(Runtime* r, size_t frame, Closure* closure, size_t env)
 {
-    return rtException(strLit("NotSupported"), strLit("def is not supported"));
+    _evUnbind(r);
+    r->frame = frame;
+    r->closure = closure;
+    r->env = env;
 }
\ No newline at end of file
@@ -3,13 +3,68 @@
 
 #include "ParserTree.h"
 #include "List.h"
+#include "Runtime.h"
+
+#ifndef ev_SPECIALIZE_THRESHOLD
+// number of calls with the same argument types after which call node specializes
+#define ev_SPECIALIZE_THRESHOLD 8
+#endif // ev_SPECIALIZE_THRESHOLD
+
+#ifndef ev_MAX_DEOPTS
+// after this many deoptimizations the node stays generic
+#define ev_MAX_DEOPTS 4
+#endif // ev_MAX_DEOPTS
+
+#ifndef ev_SPECIALIZE_MAX_ARGS
+// calls with more arguments are never specialized
+#define ev_SPECIALIZE_MAX_ARGS 8
+#endif // ev_SPECIALIZE_MAX_ARGS
+
+#ifndef ev_MAX_DEPTH
+// maximum number of pending evaluation steps, deeper evaluation raises StackOverflow
+#define ev_MAX_DEPTH 1000000
+#endif // ev_MAX_DEPTH
 
 /**
- * @brief runs the given parser tree
- * 
+ * @brief runs the top level expressions of the tree on the runtime, the
+ * tree must have constant pool and must be resolved,
+ * the evaluation doesn't recurse on the C stack so the nesting depth of
+ * expressions and calls is limited only by ev_MAX_DEPTH,
+ * the tree may be run by many runtimes at the same time, even on different
+ * threads, because each runtime remembers where it found the global
+ * variables and the type feedback of the calls is only updated atomically,
+ * the tree must outlive the runtimes that ran it because their functions
+ * point to it
+ *
  * @param tree tree to run
- * @return List list of errors
+ * @param r the runtime, it may have run other trees before
+ * @return Variable value of the last expression or the first uncaught
+ * exception which stops the evaluation, its heap objects are valid until
+ * the runtime evaluates again
+ */
+Variable evRun(ParserTree* tree, Runtime* r);
+
+/**
+ * @brief action of user defined functions, runs the function when it is
+ * called from builtin
+ *
+ * @param f function to run
+ * @param r runtime context
+ * @param par arguments, this takes their ownership
+ * @return Variable result of the function
+ */
+Variable evRunFunction(Function* f, Runtime* r, List par);
+
+/**
+ * @brief calls function on runtime of thread of the pool, lazy result is
+ * computed, the heap of the runtime may be collected during the call so
+ * the values the caller keeps in that heap must be in its locals
+ *
+ * @param f function to call
+ * @param r runtime of thread of the pool
+ * @param par arguments, this takes their ownership
+ * @return Variable result of the function
  */
-List evEvaluate(ParserTree tree);
+Variable evCall(Function* f, Runtime* r, List par);
 
 #endif // ev_EVALUATOR_INCLUDED
\ No newline at end of file
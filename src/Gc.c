@@ -0,0 +1,498 @@
+#include "Gc.h"
+
+#include <assert.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "Runtime.h"
+#include "Memo.h"
+#include "BigInt.h"
+
+// objects in the nursery are aligned to this
+#define _GC_ALIGN 16
+#define _gcAligned(__size) (((__size) + _GC_ALIGN - 1) & ~(size_t)(_GC_ALIGN - 1))
+
+/**
+ * @brief string value, String.c points to chars
+ *
+ */
+typedef struct _GcString
+{
+    GcObject header;
+    char chars[];
+} _GcString;
+
+/**
+ * @brief checks whether the object is in the nursery
+ *
+ * @param gc the heap
+ * @param o the object
+ * @return true the object is in the nursery
+ * @return false the object is old or belongs to other heap
+ */
+_Bool _gcYoung(Gc* gc, GcObject* o);
+
+/**
+ * @brief checks whether the object may reference other objects
+ *
+ * @param o the object
+ * @return true the object may have childs
+ * @return false the object is string, bigint or array
+ */
+_Bool _gcHasChilds(GcObject* o);
+
+/**
+ * @brief moves nursery object to the old space, the childs are visited later
+ *
+ * @param gc heap being collected
+ * @param o nursery object
+ * @return GcObject* the copy in the old space
+ */
+GcObject* _gcPromote(Gc* gc, GcObject* o);
+
+/**
+ * @brief moves the reachable nursery objects to the old space and frees
+ * the others
+ *
+ * @param gc heap to collect
+ * @param roots visits the roots
+ * @param context passed to roots
+ */
+void _gcMinor(Gc* gc, GcRoots roots, void* context);
+
+/**
+ * @brief frees the unreachable objects of the old space, the nursery must be empty
+ *
+ * @param gc heap to collect
+ * @param roots visits the roots
+ * @param context passed to roots
+ */
+void _gcMajor(Gc* gc, GcRoots roots, void* context);
+
+/**
+ * @brief visits the childs of the gray objects until there are none
+ *
+ * @param gc heap being collected
+ */
+void _gcTrace(Gc* gc);
+
+/**
+ * @brief visits the objects referenced by the object
+ *
+ * @param gc heap being collected
+ * @param o the object
+ */
+void _gcVisitChilds(Gc* gc, GcObject* o);
+
+/**
+ * @brief frees unmarked old objects and unmarks the others
+ *
+ * @param gc heap being collected
+ */
+void _gcSweep(Gc* gc);
+
+/**
+ * @brief frees everything the object owns that isn't heap object
+ *
+ * @param o object to finalize
+ */
+void _gcFinalize(GcObject* o);
+
+/**
+ * @brief finalizes the nursery objects that weren't promoted and empties the nursery
+ *
+ * @param gc the heap
+ */
+void _gcClearNursery(Gc* gc);
+
+Gc gcCreate(unsigned char id)
+{
+    assert(id);
+
+    Gc gc =
+    {
+        .id = id,
+        .objects = NULL,
+        .bytes = 0,
+        .allocated = 0,
+        .budget = gc_INITIAL_BUDGET,
+        .nursery = malloc(gc_NURSERY_SIZE),
+        .nurseryUsed = 0,
+        .remembered = listNew(GcObject*),
+        .gray = listNew(GcObject*),
+        .due = 0,
+        .minor = 0,
+        .minorCollections = 0,
+        .collections = 0,
+        .promoted = 0,
+        .freed = 0,
+        .peak = 0,
+        .minorPause = 0,
+        .pause = 0,
+        .maxPause = 0,
+    };
+    assert(gc.nursery);
+    return gc;
+}
+
+void gcFree(Gc* gc)
+{
+    gcClear(gc);
+    free(gc->nursery);
+    listFree(gc->remembered);
+    listFree(gc->gray);
+}
+
+void gcClear(Gc* gc)
+{
+    _gcClearNursery(gc);
+    while (gc->objects)
+    {
+        GcObject* o = gc->objects;
+        gc->objects = o->next;
+        _gcFinalize(o);
+        free(o);
+    }
+    gc->bytes = 0;
+    gc->allocated = 0;
+    gc->remembered.length = 0;
+    gc->due = 0;
+}
+
+_Bool gcOwns(Gc* gc, GcObject* o)
+{
+    return o && o->heap == gc->id;
+}
+
+void* gcAlloc(Gc* gc, GcKind kind, size_t size)
+{
+    assert(size >= sizeof(GcObject));
+
+    GcObject* o;
+    size_t aligned = _gcAligned(size);
+    if (gc && size <= gc_LARGE_OBJECT && gc->nurseryUsed + aligned <= gc_NURSERY_SIZE)
+    {
+        o = (GcObject*)(gc->nursery + gc->nurseryUsed);
+        gc->nurseryUsed += aligned;
+        o->next = NULL;
+    }
+    else
+    {
+        o = malloc(size);
+        assert(o);
+        o->next = NULL;
+        if (gc)
+        {
+            o->next = gc->objects;
+            gc->objects = o;
+            gc->bytes += size;
+            gc->allocated += size;
+            if (gc->bytes > gc->peak)
+                gc->peak = gc->bytes;
+        }
+    }
+
+    o->size = size;
+    o->kind = kind;
+    o->marked = 0;
+    o->heap = gc ? gc->id : 0;
+    o->forwarded = 0;
+    o->remembered = 0;
+    if (!gc)
+        return o;
+    if (gc->nurseryUsed > gc_NURSERY_SIZE / 4 * 3 || gc->allocated > gc->budget)
+        gc->due = 1;
+    // old object may get references to the nursery before it is initialized
+    if (!_gcYoung(gc, o))
+        gcBarrier(gc, o);
+    return o;
+}
+
+GcObject* gcCopy(Gc* gc, GcObject* o)
+{
+    assert(!_gcHasChilds(o));
+
+    GcObject* copy = gcAlloc(gc, o->kind, o->size);
+    memcpy(copy + 1, o + 1, o->size - sizeof(GcObject));
+    return copy;
+}
+
+void gcFreeObject(GcObject* o)
+{
+    assert(!o->heap);
+    _gcFinalize(o);
+    free(o);
+}
+
+String gcString(Gc* gc, String str)
+{
+    _GcString* s = gcAlloc(gc, GC_STRING, sizeof(_GcString) + str.length + 1);
+    if (str.length)
+        memcpy(s->chars, str.c, str.length);
+    s->chars[str.length] = '\0';
+
+    String res =
+    {
+        .c = s->chars,
+        .length = str.length,
+    };
+    return res;
+}
+
+void gcFreeString(String str)
+{
+    if (str.c)
+        gcFreeObject((GcObject*)(str.c - offsetof(_GcString, chars)));
+}
+
+void gcBarrier(Gc* gc, GcObject* o)
+{
+    if (o->remembered || !_gcHasChilds(o) || _gcYoung(gc, o))
+        return;
+    o->remembered = 1;
+    listAdd(gc->remembered, o, GcObject*);
+}
+
+void gcCollect(Gc* gc, GcRoots roots, void* context)
+{
+    clock_t start = clock();
+    _gcMinor(gc, roots, context);
+    double minor = (double)(clock() - start) / CLOCKS_PER_SEC;
+    gc->minorPause += minor;
+    if (minor > gc->maxPause)
+        gc->maxPause = minor;
+
+    if (gc->allocated <= gc->budget)
+        return;
+
+    start = clock();
+    _gcMajor(gc, roots, context);
+    double pause = (double)(clock() - start) / CLOCKS_PER_SEC;
+    gc->pause += pause;
+    if (pause + minor > gc->maxPause)
+        gc->maxPause = pause + minor;
+}
+
+void gcVisitVariable(Gc* gc, Variable* v)
+{
+    switch (v->type)
+    {
+    case V_STRING:
+        if (v->str.c)
+        {
+            GcObject* o = gcVisitObject(gc, (GcObject*)(v->str.c - offsetof(_GcString, chars)));
+            v->str.c = ((_GcString*)o)->chars;
+        }
+        return;
+    case V_FUNCTION:
+        v->function.closure = (Closure*)gcVisitObject(gc, (GcObject*)v->function.closure);
+        v->function.memo = (Memo*)gcVisitObject(gc, (GcObject*)v->function.memo);
+        return;
+    case V_THUNK:
+        v->thunk = (Thunk*)gcVisitObject(gc, (GcObject*)v->thunk);
+        return;
+    case V_BIGINT:
+        v->big = (BigInt*)gcVisitObject(gc, (GcObject*)v->big);
+        return;
+    case V_ARRAY:
+        v->array.items = (Array*)gcVisitObject(gc, (GcObject*)v->array.items);
+        return;
+    default:
+        return;
+    }
+}
+
+GcObject* gcVisitObject(Gc* gc, GcObject* o)
+{
+    // objects of other heaps are kept alive by their own heaps
+    if (!o || o->heap != gc->id)
+        return o;
+
+    // minor collection doesn't look into the old space
+    if (gc->minor)
+        return _gcYoung(gc, o) ? _gcPromote(gc, o) : o;
+
+    if (o->marked)
+        return o;
+    o->marked = 1;
+    if (_gcHasChilds(o))
+        listAdd(gc->gray, o, GcObject*);
+    return o;
+}
+
+void gcPrintStats(FILE* out, Gc* gc)
+{
+    fprintf(out, "gc minor collections: %zu, %.3f ms\n", gc->minorCollections, gc->minorPause * 1000);
+    fprintf(out, "gc full collections: %zu, %.3f ms\n", gc->collections, gc->pause * 1000);
+    fprintf(out, "gc max pause: %.3f ms\n", gc->maxPause * 1000);
+    fprintf(out, "gc promoted: %zu B\n", gc->promoted);
+    fprintf(out, "gc freed old objects: %zu\n", gc->freed);
+    fprintf(out, "heap size: %zu B, peak %zu B, nursery %zu B\n", gc->bytes, gc->peak, gc->nurseryUsed);
+}
+
+_Bool _gcYoung(Gc* gc, GcObject* o)
+{
+    return (char*)o >= gc->nursery && (char*)o < gc->nursery + gc_NURSERY_SIZE;
+}
+
+_Bool _gcHasChilds(GcObject* o)
+{
+    return o->kind != GC_STRING && o->kind != GC_BIGINT && o->kind != GC_ARRAY;
+}
+
+GcObject* _gcPromote(Gc* gc, GcObject* o)
+{
+    if (o->forwarded)
+        return o->next;
+
+    GcObject* copy = malloc(o->size);
+    assert(copy);
+    memcpy(copy, o, o->size);
+    copy->next = gc->objects;
+    gc->objects = copy;
+    gc->bytes += o->size;
+    gc->allocated += o->size;
+    gc->promoted += o->size;
+    if (gc->bytes > gc->peak)
+        gc->peak = gc->bytes;
+
+    o->forwarded = 1;
+    o->next = copy;
+    if (_gcHasChilds(copy))
+        listAdd(gc->gray, copy, GcObject*);
+    return copy;
+}
+
+void _gcMinor(Gc* gc, GcRoots roots, void* context)
+{
+    gc->minor = 1;
+    roots(gc, context);
+    // the old objects that were changed may be the only ones that
+    // reference some nursery objects
+    for (size_t i = 0; i < gc->remembered.length; i++)
+    {
+        GcObject* o = listGet(gc->remembered, i, GcObject*);
+        o->remembered = 0;
+        _gcVisitChilds(gc, o);
+    }
+    gc->remembered.length = 0;
+    _gcTrace(gc);
+    gc->minor = 0;
+
+    _gcClearNursery(gc);
+    gc->minorCollections++;
+    gc->due = gc->allocated > gc->budget;
+}
+
+void _gcMajor(Gc* gc, GcRoots roots, void* context)
+{
+    assert(gc->nurseryUsed == 0);
+
+    roots(gc, context);
+    _gcTrace(gc);
+    _gcSweep(gc);
+
+    // the old space may grow to twice the size of the live objects
+    gc->allocated = 0;
+    gc->budget = gc->bytes > gc_INITIAL_BUDGET ? gc->bytes : gc_INITIAL_BUDGET;
+    gc->due = 0;
+    gc->collections++;
+}
+
+void _gcTrace(Gc* gc)
+{
+    while (gc->gray.length)
+        _gcVisitChilds(gc, listGet(gc->gray, --gc->gray.length, GcObject*));
+}
+
+void _gcVisitChilds(Gc* gc, GcObject* o)
+{
+    switch (o->kind)
+    {
+    case GC_CLOSURE:
+    {
+        Closure* c = (Closure*)o;
+        for (size_t i = 0; i < c->length; i++)
+            gcVisitVariable(gc, c->variables + i);
+        return;
+    }
+    case GC_THUNK:
+    {
+        Thunk* t = (Thunk*)o;
+        t->closure = (Closure*)gcVisitObject(gc, (GcObject*)t->closure);
+        if (t->forced)
+            gcVisitVariable(gc, &t->value);
+        return;
+    }
+    case GC_MEMO:
+    {
+        Memo* m = (Memo*)o;
+        for (size_t i = 0; i < m->length; i++)
+        {
+            for (size_t j = 0; j < m->entries[i].argc; j++)
+                gcVisitVariable(gc, m->entries[i].key + j);
+            gcVisitVariable(gc, &m->entries[i].value);
+        }
+        return;
+    }
+    default:
+        return;
+    }
+}
+
+void _gcSweep(Gc* gc)
+{
+    GcObject** link = &gc->objects;
+    while (*link)
+    {
+        GcObject* o = *link;
+        if (o->marked)
+        {
+            o->marked = 0;
+            link = &o->next;
+            continue;
+        }
+        *link = o->next;
+        gc->bytes -= o->size;
+        gc->freed++;
+        _gcFinalize(o);
+        free(o);
+    }
+}
+
+void _gcFinalize(GcObject* o)
+{
+    switch (o->kind)
+    {
+    case GC_CLOSURE:
+    {
+        Closure* c = (Closure*)o;
+        for (size_t i = 0; i < c->length; i++)
+            rtFreeVariable(c->variables[i]);
+        return;
+    }
+    case GC_THUNK:
+        if (((Thunk*)o)->forced)
+            rtFreeVariable(((Thunk*)o)->value);
+        return;
+    case GC_MEMO:
+        memoFreeEntries((Memo*)o);
+        return;
+    default:
+        return;
+    }
+}
+
+void _gcClearNursery(Gc* gc)
+{
+    // promoted objects belong to their copies now
+    for (size_t pos = 0; pos < gc->nurseryUsed;)
+    {
+        GcObject* o = (GcObject*)(gc->nursery + pos);
+        pos += _gcAligned(o->size);
+        if (!o->forwarded)
+            _gcFinalize(o);
+    }
+    gc->nurseryUsed = 0;
+}
@@ -0,0 +1,239 @@
+#ifndef gc_GC_INCLUDED
+#define gc_GC_INCLUDED
+
+#include <stddef.h>
+#include <stdio.h>
+
+#include "List.h"
+#include "String.h"
+
+#ifndef gc_INITIAL_BUDGET
+// number of bytes promoted to the old space before the first full collection,
+// later the budget is the size of the old space that survived the last full
+// collection if it is larger
+#define gc_INITIAL_BUDGET (1024 * 1024)
+#endif // gc_INITIAL_BUDGET
+
+#ifndef gc_NURSERY_SIZE
+// size of the space where new objects are allocated
+#define gc_NURSERY_SIZE (256 * 1024)
+#endif // gc_NURSERY_SIZE
+
+#ifndef gc_LARGE_OBJECT
+// objects larger than this are allocated directly in the old space
+#define gc_LARGE_OBJECT (gc_NURSERY_SIZE / 16)
+#endif // gc_LARGE_OBJECT
+
+// checks whether collection is due, this is checked between every two
+// evaluation steps so it is a macro
+#define gcShouldCollect(__gc) ((__gc)->due)
+
+typedef struct Variable Variable;
+
+typedef enum GcKind
+{
+    GC_STRING,
+    GC_CLOSURE,
+    GC_THUNK,
+    GC_MEMO,
+    GC_BIGINT,
+    GC_ARRAY,
+} GcKind;
+
+/**
+ * @brief header of every heap allocated runtime value, must be the first
+ * member of the object
+ *
+ */
+typedef struct GcObject
+{
+    // next object of the old space, the copy of the object if it was
+    // promoted from the nursery
+    struct GcObject* next;
+    // size of the object including the header
+    size_t size;
+    GcKind kind;
+    _Bool marked;
+    // id of the heap that owns the object, 0 for objects that aren't owned
+    // by any heap, like string constants
+    unsigned char heap;
+    // true for nursery object that was promoted
+    _Bool forwarded;
+    // true for old object that may reference nursery objects
+    _Bool remembered;
+} GcObject;
+
+/**
+ * @brief heap of the runtime values, new objects are bump allocated in the
+ * nursery, minor collection moves the reachable ones to the old space and
+ * full collection frees the unreachable old objects by mark and sweep
+ *
+ */
+typedef struct Gc
+{
+    // id of the heap, objects of other heaps are never visited nor freed by it
+    unsigned char id;
+    // objects of the old space
+    GcObject* objects;
+    // size of the old space
+    size_t bytes;
+    // bytes added to the old space since the last full collection
+    size_t allocated;
+    // full collection is due when allocated exceeds this
+    size_t budget;
+    // space for new objects, they are allocated one after another
+    char* nursery;
+    size_t nurseryUsed;
+    // old objects that may reference nursery objects, List of GcObject*
+    List remembered;
+    // objects whose childs weren't visited yet, List of GcObject*
+    List gray;
+    // set by allocation when the nursery is three quarters full, so that
+    // the steps until the next check fit in the rest, or when the budget
+    // is exhausted
+    _Bool due;
+    // true while the nursery is collected
+    _Bool minor;
+    size_t minorCollections;
+    size_t collections;
+    // bytes moved from the nursery to the old space
+    size_t promoted;
+    // number of objects freed by collections
+    size_t freed;
+    // largest size of the old space
+    size_t peak;
+    // time spent in collections in seconds
+    double minorPause;
+    double pause;
+    double maxPause;
+} Gc;
+
+/**
+ * @brief visits the roots of collection with gcVisitVariable and gcVisitObject
+ *
+ */
+typedef void (*GcRoots)(Gc* gc, void* context);
+
+/**
+ * @brief creates empty heap
+ *
+ * @param id id of the heap, heaps whose objects may reference each other
+ * must have different ids
+ * @return Gc new instance
+ */
+Gc gcCreate(unsigned char id);
+
+/**
+ * @brief frees the heap with all of its objects
+ *
+ * @param gc heap to free
+ */
+void gcFree(Gc* gc);
+
+/**
+ * @brief frees all objects of the heap, it stays usable
+ *
+ * @param gc heap to clear
+ */
+void gcClear(Gc* gc);
+
+/**
+ * @brief checks whether the heap owns the object
+ *
+ * @param gc the heap
+ * @param o the object, may be NULL
+ * @return true the object belongs to the heap
+ * @return false the object is NULL or belongs to other heap or to no heap
+ */
+_Bool gcOwns(Gc* gc, GcObject* o);
+
+/**
+ * @brief allocates object, its header is initialized and the rest is not
+ *
+ * @param gc heap that owns the object, NULL if the object is freed with gcFreeObject
+ * @param kind kind of the object
+ * @param size size of the object including the header
+ * @return void* the object
+ */
+void* gcAlloc(Gc* gc, GcKind kind, size_t size);
+
+/**
+ * @brief copies string, bigint or array to the heap
+ *
+ * @param gc heap that owns the copy
+ * @param o object without childs
+ * @return GcObject* the copy
+ */
+GcObject* gcCopy(Gc* gc, GcObject* o);
+
+/**
+ * @brief frees object that isn't owned by any heap
+ *
+ * @param o the object
+ */
+void gcFreeObject(GcObject* o);
+
+/**
+ * @brief allocates string value, the characters are followed by '\0'
+ *
+ * @param gc heap that owns the string, NULL if it is freed with gcFreeString
+ * @param str characters to copy
+ * @return String the string
+ */
+String gcString(Gc* gc, String str);
+
+/**
+ * @brief frees string value that isn't owned by any heap
+ *
+ * @param str string created by gcString
+ */
+void gcFreeString(String str);
+
+/**
+ * @brief must be called after reference to other object is stored in
+ * existing object, so that minor collection finds the references from
+ * old objects to the nursery
+ *
+ * @param gc heap of the object
+ * @param o the changed object
+ */
+void gcBarrier(Gc* gc, GcObject* o);
+
+/**
+ * @brief collects the nursery and if the budget is exhausted also the
+ * old space, objects may move so the roots must be visited trough
+ * pointers that are updated
+ *
+ * @param gc heap to collect
+ * @param roots visits the roots
+ * @param context passed to roots
+ */
+void gcCollect(Gc* gc, GcRoots roots, void* context);
+
+/**
+ * @brief visits objects referenced by the variable and updates the
+ * references to objects that moved
+ *
+ * @param gc heap being collected
+ * @param v the variable
+ */
+void gcVisitVariable(Gc* gc, Variable* v);
+
+/**
+ * @brief visits object and later the objects it references
+ *
+ * @param gc heap being collected
+ * @param o object to visit, may be NULL
+ * @return GcObject* the object at its new place
+ */
+GcObject* gcVisitObject(Gc* gc, GcObject* o);
+
+/**
+ * @brief prints statistics of the heap
+ *
+ * @param out where to print
+ * @param gc the heap
+ */
+void gcPrintStats(FILE* out, Gc* gc);
+
+#endif // gc_GC_INCLUDED
@@ -0,0 +1,2093 @@
+#include "Image.h"
+
+#include <assert.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif // _WIN32
+
+#include "Array.h"
+#include "BigInt.h"
+#include "ConstantPool.h"
+#include "Evaluator.h"
+#include "Gc.h"
+#include "Jit.h"
+#include "Memo.h"
+#include "Resolver.h"
+
+// first bytes of every image
+#define _IMG_MAGIC "SLIM"
+// version of the format, images of other versions are rejected
+#define _IMG_VERSION 5
+// FNV-1a parameters of the checksum
+#define _IMG_HASH_START 14695981039346656037ULL
+#define _IMG_HASH_PRIME 1099511628211ULL
+// flags of saved node
+#define _IMG_TOKEN 1
+#define _IMG_FRAME 2
+
+/**
+ * @brief growable buffer the image is written to before it is saved
+ *
+ */
+typedef struct _ImgWriter
+{
+    unsigned char* data;
+    size_t length;
+    size_t capacity;
+} _ImgWriter;
+
+/**
+ * @brief position in the mapped image, reading past its end or invalid
+ * value sets failed and all following reads return zeros
+ *
+ */
+typedef struct _ImgReader
+{
+    const unsigned char* pos;
+    const unsigned char* end;
+    _Bool failed;
+} _ImgReader;
+
+/**
+ * @brief hash table from addresses to their indices in the image
+ *
+ */
+typedef struct _ImgMap
+{
+    // NULL for empty entry
+    const void** keys;
+    size_t* values;
+    // power of two or 0 if nothing was added yet
+    size_t capacity;
+    size_t count;
+} _ImgMap;
+
+/**
+ * @brief heap object of the image
+ *
+ */
+typedef struct _ImgObject
+{
+    GcKind kind;
+    // the object, characters for GC_STRING
+    void* address;
+    // GC_STRING: number of characters
+    size_t length;
+} _ImgObject;
+
+/**
+ * @brief state of saving image
+ *
+ */
+typedef struct _ImgSaver
+{
+    _ImgWriter out;
+    // nodes of the program mapped to their indices
+    _ImgMap nodes;
+    // frame layouts mapped to the indices of the nodes that own them
+    _ImgMap frames;
+    // heap objects reachable from the globals mapped to their indices,
+    // strings by their characters
+    _ImgMap objects;
+    // the objects in the order of their indices, List of _ImgObject
+    List order;
+    List builtins;
+    Stream* messages;
+    _Bool failed;
+} _ImgSaver;
+
+/**
+ * @brief state of loading image
+ *
+ */
+typedef struct _ImgLoader
+{
+    _ImgReader in;
+    Runtime* r;
+    List builtins;
+    Stream* messages;
+    // nodes of the program in the order of their indices, List of ParserNode*
+    List nodes;
+    // the heap objects in the order of their indices
+    _ImgObject* objects;
+    size_t objectCount;
+    // set when the reason of failure was already printed
+    _Bool reported;
+} _ImgLoader;
+
+/**
+ * @brief image file mapped to memory
+ *
+ */
+typedef struct _ImgFile
+{
+    const unsigned char* data;
+    size_t size;
+#ifdef _WIN32
+    HANDLE file;
+    HANDLE mapping;
+#endif // _WIN32
+} _ImgFile;
+
+/**
+ * @brief node whose childs are being loaded
+ *
+ */
+typedef struct _ImgPending
+{
+    ParserNode* node;
+    // number of childs that weren't loaded yet
+    size_t remaining;
+} _ImgPending;
+
+/**
+ * @brief saves image of program and of the globals of runtime
+ *
+ * @param filename where to save the image
+ * @param p the program
+ * @param r runtime that ran the program, NULL to save only the program
+ * without the modules it imports
+ * @param builtins the builtins the runtime was created from
+ * @param key identifies what the image was created from
+ * @param data bytes stored with the image
+ * @param messages where to print why the image couldn't be saved, may be NULL
+ * @return true the image was saved
+ * @return false the image cannot be saved
+ */
+_Bool _imgSaveFile(const char* filename, Program* p, Runtime* r, List builtins, String key, String data, Stream* messages);
+
+/**
+ * @brief loads image saved by _imgSaveFile
+ *
+ * @param filename the image
+ * @param key the key the image must have
+ * @param data set to copy of the bytes stored with the image, may be NULL
+ * @param builtins the builtins the runtime was created from
+ * @param r where to set the globals, NULL if the image must have none
+ * @param messages where to print why the image couldn't be loaded, may be NULL
+ * @return Program* the program or NULL if the image isn't valid
+ */
+Program* _imgLoadFile(const char* filename, String key, String* data, List builtins, Runtime* r, Stream* messages);
+
+/**
+ * @brief writes the whole file, it is written under temporary name and
+ * then renamed so that the processes that read it at the same time never
+ * see incomplete file
+ *
+ * @param filename the file
+ * @param data what to write
+ * @param length number of bytes to write
+ * @return true the file was written
+ * @return false the file cannot be written
+ */
+_Bool _imgWriteFile(const char* filename, const void* data, size_t length);
+
+/**
+ * @brief appends bytes to the image
+ *
+ * @param w where to write
+ * @param data the bytes
+ * @param length number of the bytes
+ */
+void _imgWriteBytes(_ImgWriter* w, const void* data, size_t length);
+
+/**
+ * @brief appends unsigned number, 7 bits in each byte so that small
+ * numbers take single byte
+ *
+ * @param w where to write
+ * @param value the number
+ */
+void _imgWriteSize(_ImgWriter* w, uint64_t value);
+
+/**
+ * @brief appends signed number, small negative numbers take single byte too
+ *
+ * @param w where to write
+ * @param value the number
+ */
+void _imgWriteInt(_ImgWriter* w, long long value);
+
+/**
+ * @brief appends bits of float
+ *
+ * @param w where to write
+ * @param value the number
+ */
+void _imgWriteFloat(_ImgWriter* w, double value);
+
+/**
+ * @brief appends length of string followed by its characters
+ *
+ * @param w where to write
+ * @param str the string
+ */
+void _imgWriteString(_ImgWriter* w, String str);
+
+/**
+ * @brief takes bytes from the image
+ *
+ * @param in where to read
+ * @param length number of the bytes
+ * @return const unsigned char* the bytes or NULL if there aren't enough of them
+ */
+const unsigned char* _imgReadBytes(_ImgReader* in, size_t length);
+
+/**
+ * @brief reads number written by _imgWriteSize
+ *
+ * @param in where to read
+ * @return uint64_t the number
+ */
+uint64_t _imgReadSize(_ImgReader* in);
+
+/**
+ * @brief reads number that counts items of at least one byte that follow
+ * it, so that invalid image cannot make the loader allocate more than the
+ * size of the image
+ *
+ * @param in where to read
+ * @return size_t the number
+ */
+size_t _imgReadCount(_ImgReader* in);
+
+/**
+ * @brief reads number written by _imgWriteInt
+ *
+ * @param in where to read
+ * @return long long the number
+ */
+long long _imgReadInt(_ImgReader* in);
+
+/**
+ * @brief reads float written by _imgWriteFloat
+ *
+ * @param in where to read
+ * @return double the number
+ */
+double _imgReadFloat(_ImgReader* in);
+
+/**
+ * @brief reads single byte
+ *
+ * @param in where to read
+ * @return unsigned char the byte
+ */
+unsigned char _imgReadByte(_ImgReader* in);
+
+/**
+ * @brief reads string written by _imgWriteString
+ *
+ * @param in where to read
+ * @return String the characters in the image, they aren't terminated by '\0'
+ */
+String _imgReadString(_ImgReader* in);
+
+/**
+ * @brief copies string read by _imgReadString
+ *
+ * @param str the string
+ * @return String new instance, empty string if it has no characters
+ */
+String _imgCopyString(String str);
+
+/**
+ * @brief finds entry of address in the table
+ *
+ * @param m the table, must have some empty entries
+ * @param key the address
+ * @return size_t index of the entry with the address or of empty entry
+ */
+size_t _imgMapSlot(_ImgMap* m, const void* key);
+
+/**
+ * @brief adds address to the table
+ *
+ * @param m the table
+ * @param key the address, must not be in the table
+ * @param value its index
+ */
+void _imgMapAdd(_ImgMap* m, const void* key, size_t value);
+
+/**
+ * @brief finds index of address
+ *
+ * @param m the table
+ * @param key the address
+ * @param value set to the index if the address was found
+ * @return true the address is in the table
+ * @return false the address isn't in the table
+ */
+_Bool _imgMapFind(_ImgMap* m, const void* key, size_t* value);
+
+/**
+ * @brief frees the table
+ *
+ * @param m the table
+ */
+void _imgMapFree(_ImgMap* m);
+
+/**
+ * @brief prints why the image cannot be saved and marks it as failed
+ *
+ * @param s the saver
+ * @param v variable that cannot be saved
+ * @param reason why it cannot be saved, follows "it"
+ */
+void _imgSaveError(_ImgSaver* s, Variable* v, const char* reason);
+
+/**
+ * @brief adds the programs of the modules imported by the programs of the
+ * list and by the modules they import, each of them once
+ *
+ * @param programs the programs, List of Program*
+ */
+void _imgAddImports(List* programs);
+
+/**
+ * @brief writes the tree in preorder and gives the nodes their indices
+ *
+ * @param s the saver
+ * @param tree the tree
+ */
+void _imgWriteTree(_ImgSaver* s, ParserTree* tree);
+
+/**
+ * @brief writes node without its childs
+ *
+ * @param w where to write
+ * @param n the node
+ */
+void _imgWriteNode(_ImgWriter* w, ParserNode* n);
+
+/**
+ * @brief checks whether the nodes of the type have resolved variable
+ *
+ * @param type type of the node
+ * @return _Bool true for identifiers and setters
+ */
+_Bool _imgNamed(ParserNodeType type);
+
+/**
+ * @brief writes token with its value
+ *
+ * @param w where to write
+ * @param t the token
+ */
+void _imgWriteToken(_ImgWriter* w, Token* t);
+
+/**
+ * @brief adds heap object to the image if it isn't there yet
+ *
+ * @param s the saver
+ * @param kind kind of the object
+ * @param address the object, characters of string, may be NULL
+ * @param length number of characters of string
+ */
+void _imgAddObject(_ImgSaver* s, GcKind kind, void* address, size_t length);
+
+/**
+ * @brief adds heap objects referenced by variable to the image
+ *
+ * @param s the saver
+ * @param v the variable
+ */
+void _imgCollect(_ImgSaver* s, Variable* v);
+
+/**
+ * @brief writes the objects of the image, first all of them without their
+ * references so that the loader can create them and then the references
+ *
+ * @param s the saver
+ */
+void _imgWriteObjects(_ImgSaver* s);
+
+/**
+ * @brief writes index of object plus one or 0 for NULL
+ *
+ * @param s the saver
+ * @param address the object
+ */
+void _imgWriteObjectRef(_ImgSaver* s, void* address);
+
+/**
+ * @brief writes index of node of the program
+ *
+ * @param s the saver
+ * @param v variable that references the node
+ * @param n the node
+ */
+void _imgWriteNodeRef(_ImgSaver* s, Variable* v, ParserNode* n);
+
+/**
+ * @brief writes index of node that owns frame layout
+ *
+ * @param s the saver
+ * @param v variable that references the layout
+ * @param frame the layout
+ */
+void _imgWriteFrameRef(_ImgSaver* s, Variable* v, FrameLayout* frame);
+
+/**
+ * @brief writes variable with its name
+ *
+ * @param s the saver
+ * @param v the variable
+ */
+void _imgWriteVariable(_ImgSaver* s, Variable* v);
+
+/**
+ * @brief writes function, builtins are written as their names
+ *
+ * @param s the saver
+ * @param v variable with the function
+ */
+void _imgWriteFunction(_ImgSaver* s, Variable* v);
+
+/**
+ * @brief checks the magic, version and key of the image
+ *
+ * @param l the loader
+ * @param key the expected key
+ * @param data set to the bytes stored with the image
+ * @return true the header is valid
+ * @return false other file, other version or other key
+ */
+_Bool _imgReadHeader(_ImgLoader* l, String key, String* data);
+
+/**
+ * @brief loads the program and its constant pool
+ *
+ * @param l the loader
+ * @param p where to load, its tree must be empty
+ * @return true the program was loaded
+ * @return false the image is invalid
+ */
+_Bool _imgReadProgram(_ImgLoader* l, Program* p);
+
+/**
+ * @brief reads node without its childs
+ *
+ * @param l the loader
+ * @param n set to the node
+ * @param filename name of the program, the tokens point to it
+ * @param childs set to the number of the childs
+ * @return true the node was read
+ * @return false the image is invalid
+ */
+_Bool _imgReadNode(_ImgLoader* l, ParserNode* n, String* filename, size_t* childs);
+
+/**
+ * @brief reads token with its value
+ *
+ * @param in where to read
+ * @param t set to the token
+ * @param filename name of the program, the token points to it
+ * @return true the token was read
+ * @return false the image is invalid
+ */
+_Bool _imgReadToken(_ImgReader* in, Token* t, String* filename);
+
+/**
+ * @brief creates the objects of the image in the heap of the runtime
+ *
+ * @param l the loader
+ * @return true the objects were loaded
+ * @return false the image is invalid
+ */
+_Bool _imgReadObjects(_ImgLoader* l);
+
+/**
+ * @brief creates object without its references
+ *
+ * @param l the loader
+ * @param o set to the object
+ * @return true the object was created
+ * @return false the image is invalid
+ */
+_Bool _imgReadShape(_ImgLoader* l, _ImgObject* o);
+
+/**
+ * @brief reads the references of object created by _imgReadShape
+ *
+ * @param l the loader
+ * @param o the object
+ * @return true the references were read
+ * @return false the image is invalid
+ */
+_Bool _imgReadContent(_ImgLoader* l, _ImgObject* o);
+
+/**
+ * @brief reads the global variables and sets them in the runtime, nothing
+ * is set if any of them is invalid
+ *
+ * @param l the loader
+ * @return true the globals were loaded
+ * @return false the image is invalid
+ */
+_Bool _imgReadGlobals(_ImgLoader* l);
+
+/**
+ * @brief reads object written by _imgWriteObjectRef
+ *
+ * @param l the loader
+ * @param kind the expected kind of the object
+ * @return _ImgObject* the object or NULL
+ */
+_ImgObject* _imgReadObjectRef(_ImgLoader* l, GcKind kind);
+
+/**
+ * @brief reads node written by _imgWriteNodeRef
+ *
+ * @param l the loader
+ * @return ParserNode* the node or NULL if the image is invalid
+ */
+ParserNode* _imgReadNodeRef(_ImgLoader* l);
+
+/**
+ * @brief reads frame layout written by _imgWriteFrameRef
+ *
+ * @param l the loader
+ * @return FrameLayout* the layout or NULL if the image is invalid
+ */
+FrameLayout* _imgReadFrameRef(_ImgLoader* l);
+
+/**
+ * @brief reads variable written by _imgWriteVariable
+ *
+ * @param l the loader
+ * @param v set to the variable, nothing if the image is invalid
+ * @return true the variable was read
+ * @return false the image is invalid
+ */
+_Bool _imgReadVariable(_ImgLoader* l, Variable* v);
+
+/**
+ * @brief reads function written by _imgWriteFunction
+ *
+ * @param l the loader
+ * @param v set to variable with the function
+ * @return true the function was read
+ * @return false the image is invalid
+ */
+_Bool _imgReadFunction(_ImgLoader* l, Variable* v);
+
+/**
+ * @brief maps the whole file to memory for reading
+ *
+ * @param filename the file
+ * @param file set to the mapping
+ * @return true the file was mapped
+ * @return false the file cannot be opened or it is empty
+ */
+_Bool _imgMapFile(const char* filename, _ImgFile* file);
+
+/**
+ * @brief unmaps file mapped by _imgMapFile
+ *
+ * @param file the mapping
+ */
+void _imgUnmapFile(_ImgFile* file);
+
+_Bool imgSave(const char* filename, Program* p, Runtime* r, List builtins, Stream* messages)
+{
+    assert(!r->worker);
+    return _imgSaveFile(filename, p, r, builtins, strEmpty(), strEmpty(), messages);
+}
+
+Program* imgLoad(const char* filename, List builtins, Runtime* r, Stream* messages)
+{
+    assert(!r->worker);
+
+    // the image of runtime has no key
+    return _imgLoadFile(filename, strEmpty(), NULL, builtins, r, messages);
+}
+
+void imgFree(Program* p)
+{
+    listForEach(p->imports, Program*, module, progFree(module));
+    progFree(p);
+}
+
+_Bool imgSaveProgram(const char* filename, Program* p, String key, String data)
+{
+    List none = listNew(Variable);
+    _Bool saved = _imgSaveFile(filename, p, NULL, none, key, data, NULL);
+    listFree(none);
+    return saved;
+}
+
+Program* imgLoadProgram(const char* filename, String key, String* data)
+{
+    List none = listNew(Variable);
+    Program* p = _imgLoadFile(filename, key, data, none, NULL, NULL);
+    listFree(none);
+    return p;
+}
+
+uint64_t imgChecksum(const void* data, size_t length)
+{
+    const unsigned char* bytes = data;
+    uint64_t hash = _IMG_HASH_START;
+    for (size_t i = 0; i < length; i++)
+        hash = (hash ^ bytes[i]) * _IMG_HASH_PRIME;
+    return hash;
+}
+
+_Bool _imgSaveFile(const char* filename, Program* p, Runtime* r, List builtins, String key, String data, Stream* messages)
+{
+    _ImgSaver s =
+    {
+        .out = { .data = NULL, .length = 0, .capacity = 0 },
+        .nodes = { 0 },
+        .frames = { 0 },
+        .objects = { 0 },
+        .order = listNew(_ImgObject),
+        .builtins = builtins,
+        .messages = messages,
+        .failed = 0,
+    };
+
+    _imgWriteBytes(&s.out, _IMG_MAGIC, 4);
+    _imgWriteSize(&s.out, _IMG_VERSION);
+    _imgWriteString(&s.out, key);
+    _imgWriteString(&s.out, data);
+
+    // the functions in the globals may come from the imported modules, the
+    // cache of program holds only the program because every module has its
+    // own cache
+    List programs = listNew(Program*);
+    listAdd(programs, p, Program*);
+    if (r)
+        _imgAddImports(&programs);
+    _imgWriteSize(&s.out, programs.length);
+    listForEach(programs, Program*, q,
+        _imgWriteString(&s.out, q->filename);
+        _imgWriteTree(&s, &q->tree);
+    );
+    listFree(programs);
+
+    // the constant globals are the builtins the runtime was created from
+    size_t count = 0;
+    for (size_t i = 0; r && i < r->variables.length; i++)
+    {
+        Variable* v = listGetP(r->variables, i);
+        if (!v->constant)
+        {
+            _imgCollect(&s, v);
+            count++;
+        }
+    }
+    _imgWriteObjects(&s);
+
+    _imgWriteSize(&s.out, count);
+    for (size_t i = 0; r && i < r->variables.length; i++)
+    {
+        Variable* v = listGetP(r->variables, i);
+        if (!v->constant)
+            _imgWriteVariable(&s, v);
+    }
+
+    if (!s.failed)
+    {
+        uint64_t sum = imgChecksum(s.out.data, s.out.length);
+        unsigned char bytes[8];
+        for (size_t i = 0; i < 8; i++)
+            bytes[i] = (unsigned char)(sum >> (i * 8));
+        _imgWriteBytes(&s.out, bytes, 8);
+
+        if (!_imgWriteFile(filename, s.out.data, s.out.length))
+        {
+            if (messages)
+                stPrintf(messages, "Error: couldn't write image %s\n", filename);
+            s.failed = 1;
+        }
+    }
+
+    free(s.out.data);
+    _imgMapFree(&s.nodes);
+    _imgMapFree(&s.frames);
+    _imgMapFree(&s.objects);
+    listFree(s.order);
+    return !s.failed;
+}
+
+Program* _imgLoadFile(const char* filename, String key, String* data, List builtins, Runtime* r, Stream* messages)
+{
+    _ImgFile file;
+    if (!_imgMapFile(filename, &file))
+    {
+        if (messages)
+            stPrintf(messages, "Error: couldn't open image %s\n", filename);
+        return NULL;
+    }
+
+    _ImgLoader l =
+    {
+        .in = { .pos = file.data, .end = file.data + file.size, .failed = 0 },
+        .r = r,
+        .builtins = builtins,
+        .messages = messages,
+        .nodes = listNew(ParserNode*),
+        .objects = NULL,
+        .objectCount = 0,
+        .reported = 0,
+    };
+
+    // the evaluator trusts the tree so only undamaged image is read
+    _Bool ok = 0;
+    if (file.size > 8)
+    {
+        uint64_t sum = 0;
+        for (size_t i = 0; i < 8; i++)
+            sum |= (uint64_t)file.data[file.size - 8 + i] << (i * 8);
+        l.in.end -= 8;
+        ok = imgChecksum(file.data, file.size - 8) == sum;
+    }
+
+    // the first program is the saved one, the others are its modules, the
+    // cache of program holds single program
+    String stored;
+    ok = ok && _imgReadHeader(&l, key, &stored);
+    size_t count = ok ? _imgReadCount(&l.in) : 0;
+    ok = ok && count && (r || count == 1);
+
+    Program* p = NULL;
+    size_t slots = 0;
+    for (size_t i = 0; ok && i < count; i++)
+    {
+        Program* q = malloc(sizeof(Program));
+        assert(q);
+        q->filename = strEmpty();
+        q->imports = listNew(Program*);
+        q->tree = ptCreate();
+        if (!p)
+            p = q;
+        else
+            listAdd(p->imports, q, Program*);
+
+        // the trees are numbered one after another like the trees of Modules
+        ok = _imgReadProgram(&l, q);
+        rsNumber(&q->tree, slots);
+        slots = q->tree.slots;
+    }
+    ok = ok
+        && _imgReadObjects(&l)
+        && _imgReadGlobals(&l);
+    if (ok && data)
+        *data = _imgCopyString(stored);
+
+    _imgUnmapFile(&file);
+    listFree(l.nodes);
+    free(l.objects);
+
+    if (!ok)
+    {
+        // the objects that were already created are garbage now
+        if (messages && !l.reported)
+            stPrintf(messages, "Error: %s is not valid image\n", filename);
+        if (p)
+            imgFree(p);
+        return NULL;
+    }
+    return p;
+}
+
+void _imgWriteBytes(_ImgWriter* w, const void* data, size_t length)
+{
+    if (w->length + length > w->capacity)
+    {
+        size_t capacity = w->capacity ? w->capacity * 2 : 4096;
+        while (capacity < w->length + length)
+            capacity *= 2;
+        unsigned char* mem = realloc(w->data, capacity);
+        assert(mem);
+        w->data = mem;
+        w->capacity = capacity;
+    }
+    memcpy(w->data + w->length, data, length);
+    w->length += length;
+}
+
+void _imgWriteSize(_ImgWriter* w, uint64_t value)
+{
+    unsigned char bytes[10];
+    size_t length = 0;
+    do
+    {
+        bytes[length] = value & 0x7F;
+        value >>= 7;
+        if (value)
+            bytes[length] |= 0x80;
+        length++;
+    } while (value);
+    _imgWriteBytes(w, bytes, length);
+}
+
+void _imgWriteInt(_ImgWriter* w, long long value)
+{
+    // the sign is moved to the lowest bit
+    uint64_t bits = (uint64_t)value;
+    _imgWriteSize(w, (bits << 1) ^ (value < 0 ? UINT64_MAX : 0));
+}
+
+void _imgWriteFloat(_ImgWriter* w, double value)
+{
+    uint64_t bits;
+    memcpy(&bits, &value, sizeof(bits));
+    unsigned char bytes[8];
+    for (size_t i = 0; i < 8; i++)
+        bytes[i] = (unsigned char)(bits >> (i * 8));
+    _imgWriteBytes(w, bytes, 8);
+}
+
+void _imgWriteString(_ImgWriter* w, String str)
+{
+    _imgWriteSize(w, str.length);
+    if (str.length)
+        _imgWriteBytes(w, str.c, str.length);
+}
+
+const unsigned char* _imgReadBytes(_ImgReader* in, size_t length)
+{
+    if (in->failed || (size_t)(in->end - in->pos) < length)
+    {
+        in->failed = 1;
+        return NULL;
+    }
+    const unsigned char* bytes = in->pos;
+    in->pos += length;
+    return bytes;
+}
+
+uint64_t _imgReadSize(_ImgReader* in)
+{
+    uint64_t value = 0;
+    for (unsigned shift = 0; shift < 64; shift += 7)
+    {
+        const unsigned char* b = _imgReadBytes(in, 1);
+        if (!b)
+            return 0;
+        value |= (uint64_t)(*b & 0x7F) << shift;
+        if (!(*b & 0x80))
+            return value;
+    }
+    in->failed = 1;
+    return 0;
+}
+
+size_t _imgReadCount(_ImgReader* in)
+{
+    uint64_t count = _imgReadSize(in);
+    if (count > (uint64_t)(in->end - in->pos))
+    {
+        in->failed = 1;
+        return 0;
+    }
+    return (size_t)count;
+}
+
+long long _imgReadInt(_ImgReader* in)
+{
+    uint64_t bits = _imgReadSize(in);
+    return (long long)((bits >> 1) ^ (bits & 1 ? UINT64_MAX : 0));
+}
+
+double _imgReadFloat(_ImgReader* in)
+{
+    const unsigned char* bytes = _imgReadBytes(in, 8);
+    if (!bytes)
+        return 0;
+    uint64_t bits = 0;
+    for (size_t i = 0; i < 8; i++)
+        bits |= (uint64_t)bytes[i] << (i * 8);
+    double value;
+    memcpy(&value, &bits, sizeof(value));
+    return value;
+}
+
+unsigned char _imgReadByte(_ImgReader* in)
+{
+    const unsigned char* b = _imgReadBytes(in, 1);
+    return b ? *b : 0;
+}
+
+String _imgReadString(_ImgReader* in)
+{
+    size_t length = _imgReadCount(in);
+    const unsigned char* chars = _imgReadBytes(in, length);
+    String str =
+    {
+        .c = (char*)chars,
+        .length = chars ? length : 0,
+    };
+    return str;
+}
+
+String _imgCopyString(String str)
+{
+    return str.length ? strCLen(str.c, str.length) : strEmpty();
+}
+
+size_t _imgMapSlot(_ImgMap* m, const void* key)
+{
+    size_t mask = m->capacity - 1;
+    size_t i = (size_t)(((uintptr_t)key >> 4) * 0x9E3779B97F4A7C15ull >> 32) & mask;
+    while (m->keys[i] && m->keys[i] != key)
+        i = (i + 1) & mask;
+    return i;
+}
+
+void _imgMapAdd(_ImgMap* m, const void* key, size_t value)
+{
+    // keep the load factor under 1/2
+    if ((m->count + 1) * 2 > m->capacity)
+    {
+        _ImgMap grown =
+        {
+            .capacity = m->capacity ? m->capacity * 2 : 256,
+            .count = m->count,
+        };
+        grown.keys = calloc(grown.capacity, sizeof(const void*));
+        grown.values = malloc(sizeof(size_t) * grown.capacity);
+        assert(grown.keys && grown.values);
+        for (size_t i = 0; i < m->capacity; i++)
+        {
+            if (!m->keys[i])
+                continue;
+            size_t slot = _imgMapSlot(&grown, m->keys[i]);
+            grown.keys[slot] = m->keys[i];
+            grown.values[slot] = m->values[i];
+        }
+        _imgMapFree(m);
+        *m = grown;
+    }
+
+    size_t slot = _imgMapSlot(m, key);
+    assert(!m->keys[slot]);
+    m->keys[slot] = key;
+    m->values[slot] = value;
+    m->count++;
+}
+
+_Bool _imgMapFind(_ImgMap* m, const void* key, size_t* value)
+{
+    if (!m->count)
+        return 0;
+    size_t slot = _imgMapSlot(m, key);
+    if (!m->keys[slot])
+        return 0;
+    *value = m->values[slot];
+    return 1;
+}
+
+void _imgMapFree(_ImgMap* m)
+{
+    free(m->keys);
+    free(m->values);
+}
+
+void _imgSaveError(_ImgSaver* s, Variable* v, const char* reason)
+{
+    if (s->messages && !s->failed)
+    {
+        if (v->name.length)
+            stPrintf(s->messages, "Error: cannot save %s to image, it %s\n", v->name.c, reason);
+        else
+            stPrintf(s->messages, "Error: cannot save value to image, it %s\n", reason);
+    }
+    s->failed = 1;
+}
+
+void _imgAddImports(List* programs)
+{
+    // the list is also the queue of the programs whose imports weren't added
+    for (size_t i = 0; i < programs->length; i++)
+    {
+        Program* q = listGet(*programs, i, Program*);
+        for (size_t j = 0; j < q->imports.length; j++)
+        {
+            Program* module = listGet(q->imports, j, Program*);
+            _Bool added = 0;
+            for (size_t k = 0; !added && k < programs->length; k++)
+                added = listGet(*programs, k, Program*) == module;
+            if (!added)
+                listAdd(*programs, module, Program*);
+        }
+    }
+}
+
+void _imgWriteTree(_ImgSaver* s, ParserTree* tree)
+{
+    _imgWriteSize(&s->out, tree->nodes.length);
+
+    // explicit stack so that deeply nested trees don't overflow the C stack
+    List pending = listNew(ParserNode*);
+    for (size_t i = tree->nodes.length; i > 0; i--)
+        listAdd(pending, listGetP(tree->nodes, i - 1), ParserNode*);
+    while (pending.length)
+    {
+        ParserNode* n = listGet(pending, --pending.length, ParserNode*);
+        size_t index = s->nodes.count;
+        _imgMapAdd(&s->nodes, n, index);
+        if (ptFrame(n))
+            _imgMapAdd(&s->frames, n->frame, index);
+        _imgWriteNode(&s->out, n);
+        for (size_t i = n->nodes.length; i > 0; i--)
+            listAdd(pending, listGetP(n->nodes, i - 1), ParserNode*);
+    }
+    listFree(pending);
+}
+
+void _imgWriteNode(_ImgWriter* w, ParserNode* n)
+{
+    _imgWriteSize(w, n->type);
+    _imgWriteSize(w, n->nodes.length);
+    FrameLayout* frame = ptFrame(n);
+    unsigned char flags = (n->token ? _IMG_TOKEN : 0) | (frame ? _IMG_FRAME : 0);
+    _imgWriteBytes(w, &flags, 1);
+
+    // the feedback is kept so that the loaded calls stay specialized
+    if (n->type == P_FUNCTION_CALL)
+    {
+        _imgWriteSize(w, n->feedback.hits);
+        _imgWriteSize(w, n->feedback.deopts);
+        _imgWriteInt(w, n->feedback.seen);
+        _imgWriteSize(w, n->feedback.specialized);
+    }
+    if (_imgNamed(n->type))
+    {
+        _imgWriteSize(w, n->slot.type);
+        _imgWriteSize(w, n->slot.index);
+    }
+
+    if (n->token)
+        _imgWriteToken(w, n->token);
+    if (frame)
+    {
+        _imgWriteSize(w, n->frame->size);
+        _imgWriteSize(w, n->frame->captures.length);
+        listForEach(n->frame->captures, Slot, c,
+            _imgWriteSize(w, c.type);
+            _imgWriteSize(w, c.index);
+        );
+        _imgWriteSize(w, n->frame->self);
+        _imgWriteSize(w, n->frame->env);
+    }
+}
+
+_Bool _imgNamed(ParserNodeType type)
+{
+    return type == P_IDENTIFIER || type == P_VARIABLE_SETTER || type == P_FUNCTION_SETTER;
+}
+
+void _imgWriteToken(_ImgWriter* w, Token* t)
+{
+    _imgWriteSize(w, t->type);
+    _imgWriteSize(w, t->pos.line);
+    _imgWriteSize(w, t->pos.col);
+    switch (t->type)
+    {
+    case T_COMMENT_LINE:
+    case T_COMMENT_BLOCK:
+    case T_IDENTIFIER_VARIABLE:
+    case T_IDENTIFIER_FUNCTION:
+    case T_IDENTIFIER_STRUCT:
+    case T_LITERAL_STRING:
+    case T_LITERAL_BIGINT:
+    case T_IDENTIFIER_PARAMETER:
+    case T_INVALID:
+        _imgWriteString(w, t->string);
+        return;
+    case T_PUNCTUATION_BRACKET_OPEN:
+    case T_PUNCTUATION_BRACKET_CLOSE:
+    case T_LITERAL_INTEGER:
+        _imgWriteInt(w, t->integer);
+        return;
+    case T_LITERAL_FLOAT:
+        _imgWriteFloat(w, t->decimal);
+        return;
+    case T_LITERAL_CHAR:
+        _imgWriteBytes(w, &t->character, 1);
+        return;
+    case T_LITERAL_BOOL:
+    {
+        unsigned char b = t->boolean;
+        _imgWriteBytes(w, &b, 1);
+        return;
+    }
+    default:
+        return;
+    }
+}
+
+void _imgAddObject(_ImgSaver* s, GcKind kind, void* address, size_t length)
+{
+    size_t index;
+    if (!address || _imgMapFind(&s->objects, address, &index))
+        return;
+    _imgMapAdd(&s->objects, address, s->order.length);
+    _ImgObject o =
+    {
+        .kind = kind,
+        .address = address,
+        .length = length,
+    };
+    listAdd(s->order, o, _ImgObject);
+}
+
+void _imgCollect(_ImgSaver* s, Variable* v)
+{
+    switch (v->type)
+    {
+    case V_STRING:
+        _imgAddObject(s, GC_STRING, v->str.c, v->str.length);
+        return;
+    case V_BIGINT:
+        _imgAddObject(s, GC_BIGINT, v->big, 0);
+        return;
+    case V_ARRAY:
+        _imgAddObject(s, GC_ARRAY, v->array.items, 0);
+        return;
+    case V_THUNK:
+        _imgAddObject(s, GC_THUNK, v->thunk, 0);
+        return;
+    case V_FUNCTION:
+        _imgAddObject(s, GC_CLOSURE, v->function.closure, 0);
+        _imgAddObject(s, GC_MEMO, v->function.memo, 0);
+        return;
+    default:
+        return;
+    }
+}
+
+void _imgWriteObjects(_ImgSaver* s)
+{
+    // the list grows while the objects are visited, so it is also the
+    // queue of the objects whose references weren't collected yet
+    for (size_t i = 0; i < s->order.length; i++)
+    {
+        _ImgObject o = listGet(s->order, i, _ImgObject);
+        switch (o.kind)
+        {
+        case GC_CLOSURE:
+        {
+            Closure* c = o.address;
+            for (size_t j = 0; j < c->length; j++)
+                _imgCollect(s, c->variables + j);
+            break;
+        }
+        case GC_THUNK:
+        {
+            Thunk* t = o.address;
+            _imgAddObject(s, GC_CLOSURE, t->closure, 0);
+            if (t->forced)
+                _imgCollect(s, &t->value);
+            break;
+        }
+        case GC_MEMO:
+        {
+            Memo* m = o.address;
+            for (size_t j = 0; j < m->length; j++)
+            {
+                for (size_t k = 0; k < m->entries[j].argc; k++)
+                    _imgCollect(s, m->entries[j].key + k);
+                _imgCollect(s, &m->entries[j].value);
+            }
+            break;
+        }
+        default:
+            break;
+        }
+    }
+
+    _imgWriteSize(&s->out, s->order.length);
+    for (size_t i = 0; i < s->order.length; i++)
+    {
+        _ImgObject* o = listGetP(s->order, i);
+        _imgWriteSize(&s->out, o->kind);
+        switch (o->kind)
+        {
+        case GC_STRING:
+        {
+            String str = { .c = o->address, .length = o->length };
+            _imgWriteString(&s->out, str);
+            break;
+        }
+        case GC_BIGINT:
+        {
+            BigInt* b = o->address;
+            unsigned char negative = b->negative;
+            _imgWriteBytes(&s->out, &negative, 1);
+            _imgWriteSize(&s->out, b->length);
+            for (size_t j = 0; j < b->length; j++)
+                _imgWriteSize(&s->out, b->digits[j]);
+            break;
+        }
+        case GC_ARRAY:
+        {
+            Array* a = o->address;
+            _imgWriteSize(&s->out, a->type);
+            _imgWriteSize(&s->out, a->length);
+            for (size_t j = 0; j < a->length; j++)
+            {
+                if (a->type == V_INT)
+                    _imgWriteInt(&s->out, a->items[j].integer);
+                else
+                    _imgWriteFloat(&s->out, a->items[j].decimal);
+            }
+            break;
+        }
+        case GC_CLOSURE:
+            _imgWriteSize(&s->out, ((Closure*)o->address)->length);
+            break;
+        case GC_MEMO:
+            _imgWriteSize(&s->out, ((Memo*)o->address)->capacity);
+            break;
+        default:
+            break;
+        }
+    }
+
+    for (size_t i = 0; i < s->order.length; i++)
+    {
+        _ImgObject* o = listGetP(s->order, i);
+        switch (o->kind)
+        {
+        case GC_CLOSURE:
+        {
+            Closure* c = o->address;
+            for (size_t j = 0; j < c->length; j++)
+                _imgWriteVariable(s, c->variables + j);
+            break;
+        }
+        case GC_THUNK:
+        {
+            Thunk* t = o->address;
+            Variable v = { .name = strEmpty(), .type = V_THUNK, .thunk = t };
+            _imgWriteNodeRef(s, &v, t->node);
+            _imgWriteFrameRef(s, &v, t->frame);
+            _imgWriteObjectRef(s, t->closure);
+            unsigned char forced = t->forced;
+            _imgWriteBytes(&s->out, &forced, 1);
+            if (t->forced)
+                _imgWriteVariable(s, &t->value);
+            break;
+        }
+        case GC_MEMO:
+        {
+            Memo* m = o->address;
+            _imgWriteSize(&s->out, m->hits);
+            _imgWriteSize(&s->out, m->misses);
+            _imgWriteSize(&s->out, m->evictions);
+            _imgWriteSize(&s->out, m->hand);
+            _imgWriteSize(&s->out, m->length);
+            for (size_t j = 0; j < m->length; j++)
+            {
+                MemoEntry* e = m->entries + j;
+                _imgWriteSize(&s->out, e->argc);
+                for (size_t k = 0; k < e->argc; k++)
+                    _imgWriteVariable(s, e->key + k);
+                _imgWriteVariable(s, &e->value);
+                unsigned char used = e->used;
+                _imgWriteBytes(&s->out, &used, 1);
+            }
+            break;
+        }
+        default:
+            break;
+        }
+    }
+}
+
+void _imgWriteObjectRef(_ImgSaver* s, void* address)
+{
+    size_t index = 0;
+    if (address)
+    {
+        _Bool found = _imgMapFind(&s->objects, address, &index);
+        assert(found);
+        (void)found;
+        index++;
+    }
+    _imgWriteSize(&s->out, index);
+}
+
+void _imgWriteNodeRef(_ImgSaver* s, Variable* v, ParserNode* n)
+{
+    size_t index = 0;
+    if (!_imgMapFind(&s->nodes, n, &index))
+        _imgSaveError(s, v, "was created by other program");
+    _imgWriteSize(&s->out, index);
+}
+
+void _imgWriteFrameRef(_ImgSaver* s, Variable* v, FrameLayout* frame)
+{
+    size_t index = 0;
+    if (!_imgMapFind(&s->frames, frame, &index))
+        _imgSaveError(s, v, "was created by other program");
+    _imgWriteSize(&s->out, index);
+}
+
+void _imgWriteVariable(_ImgSaver* s, Variable* v)
+{
+    _imgWriteString(&s->out, v->name);
+    _imgWriteSize(&s->out, v->type);
+    switch (v->type)
+    {
+    case V_BOOL:
+    {
+        unsigned char b = v->boolean;
+        _imgWriteBytes(&s->out, &b, 1);
+        return;
+    }
+    case V_INT:
+        _imgWriteInt(&s->out, v->integer);
+        return;
+    case V_FLOAT:
+        _imgWriteFloat(&s->out, v->decimal);
+        return;
+    case V_CHAR:
+        _imgWriteBytes(&s->out, &v->character, 1);
+        return;
+    case V_STRING:
+        _imgWriteObjectRef(s, v->str.c);
+        return;
+    case V_EXCEPTION:
+        // the name of exception is its kind
+        _imgWriteString(&s->out, v->str);
+        return;
+    case V_FUNCTION:
+        _imgWriteFunction(s, v);
+        return;
+    case V_THUNK:
+        _imgWriteObjectRef(s, v->thunk);
+        return;
+    case V_BIGINT:
+        _imgWriteObjectRef(s, v->big);
+        return;
+    case V_ARRAY:
+        _imgWriteObjectRef(s, v->array.items);
+        _imgWriteSize(&s->out, v->array.offset);
+        _imgWriteSize(&s->out, v->array.length);
+        return;
+    case V_NOTHING:
+        return;
+    default:
+        _imgSaveError(s, v, "has type that cannot be saved");
+        return;
+    }
+}
+
+void _imgWriteFunction(_ImgSaver* s, Variable* v)
+{
+    Function* f = &v->function;
+    unsigned char builtin = f->body == NULL;
+    _imgWriteBytes(&s->out, &builtin, 1);
+
+    if (builtin)
+    {
+        for (size_t i = 0; i < s->builtins.length; i++)
+        {
+            Variable* b = listGetP(s->builtins, i);
+            if (b->type == V_FUNCTION && b->function.action == f->action)
+            {
+                _imgWriteString(&s->out, b->name);
+                return;
+            }
+        }
+        _imgSaveError(s, v, "is not one of the builtins");
+        return;
+    }
+
+    // functions that don't escape their frame cannot be in the globals
+    if (f->env)
+    {
+        _imgSaveError(s, v, "uses frame of running function");
+        return;
+    }
+
+    _imgWriteSize(&s->out, f->parameters.length);
+    listForEach(f->parameters, String, p, _imgWriteString(&s->out, p));
+    _imgWriteNodeRef(s, v, f->body);
+    _imgWriteFrameRef(s, v, f->frame);
+    _imgWriteObjectRef(s, f->closure);
+    _imgWriteObjectRef(s, f->memo);
+}
+
+_Bool _imgReadHeader(_ImgLoader* l, String key, String* data)
+{
+    const unsigned char* magic = _imgReadBytes(&l->in, 4);
+    if (!magic || memcmp(magic, _IMG_MAGIC, 4) != 0 || _imgReadSize(&l->in) != _IMG_VERSION)
+        return 0;
+    String stored = _imgReadString(&l->in);
+    *data = _imgReadString(&l->in);
+    return !l->in.failed && stored.length == key.length && (!key.length || memcmp(stored.c, key.c, key.length) == 0);
+}
+
+_Bool _imgReadProgram(_ImgLoader* l, Program* p)
+{
+    p->filename = _imgCopyString(_imgReadString(&l->in));
+    p->tree.filename = p->filename.c;
+
+    size_t count = _imgReadCount(&l->in);
+    size_t added = 0;
+    List pending = listNew(_ImgPending);
+    while (!l->in.failed && (added < count || pending.length))
+    {
+        ParserNode n;
+        size_t childs;
+        if (!_imgReadNode(l, &n, &p->filename, &childs))
+            break;
+
+        // the childs are added to the last node that still misses some,
+        // earlier siblings may move but the ancestors don't
+        ParserNode* node;
+        if (pending.length)
+        {
+            _ImgPending* parent = listGetP(pending, pending.length - 1);
+            ptNodeAdd(parent->node, n);
+            node = listGetP(parent->node->nodes, parent->node->nodes.length - 1);
+            parent->remaining--;
+        }
+        else
+        {
+            ptAdd(&p->tree, n);
+            node = listGetP(p->tree.nodes, p->tree.nodes.length - 1);
+            added++;
+        }
+
+        if (childs)
+        {
+            _ImgPending next = { .node = node, .remaining = childs };
+            listAdd(pending, next, _ImgPending);
+        }
+        while (pending.length && listGet(pending, pending.length - 1, _ImgPending).remaining == 0)
+            pending.length--;
+    }
+    listFree(pending);
+    if (l->in.failed)
+        return 0;
+
+    // the same preorder as the one the nodes were saved in
+    List stack = listNew(ParserNode*);
+    for (size_t i = p->tree.nodes.length; i > 0; i--)
+        listAdd(stack, listGetP(p->tree.nodes, i - 1), ParserNode*);
+    while (stack.length)
+    {
+        ParserNode* n = listGet(stack, --stack.length, ParserNode*);
+        listAdd(l->nodes, n, ParserNode*);
+        for (size_t i = n->nodes.length; i > 0; i--)
+            listAdd(stack, listGetP(n->nodes, i - 1), ParserNode*);
+    }
+    listFree(stack);
+
+    // the values of the literals are created again from their tokens
+    cpBuild(&p->tree);
+    return 1;
+}
+
+_Bool _imgReadNode(_ImgLoader* l, ParserNode* n, String* filename, size_t* childs)
+{
+    _ImgReader* in = &l->in;
+    uint64_t type = _imgReadSize(in);
+    *childs = _imgReadCount(in);
+    unsigned char flags = _imgReadByte(in);
+    if (type > P_FLOAT_MULTIPLY)
+    {
+        type = P_ERROR;
+        in->failed = 1;
+    }
+    *n = ptCreateNode((ParserNodeType)type);
+
+    if (type == P_FUNCTION_CALL)
+    {
+        n->feedback.hits = (unsigned)_imgReadSize(in);
+        n->feedback.deopts = (unsigned)_imgReadSize(in);
+        n->feedback.seen = (int)_imgReadInt(in);
+        uint64_t specialized = _imgReadSize(in);
+        n->feedback.specialized = (ParserNodeType)specialized;
+        if (specialized > P_FLOAT_MULTIPLY)
+            in->failed = 1;
+    }
+    if (_imgNamed((ParserNodeType)type))
+    {
+        uint64_t slot = _imgReadSize(in);
+        n->slot.type = (SlotType)slot;
+        n->slot.index = (size_t)_imgReadSize(in);
+        if (slot > S_CAPTURED)
+            in->failed = 1;
+    }
+    if ((flags & _IMG_FRAME) && type != P_FUNCTION_DEFINITION && type != P_LAZY)
+        in->failed = 1;
+
+    Token t;
+    if ((flags & _IMG_TOKEN) && _imgReadToken(in, &t, filename))
+    {
+        n->token = malloc(sizeof(Token));
+        assert(n->token);
+        *n->token = t;
+    }
+
+    if ((flags & _IMG_FRAME) && !in->failed)
+    {
+        n->frame = malloc(sizeof(FrameLayout));
+        assert(n->frame);
+        n->frame->size = (size_t)_imgReadSize(in);
+        n->frame->captures = listNew(Slot);
+        size_t captures = _imgReadCount(in);
+        for (size_t i = 0; i < captures; i++)
+        {
+            Slot c;
+            uint64_t ctype = _imgReadSize(in);
+            c.type = (SlotType)ctype;
+            c.index = (size_t)_imgReadSize(in);
+            if (ctype > S_CAPTURED)
+                in->failed = 1;
+            listAdd(n->frame->captures, c, Slot);
+        }
+        n->frame->self = (size_t)_imgReadSize(in);
+        n->frame->env = (size_t)_imgReadSize(in);
+        // the machine code isn't saved, the loaded functions count their
+        // calls again
+        n->frame->calls = 0;
+        n->frame->jit = JIT_INTERPRETED;
+        n->frame->code = NULL;
+    }
+
+    if (in->failed)
+    {
+        ptFreeNode(*n, 1);
+        return 0;
+    }
+    return 1;
+}
+
+_Bool _imgReadToken(_ImgReader* in, Token* t, String* filename)
+{
+    uint64_t type = _imgReadSize(in);
+    size_t line = (size_t)_imgReadSize(in);
+    size_t col = (size_t)_imgReadSize(in);
+    if (type > T_ERROR)
+        in->failed = 1;
+    if (in->failed)
+        return 0;
+
+    *t = tokenCreate((T_TokenType)type, fpCreate(line, col, filename));
+    switch (t->type)
+    {
+    case T_COMMENT_LINE:
+    case T_COMMENT_BLOCK:
+    case T_IDENTIFIER_VARIABLE:
+    case T_IDENTIFIER_FUNCTION:
+    case T_IDENTIFIER_STRUCT:
+    case T_LITERAL_STRING:
+    case T_LITERAL_BIGINT:
+    case T_IDENTIFIER_PARAMETER:
+    case T_INVALID:
+    {
+        // the names are compared and printed as C strings
+        String str = _imgReadString(in);
+        t->string = strCLen(str.c ? str.c : "", str.length);
+        break;
+    }
+    case T_PUNCTUATION_BRACKET_OPEN:
+    case T_PUNCTUATION_BRACKET_CLOSE:
+    case T_LITERAL_INTEGER:
+        t->integer = _imgReadInt(in);
+        break;
+    case T_LITERAL_FLOAT:
+        t->decimal = _imgReadFloat(in);
+        break;
+    case T_LITERAL_CHAR:
+        t->character = (char)_imgReadByte(in);
+        break;
+    case T_LITERAL_BOOL:
+        t->boolean = _imgReadByte(in) != 0;
+        break;
+    default:
+        break;
+    }
+
+    if (in->failed)
+    {
+        tokenFree(*t);
+        return 0;
+    }
+    return 1;
+}
+
+_Bool _imgReadObjects(_ImgLoader* l)
+{
+    size_t count = _imgReadCount(&l->in);
+    // image of program has no heap objects
+    if (count && !l->r)
+        return 0;
+    l->objects = malloc(sizeof(_ImgObject) * (count ? count : 1));
+    assert(l->objects);
+
+    // all objects exist before any reference to them is read, the heap
+    // isn't collected while the image loads so none of them moves
+    for (; l->objectCount < count; l->objectCount++)
+    {
+        if (!_imgReadShape(l, l->objects + l->objectCount))
+            return 0;
+    }
+    for (size_t i = 0; i < count; i++)
+    {
+        if (!_imgReadContent(l, l->objects + i))
+            return 0;
+    }
+    return 1;
+}
+
+_Bool _imgReadShape(_ImgLoader* l, _ImgObject* o)
+{
+    _ImgReader* in = &l->in;
+    Gc* gc = &l->r->gc;
+    o->kind = (GcKind)_imgReadSize(in);
+    o->length = 0;
+    switch (o->kind)
+    {
+    case GC_STRING:
+    {
+        String str = _imgReadString(in);
+        if (in->failed)
+            return 0;
+        o->address = gcString(gc, str).c;
+        o->length = str.length;
+        return 1;
+    }
+    case GC_BIGINT:
+    {
+        unsigned char negative = _imgReadByte(in);
+        size_t length = _imgReadCount(in);
+        if (in->failed || length == 0)
+            return 0;
+        BigInt* b = gcAlloc(gc, GC_BIGINT, sizeof(BigInt) + sizeof(uint32_t) * length);
+        b->negative = negative != 0;
+        b->length = length;
+        for (size_t i = 0; i < length; i++)
+        {
+            uint64_t digit = _imgReadSize(in);
+            if (digit > UINT32_MAX)
+                in->failed = 1;
+            b->digits[i] = (uint32_t)digit;
+        }
+        o->address = b;
+        // leading zeros would break the comparisons
+        return !in->failed && b->digits[length - 1] != 0;
+    }
+    case GC_ARRAY:
+    {
+        uint64_t type = _imgReadSize(in);
+        size_t length = _imgReadCount(in);
+        if (in->failed || (type != V_INT && type != V_FLOAT))
+            return 0;
+        Array* a = arrCreate(gc, (VariableType)type, length);
+        for (size_t i = 0; i < length; i++)
+        {
+            if (type == V_INT)
+                a->items[i].integer = _imgReadInt(in);
+            else
+                a->items[i].decimal = _imgReadFloat(in);
+        }
+        o->address = a;
+        return !in->failed;
+    }
+    case GC_CLOSURE:
+    {
+        size_t length = _imgReadCount(in);
+        if (in->failed)
+            return 0;
+        Closure* c = rtCreateClosure(l->r, length);
+        for (size_t i = 0; i < length; i++)
+            c->variables[i] = rtCreateNothingVariable();
+        o->address = c;
+        return 1;
+    }
+    case GC_THUNK:
+        o->address = rtThunkVariable(l->r, NULL, NULL, NULL).thunk;
+        return 1;
+    case GC_MEMO:
+    {
+        size_t capacity = (size_t)_imgReadSize(in);
+        if (in->failed || capacity == 0)
+            return 0;
+        o->address = memoCreate(gc, capacity);
+        return 1;
+    }
+    default:
+        in->failed = 1;
+        return 0;
+    }
+}
+
+_Bool _imgReadContent(_ImgLoader* l, _ImgObject* o)
+{
+    _ImgReader* in = &l->in;
+    switch (o->kind)
+    {
+    case GC_CLOSURE:
+    {
+        Closure* c = o->address;
+        for (size_t i = 0; i < c->length; i++)
+        {
+            if (!_imgReadVariable(l, c->variables + i))
+                return 0;
+        }
+        return 1;
+    }
+    case GC_THUNK:
+    {
+        Thunk* t = o->address;
+        t->node = _imgReadNodeRef(l);
+        t->frame = _imgReadFrameRef(l);
+        _ImgObject* closure = _imgReadObjectRef(l, GC_CLOSURE);
+        t->closure = closure ? closure->address : NULL;
+        if (_imgReadByte(in) && !in->failed)
+        {
+            if (!_imgReadVariable(l, &t->value))
+                return 0;
+            t->forced = 1;
+        }
+        return !in->failed;
+    }
+    case GC_MEMO:
+    {
+        Memo* m = o->address;
+        size_t hits = (size_t)_imgReadSize(in);
+        size_t misses = (size_t)_imgReadSize(in);
+        size_t evictions = (size_t)_imgReadSize(in);
+        size_t hand = (size_t)_imgReadSize(in);
+        size_t length = _imgReadCount(in);
+        if (in->failed || length > m->capacity)
+            return 0;
+        for (size_t i = 0; i < length; i++)
+        {
+            size_t argc = _imgReadCount(in);
+            if (in->failed)
+                return 0;
+            Variable* key = malloc(sizeof(Variable) * (argc ? argc : 1));
+            assert(key);
+            for (size_t j = 0; j < argc; j++)
+                _imgReadVariable(l, key + j);
+            Variable value;
+            _imgReadVariable(l, &value);
+            _Bool used = _imgReadByte(in) != 0;
+            if (in->failed)
+            {
+                memoFreeKey(key, argc);
+                rtFreeVariable(value);
+                return 0;
+            }
+
+            size_t before = m->length;
+            memoAdd(m, key, argc, value);
+            if (m->length != before)
+                m->entries[m->length - 1].used = used;
+        }
+        m->hits = hits;
+        m->misses = misses;
+        m->evictions = evictions;
+        m->hand = hand < m->capacity ? hand : 0;
+        return 1;
+    }
+    default:
+        return 1;
+    }
+}
+
+_Bool _imgReadGlobals(_ImgLoader* l)
+{
+    size_t count = _imgReadCount(&l->in);
+    if (count && !l->r)
+        return 0;
+    List globals = listNew(Variable);
+    for (size_t i = 0; i < count && !l->in.failed; i++)
+    {
+        Variable v;
+        if (_imgReadVariable(l, &v))
+            listAdd(globals, v, Variable);
+    }
+
+    // the whole image must be used
+    if (l->in.failed || l->in.pos != l->in.end)
+    {
+        listDeepFree(globals, Variable, v, rtFreeVariable(v));
+        return 0;
+    }
+
+    listForEach(globals, Variable, v,
+        String name = v.name;
+        v.name = strEmpty();
+        rtSet(l->r, name, v);
+    );
+    listFree(globals);
+    return 1;
+}
+
+_ImgObject* _imgReadObjectRef(_ImgLoader* l, GcKind kind)
+{
+    uint64_t index = _imgReadSize(&l->in);
+    if (index == 0)
+        return NULL;
+    if (index > l->objectCount || l->objects[index - 1].kind != kind)
+    {
+        l->in.failed = 1;
+        return NULL;
+    }
+    return l->objects + index - 1;
+}
+
+ParserNode* _imgReadNodeRef(_ImgLoader* l)
+{
+    uint64_t index = _imgReadSize(&l->in);
+    if (index >= l->nodes.length)
+    {
+        l->in.failed = 1;
+        return NULL;
+    }
+    return listGet(l->nodes, index, ParserNode*);
+}
+
+FrameLayout* _imgReadFrameRef(_ImgLoader* l)
+{
+    ParserNode* n = _imgReadNodeRef(l);
+    FrameLayout* frame = n ? ptFrame(n) : NULL;
+    if (n && !frame)
+        l->in.failed = 1;
+    return frame;
+}
+
+_Bool _imgReadVariable(_ImgLoader* l, Variable* v)
+{
+    _ImgReader* in = &l->in;
+    String name = _imgReadString(in);
+    uint64_t type = _imgReadSize(in);
+    *v = rtCreateNothingVariable();
+    if (in->failed)
+        return 0;
+
+    switch (type)
+    {
+    case V_BOOL:
+        *v = rtBoolVariable(_imgReadByte(in) != 0);
+        break;
+    case V_INT:
+        *v = rtIntVariable(_imgReadInt(in));
+        break;
+    case V_FLOAT:
+        *v = rtFloatVariable(_imgReadFloat(in));
+        break;
+    case V_CHAR:
+        *v = rtCharVariable((char)_imgReadByte(in));
+        break;
+    case V_STRING:
+    {
+        _ImgObject* o = _imgReadObjectRef(l, GC_STRING);
+        String str = { .c = o ? o->address : NULL, .length = o ? o->length : 0 };
+        *v = rtStringVariable(str);
+        break;
+    }
+    case V_EXCEPTION:
+    {
+        String message = _imgReadString(in);
+        if (in->failed)
+            return 0;
+        *v = rtException(_imgCopyString(name), _imgCopyString(message));
+        return 1;
+    }
+    case V_FUNCTION:
+        if (!_imgReadFunction(l, v))
+            return 0;
+        break;
+    case V_THUNK:
+    {
+        _ImgObject* o = _imgReadObjectRef(l, GC_THUNK);
+        if (!o)
+            in->failed = 1;
+        v->type = V_THUNK;
+        v->thunk = o ? o->address : NULL;
+        break;
+    }
+    case V_BIGINT:
+    {
+        _ImgObject* o = _imgReadObjectRef(l, GC_BIGINT);
+        if (!o)
+            in->failed = 1;
+        else
+            *v = rtBigIntVariable(o->address);
+        break;
+    }
+    case V_ARRAY:
+    {
+        _ImgObject* o = _imgReadObjectRef(l, GC_ARRAY);
+        size_t offset = (size_t)_imgReadSize(in);
+        size_t length = (size_t)_imgReadSize(in);
+        if (!o || offset > ((Array*)o->address)->length || length > ((Array*)o->address)->length - offset)
+            in->failed = 1;
+        else
+            *v = rtArrayVariable(o->address, offset, length);
+        break;
+    }
+    case V_NOTHING:
+        break;
+    default:
+        in->failed = 1;
+        break;
+    }
+
+    if (in->failed)
+    {
+        rtFreeVariable(*v);
+        *v = rtCreateNothingVariable();
+        return 0;
+    }
+    v->name = _imgCopyString(name);
+    return 1;
+}
+
+_Bool _imgReadFunction(_ImgLoader* l, Variable* v)
+{
+    _ImgReader* in = &l->in;
+    if (_imgReadByte(in))
+    {
+        String name = _imgReadString(in);
+        for (size_t i = 0; i < l->builtins.length && !in->failed; i++)
+        {
+            Variable* b = listGetP(l->builtins, i);
+            // the name in the image isn't terminated by '\0'
+            if (b->type == V_FUNCTION && b->name.length == name.length && memcmp(b->name.c, name.c, name.length) == 0)
+            {
+                *v = rtCopyVariable(strEmpty(), *b);
+                return 1;
+            }
+        }
+        if (!in->failed && l->messages)
+        {
+            stPrintf(l->messages, "Error: image uses unknown builtin %.*s\n", (int)name.length, name.c);
+            l->reported = 1;
+        }
+        in->failed = 1;
+        return 0;
+    }
+
+    List parameters = listNew(String);
+    size_t count = _imgReadCount(in);
+    for (size_t i = 0; i < count && !in->failed; i++)
+        listAdd(parameters, _imgCopyString(_imgReadString(in)), String);
+
+    Function f = rtCreateFunction(evRunFunction, parameters);
+    f.body = _imgReadNodeRef(l);
+    f.frame = _imgReadFrameRef(l);
+    _ImgObject* closure = _imgReadObjectRef(l, GC_CLOSURE);
+    f.closure = closure ? closure->address : NULL;
+    _ImgObject* memo = _imgReadObjectRef(l, GC_MEMO);
+    f.memo = memo ? memo->address : NULL;
+    if (in->failed)
+    {
+        rtFreeFunction(f);
+        return 0;
+    }
+    *v = rtFunctionVariable(f);
+    return 1;
+}
+
+_Bool _imgWriteFile(const char* filename, const void* data, size_t length)
+{
+    // the name of the process keeps the temporary files of processes apart
+#ifdef _WIN32
+    unsigned long id = GetCurrentProcessId();
+#else
+    unsigned long id = (unsigned long)getpid();
+#endif // _WIN32
+    size_t size = strlen(filename) + 32;
+    char* temp = malloc(size);
+    assert(temp);
+    snprintf(temp, size, "%s.%lu.tmp", filename, id);
+
+    FILE* f = fopen(temp, "wb");
+    _Bool written = f && fwrite(data, 1, length, f) == length;
+    if (f && fclose(f) != 0)
+        written = 0;
+#ifdef _WIN32
+    written = written && MoveFileExA(temp, filename, MOVEFILE_REPLACE_EXISTING);
+#else
+    written = written && rename(temp, filename) == 0;
+#endif // _WIN32
+    if (!written)
+        remove(temp);
+    free(temp);
+    return written;
+}
+
+_Bool _imgMapFile(const char* filename, _ImgFile* file)
+{
+#ifdef _WIN32
+    // the image may be replaced while it is mapped
+    file->file = CreateFileA(filename, GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_DELETE, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+    if (file->file == INVALID_HANDLE_VALUE)
+        return 0;
+    LARGE_INTEGER size;
+    if (!GetFileSizeEx(file->file, &size) || size.QuadPart == 0)
+    {
+        CloseHandle(file->file);
+        return 0;
+    }
+    file->mapping = CreateFileMappingA(file->file, NULL, PAGE_READONLY, 0, 0, NULL);
+    if (!file->mapping)
+    {
+        CloseHandle(file->file);
+        return 0;
+    }
+    file->data = MapViewOfFile(file->mapping, FILE_MAP_READ, 0, 0, 0);
+    if (!file->data)
+    {
+        CloseHandle(file->mapping);
+        CloseHandle(file->file);
+        return 0;
+    }
+    file->size = (size_t)size.QuadPart;
+    return 1;
+#else
+    int fd = open(filename, O_RDONLY);
+    if (fd < 0)
+        return 0;
+    struct stat st;
+    if (fstat(fd, &st) != 0 || st.st_size <= 0)
+    {
+        close(fd);
+        return 0;
+    }
+    void* data = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    // the mapping stays valid without the descriptor
+    close(fd);
+    if (data == MAP_FAILED)
+        return 0;
+    file->data = data;
+    file->size = (size_t)st.st_size;
+    return 1;
+#endif // _WIN32
+}
+
+void _imgUnmapFile(_ImgFile* file)
+{
+#ifdef _WIN32
+    UnmapViewOfFile(file->data);
+    CloseHandle(file->mapping);
+    CloseHandle(file->file);
+#else
+    munmap((void*)file->data, file->size);
+#endif // _WIN32
+}
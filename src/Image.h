@@ -0,0 +1,93 @@
+#ifndef img_IMAGE_INCLUDED
+#define img_IMAGE_INCLUDED
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "List.h"
+#include "Program.h"
+#include "Runtime.h"
+#include "Stream.h"
+
+/**
+ * @brief saves the program and the modules it imports together with the
+ * global variables of runtime that ran it into image file, the image
+ * doesn't contain any addresses so
+ * it can be loaded by other process, the functions are saved as indices of
+ * their nodes, the builtins by their names and the heap objects reachable
+ * from the globals are saved once even if they are shared
+ *
+ * @param filename where to save the image
+ * @param p the program, all user defined functions and lazy values of the
+ * globals must come from it or from its modules
+ * @param r runtime created from the builtins that ran the program, it must
+ * not be evaluating
+ * @param builtins the builtins the runtime was created from
+ * @param messages where to print why the image couldn't be saved, may be NULL
+ * @return true the image was saved
+ * @return false some global cannot be saved or the file cannot be written
+ */
+_Bool imgSave(const char* filename, Program* p, Runtime* r, List builtins, Stream* messages);
+
+/**
+ * @brief maps image file and recreates its program and global variables,
+ * the program isn't run again so the cost doesn't depend on how long the
+ * program ran, only on the size of the image
+ *
+ * @param filename the image
+ * @param builtins the builtins the runtime was created from, the image
+ * refers to them by name
+ * @param r runtime created from the builtins, the globals of the image are
+ * set in it
+ * @param messages where to print why the image couldn't be loaded, may be NULL
+ * @return Program* the program of the image with the programs of its
+ * modules in imports, it must outlive the runtime, it shouldn't be run
+ * again and it is freed by imgFree, NULL if the image is damaged or isn't
+ * valid
+ */
+Program* imgLoad(const char* filename, List builtins, Runtime* r, Stream* messages);
+
+/**
+ * @brief frees program loaded by imgLoad together with its modules
+ *
+ * @param p the program
+ */
+void imgFree(Program* p);
+
+/**
+ * @brief saves only the program so that it can be loaded without
+ * compiling it again
+ *
+ * @param filename where to save the image
+ * @param p the program
+ * @param key identifies what the program was compiled from,
+ * imgLoadProgram loads the image only with the same key
+ * @param data any bytes stored with the program
+ * @return true the image was saved
+ * @return false the file cannot be written
+ */
+_Bool imgSaveProgram(const char* filename, Program* p, String key, String data);
+
+/**
+ * @brief loads program saved by imgSaveProgram
+ *
+ * @param filename the image
+ * @param key the key the program was saved with
+ * @param data set to copy of the bytes stored with the program if it was
+ * loaded, may be NULL
+ * @return Program* the program or NULL if the file doesn't exist, is
+ * damaged or has other key
+ */
+Program* imgLoadProgram(const char* filename, String key, String* data);
+
+/**
+ * @brief computes the checksum the images are checked with, it may also
+ * be used to compute their keys
+ *
+ * @param data the bytes
+ * @param length number of the bytes
+ * @return uint64_t the checksum
+ */
+uint64_t imgChecksum(const void* data, size_t length);
+
+#endif // img_IMAGE_INCLUDED
@@ -0,0 +1,1119 @@
+#ifndef _WIN32
+// MAP_ANONYMOUS isn't part of the older POSIX
+#define _DEFAULT_SOURCE
+#endif // _WIN32
+
+#include "Jit.h"
+
+#include <assert.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#ifndef MAP_ANONYMOUS
+#define MAP_ANONYMOUS MAP_ANON
+#endif // MAP_ANONYMOUS
+#endif // _WIN32
+
+#include "BuiltinFunctions.h"
+#include "Evaluator.h"
+#include "List.h"
+#include "StringBuilder.h"
+
+#if defined(__x86_64__) || defined(_M_X64)
+#define _JIT_X64
+#endif
+
+/**
+ * @brief static type of value computed by compiled code, all values are
+ * kept in rax as 64 bit integers
+ *
+ */
+typedef enum _JitType
+{
+    // result of recursive call while the type of the function isn't known
+    _JIT_UNKNOWN,
+    _JIT_INT,
+    // 0 or 1
+    _JIT_BOOL,
+} _JitType;
+
+/**
+ * @brief builtins computed directly by the code
+ *
+ */
+typedef enum _JitOperator
+{
+    _JIT_ADD,
+    _JIT_SUBTRACT,
+    _JIT_MULTIPLY,
+    _JIT_DIVIDE,
+    _JIT_MOD,
+    _JIT_EQUAL,
+    _JIT_LESS,
+    _JIT_LESS_EQUAL,
+    _JIT_GREATER,
+    _JIT_GREATER_EQUAL,
+    // not an operator
+    _JIT_NONE,
+} _JitOperator;
+
+/**
+ * @brief global function called by the code, the code runs only while
+ * the name has the same function
+ *
+ */
+typedef struct _JitDep
+{
+    // identifier with the name
+    const ParserNode* node;
+    // action of builtin, evRunFunction for user function
+    Action action;
+    // layout of user function, NULL for builtin
+    FrameLayout* frame;
+} _JitDep;
+
+/**
+ * @brief machine code of function definition, the memory starts with the
+ * entry called from C, then the code that bails out and then the body
+ * called by the compiled functions
+ *
+ */
+typedef struct JitCode
+{
+    void* memory;
+    size_t size;
+    // offset of the body in the memory
+    size_t body;
+    _JitType type;
+    size_t argc;
+    // the global functions called by the code and by the compiled functions
+    // it calls, List of _JitDep
+    List deps;
+    unsigned bailouts;
+} JitCode;
+
+/**
+ * @brief entry of compiled function, the callee saved registers are
+ * restored also when the code bails out
+ *
+ */
+typedef _Bool (*_JitEntry)(const long long* args, long long* res, size_t depth);
+
+/**
+ * @brief state of the compilation of single function
+ *
+ */
+typedef struct _JitCompiler
+{
+    // the machine code of the entry, the bailout and the body
+    StringBuilder code;
+    Runtime* r;
+    // layout of the compiled function, its calls are recursive
+    FrameLayout* frame;
+    size_t argc;
+    // type of the result of the function, unknown in the first pass
+    _JitType self;
+    // List of _JitDep
+    List deps;
+    // offset of the code that bails out
+    size_t bail;
+    // offset of the body
+    size_t body;
+    // offset after the prologue of the body, tail calls jump there
+    size_t start;
+    // nesting of the expression being compiled
+    size_t depth;
+    _Bool failed;
+    // the function may be compiled later, some global it calls doesn't
+    // exist yet or other function it calls is being compiled
+    _Bool retry;
+} _JitCompiler;
+
+/**
+ * @brief returns the code of the function, compiles it if it wasn't
+ * compiled yet
+ *
+ * @param frame layout of the function
+ * @param body body of the function
+ * @param argc number of the parameters
+ * @param r runtime that finds the globals
+ * @param retry set to true if the function may be compiled later
+ * @return JitCode* the code or NULL if it cannot be compiled now
+ */
+JitCode* _jitReady(FrameLayout* frame, ParserNode* body, size_t argc, Runtime* r, _Bool* retry);
+
+/**
+ * @brief compiles function in two passes, the first one finds the type of
+ * its result and the second one writes the code
+ *
+ * @param frame layout of the function
+ * @param body body of the function
+ * @param argc number of the parameters
+ * @param r runtime that finds the globals
+ * @param retry set to true if the function may be compiled later
+ * @return JitCode* the code or NULL if it cannot be compiled
+ */
+JitCode* _jitCompile(FrameLayout* frame, ParserNode* body, size_t argc, Runtime* r, _Bool* retry);
+
+/**
+ * @brief writes the entry, the bailout and the body of the function
+ *
+ * @param c the compiler
+ * @param body body of the function
+ * @return _JitType type of the result
+ */
+_JitType _jitFunction(_JitCompiler* c, ParserNode* body);
+
+/**
+ * @brief compiles expression, the code leaves its value in rax
+ *
+ * @param c the compiler
+ * @param n the expression
+ * @param tail true if the value is the result of the function
+ * @return _JitType type of the value
+ */
+_JitType _jitNode(_JitCompiler* c, ParserNode* n, _Bool tail);
+
+/**
+ * @brief compiles if, and, or and cond, when no value is selected the code
+ * bails out because the result is nothing
+ *
+ * @param c the compiler
+ * @param n the special form
+ * @param tail true if the value is the result of the function
+ * @return _JitType type of the value
+ */
+_JitType _jitBranch(_JitCompiler* c, ParserNode* n, _Bool tail);
+
+/**
+ * @brief compiles function call
+ *
+ * @param c the compiler
+ * @param n the call
+ * @param tail true if the value is the result of the function
+ * @return _JitType type of the result
+ */
+_JitType _jitCall(_JitCompiler* c, ParserNode* n, _Bool tail);
+
+/**
+ * @brief compiles call of arithmetic or comparison builtin
+ *
+ * @param c the compiler
+ * @param n the call
+ * @param op the builtin
+ * @return _JitType type of the result
+ */
+_JitType _jitOperator(_JitCompiler* c, ParserNode* n, _JitOperator op);
+
+/**
+ * @brief compiles two operands, the code leaves the first in rax and the
+ * second in rcx
+ *
+ * @param c the compiler
+ * @param n the call with the operands
+ * @param types set to the types of the operands
+ */
+void _jitOperands(_JitCompiler* c, ParserNode* n, _JitType* types);
+
+/**
+ * @brief finds which builtin the code computes directly
+ *
+ * @param action action of the builtin
+ * @return _JitOperator the builtin or _JIT_NONE
+ */
+_JitOperator _jitOperatorOf(Action action);
+
+/**
+ * @brief joins types of values that may be the same result
+ *
+ * @param c the compiler, fails if the types differ
+ * @param a type of the first value
+ * @param b type of the second value
+ * @return _JitType the joined type
+ */
+_JitType _jitJoin(_JitCompiler* c, _JitType a, _JitType b);
+
+/**
+ * @brief checks that value has the type, unknown type is accepted
+ *
+ * @param c the compiler, fails if the type is different
+ * @param type type of the value
+ * @param expected the required type
+ */
+void _jitExpect(_JitCompiler* c, _JitType type, _JitType expected);
+
+/**
+ * @brief adds global function to the dependencies of the code
+ *
+ * @param c the compiler
+ * @param node the identifier
+ * @param action action of the function
+ * @param frame layout of user function, NULL for builtin
+ */
+void _jitDepend(_JitCompiler* c, const ParserNode* node, Action action, FrameLayout* frame);
+
+/**
+ * @brief checks that the global functions are the same as when the code
+ * was compiled
+ *
+ * @param code the code
+ * @param r runtime context
+ * @return true the code may run
+ * @return false some name was redefined
+ */
+_Bool _jitCheck(JitCode* code, Runtime* r);
+
+/**
+ * @brief counts bailout and disables the code if there are too many of them
+ *
+ * @param frame layout of the function
+ * @param code the code
+ */
+void _jitBailout(FrameLayout* frame, JitCode* code);
+
+/**
+ * @brief appends machine code
+ *
+ * @param c the compiler
+ * @param bytes the instructions
+ * @param length number of the bytes
+ */
+void _jitEmit(_JitCompiler* c, const char* bytes, size_t length);
+
+/**
+ * @brief appends little endian 32 bit value
+ *
+ * @param c the compiler
+ * @param v the value
+ */
+void _jitImm32(_JitCompiler* c, uint32_t v);
+
+/**
+ * @brief appends little endian 64 bit value
+ *
+ * @param c the compiler
+ * @param v the value
+ */
+void _jitImm64(_JitCompiler* c, uint64_t v);
+
+/**
+ * @brief appends instruction with 8 or 32 bit displacement, the short
+ * form is used when the displacement fits
+ *
+ * @param c the compiler
+ * @param op the instruction without the ModRM byte
+ * @param length number of the bytes of op
+ * @param modrm ModRM byte of the short form, the long form has mod 10
+ * @param disp the displacement
+ */
+void _jitDisp(_JitCompiler* c, const char* op, size_t length, unsigned char modrm, size_t disp);
+
+/**
+ * @brief appends jump with 32 bit relative target
+ *
+ * @param c the compiler
+ * @param op the instruction without the target
+ * @param length number of the bytes of op
+ * @return size_t offset of the target, it is set by _jitPatch
+ */
+size_t _jitJump(_JitCompiler* c, const char* op, size_t length);
+
+/**
+ * @brief sets target of jump
+ *
+ * @param c the compiler
+ * @param at offset of the target returned by _jitJump
+ * @param target offset of the target
+ */
+void _jitPatch(_JitCompiler* c, size_t at, size_t target);
+
+/**
+ * @brief appends jump to the code that bails out
+ *
+ * @param c the compiler
+ * @param op the instruction without the target
+ * @param length number of the bytes of op
+ */
+void _jitBail(_JitCompiler* c, const char* op, size_t length);
+
+/**
+ * @brief appends rax = [rbp + disp] for parameter
+ *
+ * @param c the compiler
+ * @param index index of the parameter
+ */
+void _jitParameter(_JitCompiler* c, size_t index);
+
+/**
+ * @brief copies the code into executable memory
+ *
+ * @param c the compiler
+ * @param size set to the size of the memory
+ * @return void* the memory or NULL if it cannot be allocated
+ */
+void* _jitMap(_JitCompiler* c, size_t* size);
+
+/**
+ * @brief frees executable memory
+ *
+ * @param memory the memory
+ * @param size size of the memory
+ */
+void _jitUnmap(void* memory, size_t size);
+
+_Bool jitEnter(Function* f, Runtime* r, Variable* args, size_t argc, Variable* res)
+{
+    if (!r->jit || !f->frame || !f->body || argc > jit_MAX_ARGS)
+        return 0;
+
+    // runtimes that share the tree compile the function at most once
+    FrameLayout* frame = f->frame;
+    int state = __atomic_load_n(&frame->jit, __ATOMIC_ACQUIRE);
+    if (state == JIT_INTERPRETED)
+    {
+        if (__atomic_add_fetch(&frame->calls, 1, __ATOMIC_RELAXED) < jit_THRESHOLD)
+            return 0;
+        _Bool retry;
+        _jitReady(frame, f->body, argc, r, &retry);
+        state = __atomic_load_n(&frame->jit, __ATOMIC_ACQUIRE);
+    }
+    if (state != JIT_COMPILED)
+        return 0;
+
+    // the type guard of the arguments doesn't count as bailout, the code
+    // runs again once the arguments are ints
+    long long values[jit_MAX_ARGS];
+    for (size_t i = 0; i < argc; i++)
+    {
+        if (args[i].type != V_INT)
+            return 0;
+        values[i] = args[i].integer;
+    }
+
+    JitCode* code = frame->code;
+    long long out;
+    if (!_jitCheck(code, r) || !((_JitEntry)code->memory)(values, &out, jit_MAX_DEPTH))
+    {
+        _jitBailout(frame, code);
+        return 0;
+    }
+
+    *res = code->type == _JIT_BOOL ? rtBoolVariable(out != 0) : rtIntVariable(out);
+    return 1;
+}
+
+void jitFree(FrameLayout* frame)
+{
+    JitCode* code = frame->code;
+    if (!code)
+        return;
+    _jitUnmap(code->memory, code->size);
+    listFree(code->deps);
+    free(code);
+    frame->code = NULL;
+}
+
+JitCode* _jitReady(FrameLayout* frame, ParserNode* body, size_t argc, Runtime* r, _Bool* retry)
+{
+    *retry = 0;
+    int state = __atomic_load_n(&frame->jit, __ATOMIC_ACQUIRE);
+    int expected = JIT_INTERPRETED;
+    if (state == JIT_INTERPRETED
+        && !__atomic_compare_exchange_n(&frame->jit, &expected, JIT_COMPILING, 0, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE))
+    {
+        state = expected;
+    }
+
+    switch (state)
+    {
+    case JIT_INTERPRETED:
+        break;
+    // disabled code is still called by the other compiled functions
+    case JIT_COMPILED:
+    case JIT_DISABLED:
+        return frame->code;
+    case JIT_COMPILING:
+        *retry = 1;
+        return NULL;
+    default:
+        return NULL;
+    }
+
+    JitCode* code = _jitCompile(frame, body, argc, r, retry);
+    if (code)
+    {
+        frame->code = code;
+        __atomic_store_n(&frame->jit, JIT_COMPILED, __ATOMIC_RELEASE);
+        return code;
+    }
+    if (*retry)
+    {
+        __atomic_store_n(&frame->calls, 0, __ATOMIC_RELAXED);
+        __atomic_store_n(&frame->jit, JIT_INTERPRETED, __ATOMIC_RELEASE);
+    }
+    else
+        __atomic_store_n(&frame->jit, JIT_FAILED, __ATOMIC_RELEASE);
+    return NULL;
+}
+
+JitCode* _jitCompile(FrameLayout* frame, ParserNode* body, size_t argc, Runtime* r, _Bool* retry)
+{
+#ifndef _JIT_X64
+    // the templates are x86-64 instructions
+    return NULL;
+#endif // _JIT_X64
+
+    _JitCompiler c =
+    {
+        .code = sbCreate(),
+        .r = r,
+        .frame = frame,
+        .argc = argc,
+        .self = _JIT_UNKNOWN,
+        .deps = listNew(_JitDep),
+    };
+
+    // the recursive calls have unknown type until the first pass finds
+    // the type from the other values of the function
+    _JitType type = _jitFunction(&c, body);
+    if (!c.failed && type != _JIT_UNKNOWN)
+    {
+        c.self = type;
+        c.deps.length = 0;
+        c.failed = type != _jitFunction(&c, body) || c.failed;
+    }
+    else
+        c.failed = 1;
+
+    JitCode* code = NULL;
+    size_t size;
+    void* memory = c.failed ? NULL : _jitMap(&c, &size);
+    if (memory)
+    {
+        code = malloc(sizeof(JitCode));
+        assert(code);
+        *code = (JitCode)
+        {
+            .memory = memory,
+            .size = size,
+            .body = c.body,
+            .type = type,
+            .argc = argc,
+            .deps = c.deps,
+            .bailouts = 0,
+        };
+    }
+    else
+        listFree(c.deps);
+
+    *retry = c.retry;
+    sbFree(&c.code);
+    return code;
+}
+
+_JitType _jitFunction(_JitCompiler* c, ParserNode* body)
+{
+    sbClear(&c->code);
+
+    // entry: saves the registers the code uses, r12 is the depth that
+    // is left, r13 the stack to which the code returns when it bails out
+    // and r14 where to store the result, the arguments are pushed like
+    // the compiled calls push them
+    _jitEmit(c, "\x55\x41\x54\x41\x55\x41\x56", 7);
+#ifdef _WIN32
+    // mov r12, r8; mov r14, rdx
+    _jitEmit(c, "\x4D\x89\xC4\x49\x89\xD6", 6);
+    const unsigned char args = 0x71;
+#else
+    // mov r12, rdx; mov r14, rsi
+    _jitEmit(c, "\x49\x89\xD4\x49\x89\xF6", 6);
+    const unsigned char args = 0x77;
+#endif // _WIN32
+    // mov r13, rsp
+    _jitEmit(c, "\x49\x89\xE5", 3);
+    for (size_t i = 0; i < c->argc; i++)
+        _jitDisp(c, "\xFF", 1, args, i * 8);
+    size_t call = _jitJump(c, "\xE8", 1);
+    // mov [r14], rax; mov eax, 1; jmp to the restoring of the registers
+    _jitEmit(c, "\x49\x89\x06\xB8\x01\x00\x00\x00\xEB\x02", 10);
+
+    // bailout: xor eax, eax; then restores the registers and returns
+    c->bail = c->code.length;
+    _jitEmit(c, "\x31\xC0", 2);
+    _jitEmit(c, "\x4C\x89\xEC\x41\x5E\x41\x5D\x41\x5C\x5D\xC3", 11);
+
+    // body: push rbp; mov rbp, rsp; dec r12; jz bail
+    c->body = c->code.length;
+    _jitPatch(c, call, c->body);
+    _jitEmit(c, "\x55\x48\x89\xE5\x49\xFF\xCC", 7);
+    _jitBail(c, "\x0F\x84", 2);
+    c->start = c->code.length;
+    c->depth = 0;
+    _JitType type = _jitNode(c, body, 1);
+    // inc r12; leave; ret
+    _jitEmit(c, "\x49\xFF\xC4\xC9\xC3", 5);
+    return type;
+}
+
+_JitType _jitNode(_JitCompiler* c, ParserNode* n, _Bool tail)
+{
+    if (c->failed)
+        return _JIT_UNKNOWN;
+    if (++c->depth > jit_MAX_NESTING)
+    {
+        c->failed = 1;
+        c->depth--;
+        return _JIT_UNKNOWN;
+    }
+
+    _JitType type = _JIT_UNKNOWN;
+    switch (n->type)
+    {
+    case P_VALUE_INTEGER:
+    {
+        long long v = n->value->integer;
+        if (v >= INT32_MIN && v <= INT32_MAX)
+        {
+            // mov rax, imm32
+            _jitEmit(c, "\x48\xC7\xC0", 3);
+            _jitImm32(c, (uint32_t)v);
+        }
+        else
+        {
+            // mov rax, imm64
+            _jitEmit(c, "\x48\xB8", 2);
+            _jitImm64(c, (uint64_t)v);
+        }
+        type = _JIT_INT;
+        break;
+    }
+    case P_VALUE_BOOL:
+        // mov eax, imm32
+        _jitEmit(c, "\xB8", 1);
+        _jitImm32(c, n->value->boolean != 0);
+        type = _JIT_BOOL;
+        break;
+    case P_IDENTIFIER:
+        // only the parameters are read, the entry checks that they are ints
+        if (n->slot.type != S_LOCAL || n->slot.index >= c->argc)
+        {
+            c->failed = 1;
+            break;
+        }
+        _jitParameter(c, n->slot.index);
+        type = _JIT_INT;
+        break;
+    case P_IF:
+    case P_AND:
+    case P_OR:
+    case P_COND:
+        type = _jitBranch(c, n, tail);
+        break;
+    case P_FUNCTION_CALL:
+        type = _jitCall(c, n, tail);
+        break;
+    default:
+        // other values are on the heap or have side effects
+        c->failed = 1;
+        break;
+    }
+
+    c->depth--;
+    return type;
+}
+
+_JitType _jitBranch(_JitCompiler* c, ParserNode* n, _Bool tail)
+{
+    size_t count = n->nodes.length;
+    // [and] and [or] are bools, [cond] is nothing
+    if (count == 0)
+    {
+        if (n->type == P_COND)
+        {
+            _jitBail(c, "\xE9", 1);
+            return _JIT_UNKNOWN;
+        }
+        _jitEmit(c, "\xB8", 1);
+        _jitImm32(c, n->type == P_AND);
+        return _JIT_BOOL;
+    }
+
+    // the jumps to the end of the form
+    List ends = listNew(size_t);
+    _JitType type = _JIT_UNKNOWN;
+    if (n->type == P_IF)
+    {
+        // ints are always true
+        _JitType cond = _jitNode(c, listGetP(n->nodes, 0), 0);
+        size_t other = 0;
+        if (cond != _JIT_INT)
+        {
+            // test rax, rax; jz other
+            _jitEmit(c, "\x48\x85\xC0", 3);
+            other = _jitJump(c, "\x0F\x84", 2);
+        }
+        type = _jitNode(c, listGetP(n->nodes, 1), tail);
+        size_t end = _jitJump(c, "\xE9", 1);
+        listAdd(ends, end, size_t);
+        if (cond != _JIT_INT)
+            _jitPatch(c, other, c->code.length);
+        if (count < 3)
+            _jitBail(c, "\xE9", 1);
+        else
+            type = _jitJoin(c, type, _jitNode(c, listGetP(n->nodes, 2), tail));
+    }
+    else if (n->type == P_AND || n->type == P_OR)
+    {
+        // the value that decides the result is the result, the last value
+        // is the result too
+        for (size_t i = 0; i < count; i++)
+        {
+            _Bool last = i + 1 == count;
+            _JitType t = _jitNode(c, listGetP(n->nodes, i), tail && last);
+            type = _jitJoin(c, type, t);
+            if (last)
+                break;
+            if (t == _JIT_INT)
+            {
+                // ints are true, [or] ends and [and] continues
+                if (n->type == P_OR)
+                    listAdd(ends, _jitJump(c, "\xE9", 1), size_t);
+                continue;
+            }
+            // test rax, rax; jz or jnz end
+            _jitEmit(c, "\x48\x85\xC0", 3);
+            listAdd(ends, _jitJump(c, n->type == P_AND ? "\x0F\x84" : "\x0F\x85", 2), size_t);
+        }
+    }
+    else
+    {
+        // the childs are the conditions and the values of the clauses
+        for (size_t i = 0; i + 1 < count; i += 2)
+        {
+            _JitType cond = _jitNode(c, listGetP(n->nodes, i), 0);
+            size_t next = 0;
+            if (cond != _JIT_INT)
+            {
+                _jitEmit(c, "\x48\x85\xC0", 3);
+                next = _jitJump(c, "\x0F\x84", 2);
+            }
+            type = _jitJoin(c, type, _jitNode(c, listGetP(n->nodes, i + 1), tail));
+            listAdd(ends, _jitJump(c, "\xE9", 1), size_t);
+            if (cond != _JIT_INT)
+                _jitPatch(c, next, c->code.length);
+        }
+        // no clause was selected so the result is nothing
+        _jitBail(c, "\xE9", 1);
+    }
+
+    for (size_t i = 0; i < ends.length; i++)
+        _jitPatch(c, listGet(ends, i, size_t), c->code.length);
+    listFree(ends);
+    return type;
+}
+
+_JitType _jitCall(_JitCompiler* c, ParserNode* n, _Bool tail)
+{
+    assert(n->nodes.length > 0);
+
+    // the code calls only global functions that it can check before it runs
+    ParserNode* head = listGetP(n->nodes, 0);
+    if (head->type != P_IDENTIFIER || head->slot.type != S_GLOBAL)
+    {
+        c->failed = 1;
+        return _JIT_UNKNOWN;
+    }
+    Variable* v = rtFindGlobal(c->r, head);
+    if (!v)
+    {
+        // the function may be defined later
+        c->failed = 1;
+        c->retry = 1;
+        return _JIT_UNKNOWN;
+    }
+    if (v->type != V_FUNCTION)
+    {
+        c->failed = 1;
+        return _JIT_UNKNOWN;
+    }
+
+    Function f = v->function;
+    if (f.action != evRunFunction)
+    {
+        _JitOperator op = _jitOperatorOf(f.action);
+        if (op == _JIT_NONE)
+        {
+            c->failed = 1;
+            return _JIT_UNKNOWN;
+        }
+        _jitDepend(c, head, f.action, NULL);
+        return _jitOperator(c, n, op);
+    }
+
+    // memoized function must use its cache
+    size_t argc = n->nodes.length - 1;
+    if (f.memo || !f.frame || argc != f.parameters.length)
+    {
+        c->failed = 1;
+        return _JIT_UNKNOWN;
+    }
+
+    _Bool self = f.frame == c->frame;
+    _JitType type = c->self;
+    void* target = NULL;
+    if (!self)
+    {
+        _Bool retry;
+        JitCode* callee = _jitReady(f.frame, f.body, argc, c->r, &retry);
+        if (!callee)
+        {
+            c->failed = 1;
+            c->retry |= retry;
+            return _JIT_UNKNOWN;
+        }
+        type = callee->type;
+        target = (char*)callee->memory + callee->body;
+        for (size_t i = 0; i < callee->deps.length; i++)
+        {
+            _JitDep* d = listGetP(callee->deps, i);
+            _jitDepend(c, d->node, d->action, d->frame);
+        }
+    }
+    _jitDepend(c, head, evRunFunction, f.frame);
+
+    // the arguments are pushed from the first to the last
+    for (size_t i = 1; i <= argc; i++)
+    {
+        _jitExpect(c, _jitNode(c, listGetP(n->nodes, i), 0), _JIT_INT);
+        _jitEmit(c, "\x50", 1);
+    }
+
+    // tail call of the function itself replaces the parameters and jumps
+    // to the start of the body, nothing else is on the stack
+    if (tail && self)
+    {
+        for (size_t i = argc; i > 0; i--)
+        {
+            // pop rax; mov [rbp + disp], rax
+            _jitEmit(c, "\x58", 1);
+            _jitDisp(c, "\x48\x89", 2, 0x45, 16 + (c->argc - i) * 8);
+        }
+        size_t start = _jitJump(c, "\xE9", 1);
+        _jitPatch(c, start, c->start);
+        return type;
+    }
+
+    if (self)
+        _jitPatch(c, _jitJump(c, "\xE8", 1), c->body);
+    else
+    {
+        // mov rax, imm64; call rax
+        _jitEmit(c, "\x48\xB8", 2);
+        _jitImm64(c, (uint64_t)(uintptr_t)target);
+        _jitEmit(c, "\xFF\xD0", 2);
+    }
+    if (argc)
+    {
+        // add rsp, imm32
+        _jitEmit(c, "\x48\x81\xC4", 3);
+        _jitImm32(c, (uint32_t)(argc * 8));
+    }
+    return type;
+}
+
+_JitType _jitOperator(_JitCompiler* c, ParserNode* n, _JitOperator op)
+{
+    // setl, setle, setg, setge and sete of the comparisons
+    static const char* const conditions[] =
+    {
+        [_JIT_EQUAL] = "\x0F\x94\xC0",
+        [_JIT_LESS] = "\x0F\x9C\xC0",
+        [_JIT_LESS_EQUAL] = "\x0F\x9E\xC0",
+        [_JIT_GREATER] = "\x0F\x9F\xC0",
+        [_JIT_GREATER_EQUAL] = "\x0F\x9D\xC0",
+    };
+
+    size_t argc = n->nodes.length - 1;
+    _JitType types[2];
+    switch (op)
+    {
+    case _JIT_ADD:
+    case _JIT_MULTIPLY:
+        // overflowing ints become bigints in the builtin, the code bails out
+        if (argc == 0)
+            break;
+        _jitExpect(c, _jitNode(c, listGetP(n->nodes, 1), 0), _JIT_INT);
+        for (size_t i = 2; i <= argc; i++)
+        {
+            // push rax; (the operand); mov rcx, rax; pop rax
+            _jitEmit(c, "\x50", 1);
+            _jitExpect(c, _jitNode(c, listGetP(n->nodes, i), 0), _JIT_INT);
+            _jitEmit(c, "\x48\x89\xC1\x58", 4);
+            // add rax, rcx or imul rax, rcx; jo bail
+            if (op == _JIT_ADD)
+                _jitEmit(c, "\x48\x01\xC8", 3);
+            else
+                _jitEmit(c, "\x48\x0F\xAF\xC1", 4);
+            _jitBail(c, "\x0F\x80", 2);
+        }
+        return _JIT_INT;
+    case _JIT_SUBTRACT:
+        if (argc == 1)
+        {
+            // neg rax; jo bail
+            _jitExpect(c, _jitNode(c, listGetP(n->nodes, 1), 0), _JIT_INT);
+            _jitEmit(c, "\x48\xF7\xD8", 3);
+            _jitBail(c, "\x0F\x80", 2);
+            return _JIT_INT;
+        }
+        if (argc != 2)
+            break;
+        _jitOperands(c, n, types);
+        _jitExpect(c, types[0], _JIT_INT);
+        _jitExpect(c, types[1], _JIT_INT);
+        // sub rax, rcx; jo bail
+        _jitEmit(c, "\x48\x29\xC8", 3);
+        _jitBail(c, "\x0F\x80", 2);
+        return _JIT_INT;
+    case _JIT_DIVIDE:
+    case _JIT_MOD:
+    {
+        if (argc != 2)
+            break;
+        _jitOperands(c, n, types);
+        _jitExpect(c, types[0], _JIT_INT);
+        _jitExpect(c, types[1], _JIT_INT);
+        // division by zero is exception: test rcx, rcx; jz bail
+        _jitEmit(c, "\x48\x85\xC9", 3);
+        _jitBail(c, "\x0F\x84", 2);
+        // idiv faults on the min int divided by -1: cmp rcx, -1; je minus
+        _jitEmit(c, "\x48\x83\xF9\xFF", 4);
+        size_t minus = _jitJump(c, "\x0F\x84", 2);
+        // cqo; idiv rcx; the remainder is in rdx
+        _jitEmit(c, "\x48\x99\x48\xF7\xF9", 5);
+        if (op == _JIT_MOD)
+            _jitEmit(c, "\x48\x89\xD0", 3);
+        size_t end = _jitJump(c, "\xE9", 1);
+        _jitPatch(c, minus, c->code.length);
+        if (op == _JIT_MOD)
+            _jitEmit(c, "\x31\xC0", 2);
+        else
+        {
+            // neg rax; jo bail
+            _jitEmit(c, "\x48\xF7\xD8", 3);
+            _jitBail(c, "\x0F\x80", 2);
+        }
+        _jitPatch(c, end, c->code.length);
+        return _JIT_INT;
+    }
+    default:
+        // the comparisons compare bools as 0 and 1 like the builtins do
+        if (argc != 2)
+            break;
+        _jitOperands(c, n, types);
+        // cmp rax, rcx; setcc al; movzx eax, al
+        _jitEmit(c, "\x48\x39\xC8", 3);
+        _jitEmit(c, conditions[op], 3);
+        _jitEmit(c, "\x0F\xB6\xC0", 3);
+        return _JIT_BOOL;
+    }
+
+    // the builtin returns error or value of other type
+    c->failed = 1;
+    return _JIT_UNKNOWN;
+}
+
+void _jitOperands(_JitCompiler* c, ParserNode* n, _JitType* types)
+{
+    types[0] = _jitNode(c, listGetP(n->nodes, 1), 0);
+    _jitEmit(c, "\x50", 1);
+    types[1] = _jitNode(c, listGetP(n->nodes, 2), 0);
+    // mov rcx, rax; pop rax
+    _jitEmit(c, "\x48\x89\xC1\x58", 4);
+}
+
+_JitOperator _jitOperatorOf(Action action)
+{
+    static const struct
+    {
+        Action action;
+        _JitOperator op;
+    } operators[] =
+    {
+        { bifAdd, _JIT_ADD },
+        { bifSubtract, _JIT_SUBTRACT },
+        { bifMultiply, _JIT_MULTIPLY },
+        { bifDivide, _JIT_DIVIDE },
+        { bifMod, _JIT_MOD },
+        { bifEqual, _JIT_EQUAL },
+        { bifLess, _JIT_LESS },
+        { bifLessEqual, _JIT_LESS_EQUAL },
+        { bifGreater, _JIT_GREATER },
+        { bifGreaterEqual, _JIT_GREATER_EQUAL },
+    };
+
+    for (size_t i = 0; i < sizeof(operators) / sizeof(*operators); i++)
+    {
+        if (operators[i].action == action)
+            return operators[i].op;
+    }
+    return _JIT_NONE;
+}
+
+_JitType _jitJoin(_JitCompiler* c, _JitType a, _JitType b)
+{
+    if (a == _JIT_UNKNOWN)
+        return b;
+    if (b != _JIT_UNKNOWN && a != b)
+        c->failed = 1;
+    return a;
+}
+
+void _jitExpect(_JitCompiler* c, _JitType type, _JitType expected)
+{
+    if (type != _JIT_UNKNOWN && type != expected)
+        c->failed = 1;
+}
+
+void _jitDepend(_JitCompiler* c, const ParserNode* node, Action action, FrameLayout* frame)
+{
+    // all identifiers with the same name find the same global
+    String name = node->token->string;
+    for (size_t i = 0; i < c->deps.length; i++)
+    {
+        String other = listGet(c->deps, i, _JitDep).node->token->string;
+        if (other.length == name.length && memcmp(other.c, name.c, name.length) == 0)
+            return;
+    }
+    _JitDep d = { .node = node, .action = action, .frame = frame };
+    listAddP(&c->deps, &d);
+}
+
+_Bool _jitCheck(JitCode* code, Runtime* r)
+{
+    for (size_t i = 0; i < code->deps.length; i++)
+    {
+        _JitDep* d = listGetP(code->deps, i);
+        Variable* v = rtFindGlobal(r, d->node);
+        if (!v || v->type != V_FUNCTION || v->function.action != d->action)
+            return 0;
+        if (d->frame && (v->function.frame != d->frame || v->function.memo))
+            return 0;
+    }
+    return 1;
+}
+
+void _jitBailout(FrameLayout* frame, JitCode* code)
+{
+    if (__atomic_add_fetch(&code->bailouts, 1, __ATOMIC_RELAXED) < jit_MAX_BAILOUTS)
+        return;
+    int expected = JIT_COMPILED;
+    __atomic_compare_exchange_n(&frame->jit, &expected, JIT_DISABLED, 0, __ATOMIC_RELAXED, __ATOMIC_RELAXED);
+}
+
+void _jitEmit(_JitCompiler* c, const char* bytes, size_t length)
+{
+    sbAppendL(&c->code, bytes, length);
+}
+
+void _jitImm32(_JitCompiler* c, uint32_t v)
+{
+    char bytes[4];
+    for (size_t i = 0; i < 4; i++)
+        bytes[i] = (char)(v >> (i * 8));
+    _jitEmit(c, bytes, 4);
+}
+
+void _jitImm64(_JitCompiler* c, uint64_t v)
+{
+    _jitImm32(c, (uint32_t)v);
+    _jitImm32(c, (uint32_t)(v >> 32));
+}
+
+void _jitDisp(_JitCompiler* c, const char* op, size_t length, unsigned char modrm, size_t disp)
+{
+    _jitEmit(c, op, length);
+    if (disp < 128)
+    {
+        sbAdd(&c->code, (char)modrm);
+        sbAdd(&c->code, (char)disp);
+        return;
+    }
+    // mod 01 becomes mod 10
+    sbAdd(&c->code, (char)((modrm & 0x3F) | 0x80));
+    _jitImm32(c, (uint32_t)disp);
+}
+
+size_t _jitJump(_JitCompiler* c, const char* op, size_t length)
+{
+    _jitEmit(c, op, length);
+    size_t at = c->code.length;
+    _jitImm32(c, 0);
+    return at;
+}
+
+void _jitPatch(_JitCompiler* c, size_t at, size_t target)
+{
+    uint32_t rel = (uint32_t)(target - (at + 4));
+    for (size_t i = 0; i < 4; i++)
+        c->code.buffer[at + i] = (char)(rel >> (i * 8));
+}
+
+void _jitBail(_JitCompiler* c, const char* op, size_t length)
+{
+    _jitPatch(c, _jitJump(c, op, length), c->bail);
+}
+
+void _jitParameter(_JitCompiler* c, size_t index)
+{
+    // the first argument was pushed first so it is the farthest from rbp,
+    // above rbp are the saved rbp and the return address
+    size_t disp = 16 + (c->argc - 1 - index) * 8;
+    // mov rax, [rbp + disp]
+    _jitDisp(c, "\x48\x8B", 2, 0x45, disp);
+}
+
+void* _jitMap(_JitCompiler* c, size_t* size)
+{
+    *size = c->code.length;
+#ifdef _WIN32
+    void* memory = VirtualAlloc(NULL, *size, MEM_COMMIT | MEM_RESERVE, PAGE_READWRITE);
+    if (!memory)
+        return NULL;
+    memcpy(memory, c->code.buffer, *size);
+    DWORD old;
+    if (!VirtualProtect(memory, *size, PAGE_EXECUTE_READ, &old))
+    {
+        VirtualFree(memory, 0, MEM_RELEASE);
+        return NULL;
+    }
+    FlushInstructionCache(GetCurrentProcess(), memory, *size);
+    return memory;
+#else
+    // the memory is never writable and executable at the same time
+    void* memory = mmap(NULL, *size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (memory == MAP_FAILED)
+        return NULL;
+    memcpy(memory, c->code.buffer, *size);
+    if (mprotect(memory, *size, PROT_READ | PROT_EXEC) != 0)
+    {
+        munmap(memory, *size);
+        return NULL;
+    }
+    return memory;
+#endif // _WIN32
+}
+
+void _jitUnmap(void* memory, size_t size)
+{
+#ifdef _WIN32
+    VirtualFree(memory, 0, MEM_RELEASE);
+#else
+    munmap(memory, size);
+#endif // _WIN32
+}
@@ -0,0 +1,84 @@
+#ifndef jit_JIT_INCLUDED
+#define jit_JIT_INCLUDED
+
+#include <stddef.h>
+
+#include "ParserTree.h"
+#include "Runtime.h"
+
+#ifndef jit_THRESHOLD
+// number of calls of function after which it is compiled to machine code
+#define jit_THRESHOLD 1000
+#endif // jit_THRESHOLD
+
+#ifndef jit_MAX_BAILOUTS
+// after this many bailouts the function runs only in the interpreter
+#define jit_MAX_BAILOUTS 16
+#endif // jit_MAX_BAILOUTS
+
+#ifndef jit_MAX_DEPTH
+// maximum number of nested calls of compiled functions, deeper call bails
+// out and the interpreter runs the whole call again
+#define jit_MAX_DEPTH 4096
+#endif // jit_MAX_DEPTH
+
+#ifndef jit_MAX_NESTING
+// functions with more deeply nested expressions are not compiled
+#define jit_MAX_NESTING 100
+#endif // jit_MAX_NESTING
+
+#ifndef jit_MAX_ARGS
+// functions with more parameters are not compiled
+#define jit_MAX_ARGS 16
+#endif // jit_MAX_ARGS
+
+/**
+ * @brief state of function definition in FrameLayout.jit
+ *
+ */
+typedef enum JitState
+{
+    // the calls are counted until the function is compiled
+    JIT_INTERPRETED,
+    // some runtime compiles the function
+    JIT_COMPILING,
+    // the calls run the machine code
+    JIT_COMPILED,
+    // the function cannot be compiled
+    JIT_FAILED,
+    // the code bailed out too often, it is called only by other compiled
+    // functions
+    JIT_DISABLED,
+} JitState;
+
+/**
+ * @brief calls user function as machine code if it is hot, counts the call
+ * and compiles the function when it reaches jit_THRESHOLD calls,
+ * only bodies made of int and bool literals, parameters, if, and, or, cond,
+ * arithmetic and comparison builtins and calls of such functions trough
+ * their global names are compiled, the parameters are ints and the code
+ * doesn't touch the heap so it cannot have side effects,
+ * the code bails out when argument isn't int, global name used by the code
+ * was redefined, int overflows, int is divided by zero or the calls are
+ * nested too deeply, then this returns false and the interpreter runs
+ * the call from the start
+ *
+ * @param f the called function, not memoized
+ * @param r runtime context, the JIT is used only if r->jit is true
+ * @param args the arguments, they are not freed
+ * @param argc number of arguments, the same as the number of parameters
+ * @param res set to the result if the code ran
+ * @return true the code ran and res is its result
+ * @return false the interpreter must run the call
+ */
+_Bool jitEnter(Function* f, Runtime* r, Variable* args, size_t argc, Variable* res);
+
+/**
+ * @brief frees the machine code of function definition, the code must not
+ * run and no other compiled code may call it
+ *
+ * @param frame layout of the definition
+ */
+void jitFree(FrameLayout* frame);
+
+#endif // jit_JIT_INCLUDED
@@ -15,6 +15,7 @@
 #include "DebugTools.h"
 #include "Stream.h"
 #include "StringBuilder.h"
+#include "BigInt.h"
 
 #define _lexError(context, level, msg, help) listAdd((context)->err, errCreateErrorSpan(level, (context)->span, strLit(msg), strLit(help)), ErrorSpan)
 
@@ -136,9 +137,19 @@ _Bool _lexOnTNumber(_LexLContext* restrict llc);
  * 
  * @param llc context
  * @param num parsed number
- * @param overflow if overflow occured
  */
-void _lexOnTInt(_LexLContext* restrict llc, intmax_t num, _Bool overflow);
+void _lexOnTInt(_LexLContext* restrict llc, intmax_t num);
+
+/**
+ * @brief adds integer literal that overflowed while it was read, it is
+ * bigint literal unless it is the smallest int
+ * 
+ * @param llc context
+ * @param digits the digits without sign
+ * @param base base of the digits
+ * @param isNegative true if the number is negative
+ */
+void _lexOnTBigInt(_LexLContext* restrict llc, char* digits, intmax_t base, _Bool isNegative);
 
 /**
  * @brief adds float literal token
@@ -420,8 +431,9 @@ List lexLex(Stream* in, List* errors, String* filename)
         }
     }
 
+    // the spans are already read so the error points to the last token
     if (llc->nest > 0)
-        listAdd(llc->err, errCreateErrorSpan(E_ERROR, fsCreate(strLit("]"), liGet(&llc->spans, FileSpan).pos), strLit("missing 1 or more closing brackets"), strLit("try adding ]")), ErrorSpan);
+        listAdd(llc->err, errCreateErrorSpan(E_ERROR, fsCreate(strLit("]"), listGet(llc->tokens, llc->tokens.length - 1, Token).pos), strLit("missing 1 or more closing brackets"), strLit("try adding ]")), ErrorSpan);
 
     // free the list of strings
     listFree(spans);
@@ -463,7 +475,9 @@ intmax_t _lexReadInt(char* str, char** endptr, intmax_t base, _Bool* overflow, s
     {
         if (num > INTMAX_MAX / base || (num == INTMAX_MAX / base && digit > INTMAX_MAX % base))
             ovfl = 1;
-        num = num * base + digit;
+        // the digits of too large number are read by _lexOnTBigInt
+        if (!ovfl)
+            num = num * base + digit;
     }
     if (endptr)
         *endptr = str;
@@ -615,7 +629,10 @@ _Bool _lexOnTNumber(_LexLContext* restrict llc)
     {
     // if it doesn't continue, it is integer
     case 0:
-        _lexOnTInt(llc, isNegative ? -num : num, overflow);
+        if (overflow)
+            _lexOnTBigInt(llc, llc->span.str.c + isNegative, 10, isNegative);
+        else
+            _lexOnTInt(llc, isNegative ? -num : num);
         return 1;
     // if there is . read decimal values
     case '.':
@@ -640,14 +657,31 @@ _Bool _lexOnTNumber(_LexLContext* restrict llc)
     }
 }
 
-void _lexOnTInt(_LexLContext* restrict llc, intmax_t num, _Bool overflow)
+void _lexOnTInt(_LexLContext* restrict llc, intmax_t num)
 {
     listAdd(llc->tokens, tokenInt(T_LITERAL_INTEGER, num, llc->span.pos), Token);
-    if (overflow)
+    fsFree(llc->span);
+}
+
+void _lexOnTBigInt(_LexLContext* restrict llc, char* digits, intmax_t base, _Bool isNegative)
+{
+    BigInt* b = bigParse(NULL, digits, base);
+    if (isNegative)
     {
-        _lexError(llc, E_WARNING, "number is too large", "make the number smaller or use defferent type");
-        return;
+        BigInt* negated = bigNegate(NULL, b);
+        gcFreeObject(&b->header);
+        b = negated;
     }
+
+    // the magnitude of the smallest int overflows but the int doesn't
+    long long num;
+    Token t;
+    if (bigToInt(b, &num))
+        t = tokenInt(T_LITERAL_INTEGER, num, llc->span.pos);
+    else
+        t = tokenStr(T_LITERAL_BIGINT, bigToString(b), llc->span.pos);
+    listAdd(llc->tokens, t, Token);
+    gcFreeObject(&b->header);
     fsFree(llc->span);
 }
 
@@ -699,8 +733,9 @@ void _lexOnTBase(_LexLContext* restrict llc, intmax_t base, char* c, _Bool isNeg
     }
 
     _Bool overflow = 0;
+    char* digits = c + 1;
 
-    intmax_t num = _lexReadInt(c + 1, &c, base, &overflow, NULL);
+    intmax_t num = _lexReadInt(digits, &c, base, &overflow, NULL);
     
     if (*c)
     {
@@ -708,12 +743,12 @@ void _lexOnTBase(_LexLContext* restrict llc, intmax_t base, char* c, _Bool isNeg
         return;
     }
 
-    listAdd(llc->tokens, tokenInt(T_LITERAL_INTEGER, isNegative ? -num : num, llc->span.pos), Token);
     if (overflow)
     {
-        _lexError(llc, E_WARNING, "number is too large", "make the number smaller or use defferent type");
+        _lexOnTBigInt(llc, digits, base, isNegative);
         return;
     }
+    listAdd(llc->tokens, tokenInt(T_LITERAL_INTEGER, isNegative ? -num : num, llc->span.pos), Token);
     fsFree(llc->span);
 }
 
@@ -725,7 +760,7 @@ _Bool _lexOnTKeyword(_LexLContext* restrict llc)
         return 1;
     if (_lexCheckKeyword(llc, strLit("sign"), T_KEYWORD_SIGN, &llc->defd, 0))
         return 1;
-    if (_lexCheckKeyword(llc, strLit("def"), T_KEYWORD_DEF, &llc->defd, 1))
+    if (_lexCheckKeyword(llc, strLit("def"), T_KEYWORD_DEF, &llc->parm, 1))
         return 1;
     return 0;
 }
@@ -20,9 +20,21 @@ List listCreate(size_t elementSize)
     return list;
 }
 
+List listCreateEmpty(size_t elementSize)
+{
+    List list =
+    {
+        .data = NULL,
+        .allocated = 0,
+        .length = 0,
+        .element = elementSize
+    };
+    return list;
+}
+
 void listFree(List list)
 {
-    assert(list.data);
+    assert(list.data || !list.allocated);
     free(list.data);
 }
 
@@ -32,7 +44,11 @@ void listAddP(List* list, void* pItem)
     unsigned char* item = (unsigned char*)pItem;
     if (list->allocated == list->length)
     {
-        size_t newSize = list->allocated < list_ALLOC_SIZE ? list->allocated * 2 : list->allocated + list_ALLOC_SIZE;
+        // large lists grow by half so that adding stays amortized constant
+        size_t step = list->allocated / 2 > list_ALLOC_SIZE ? list->allocated / 2 : list_ALLOC_SIZE;
+        size_t newSize = list->allocated < list_ALLOC_SIZE ? list->allocated * 2 : list->allocated + step;
+        if (!newSize)
+            newSize = list_EMPTY_START_SIZE;
         unsigned char* newData = realloc(list->data, newSize * list->element);
         assert(newData);
         list->data = newData;
@@ -13,8 +13,14 @@
 #define list_ALLOC_SIZE 128LL
 #endif // list_ALLOC_SIZE
 
+#ifndef list_EMPTY_START_SIZE
+#define list_EMPTY_START_SIZE 4LL
+#endif // list_EMPTY_START_SIZE
+
 #define listNew(__type) listCreate(sizeof(__type))
 
+#define listNewEmpty(__type) listCreateEmpty(sizeof(__type))
+
 #define listAdd(__list, __item, __type) \
 {\
     __type __i = __item;\
@@ -128,6 +134,15 @@ void liAddP(ListIterator* iterator, void* element);
  */
 List listCreate(size_t elementSize);
 
+/**
+ * @brief Creates list that allocates only when the first item is added,
+ * it starts with list_EMPTY_START_SIZE items
+ * 
+ * @param elementSize size of the items in the list
+ * @return List new instance
+ */
+List listCreateEmpty(size_t elementSize);
+
 /**
  * @brief frees this string list
  * 
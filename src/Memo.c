@@ -0,0 +1,279 @@
+#include "Memo.h"
+
+#include <assert.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "BigInt.h"
+
+/**
+ * @brief computes hash of the arguments
+ *
+ * @param args the arguments, must be usable as key
+ * @param argc number of arguments
+ * @return size_t the hash
+ */
+size_t _memoHash(Variable* args, size_t argc);
+
+/**
+ * @brief compares key of the entry with the arguments
+ *
+ * @param e entry to compare
+ * @param args the arguments
+ * @param argc number of arguments
+ * @return true the arguments are the key of the entry
+ * @return false the arguments differ
+ */
+_Bool _memoEquals(MemoEntry* e, Variable* args, size_t argc);
+
+/**
+ * @brief finds entry with the given key
+ *
+ * @param m cache to search
+ * @param args the arguments
+ * @param argc number of arguments
+ * @param hash hash of the arguments
+ * @return MemoEntry* the entry or NULL if there is none
+ */
+MemoEntry* _memoFind(Memo* m, Variable* args, size_t argc, size_t hash);
+
+/**
+ * @brief removes entry chosen by the CLOCK policy from the cache, entries
+ * that were used since the hand last passed them get another chance
+ *
+ * @param m full cache
+ * @return size_t index of the freed entry
+ */
+size_t _memoEvict(Memo* m);
+
+Memo* memoCreate(Gc* gc, size_t capacity)
+{
+    assert(capacity);
+
+    Memo* m = gcAlloc(gc, GC_MEMO, sizeof(Memo));
+    m->capacity = capacity;
+    m->entries = malloc(sizeof(MemoEntry) * capacity);
+    assert(m->entries);
+    m->length = 0;
+
+    m->bucketCount = 1;
+    while (m->bucketCount < capacity)
+        m->bucketCount <<= 1;
+    m->buckets = calloc(m->bucketCount, sizeof(size_t));
+    assert(m->buckets);
+
+    m->hand = 0;
+    m->hits = 0;
+    m->misses = 0;
+    m->evictions = 0;
+    return m;
+}
+
+void memoFreeEntries(Memo* m)
+{
+    for (size_t i = 0; i < m->length; i++)
+    {
+        memoFreeKey(m->entries[i].key, m->entries[i].argc);
+        rtFreeVariable(m->entries[i].value);
+    }
+    free(m->entries);
+    free(m->buckets);
+}
+
+_Bool memoCanKey(Variable* args, size_t argc)
+{
+    for (size_t i = 0; i < argc; i++)
+    {
+        switch (args[i].type)
+        {
+        case V_BOOL:
+        case V_INT:
+        case V_FLOAT:
+        case V_CHAR:
+        case V_STRING:
+        case V_NOTHING:
+        case V_BIGINT:
+            continue;
+        default:
+            return 0;
+        }
+    }
+    return 1;
+}
+
+Variable* memoFind(Memo* m, Variable* args, size_t argc)
+{
+    MemoEntry* e = _memoFind(m, args, argc, _memoHash(args, argc));
+    if (!e)
+    {
+        m->misses++;
+        return NULL;
+    }
+    m->hits++;
+    e->used = 1;
+    return &e->value;
+}
+
+Variable* memoCopyKey(Variable* args, size_t argc)
+{
+    Variable* key = malloc(sizeof(Variable) * (argc ? argc : 1));
+    assert(key);
+    for (size_t i = 0; i < argc; i++)
+        key[i] = rtCopyVariable(strEmpty(), args[i]);
+    return key;
+}
+
+void memoFreeKey(Variable* key, size_t argc)
+{
+    for (size_t i = 0; i < argc; i++)
+        rtFreeVariable(key[i]);
+    free(key);
+}
+
+void memoAdd(Memo* m, Variable* key, size_t argc, Variable value)
+{
+    if (value.constant)
+        value = rtCopyVariable(strEmpty(), value);
+
+    // recursive call with the same arguments may have finished first
+    size_t hash = _memoHash(key, argc);
+    if (_memoFind(m, key, argc, hash))
+    {
+        memoFreeKey(key, argc);
+        rtFreeVariable(value);
+        return;
+    }
+
+    size_t index = m->length < m->capacity ? m->length++ : _memoEvict(m);
+    MemoEntry* e = m->entries + index;
+    size_t* bucket = m->buckets + (hash & (m->bucketCount - 1));
+    *e = (MemoEntry)
+    {
+        .key = key,
+        .argc = argc,
+        .value = value,
+        .hash = hash,
+        .next = *bucket,
+        .used = 0,
+    };
+    *bucket = index + 1;
+}
+
+size_t _memoHash(Variable* args, size_t argc)
+{
+    // FNV-1a over the type and value of each argument
+    size_t hash = 14695981039346656037ULL;
+    for (size_t i = 0; i < argc; i++)
+    {
+        unsigned long long bits = 0;
+        switch (args[i].type)
+        {
+        case V_BOOL:
+            bits = args[i].boolean;
+            break;
+        case V_INT:
+            bits = (unsigned long long)args[i].integer;
+            break;
+        case V_FLOAT:
+            // floats are keys by their bits (see _memoEquals)
+            memcpy(&bits, &args[i].decimal, sizeof(bits));
+            break;
+        case V_CHAR:
+            bits = (unsigned char)args[i].character;
+            break;
+        case V_STRING:
+            for (size_t j = 0; j < args[i].str.length; j++)
+                bits = (bits ^ (unsigned char)args[i].str.c[j]) * 1099511628211ULL;
+            break;
+        case V_BIGINT:
+            bits = bigHash(args[i].big);
+            break;
+        default:
+            break;
+        }
+        hash = (hash ^ args[i].type) * 1099511628211ULL;
+        hash = (hash ^ bits) * 1099511628211ULL;
+    }
+    return hash ^ (hash >> 29);
+}
+
+_Bool _memoEquals(MemoEntry* e, Variable* args, size_t argc)
+{
+    if (e->argc != argc)
+        return 0;
+    for (size_t i = 0; i < argc; i++)
+    {
+        Variable a = e->key[i];
+        Variable b = args[i];
+        if (a.type != b.type)
+            return 0;
+        switch (a.type)
+        {
+        case V_BOOL:
+            if (a.boolean != b.boolean)
+                return 0;
+            continue;
+        case V_INT:
+            if (a.integer != b.integer)
+                return 0;
+            continue;
+        case V_FLOAT:
+            // 0.0 and -0.0 are equal but functions can return different
+            // values for them ([/ 1.0 x]), NaN is the same key as itself
+            if (memcmp(&a.decimal, &b.decimal, sizeof(a.decimal)))
+                return 0;
+            continue;
+        case V_CHAR:
+            if (a.character != b.character)
+                return 0;
+            continue;
+        case V_STRING:
+            if (!strEquals(a.str, b.str))
+                return 0;
+            continue;
+        case V_BIGINT:
+            if (bigCompare(a.big, b.big) != 0)
+                return 0;
+            continue;
+        default:
+            continue;
+        }
+    }
+    return 1;
+}
+
+MemoEntry* _memoFind(Memo* m, Variable* args, size_t argc, size_t hash)
+{
+    size_t next = m->buckets[hash & (m->bucketCount - 1)];
+    while (next)
+    {
+        MemoEntry* e = m->entries + next - 1;
+        if (e->hash == hash && _memoEquals(e, args, argc))
+            return e;
+        next = e->next;
+    }
+    return NULL;
+}
+
+size_t _memoEvict(Memo* m)
+{
+    while (m->entries[m->hand].used)
+    {
+        m->entries[m->hand].used = 0;
+        m->hand = (m->hand + 1) % m->capacity;
+    }
+    size_t index = m->hand;
+    m->hand = (m->hand + 1) % m->capacity;
+
+    // unlink the entry from its bucket
+    MemoEntry* e = m->entries + index;
+    size_t* link = m->buckets + (e->hash & (m->bucketCount - 1));
+    while (*link != index + 1)
+        link = &m->entries[*link - 1].next;
+    *link = e->next;
+
+    memoFreeKey(e->key, e->argc);
+    rtFreeVariable(e->value);
+    m->evictions++;
+    return index;
+}
@@ -0,0 +1,119 @@
+#ifndef memo_MEMO_INCLUDED
+#define memo_MEMO_INCLUDED
+
+#include <stddef.h>
+
+#include "Runtime.h"
+#include "Gc.h"
+
+#ifndef memo_DEFAULT_CAPACITY
+// number of cached results of memoized function without explicit capacity
+#define memo_DEFAULT_CAPACITY 1024
+#endif // memo_DEFAULT_CAPACITY
+
+/**
+ * @brief cached result of memoized function
+ *
+ */
+typedef struct MemoEntry
+{
+    // copies of the arguments
+    Variable* key;
+    size_t argc;
+    Variable value;
+    size_t hash;
+    // index of the next entry with the same bucket plus one, 0 if it is the last
+    size_t next;
+    // set when the entry is used, entries without it are evicted first
+    _Bool used;
+} MemoEntry;
+
+/**
+ * @brief results of memoized function keyed by the argument values, shared
+ * by all copies of the function, when it is full the entries are evicted
+ * by the CLOCK policy
+ *
+ */
+struct Memo
+{
+    GcObject header;
+    // maximum number of entries
+    size_t capacity;
+    MemoEntry* entries;
+    size_t length;
+    // first entry of each bucket plus one, the number of buckets is power of two
+    size_t* buckets;
+    size_t bucketCount;
+    // next entry considered for eviction
+    size_t hand;
+    size_t hits;
+    size_t misses;
+    size_t evictions;
+};
+
+/**
+ * @brief creates empty cache
+ *
+ * @param gc heap that owns the cache
+ * @param capacity maximum number of results, must be at least 1
+ * @return Memo* new instance
+ */
+Memo* memoCreate(Gc* gc, size_t capacity);
+
+/**
+ * @brief frees the cached results, called by the collector before it
+ * frees the cache
+ *
+ * @param m cache to clear
+ */
+void memoFreeEntries(Memo* m);
+
+/**
+ * @brief checks whether the arguments can be used as key, only bool, int,
+ * bigint, float, char, string and nothing arguments can
+ *
+ * @param args the arguments
+ * @param argc number of arguments
+ * @return true the arguments can be used as key
+ * @return false the call cannot be cached
+ */
+_Bool memoCanKey(Variable* args, size_t argc);
+
+/**
+ * @brief finds the cached result and counts hit or miss
+ *
+ * @param m cache to search
+ * @param args the arguments, must be usable as key
+ * @param argc number of arguments
+ * @return Variable* the cached result or NULL if it isn't cached
+ */
+Variable* memoFind(Memo* m, Variable* args, size_t argc);
+
+/**
+ * @brief copies the arguments so that they can be added to the cache
+ *
+ * @param args the arguments, must be usable as key
+ * @param argc number of arguments
+ * @return Variable* the copies
+ */
+Variable* memoCopyKey(Variable* args, size_t argc);
+
+/**
+ * @brief frees copied key
+ *
+ * @param key the copies
+ * @param argc number of arguments
+ */
+void memoFreeKey(Variable* key, size_t argc);
+
+/**
+ * @brief adds the result to the cache, some entry is evicted if it is full
+ *
+ * @param m cache to add to
+ * @param key copied arguments, the cache takes their ownership
+ * @param argc number of arguments
+ * @param value result of the call, the cache takes its ownership
+ */
+void memoAdd(Memo* m, Variable* key, size_t argc, Variable value);
+
+#endif // memo_MEMO_INCLUDED
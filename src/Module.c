@@ -0,0 +1,425 @@
+#ifndef _WIN32
+// realpath isn't part of the C standard
+#define _DEFAULT_SOURCE
+#endif // _WIN32
+
+#include "Module.h"
+
+#include <assert.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "List.h"
+#include "Errors.h"
+#include "Pool.h"
+#include "Resolver.h"
+#include "StringBuilder.h"
+#include "Thread.h"
+
+#ifndef _MOD_START
+// number of entries of the table of modules when the first module is added,
+// the table doubles when it is half full
+#define _MOD_START 16
+#endif // _MOD_START
+
+/**
+ * @brief compiled module or module that waits for compilation
+ *
+ */
+typedef struct _ModEntry
+{
+    // absolute path of the file, identifies the module
+    char* path;
+    // the file as it is opened, used in the messages
+    char* filename;
+    // NULL until the module is compiled or if it couldn't be compiled
+    Program* program;
+    // modules imported by the program in the order of the imports,
+    // List of _ModEntry*
+    List imports;
+    // the file or some module it imports couldn't be compiled
+    _Bool failed;
+    // false if the file couldn't be opened
+    _Bool opened;
+    // the first import of the module, its filename is NULL for the file
+    // given to modLoad
+    FilePos at;
+    // messages of the compilation, printed after the whole wave
+    StringBuilder messages;
+} _ModEntry;
+
+struct Modules
+{
+    _Bool optimize;
+    _Bool cache;
+    size_t threads;
+    // threads that compile the modules, NULL until more modules are
+    // compiled at once
+    Pool* pool;
+    // hash table of the modules found by their paths, NULL for empty entry
+    _ModEntry** entries;
+    // number of entries, power of two or 0 if it wasn't allocated
+    size_t capacity;
+    size_t count;
+    // the largest global slot of the modules, the slots of the next module
+    // start after it so that the trees don't replace each other's globals
+    // in the tables of the runtimes
+    size_t slots;
+};
+
+/**
+ * @brief modules compiled at the same time
+ *
+ */
+typedef struct _ModWave
+{
+    Modules* m;
+    // List of _ModEntry*
+    List entries;
+} _ModWave;
+
+/**
+ * @brief finds the entry of the path in the table of modules
+ *
+ * @param m the modules, the table has at least one empty entry
+ * @param path absolute path of the module
+ * @return _ModEntry** entry of the path or the empty entry where it belongs
+ */
+_ModEntry** _modFind(Modules* m, const char* path);
+
+/**
+ * @brief finds module or creates new one if the file wasn't loaded yet
+ *
+ * @param m the modules
+ * @param filename the file relative to the working directory, this takes
+ * its ownership
+ * @param at where the module is imported
+ * @param wave where to add the new module
+ * @param loaded where to add the new module
+ * @return _ModEntry* the module
+ */
+_ModEntry* _modAdd(Modules* m, char* filename, FilePos at, List* wave, List* loaded);
+
+/**
+ * @brief compiles one module of wave, runs on the threads of the pool
+ *
+ * @param context the wave
+ * @param thread index of the thread
+ * @param index index of the module in the wave
+ */
+void _modCompile(void* context, size_t thread, size_t index);
+
+/**
+ * @brief finds the imports of compiled module and adds the modules that
+ * weren't loaded yet to the next wave
+ *
+ * @param m the modules
+ * @param e the compiled module
+ * @param wave where to add the new modules
+ * @param loaded where to add the new modules
+ */
+void _modFindImports(Modules* m, _ModEntry* e, List* wave, List* loaded);
+
+/**
+ * @brief joins path of import with the directory of the importing file
+ *
+ * @param importer the importing file
+ * @param path the imported path, absolute path is used as it is
+ * @return char* the path, must be freed
+ */
+char* _modJoin(const char* importer, String path);
+
+/**
+ * @brief returns the absolute path of the file
+ *
+ * @param filename the file
+ * @return char* the path, must be freed, copy of the filename if it cannot
+ * be made absolute
+ */
+char* _modAbsolute(const char* filename);
+
+/**
+ * @brief copies null terminated string
+ *
+ * @param s the string
+ * @param length number of chars of the string
+ * @return char* the copy, must be freed
+ */
+char* _modCopy(const char* s, size_t length);
+
+Modules* modCreate(_Bool optimize, _Bool cache, size_t threads)
+{
+    Modules* m = malloc(sizeof(Modules));
+    assert(m);
+    m->optimize = optimize;
+    m->cache = cache;
+    m->threads = threads;
+    m->pool = NULL;
+    m->entries = NULL;
+    m->capacity = 0;
+    m->count = 0;
+    m->slots = 0;
+    return m;
+}
+
+Program* modLoad(Modules* m, const char* filename, Stream* messages)
+{
+    List wave = listNew(_ModEntry*);
+    List loaded = listNew(_ModEntry*);
+    FilePos none = { .line = 0, .col = 0, .filename = NULL };
+    _ModEntry* root = _modAdd(m, _modCopy(filename, strlen(filename)), none, &wave, &loaded);
+
+    // every wave are the modules imported by the previous one that weren't
+    // loaded yet, they don't depend on each other
+    while (wave.length)
+    {
+        _ModWave w = { .m = m, .entries = wave };
+        if (wave.length == 1 || m->threads == 1)
+        {
+            for (size_t i = 0; i < wave.length; i++)
+                _modCompile(&w, 0, i);
+        }
+        else
+        {
+            if (!m->pool)
+            {
+                size_t threads = m->threads ? m->threads : thrCpuCount();
+                m->pool = poolCreate(threads > pool_MAX_THREADS ? pool_MAX_THREADS : threads);
+            }
+            poolRun(m->pool, _modCompile, &w, wave.length);
+        }
+
+        List next = listNew(_ModEntry*);
+        for (size_t i = 0; i < wave.length; i++)
+        {
+            _ModEntry* e = listGet(wave, i, _ModEntry*);
+            if (messages && e->messages.length)
+                stWrite(messages, e->messages.buffer, e->messages.length);
+            sbClear(&e->messages);
+
+            if (!e->opened && messages && !e->at.filename)
+                stPrintf(messages, "Error: couldn't open file %s\n", e->filename);
+            else if (!e->opened && messages)
+            {
+                ErrorToken err = errCreateErrorToken(E_ERROR, tokenCreate(T_ERROR, e->at), "cannot open module", "the path is relative to the importing file");
+                errPrintErrorToken(messages, err, e->at.filename->c);
+                stPrintf(messages, "\n");
+                errFreeErrorToken(err);
+            }
+
+            if (e->program)
+            {
+                rsNumber(&e->program->tree, m->slots);
+                m->slots = e->program->tree.slots;
+                _modFindImports(m, e, &next, &loaded);
+            }
+            else
+                e->failed = 1;
+        }
+        listFree(wave);
+        wave = next;
+    }
+    listFree(wave);
+
+    // module fails with the modules it imports, the failure spreads trough
+    // at most as many imports as there are new modules
+    _Bool changed = 1;
+    while (changed)
+    {
+        changed = 0;
+        for (size_t i = 0; i < loaded.length; i++)
+        {
+            _ModEntry* e = listGet(loaded, i, _ModEntry*);
+            for (size_t j = 0; !e->failed && j < e->imports.length; j++)
+            {
+                if (listGet(e->imports, j, _ModEntry*)->failed)
+                    e->failed = changed = 1;
+            }
+        }
+    }
+
+    for (size_t i = 0; i < loaded.length; i++)
+    {
+        _ModEntry* e = listGet(loaded, i, _ModEntry*);
+        sbFree(&e->messages);
+        if (e->failed)
+        {
+            if (e->program)
+                progFree(e->program);
+            e->program = NULL;
+            continue;
+        }
+        for (size_t j = 0; j < e->imports.length; j++)
+            listAdd(e->program->imports, listGet(e->imports, j, _ModEntry*)->program, Program*);
+    }
+    listFree(loaded);
+
+    return root->program;
+}
+
+void modFree(Modules* m)
+{
+    for (size_t i = 0; i < m->capacity; i++)
+    {
+        _ModEntry* e = m->entries[i];
+        if (!e)
+            continue;
+        if (e->program)
+            progFree(e->program);
+        listFree(e->imports);
+        free(e->path);
+        free(e->filename);
+        free(e);
+    }
+    if (m->pool)
+        poolFree(m->pool);
+    free(m->entries);
+    free(m);
+}
+
+_ModEntry** _modFind(Modules* m, const char* path)
+{
+    // FNV-1a of the path
+    uint64_t h = 0xcbf29ce484222325ull;
+    for (const char* c = path; *c; c++)
+        h = (h ^ (unsigned char)*c) * 0x100000001b3ull;
+
+    size_t mask = m->capacity - 1;
+    for (size_t i = (size_t)h & mask;; i = (i + 1) & mask)
+    {
+        if (!m->entries[i] || strcmp(m->entries[i]->path, path) == 0)
+            return m->entries + i;
+    }
+}
+
+_ModEntry* _modAdd(Modules* m, char* filename, FilePos at, List* wave, List* loaded)
+{
+    if ((m->count + 1) * 2 > m->capacity)
+    {
+        _ModEntry** old = m->entries;
+        size_t oldCapacity = m->capacity;
+        m->capacity = oldCapacity ? oldCapacity * 2 : _MOD_START;
+        m->entries = calloc(m->capacity, sizeof(_ModEntry*));
+        assert(m->entries);
+        for (size_t i = 0; i < oldCapacity; i++)
+        {
+            if (old[i])
+                *_modFind(m, old[i]->path) = old[i];
+        }
+        free(old);
+    }
+
+    char* path = _modAbsolute(filename);
+    _ModEntry** slot = _modFind(m, path);
+    if (*slot)
+    {
+        free(path);
+        free(filename);
+        return *slot;
+    }
+
+    _ModEntry* e = malloc(sizeof(_ModEntry));
+    assert(e);
+    e->path = path;
+    e->filename = filename;
+    e->program = NULL;
+    e->imports = listNew(_ModEntry*);
+    e->failed = 0;
+    e->opened = 0;
+    e->at = at;
+    e->messages = sbCreate();
+    *slot = e;
+    m->count++;
+
+    listAdd(*wave, e, _ModEntry*);
+    listAdd(*loaded, e, _ModEntry*);
+    return e;
+}
+
+void _modCompile(void* context, size_t thread, size_t index)
+{
+    (void)thread;
+    _ModWave* w = context;
+    _ModEntry* e = listGet(w->entries, index, _ModEntry*);
+
+    Stream in;
+    if (stFileStream(&in, e->filename, "r"))
+        return;
+    e->opened = 1;
+
+    Stream messages;
+    stStringBuilderStream(&messages, &e->messages, stWRITE);
+    e->program = w->m->cache
+        ? progCompileCached(&in, e->filename, w->m->optimize, &messages)
+        : progCompile(&in, e->filename, w->m->optimize, &messages);
+    stClose(&messages);
+    stClose(&in);
+}
+
+void _modFindImports(Modules* m, _ModEntry* e, List* wave, List* loaded)
+{
+    // the imports are visited in the order in which they are in the source
+    List pending = listNew(ParserNode*);
+    for (size_t i = e->program->tree.nodes.length; i > 0; i--)
+        listAdd(pending, listGetP(e->program->tree.nodes, i - 1), ParserNode*);
+
+    while (pending.length)
+    {
+        ParserNode* n = listGet(pending, --pending.length, ParserNode*);
+        if (n->type == P_IMPORT)
+        {
+            Token* path = ((ParserNode*)listGetP(n->nodes, 0))->token;
+            _ModEntry* module = _modAdd(m, _modJoin(e->filename, path->string), path->pos, wave, loaded);
+
+            _Bool seen = 0;
+            for (size_t i = 0; i < e->imports.length && !seen; i++)
+                seen = listGet(e->imports, i, _ModEntry*) == module;
+            if (!seen)
+                listAdd(e->imports, module, _ModEntry*);
+            continue;
+        }
+
+        for (size_t i = n->nodes.length; i > 0; i--)
+            listAdd(pending, listGetP(n->nodes, i - 1), ParserNode*);
+    }
+    listFree(pending);
+}
+
+char* _modJoin(const char* importer, String path)
+{
+    _Bool absolute = path.length
+        && (path.c[0] == '/' || path.c[0] == '\\' || (path.length > 1 && path.c[1] == ':'));
+    size_t dir = 0;
+    for (size_t i = 0; !absolute && importer[i]; i++)
+    {
+        if (importer[i] == '/' || importer[i] == '\\')
+            dir = i + 1;
+    }
+
+    char* joined = malloc(dir + path.length + 1);
+    assert(joined);
+    memcpy(joined, importer, dir);
+    memcpy(joined + dir, path.c, path.length);
+    joined[dir + path.length] = 0;
+    return joined;
+}
+
+char* _modAbsolute(const char* filename)
+{
+#ifdef _WIN32
+    char* path = _fullpath(NULL, filename, 0);
+#else
+    char* path = realpath(filename, NULL);
+#endif // _WIN32
+    return path ? path : _modCopy(filename, strlen(filename));
+}
+
+char* _modCopy(const char* s, size_t length)
+{
+    char* copy = malloc(length + 1);
+    assert(copy);
+    memcpy(copy, s, length);
+    copy[length] = 0;
+    return copy;
+}
@@ -0,0 +1,52 @@
+#ifndef mod_MODULE_INCLUDED
+#define mod_MODULE_INCLUDED
+
+#include <stddef.h>
+
+#include "Program.h"
+#include "Stream.h"
+
+/**
+ * @brief compiled modules of the process found by their paths, every file
+ * is compiled at most once and its program is shared by all programs that
+ * import it
+ *
+ */
+typedef struct Modules Modules;
+
+/**
+ * @brief creates empty set of modules
+ *
+ * @param optimize if true the modules are optimized
+ * @param cache if true the modules are compiled trough progCompileCached
+ * @param threads number of threads that compile the modules, 0 for one
+ * thread for every processor
+ * @return Modules* new instance
+ */
+Modules* modCreate(_Bool optimize, _Bool cache, size_t threads);
+
+/**
+ * @brief compiles the file and all modules it imports, the imports are
+ * relative to the file that contains them, the modules that don't depend
+ * on each other are compiled in parallel and the modules compiled by the
+ * previous calls are reused, it must not be called by more threads at the
+ * same time
+ *
+ * @param m the modules
+ * @param filename the file
+ * @param messages where to print the errors and warnings, NULL to not
+ * print them
+ * @return Program* program of the file with its imports, owned by the
+ * modules, NULL if the file or some module it imports couldn't be compiled
+ */
+Program* modLoad(Modules* m, const char* filename, Stream* messages);
+
+/**
+ * @brief frees the modules with their programs, the runtimes that ran them
+ * must be freed first
+ *
+ * @param m the modules
+ */
+void modFree(Modules* m);
+
+#endif // mod_MODULE_INCLUDED
@@ -0,0 +1,538 @@
+#include "Native.h"
+
+#include <assert.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "BigInt.h"
+#include "FileSpan.h"
+#include "Pool.h"
+#include "Thread.h"
+
+/**
+ * @brief the program and its result, passed to the thread that runs it
+ *
+ */
+typedef struct _NatMain
+{
+    Runtime* r;
+    NatProgram run;
+    // size of the stack of the thread
+    size_t stack;
+    Variable res;
+} _NatMain;
+
+// number of nested calls of compiled functions on the thread
+static _Thread_local size_t _natDepth = 0;
+// address in the frame of the outermost call of compiled function on the
+// thread, the stacks grow down on the supported processors
+static _Thread_local uintptr_t _natBase = 0;
+// size of the stack of the thread, 0 on the threads of the pool
+static _Thread_local size_t _natStack = 0;
+// set when call didn't fit into the stack, the running calls return
+// StackOverflow until the outermost one returns, like the evaluator that
+// discards all pending steps
+static _Thread_local _Bool _natOverflow = 0;
+// number of builtins called by compiled code that are running on the
+// thread, they may keep values in C variables so the heap isn't collected
+static _Thread_local size_t _natNoCollect = 0;
+
+/**
+ * @brief runs compiled program, runs on thread with large stack
+ *
+ * @param context the program
+ */
+void _natStart(void* context);
+
+/**
+ * @brief creates the error of call that doesn't fit into the stack
+ *
+ * @return Variable StackOverflow exception
+ */
+Variable _natStackOverflow(void);
+
+/**
+ * @brief visits the variables of the runtime, compiled code keeps all
+ * its values in the locals
+ *
+ * @param gc heap being collected
+ * @param context the runtime
+ */
+void _natRoots(Gc* gc, void* context);
+
+/**
+ * @brief creates the result of call whose head is not function
+ *
+ * @param head the head, NULL if it is global variable that doesn't exist
+ * @return Variable call result
+ */
+Variable _natNotFunction(Variable* head);
+
+/**
+ * @brief calls compiled function, memoized function isn't called if the
+ * result is cached
+ *
+ * @param r runtime context
+ * @param head the function as it is stored
+ * @param f copy of the function
+ * @param args arguments, this takes their ownership
+ * @param argc number of arguments, the same as the number of parameters
+ * @return Variable result of the function
+ */
+Variable _natCallCompiled(Runtime* r, Variable* head, Function* f, Variable* args, size_t argc);
+
+/**
+ * @brief makes room for variables at the end of the list
+ *
+ * @param list the list
+ * @param count number of the variables
+ */
+void _natReserve(List* list, size_t count);
+
+/**
+ * @brief frees the arguments
+ *
+ * @param args the arguments
+ * @param argc number of the arguments
+ */
+void _natFreeArgs(Variable* args, size_t argc);
+
+int natMain(int argc, char** argv, NatProgram run, NatConstants constants)
+{
+    _Bool stats = 0;
+    // one thread for every processor by default
+    size_t threads = 0;
+
+    for (int i = 1; i < argc; i++)
+    {
+        if (strcmp(argv[i], "-S") == 0)
+        {
+            stats = 1;
+            continue;
+        }
+        if (strcmp(argv[i], "-j") == 0)
+        {
+            char* end = NULL;
+            if (i + 1 < argc)
+                threads = strtoull(argv[++i], &end, 10);
+            if (!end || *end || threads == 0)
+            {
+                printf("Error: -j takes positive number of threads");
+                return EXIT_FAILURE;
+            }
+            continue;
+        }
+        printf("Error: invalid number of arguments");
+        return EXIT_FAILURE;
+    }
+
+    constants(1);
+    List builtins = bifCreateBuiltins();
+    List errors = listNew(FileSpan);
+    Runtime r = rtCreateFrom(builtins, &errors, stdout);
+    r.threads = threads;
+
+    // the calls of compiled functions recurse on the C stack
+    _NatMain m = { .r = &r, .run = run, .stack = nat_STACK_SIZE };
+    Thread t;
+    if (thrCreateStack(&t, _natStart, &m, nat_STACK_SIZE))
+        thrJoin(&t);
+    else
+    {
+        m.stack = nat_DEFAULT_STACK;
+        _natStart(&m);
+    }
+
+    int res = EXIT_SUCCESS;
+    if (m.res.type == V_EXCEPTION)
+    {
+        rtPrintException(stdout, m.res);
+        res = EXIT_FAILURE;
+    }
+    rtFreeVariable(m.res);
+
+    if (stats)
+        gcPrintStats(stderr, &r.gc);
+    rtFree(r);
+    listFree(errors);
+    bifFreeBuiltins(builtins);
+    constants(0);
+    return res;
+}
+
+Variable natRun(Function* f, Runtime* r, List par)
+{
+    Variable res = ((NatLayout*)f->frame)->entry(f, r, (Variable*)par.data, par.length);
+    listFree(par);
+    return res;
+}
+
+_Bool natEnter(Function* f, Runtime* r, Variable* args, size_t argc, size_t temps, size_t* caller, Variable* err)
+{
+    if (f && argc != f->parameters.length)
+    {
+        _natFreeArgs(args, argc);
+        *err = rtException(strLit("InvalidArgumentCount"), strLit("Number of arguments doesn't match the number of parameters"));
+        return 0;
+    }
+    // the frames of the compiled functions have different sizes, so the
+    // depth is limited by the bytes of the stack they use
+    uintptr_t here = (uintptr_t)&here;
+    if (!_natDepth)
+        _natBase = here;
+    size_t stack = _natStack ? _natStack : pool_STACK_SIZE;
+    if (_natOverflow || _natBase - here > stack - nat_STACK_RESERVE)
+    {
+        _natOverflow = _natDepth > 0;
+        _natFreeArgs(args, argc);
+        *err = _natStackOverflow();
+        return 0;
+    }
+    _natDepth++;
+
+    // f may be in the locals so it is read before they grow
+    FrameLayout* frame = f ? f->frame : NULL;
+    size_t size = frame ? frame->size : 0;
+    Closure* closure = f ? f->closure : NULL;
+    Variable self = rtCreateNothingVariable();
+    if (frame && frame->self)
+    {
+        Variable v = { .type = V_FUNCTION, .function = *f };
+        self = rtCopyVariable(strEmpty(), v);
+    }
+    // the closure of the caller is in the frame so that the collector
+    // updates it, the constant is never freed
+    Variable saved = { .type = V_FUNCTION, .constant = 1 };
+    saved.function.closure = r->closure;
+    saved.function.env = r->env;
+
+    // the frame is added at once, the slots are written in place
+    size_t length = size + 1 + temps;
+    _natReserve(&r->locals, length);
+    Variable* slots = (Variable*)r->locals.data + r->locals.length;
+    *caller = r->frame;
+    r->frame = r->locals.length;
+    r->locals.length += length;
+    for (size_t i = 0; i < argc; i++)
+    {
+        // pooled constants cannot be owned by the frame
+        slots[i] = args[i].constant ? rtCopyVariable(strEmpty(), args[i]) : args[i];
+    }
+    for (size_t i = argc; i < length; i++)
+        slots[i] = (Variable){ .type = V_NOTHING };
+    if (frame && frame->self)
+        slots[frame->self - 1] = self;
+    slots[size] = saved;
+
+    r->closure = closure;
+    r->env = 0;
+    if (gcShouldCollect(&r->gc))
+        natCollect(r);
+    return 1;
+}
+
+void natLeave(Runtime* r, size_t size, size_t caller, Variable* res)
+{
+    Variable saved = natSlot(r, size);
+    for (size_t i = r->frame; i < r->locals.length; i++)
+        rtFreeVariable(listGet(r->locals, i, Variable));
+    r->locals.length = r->frame;
+    r->frame = caller;
+    r->closure = saved.function.closure;
+    r->env = saved.function.env;
+    _natDepth--;
+
+    if (_natOverflow)
+    {
+        rtFreeVariable(*res);
+        *res = _natStackOverflow();
+        _natOverflow = _natDepth > 0;
+    }
+}
+
+void natRebind(Runtime* r, const FrameLayout* frame, size_t base, size_t argc)
+{
+    for (size_t i = 0; i < argc; i++)
+    {
+        Variable v = natSlot(r, base + i);
+        natSlot(r, base + i) = rtCreateNothingVariable();
+        if (v.constant)
+            v = rtCopyVariable(strEmpty(), v);
+        rtFreeVariable(natSlot(r, i));
+        natSlot(r, i) = v;
+    }
+    // the function itself stays in its slot
+    for (size_t i = argc; i < frame->size; i++)
+    {
+        if (i + 1 == frame->self)
+            continue;
+        rtFreeVariable(natSlot(r, i));
+        natSlot(r, i) = rtCreateNothingVariable();
+    }
+
+    if (gcShouldCollect(&r->gc))
+        natCollect(r);
+}
+
+void natCollect(Runtime* r)
+{
+    if (!_natNoCollect)
+        gcCollect(&r->gc, _natRoots, r);
+}
+
+Variable* natGlobal(Runtime* r, size_t* cache, String name)
+{
+    // the threads of the pool share the globals so they share the cache
+    size_t index = __atomic_load_n(cache, __ATOMIC_RELAXED);
+    if (index && index <= r->variables.length)
+    {
+        Variable* v = (Variable*)r->variables.data + index - 1;
+        if (v->name.length == name.length && memcmp(v->name.c, name.c, name.length) == 0)
+            return v;
+    }
+
+    Variable* v = rtFind(r, name);
+    if (v)
+        __atomic_store_n(cache, (size_t)(v - (Variable*)r->variables.data) + 1, __ATOMIC_RELAXED);
+    return v;
+}
+
+Variable natGet(Runtime* r, size_t* cache, String name)
+{
+    Variable* v = natGlobal(r, cache, name);
+    if (!v)
+        return rtException(strLit("InvalidName"), strLit("The variable doesn't exist"));
+    return natCopy(v);
+}
+
+Variable natCopy(Variable* v)
+{
+    return rtCopyVariable(v->type == V_FUNCTION ? strCopy(v->name) : strEmpty(), *v);
+}
+
+Variable natSet(Runtime* r, String name, Variable v)
+{
+    if (v.type == V_EXCEPTION)
+        return v;
+    if (r->worker)
+    {
+        rtFreeVariable(v);
+        return rtException(strLit("SideEffect"), strLit("Parallel function cannot set global variable"));
+    }
+
+    Variable* var = rtSet(r, strCopy(name), v);
+    return rtCopyVariable(strEmpty(), *var);
+}
+
+Variable natSetLocal(Runtime* r, size_t index, String name, Variable v)
+{
+    if (v.type == V_EXCEPTION)
+        return v;
+
+    // pooled constants cannot be owned by the frame
+    if (v.constant)
+        v = rtCopyVariable(strEmpty(), v);
+    strFree(v.name);
+    v.name = strCopy(name);
+    rtFreeVariable(natSlot(r, index));
+    natSlot(r, index) = v;
+    return rtCopyVariable(strEmpty(), v);
+}
+
+Variable natFunction(NatLayout* l, Closure* closure, const String* parameters, size_t count)
+{
+    List names = listNew(String);
+    for (size_t i = 0; i < count; i++)
+        listAdd(names, strCopy(parameters[i]), String);
+
+    Function f = rtCreateFunction(natRun, names);
+    f.frame = &l->frame;
+    f.closure = closure;
+    return rtFunctionVariable(f);
+}
+
+_Bool natCheck(Variable* head, Variable* res)
+{
+    if (head && head->type == V_FUNCTION)
+        return 1;
+    *res = _natNotFunction(head);
+    return 0;
+}
+
+Variable natCall(Runtime* r, Variable* head, size_t base, size_t argc)
+{
+    Variable res;
+    // nothing is called while the calls that overflowed the stack return
+    if (_natOverflow)
+        res = _natStackOverflow();
+    if (_natOverflow || !natCheck(head, &res))
+    {
+        for (size_t i = 0; i < argc; i++)
+        {
+            rtFreeVariable(natSlot(r, base + i));
+            natSlot(r, base + i) = rtCreateNothingVariable();
+        }
+        return res;
+    }
+
+    // the locals move when the called function creates its frame so the
+    // function and the arguments are copied out of them
+    Function f = head->function;
+    Variable buffer[nat_ARGS];
+    Variable* args = argc <= nat_ARGS ? buffer : malloc(sizeof(Variable) * argc);
+    assert(args);
+    for (size_t i = 0; i < argc; i++)
+    {
+        args[i] = natSlot(r, base + i);
+        natSlot(r, base + i) = rtCreateNothingVariable();
+    }
+
+    if (f.action != natRun)
+    {
+        List par = listNew(Variable);
+        for (size_t i = 0; i < argc; i++)
+            listAddP(&par, args + i);
+
+        // the builtin may call compiled function while it holds values
+        // the collector doesn't see
+        _natNoCollect++;
+        res = rtInvokeFunction(&f, r, par);
+        _natNoCollect--;
+    }
+    else if (argc != f.parameters.length)
+    {
+        _natFreeArgs(args, argc);
+        res = rtException(strLit("InvalidArgumentCount"), strLit("Number of arguments doesn't match the number of parameters"));
+    }
+    else
+        res = _natCallCompiled(r, head, &f, args, argc);
+
+    if (args != buffer)
+        free(args);
+    return res;
+}
+
+Variable natConstant(VariableType type, const char* value, size_t length)
+{
+    Variable v;
+    if (type == V_BIGINT)
+        v = rtBigIntVariable(bigParse(NULL, value, 10));
+    else
+    {
+        String s = { .c = (char*)value, .length = length };
+        v = rtStringVariable(gcString(NULL, s));
+    }
+    v.constant = 1;
+    return v;
+}
+
+void natFreeConstant(Variable v)
+{
+    if (v.type == V_BIGINT)
+        gcFreeObject(&v.big->header);
+    else
+        gcFreeString(v.str);
+}
+
+void _natStart(void* context)
+{
+    _NatMain* m = context;
+    _natStack = m->stack;
+    m->res = m->run(m->r);
+}
+
+Variable _natStackOverflow(void)
+{
+    return rtException(strLit("StackOverflow"), strLit("Maximum evaluation depth exceeded"));
+}
+
+void _natRoots(Gc* gc, void* context)
+{
+    Runtime* r = context;
+    // pool threads share the globals of the main runtime (see _evRoots)
+    if (!r->worker)
+    {
+        for (size_t i = 0; i < r->variables.length; i++)
+            gcVisitVariable(gc, listGetP(r->variables, i));
+    }
+    for (size_t i = 0; i < r->locals.length; i++)
+        gcVisitVariable(gc, listGetP(r->locals, i));
+    r->closure = (Closure*)gcVisitObject(gc, (GcObject*)r->closure);
+}
+
+Variable _natNotFunction(Variable* head)
+{
+    if (!head)
+        return rtException(strLit("InvalidName"), strLit("The function doesn't exist"));
+
+    switch (head->type)
+    {
+    case V_NOTHING:
+        return rtCreateNothingVariable();
+    case V_EXCEPTION:
+        return rtCopyVariable(strEmpty(), *head);
+    default:
+        return rtException(strLit("InvalidFunction"), strLit("This is not function"));
+    }
+}
+
+Variable _natCallCompiled(Runtime* r, Variable* head, Function* f, Variable* args, size_t argc)
+{
+    // the threads of the pool cannot change the caches of the other heaps
+    Memo* memo = f->memo && gcOwns(&r->gc, &f->memo->header) && memoCanKey(args, argc) ? f->memo : NULL;
+    NatEntry entry = ((NatLayout*)f->frame)->entry;
+    if (!memo)
+        return entry(f, r, args, argc);
+
+    Variable* cached = memoFind(memo, args, argc);
+    if (cached)
+    {
+        _natFreeArgs(args, argc);
+        return rtCopyVariable(strEmpty(), *cached);
+    }
+
+    // the function with the cache and the copies of the arguments wait for
+    // the result in the locals so that the collector sees them
+    size_t keep = r->locals.length;
+    Variable function = rtCopyVariable(strEmpty(), *head);
+    listAdd(r->locals, function, Variable);
+    for (size_t i = 0; i < argc; i++)
+        listAdd(r->locals, rtCopyVariable(strEmpty(), args[i]), Variable);
+
+    r->memoDepth++;
+    Variable res = entry(f, r, args, argc);
+    r->memoDepth--;
+    if (res.type != V_EXCEPTION)
+    {
+        Variable* kept = listGetP(r->locals, keep);
+        memo = kept->function.memo;
+        memoAdd(memo, memoCopyKey(kept + 1, argc), argc, rtCopyVariable(strEmpty(), res));
+        gcBarrier(&r->gc, &memo->header);
+    }
+
+    for (size_t i = keep; i < r->locals.length; i++)
+        rtFreeVariable(listGet(r->locals, i, Variable));
+    r->locals.length = keep;
+    return res;
+}
+
+void _natFreeArgs(Variable* args, size_t argc)
+{
+    for (size_t i = 0; i < argc; i++)
+        rtFreeVariable(args[i]);
+}
+
+void _natReserve(List* list, size_t count)
+{
+    if (list->length + count <= list->allocated)
+        return;
+
+    // grows by half like listAddP so that adding stays amortized constant
+    size_t step = list->allocated / 2 > count ? list->allocated / 2 : count;
+    void* data = realloc(list->data, (list->allocated + step) * list->element);
+    assert(data);
+    list->data = data;
+    list->allocated += step;
+}
@@ -0,0 +1,262 @@
+#ifndef nat_NATIVE_INCLUDED
+#define nat_NATIVE_INCLUDED
+
+#include <stddef.h>
+
+#include "BuiltinFunctions.h"
+#include "Gc.h"
+#include "List.h"
+#include "Memo.h"
+#include "ParserTree.h"
+#include "Runtime.h"
+#include "String.h"
+
+#ifndef nat_STACK_SIZE
+// size of the stack of the thread that runs the program, the memory is
+// committed only as the stack grows
+#define nat_STACK_SIZE ((size_t)1 << 30)
+#endif // nat_STACK_SIZE
+
+#ifndef nat_DEFAULT_STACK
+// size of the stack assumed when the program runs on the main thread
+// because the system couldn't start thread with nat_STACK_SIZE, the
+// smallest default of the supported systems (1 MiB on Windows)
+#define nat_DEFAULT_STACK ((size_t)1 << 20)
+#endif // nat_DEFAULT_STACK
+
+#ifndef nat_STACK_RESERVE
+// bytes of the stack left for the builtins and the collector called by
+// the deepest compiled function, calls of compiled functions that would
+// use more of the stack raise StackOverflow
+#define nat_STACK_RESERVE ((size_t)128 << 10)
+#endif // nat_STACK_RESERVE
+
+#ifndef nat_ARGS
+// calls with at most this many arguments pass them on the C stack
+#define nat_ARGS 8
+#endif // nat_ARGS
+
+// variable in the frame of the running compiled function, it is macro so
+// that the compiled code accesses the frame directly, the locals may move
+// with every call so the address must not be kept
+#define natSlot(__r, __index) (((Variable*)(__r)->locals.data)[(__r)->frame + (__index)])
+
+// determines whether value is true for conditions like the evaluator does
+#define natTruthy(__v) ((__v).type == V_BOOL ? (__v).boolean : (__v).type != V_NOTHING)
+
+// frees variable only if rtFreeVariable would free anything, so that the
+// compiled code doesn't call it for plain values
+#define natFree(__v) \
+{\
+    if (!(__v).constant && ((__v).name.c || (__v).type == V_EXCEPTION || (__v).type == V_FUNCTION))\
+        rtFreeVariable(__v);\
+}
+
+/**
+ * @brief runs compiled function, the arguments are moved to its frame
+ *
+ */
+typedef Variable (*NatEntry)(Function* f, Runtime* r, Variable* args, size_t argc);
+
+/**
+ * @brief runs the compiled top level expressions of the program and its
+ * imports
+ *
+ */
+typedef Variable (*NatProgram)(Runtime* r);
+
+/**
+ * @brief creates or frees the string and bigint literals of compiled program
+ *
+ */
+typedef void (*NatConstants)(_Bool create);
+
+/**
+ * @brief layout of the frame of compiled function, the functions point to
+ * its frame so the compiled code finds its entry trough the function
+ *
+ */
+typedef struct NatLayout
+{
+    // must be the first member
+    FrameLayout frame;
+    NatEntry entry;
+} NatLayout;
+
+/**
+ * @brief runs compiled program like slang runs the source, recognizes
+ * the -j and -S options of slang
+ *
+ * @param argc number of the command line arguments
+ * @param argv the command line arguments
+ * @param run the compiled program
+ * @param constants creates and frees the literals of the program
+ * @return int exit code of the process
+ */
+int natMain(int argc, char** argv, NatProgram run, NatConstants constants);
+
+/**
+ * @brief action of compiled functions, runs the function when it is called
+ * from builtin
+ *
+ * @param f function to run, its frame is NatLayout
+ * @param r runtime context
+ * @param par arguments, this takes their ownership
+ * @return Variable result of the function
+ */
+Variable natRun(Function* f, Runtime* r, List par);
+
+/**
+ * @brief creates frame of compiled function with the arguments followed by
+ * nothing up to the frame size, one slot that keeps the closure of the
+ * caller and the temporaries, then collects the heap if it is due
+ *
+ * @param f the function, NULL for the top level expressions
+ * @param r runtime context
+ * @param args arguments, this takes their ownership
+ * @param argc number of arguments
+ * @param temps number of temporaries
+ * @param caller set to the frame of the caller
+ * @param err set to the exception if the frame wasn't created
+ * @return true the frame was created
+ * @return false wrong number of arguments or too deep recursion, the
+ * arguments were freed
+ */
+_Bool natEnter(Function* f, Runtime* r, Variable* args, size_t argc, size_t temps, size_t* caller, Variable* err);
+
+/**
+ * @brief frees the frame of compiled function and returns to the caller
+ *
+ * @param r runtime context
+ * @param size size of the frame without the temporaries
+ * @param caller frame of the caller returned by natEnter
+ * @param res result of the function, replaced by StackOverflow while the
+ * calls that didn't fit into the stack return
+ */
+void natLeave(Runtime* r, size_t size, size_t caller, Variable* res);
+
+/**
+ * @brief moves the arguments of tail call of the running function to its
+ * frame so that the function can start again, then collects the heap if
+ * it is due
+ *
+ * @param r runtime context
+ * @param frame layout of the function
+ * @param base slot of the first argument
+ * @param argc number of arguments, the same as the number of parameters
+ */
+void natRebind(Runtime* r, const FrameLayout* frame, size_t base, size_t argc);
+
+/**
+ * @brief collects the heap unless some builtin that may hold values the
+ * collector doesn't see is running on the thread
+ *
+ * @param r runtime context
+ */
+void natCollect(Runtime* r);
+
+/**
+ * @brief finds global variable, the compiled code remembers its index like
+ * the runtime does for identifiers
+ *
+ * @param r runtime context
+ * @param cache index of the variable plus one, 0 if it wasn't found yet
+ * @param name name of the variable
+ * @return Variable* the variable or NULL if it doesn't exist
+ */
+Variable* natGlobal(Runtime* r, size_t* cache, String name);
+
+/**
+ * @brief reads global variable
+ *
+ * @param r runtime context
+ * @param cache index of the variable plus one, 0 if it wasn't found yet
+ * @param name name of the variable
+ * @return Variable copy of the variable or InvalidName exception
+ */
+Variable natGet(Runtime* r, size_t* cache, String name);
+
+/**
+ * @brief copies variable, functions keep their name so that they can be
+ * printed
+ *
+ * @param v the variable
+ * @return Variable the copy
+ */
+Variable natCopy(Variable* v);
+
+/**
+ * @brief sets global variable
+ *
+ * @param r runtime context
+ * @param name name of the variable
+ * @param v the value, this takes its ownership
+ * @return Variable copy of the stored value or exception
+ */
+Variable natSet(Runtime* r, String name, Variable v);
+
+/**
+ * @brief sets variable in the frame of the running function
+ *
+ * @param r runtime context
+ * @param index slot of the variable
+ * @param name name of the variable
+ * @param v the value, this takes its ownership
+ * @return Variable copy of the stored value or exception
+ */
+Variable natSetLocal(Runtime* r, size_t index, String name, Variable v);
+
+/**
+ * @brief creates compiled function
+ *
+ * @param l layout of the function
+ * @param closure captured variables, may be NULL
+ * @param parameters names of the parameters
+ * @param count number of the parameters
+ * @return Variable new function
+ */
+Variable natFunction(NatLayout* l, Closure* closure, const String* parameters, size_t count);
+
+/**
+ * @brief checks that the head of call is function
+ *
+ * @param head the head, NULL if it is global variable that doesn't exist
+ * @param res set to the result of the call if the head isn't function
+ * @return true the head is function
+ * @return false the head isn't function
+ */
+_Bool natCheck(Variable* head, Variable* res);
+
+/**
+ * @brief calls function with the arguments in the frame of the running
+ * function, memoized functions use their caches, builtins may call
+ * compiled functions that don't collect the heap until they return
+ *
+ * @param r runtime context
+ * @param head the called function, NULL if it is global variable that
+ * doesn't exist, it may be in the frame but not among the arguments
+ * @param base slot of the first argument, the arguments are moved
+ * @param argc number of arguments
+ * @return Variable result of the call
+ */
+Variable natCall(Runtime* r, Variable* head, size_t base, size_t argc);
+
+/**
+ * @brief creates literal of compiled program, it is constant that isn't
+ * owned by any heap
+ *
+ * @param type V_STRING or V_BIGINT
+ * @param value the characters of string or decimal digits of bigint
+ * @param length number of the characters
+ * @return Variable the constant
+ */
+Variable natConstant(VariableType type, const char* value, size_t length);
+
+/**
+ * @brief frees literal created by natConstant
+ *
+ * @param v the literal
+ */
+void natFreeConstant(Variable v);
+
+#endif // nat_NATIVE_INCLUDED
@@ -0,0 +1,345 @@
+#include "Optimizer.h"
+
+#include <stdlib.h>
+#include <assert.h>
+
+#include "ParserTree.h"
+#include "ConstantPool.h"
+#include "Runtime.h"
+#include "BuiltinFunctions.h"
+#include "List.h"
+#include "Token.h"
+#include "BigInt.h"
+
+#define _OPT_BUILTIN_COUNT 5
+// limits the recursion of _optType on deeply nested calls
+#define _OPT_TYPE_DEPTH 64
+
+typedef struct _OptBuiltin
+{
+    String name;
+    Action action;
+    // identity element for the simplification, -1 if there is none
+    long long identity;
+    // if true, the identity may be only the second argument
+    _Bool rightOnly;
+    // true if the result type is always the same as the type of the other argument for floats
+    _Bool floatSafe;
+    // true if the name is redefined somewhere in the program
+    _Bool shadowed;
+} _OptBuiltin;
+
+typedef struct _OptContext
+{
+    ConstantPool* pool;
+    Function fun;
+    // owns the bigints created while folding
+    Runtime runtime;
+    _OptBuiltin builtins[_OPT_BUILTIN_COUNT];
+} _OptContext;
+
+typedef struct _OptPending
+{
+    ParserNode* node;
+    // true if the childs of the node are already on the stack
+    _Bool expanded;
+} _OptPending;
+
+/**
+ * @brief marks builtins whose names are set or used as parameters
+ *
+ * @param oc context
+ * @param node node to search
+ */
+void _optFindShadowed(_OptContext* oc, ParserNode* node);
+
+/**
+ * @brief marks builtin with the given name as shadowed
+ *
+ * @param oc context
+ * @param name name to check
+ */
+void _optShadow(_OptContext* oc, String name);
+
+/**
+ * @brief optimizes the node and all of its childs
+ *
+ * @param oc context
+ * @param node node to optimize
+ */
+void _optNode(_OptContext* oc, ParserNode* node);
+
+/**
+ * @brief gets the foldable builtin called by the node
+ *
+ * @param oc context
+ * @param node function call node
+ * @return _OptBuiltin* the builtin or NULL if the node doesn't call foldable builtin
+ */
+_OptBuiltin* _optGetBuiltin(_OptContext* oc, ParserNode* node);
+
+/**
+ * @brief replaces call with literal arguments with its result
+ *
+ * @param oc context
+ * @param node call node
+ * @param bi called builtin
+ * @return true the node was folded
+ * @return false the call would raise exception or some of the arguments is not literal
+ */
+_Bool _optFold(_OptContext* oc, ParserNode* node, _OptBuiltin* bi);
+
+/**
+ * @brief removes identity operation such as [* x 1]
+ *
+ * @param oc context
+ * @param node call node
+ * @param bi called builtin
+ * @return true the node was simplified
+ * @return false the node cannot be simplified
+ */
+_Bool _optSimplify(_OptContext* oc, ParserNode* node, _OptBuiltin* bi);
+
+/**
+ * @brief determines the type of the value of the node if it is known
+ * and the node cannot raise exception
+ *
+ * @param oc context
+ * @param node node to examine
+ * @param depth how many levels of calls may be examined
+ * @return VariableType V_INT, V_FLOAT or V_NOTHING if unknown
+ */
+VariableType _optType(_OptContext* oc, ParserNode* node, size_t depth);
+
+void optOptimize(ParserTree* tree)
+{
+    cpBuild(tree);
+
+    _OptContext context =
+    {
+        .pool = tree->constants,
+        .fun = rtCreateFunction(NULL, listNew(String)),
+        .runtime = rtCreate(NULL, NULL),
+        .builtins =
+        {
+            { .name = strLit("+"), .action = bifAdd, .identity = 0, .rightOnly = 0, .floatSafe = 0 },
+            { .name = strLit("*"), .action = bifMultiply, .identity = 1, .rightOnly = 0, .floatSafe = 1 },
+            { .name = strLit("-"), .action = bifSubtract, .identity = 0, .rightOnly = 1, .floatSafe = 1 },
+            { .name = strLit("/"), .action = bifDivide, .identity = 1, .rightOnly = 1, .floatSafe = 1 },
+            { .name = strLit("%"), .action = bifMod, .identity = -1, .rightOnly = 1, .floatSafe = 0 },
+        },
+    };
+    _OptContext* oc = &context;
+
+    for (size_t i = 0; i < tree->nodes.length; i++)
+        _optFindShadowed(oc, listGetP(tree->nodes, i));
+
+    for (size_t i = 0; i < tree->nodes.length; i++)
+        _optNode(oc, listGetP(tree->nodes, i));
+
+    for (size_t i = 0; i < _OPT_BUILTIN_COUNT; i++)
+        strFree(oc->builtins[i].name);
+    rtFreeFunction(oc->fun);
+    rtFree(oc->runtime);
+}
+
+void _optFindShadowed(_OptContext* oc, ParserNode* node)
+{
+    List pending = listNew(ParserNode*);
+    listAdd(pending, node, ParserNode*);
+    while (pending.length)
+    {
+        ParserNode* n = listGet(pending, --pending.length, ParserNode*);
+        switch (n->type)
+        {
+        case P_VARIABLE_SETTER:
+        case P_FUNCTION_SETTER:
+            _optShadow(oc, n->token->string);
+            break;
+        case P_FUNCTION_DEFINITION:
+            // all but the last child are parameters
+            for (size_t i = 0; i + 1 < n->nodes.length; i++)
+            {
+                ParserNode* p = listGetP(n->nodes, i);
+                if (p->type == P_IDENTIFIER)
+                    _optShadow(oc, p->token->string);
+            }
+            break;
+        default:
+            break;
+        }
+
+        for (size_t i = 0; i < n->nodes.length; i++)
+            listAdd(pending, listGetP(n->nodes, i), ParserNode*);
+    }
+    listFree(pending);
+}
+
+void _optShadow(_OptContext* oc, String name)
+{
+    for (size_t i = 0; i < _OPT_BUILTIN_COUNT; i++)
+    {
+        if (strEquals(oc->builtins[i].name, name))
+            oc->builtins[i].shadowed = 1;
+    }
+}
+
+void _optNode(_OptContext* oc, ParserNode* node)
+{
+    // post-order walk on explicit stack, the childs are optimized before
+    // their parent so that folded calls can be folded further
+    List pending = listNew(_OptPending);
+    listAdd(pending, ((_OptPending){ .node = node, .expanded = 0 }), _OptPending);
+    while (pending.length)
+    {
+        _OptPending p = listGet(pending, --pending.length, _OptPending);
+        if (!p.expanded)
+        {
+            p.expanded = 1;
+            listAdd(pending, p, _OptPending);
+            for (size_t i = p.node->nodes.length; i > 0; i--)
+                listAdd(pending, ((_OptPending){ .node = listGetP(p.node->nodes, i - 1), .expanded = 0 }), _OptPending);
+            continue;
+        }
+
+        if (p.node->type != P_FUNCTION_CALL)
+            continue;
+
+        _OptBuiltin* bi = _optGetBuiltin(oc, p.node);
+        if (!bi)
+            continue;
+
+        if (_optFold(oc, p.node, bi))
+            continue;
+        _optSimplify(oc, p.node, bi);
+    }
+    listFree(pending);
+}
+
+_OptBuiltin* _optGetBuiltin(_OptContext* oc, ParserNode* node)
+{
+    assert(node->nodes.length > 0);
+
+    ParserNode* head = listGetP(node->nodes, 0);
+    if (head->type != P_IDENTIFIER)
+        return NULL;
+
+    for (size_t i = 0; i < _OPT_BUILTIN_COUNT; i++)
+    {
+        _OptBuiltin* bi = &oc->builtins[i];
+        if (!bi->shadowed && strEquals(bi->name, head->token->string))
+            return bi;
+    }
+    return NULL;
+}
+
+_Bool _optFold(_OptContext* oc, ParserNode* node, _OptBuiltin* bi)
+{
+    for (size_t i = 1; i < node->nodes.length; i++)
+    {
+        if (!listGet(node->nodes, i, ParserNode).value)
+            return 0;
+    }
+
+    List par = listNew(Variable);
+    for (size_t i = 1; i < node->nodes.length; i++)
+        listAdd(par, *listGet(node->nodes, i, ParserNode).value, Variable);
+
+    // the arithmetic builtins use only the heap of the runtime
+    Variable res = bi->action(&oc->fun, &oc->runtime, par);
+
+    FilePos pos = listGet(node->nodes, 0, ParserNode).token->pos;
+    ParserNode folded;
+    switch (res.type)
+    {
+    case V_BOOL:
+        folded = ptTokenNode(P_VALUE_BOOL, tokenBool(T_LITERAL_BOOL, res.boolean, pos));
+        break;
+    case V_INT:
+        folded = ptTokenNode(P_VALUE_INTEGER, tokenInt(T_LITERAL_INTEGER, res.integer, pos));
+        break;
+    case V_FLOAT:
+        folded = ptTokenNode(P_VALUE_FLOAT, tokenFloat(T_LITERAL_FLOAT, res.decimal, pos));
+        break;
+    case V_BIGINT:
+        folded = ptTokenNode(P_VALUE_BIGINT, tokenStr(T_LITERAL_BIGINT, bigToString(res.big), pos));
+        break;
+    default:
+        // exceptions must be raised at runtime
+        rtFreeVariable(res);
+        return 0;
+    }
+
+    ptFreeNode(*node, 1);
+    *node = folded;
+    cpAddNode(oc->pool, node);
+    return 1;
+}
+
+_Bool _optSimplify(_OptContext* oc, ParserNode* node, _OptBuiltin* bi)
+{
+    if (bi->identity < 0 || node->nodes.length != 3)
+        return 0;
+
+    for (size_t i = bi->rightOnly ? 2 : 1; i < 3; i++)
+    {
+        ParserNode* id = listGetP(node->nodes, i);
+        if (id->type != P_VALUE_INTEGER || id->token->integer != bi->identity)
+            continue;
+
+        ParserNode* x = listGetP(node->nodes, 3 - i);
+        VariableType t = _optType(oc, x, _OPT_TYPE_DEPTH);
+        if (t != V_INT && (t != V_FLOAT || !bi->floatSafe))
+            continue;
+
+        ParserNode keep = *x;
+        ptFreeNode(listGet(node->nodes, 0, ParserNode), 1);
+        ptFreeNode(*id, 1);
+        listFree(node->nodes);
+        *node = keep;
+        return 1;
+    }
+    return 0;
+}
+
+VariableType _optType(_OptContext* oc, ParserNode* node, size_t depth)
+{
+    switch (node->type)
+    {
+    case P_VALUE_INTEGER:
+        return V_INT;
+    case P_VALUE_FLOAT:
+        return V_FLOAT;
+    case P_FUNCTION_CALL:
+        if (depth == 0)
+            return V_NOTHING;
+        break;
+    default:
+        return V_NOTHING;
+    }
+
+    _OptBuiltin* bi = _optGetBuiltin(oc, node);
+    // division and modulo may raise exception
+    if (!bi || bi->action == bifDivide || bi->action == bifMod)
+        return V_NOTHING;
+    if (bi->action == bifSubtract && (node->nodes.length < 2 || node->nodes.length > 3))
+        return V_NOTHING;
+
+    VariableType res = V_INT;
+    for (size_t i = 1; i < node->nodes.length; i++)
+    {
+        switch (_optType(oc, listGetP(node->nodes, i), depth - 1))
+        {
+        case V_INT:
+            continue;
+        case V_FLOAT:
+            res = V_FLOAT;
+            continue;
+        default:
+            return V_NOTHING;
+        }
+    }
+
+    // [+] and [*] return bool
+    return node->nodes.length > 1 ? res : V_NOTHING;
+}
@@ -0,0 +1,15 @@
+#ifndef opt_OPTIMIZER_INCLUDED
+#define opt_OPTIMIZER_INCLUDED
+
+#include "ParserTree.h"
+
+/**
+ * @brief folds calls to the arithmetic builtins with literal arguments
+ * and removes identity operations where it doesn't change the result,
+ * calls that would raise exception are kept so that they raise at runtime
+ *
+ * @param tree tree to optimize, constant pool is created if it is missing
+ */
+void optOptimize(ParserTree* tree);
+
+#endif // opt_OPTIMIZER_INCLUDED
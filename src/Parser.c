@@ -2,52 +2,161 @@
 
 #include <stdlib.h>
 #include <stdint.h>
+#include <string.h>
 #include <assert.h>
 
 #include "ParserTree.h"
 #include "List.h"
 #include "Errors.h"
 #include "DebugTools.h"
+#include "BuiltinFunctions.h"
 
 #define _parNextToken(__list, __i, __name, __ifnot) if(__i+1<__list.length)__name=*(Token*)listGetP(__list, ++__i);else{__ifnot;}
 #define _parNextTokenP(__list, __i, __name, __ifnot) if(*__i+1<__list->length)__name=*(Token*)listGetP(*__list, ++*__i);else{__ifnot;}
 
+typedef enum _ParFrameType
+{
+    // reads arguments of function call
+    PAR_CALL,
+    // waits for the head of function call that starts with [[
+    PAR_HEAD,
+    // waits for the body of function definition
+    PAR_DEF,
+    // waits for the value of setter
+    PAR_SET,
+} _ParFrameType;
+
+/**
+ * @brief node that is being parsed, the frames replace the recursion so
+ * the nesting depth is limited only by memory
+ *
+ */
+typedef struct _ParFrame
+{
+    _ParFrameType type;
+    ParserNode node;
+    // PAR_SET: name of the variable
+    Token token;
+} _ParFrame;
+
 void _parErrAddP(List* list, ErrorToken item);
 
 /**
- * @brief creates function call node
- * 
- * @param function what will return the function
+ * @brief pushes new frame to the stack
+ *
+ * @param stack stack of frames
+ * @param type type of the frame
+ * @param node node that is being parsed
+ * @param token name of the variable for setter, NULL for other frames
+ */
+void _parPush(List* stack, _ParFrameType type, ParserNode node, Token* token);
+
+/**
+ * @brief finishes parsing of node whose parsing has started
+ *
+ * @param stack stack of frames, is empty when this returns
+ * @param tokens tokens
+ * @param i position in tokens
+ * @param errors error output
+ * @param n finished node if done is true
+ * @param done true if there are no frames to finish
+ * @return ParserNode the parsed node
+ */
+ParserNode _parRun(List* stack, List* tokens, size_t* i, List* errors, ParserNode n, _Bool done);
+
+/**
+ * @brief reads the next part of the node on top of the stack
+ *
+ * @param stack stack of frames
  * @param tokens tokens
  * @param i position in tokens
  * @param errors error output
- * @return ParserNode function call
+ * @param out finished node
+ * @return true out must be given to the frame on top of the stack
+ * @return false the parsing continues
  */
-ParserNode _parFunctionCall(ParserNode function, List* tokens, size_t* i, List* errors);
+_Bool _parStep(List* stack, List* tokens, size_t* i, List* errors, ParserNode* out);
+
+/**
+ * @brief gives finished node to the frame on top of the stack
+ *
+ * @param stack stack of frames
+ * @param tokens tokens
+ * @param i position in tokens
+ * @param errors error output
+ * @param n finished node, replaced by node of the top frame if it finishes
+ * @return true the top frame was finished and popped, n must be given to the next one
+ * @return false the parsing continues
+ */
+_Bool _parDeliver(List* stack, List* tokens, size_t* i, List* errors, ParserNode* n);
+
+/**
+ * @brief turns finished call of special form (lazy, if, and, or, cond, memo,
+ * import) into node of its own type
+ *
+ * @param call finished function call
+ * @param errors error output
+ * @return ParserNode the call or the special form
+ */
+ParserNode _parSpecialForm(ParserNode call, List* errors);
+
+/**
+ * @brief finds call of builtin with side effects in body of memoized function
+ *
+ * @param def the function definition
+ * @return ParserNode* identifier of the builtin or NULL if the body is pure
+ */
+ParserNode* _parFindSideEffect(ParserNode* def);
+
+/**
+ * @brief starts function call
+ *
+ * @param stack stack of frames
+ * @param function what will return the function
+ */
+void _parFunctionCall(List* stack, ParserNode function);
 
 /**
  * @brief evaluates given function
- * 
+ *
+ * @param stack stack of frames
  * @param tokens tokens
  * @param i position in tokens
  * @param errors error output
- * @return ParserNode value
+ * @param out value if it is finished
+ * @return true the value is finished
+ * @return false frames were pushed to the stack
  */
-ParserNode _parEvaluate(List* tokens, size_t* i, List* errors);
+_Bool _parEvaluate(List* stack, List* tokens, size_t* i, List* errors, ParserNode* out);
 
 /**
  * @brief defines function
- * 
+ *
+ * @param stack stack of frames
+ * @param tokens tokens
+ * @param i position in tokens
+ * @param errors error output
+ * @param out value if it is finished
+ * @return true the value is finished
+ * @return false frame was pushed to the stack
+ */
+_Bool _parDef(List* stack, List* tokens, size_t* i, List* errors, ParserNode* out);
+
+/**
+ * @brief finishes function definition on top of the stack
+ *
+ * @param stack stack of frames
  * @param tokens tokens
  * @param i position in tokens
  * @param errors error output
- * @return ParserNode value
+ * @param out function definition
+ * @return true always
  */
-ParserNode _parDef(List* tokens, size_t* i, List* errors);
+_Bool _parDefEnd(List* stack, List* tokens, size_t* i, List* errors, ParserNode* out);
 
 /**
  * @brief defines structure
- * 
+ *
  * @param tokens tokens
  * @param i position in tokens
  * @param errors error output
@@ -57,17 +166,44 @@ ParserNode _parStruct(List* tokens, size_t* i, List* errors);
 
 /**
  * @brief sets a variable or function
- * 
+ *
+ * @param stack stack of frames
+ * @param tokens tokens
+ * @param i position in tokens
+ * @param errors error output
+ * @param out value if it is finished
+ * @return true the value is finished
+ * @return false frame was pushed to the stack
+ */
+_Bool _parSet(List* stack, List* tokens, size_t* i, List* errors, ParserNode* out);
+
+/**
+ * @brief finishes setter on top of the stack
+ *
+ * @param stack stack of frames
  * @param tokens tokens
  * @param i position in tokens
  * @param errors error output
- * @return ParserNode variable
+ * @param n value of the setter, replaced by the setter
+ * @return true always
  */
-ParserNode _parSet(List* tokens, size_t* i, List* errors);
+_Bool _parSetEnd(List* stack, List* tokens, size_t* i, List* errors, ParserNode* n);
+
+/**
+ * @brief skips to the closing bracket after single statement
+ *
+ * @param tokens tokens
+ * @param i position in tokens
+ * @param errors error output
+ * @param t current token
+ * @return true the bracket was found
+ * @return false unexpected end
+ */
+_Bool _parSkipToClose(List* tokens, size_t* i, List* errors, Token t);
 
 /**
  * @brief defines function or variable signature
- * 
+ *
  * @param tokens tokens
  * @param i position in tokens
  * @param errors error output
@@ -77,7 +213,7 @@ ParserNode _parSign(List* tokens, size_t* i, List* errors);
 
 /**
  * @brief returns nothing :)
- * 
+ *
  * @param tokens tokens
  * @param i position in tokens
  * @param errors error output
@@ -87,20 +223,26 @@ ParserNode _parNothing(List* tokens, size_t* i, List* errors);
 
 /**
  * @brief gets value
- * 
+ *
+ * @param stack stack of frames
  * @param tokens tokens
  * @param i position in tokens
  * @param errors error output
  * @param out token output
- * @return true value readed
- * @return false closing bracket encountered
+ * @return 1 value readed
+ * @return 2 value is nested call, frames were pushed to the stack
+ * @return 3 frames were pushed to the stack and out must be given to the top one
+ * @return 0 closing bracket encountered
+ * @return -1 invalid token
+ * @return -2 unexpected end
  */
-int _parValue(List* tokens, size_t* i, List* errors, ParserNode* out);
+int _parValue(List* stack, List* tokens, size_t* i, List* errors, ParserNode* out);
 
 ParserTree parParse(List tokens, List* errors)
 {
     ParserTree tree = ptCreate();
     List errs = listNew(ErrorToken);
+    List stack = listNew(_ParFrame);
 
     for (size_t i = 0; i < tokens.length; i++)
     {
@@ -111,38 +253,47 @@ ParserTree parParse(List tokens, List* errors)
             continue;
         }
         _parNextToken(tokens, i, t, continue);
+
+        ParserNode n;
+        _Bool done;
         switch (t.type)
         {
         case T_PUNCTUATION_BRACKET_OPEN:
-            ptAdd(&tree, _parEvaluate(&tokens, &i, &errs));
-            continue;
+            done = _parEvaluate(&stack, &tokens, &i, &errs, &n);
+            break;
         case T_PUNCTUATION_BRACKET_CLOSE:
             continue;
         case T_IDENTIFIER_FUNCTION:
-            ptAdd(&tree, _parFunctionCall(ptTokenNode(P_IDENTIFIER, t), &tokens, &i, &errs));
-            continue;
+            _parFunctionCall(&stack, ptTokenNode(P_IDENTIFIER, t));
+            done = 0;
+            break;
         case T_KEYWORD_DEF:
-            ptAdd(&tree, _parDef(&tokens, &i, &errs));
-            continue;
+            done = _parDef(&stack, &tokens, &i, &errs, &n);
+            break;
         case T_KEYWORD_STRUCT:
-            ptAdd(&tree, _parStruct(&tokens, &i, &errs));
-            continue;
+            n = _parStruct(&tokens, &i, &errs);
+            done = 1;
+            break;
         case T_KEYWORD_SET:
-            ptAdd(&tree, _parSet(&tokens, &i, &errs));
-            continue;
+            done = _parSet(&stack, &tokens, &i, &errs, &n);
+            break;
         case T_KEYWORD_SIGN:
-            ptAdd(&tree, _parSign(&tokens, &i, &errs));
-            continue;
+            n = _parSign(&tokens, &i, &errs);
+            done = 1;
+            break;
         case T_OPERATOR_NOTHING:
             listAdd(errs, errCreateErrorToken(E_WARNING, t, "call with nothing", "did you forget to remove _?"), ErrorToken);
             _parNothing(&tokens, &i, &errs);
             continue;
         default:
             listAdd(errs, errCreateErrorToken(E_ERROR, t, "expected [, ], function identifier, def, struct, set, defined or _", "use anything of the things specified above"), ErrorToken);
-            break;
+            continue;
         }
+
+        ptAdd(&tree, _parRun(&stack, &tokens, &i, &errs, n, done));
     }
 
+    listFree(stack);
     if (errors)
         *errors = errs;
     else
@@ -150,63 +301,337 @@ ParserTree parParse(List tokens, List* errors)
     return tree;
 }
 
-ParserNode _parFunctionCall(ParserNode function, List* tokens, size_t* i, List* errors)
+void _parPush(List* stack, _ParFrameType type, ParserNode node, Token* token)
 {
-    ParserNode call = ptCreateNode(P_FUNCTION_CALL);
-    ptNodeAdd(&call, function);
-    while (*i < tokens->length)
+    _ParFrame frame =
     {
-        ParserNode n;
-        switch (_parValue(tokens, i, errors, &n))
+        .type = type,
+        .node = node,
+        .token = token ? *token : tokenCreate(T_ERROR, (FilePos){ 0 }),
+    };
+    listAddP(stack, &frame);
+}
+
+ParserNode _parRun(List* stack, List* tokens, size_t* i, List* errors, ParserNode n, _Bool done)
+{
+    while (stack->length)
+    {
+        if (done)
+            done = _parDeliver(stack, tokens, i, errors, &n);
+        else
+            done = _parStep(stack, tokens, i, errors, &n);
+    }
+    assert(done);
+    return n;
+}
+
+_Bool _parStep(List* stack, List* tokens, size_t* i, List* errors, ParserNode* out)
+{
+    _ParFrame* f = listGetP(*stack, stack->length - 1);
+    ParserNode n;
+    switch (f->type)
+    {
+    case PAR_CALL:
+        if (*i >= tokens->length)
+        {
+            _parErrAddP(errors, errCreateErrorToken(E_ERROR, tokenCreate(T_ERROR, listGet(*tokens, tokens->length - 1, Token).pos), "expected ]", "try adding ]"));
+            *out = _parSpecialForm(listGet(*stack, --stack->length, _ParFrame).node, errors);
+            return 1;
+        }
+        switch (_parValue(stack, tokens, i, errors, &n))
         {
         case -1:
-            continue;
+        case 2:
+            return 0;
         case 1:
-            ptNodeAdd(&call, n);
-            continue;
+            ptNodeAdd(&f->node, n);
+            return 0;
+        case 3:
+            *out = n;
+            return 1;
+        default:
+            *out = _parSpecialForm(listGet(*stack, --stack->length, _ParFrame).node, errors);
+            return 1;
+        }
+    case PAR_DEF:
+        switch (_parValue(stack, tokens, i, errors, &n))
+        {
+        case -2:
+            *out = listGet(*stack, --stack->length, _ParFrame).node;
+            return 1;
+        case 1:
+            ptNodeAdd(&f->node, n);
+            break;
+        case 2:
+            return 0;
+        case 3:
+            *out = n;
+            return 1;
         default:
-            return call;
+            break;
         }
+        return _parDefEnd(stack, tokens, i, errors, out);
+    case PAR_SET:
+        switch (_parValue(stack, tokens, i, errors, &n))
+        {
+        case 0:
+        {
+            Token t = f->token;
+            stack->length--;
+            _parErrAddP(errors, errCreateErrorToken(E_WARNING, t, "variable is nothing", "if this is intentional set it to _"));
+            ParserNode set = ptTokenNode(P_VARIABLE_SETTER, t);
+            ptNodeAdd(&set, ptCreateNode(P_NOTHING));
+            _parNextTokenP(tokens, i, t,
+                _parErrAddP(errors, errCreateErrorToken(E_ERROR, tokenCreate(T_ERROR, listGet(*tokens, tokens->length - 1, Token).pos), "expected ]", "try closing the function body"));
+                *out = ptCreateNode(P_ERROR);
+                return 1;
+            )
+            *out = _parSkipToClose(tokens, i, errors, t) ? set : ptCreateNode(P_ERROR);
+            return 1;
+        }
+        case 1:
+            *out = n;
+            return _parSetEnd(stack, tokens, i, errors, out);
+        case 2:
+            return 0;
+        case 3:
+            *out = n;
+            return 1;
+        default:
+            stack->length--;
+            _parSkipToClose(tokens, i, errors, f->token);
+            *out = ptCreateNode(P_ERROR);
+            return 1;
+        }
+    default:
+        dtExcept("_parStep: frame cannot read");
+        return 0;
     }
-    _parErrAddP(errors, errCreateErrorToken(E_ERROR, tokenCreate(T_ERROR, listGet(*tokens, tokens->length - 1, Token).pos), "expected ]", "try adding ]"));
-    return call;
 }
 
-ParserNode _parEvaluate(List *tokens, size_t *i, List* errors)
+_Bool _parDeliver(List* stack, List* tokens, size_t* i, List* errors, ParserNode* n)
 {
-    Token t;
-    _parNextTokenP(tokens, i, t,
-        _parErrAddP(errors, errCreateErrorToken(E_ERROR, tokenCreate(T_ERROR, listGet(*tokens, tokens->length - 1, Token).pos), "unexpected end", "add function call"));
-        return ptCreateNode(P_ERROR);
-    );
-    switch (t.type)
+    _ParFrame* f = listGetP(*stack, stack->length - 1);
+    switch (f->type)
     {
-    case T_PUNCTUATION_BRACKET_OPEN:
-        return _parFunctionCall(_parEvaluate(tokens, i, errors), tokens, i, errors);
-    case T_PUNCTUATION_BRACKET_CLOSE:
-        return ptCreateNode(P_NOTHING);
-    case T_IDENTIFIER_FUNCTION:
-        return _parFunctionCall(ptTokenNode(P_IDENTIFIER, t), tokens, i, errors);
-    case T_KEYWORD_DEF:
-        return _parDef(tokens, i, errors);
-    case T_KEYWORD_SET:
-        return _parSet(tokens, i, errors);
-    case T_OPERATOR_NOTHING:
-        _parErrAddP(errors, errCreateErrorToken(E_WARNING, t, "call with nothing", "did you forget to remove _?"));
-        return _parNothing(tokens, i, errors);
+    case PAR_HEAD:
+        f->type = PAR_CALL;
+        f->node = ptCreateNode(P_FUNCTION_CALL);
+        ptNodeAdd(&f->node, *n);
+        return 0;
+    case PAR_CALL:
+        ptNodeAdd(&f->node, *n);
+        return 0;
+    case PAR_DEF:
+        ptNodeAdd(&f->node, *n);
+        return _parDefEnd(stack, tokens, i, errors, n);
+    case PAR_SET:
+        return _parSetEnd(stack, tokens, i, errors, n);
+    default:
+        dtExcept("_parDeliver: invalid frame");
+        return 0;
+    }
+}
+
+ParserNode _parSpecialForm(ParserNode call, List* errors)
+{
+    ParserNode* head = listGetP(call.nodes, 0);
+    if (head->type != P_IDENTIFIER)
+        return call;
+
+    const char* name = head->token->string.c;
+    ParserNodeType type;
+    if (strcmp(name, "lazy") == 0)
+        type = P_LAZY;
+    else if (strcmp(name, "if") == 0)
+        type = P_IF;
+    else if (strcmp(name, "and") == 0)
+        type = P_AND;
+    else if (strcmp(name, "or") == 0)
+        type = P_OR;
+    else if (strcmp(name, "cond") == 0)
+        type = P_COND;
+    else if (strcmp(name, "memo") == 0)
+        type = P_MEMO;
+    else if (strcmp(name, "import") == 0)
+        type = P_IMPORT;
+    else
+        return call;
+
+    const char* msg = NULL;
+    const char* help = NULL;
+    Token* at = head->token;
+    size_t argc = call.nodes.length - 1;
+    switch (type)
+    {
+    case P_LAZY:
+        if (argc != 1)
+        {
+            msg = "lazy takes exactly one expression";
+            help = "use [lazy [...]]";
+        }
+        break;
+    case P_IF:
+        if (argc != 2 && argc != 3)
+        {
+            msg = "if takes condition and one or two branches";
+            help = "use [if condition then else]";
+        }
+        break;
+    case P_COND:
+        for (size_t j = 1; j < call.nodes.length; j++)
+        {
+            ParserNode* clause = listGetP(call.nodes, j);
+            if (clause->type != P_FUNCTION_CALL || clause->nodes.length != 2)
+            {
+                msg = "cond clause must have condition and value";
+                help = "use [cond [condition value] ...]";
+            }
+        }
+        break;
+    case P_MEMO:
+    {
+        ParserNode* def = argc ? listGetP(call.nodes, argc) : NULL;
+        ParserNode* capacity = argc == 2 ? listGetP(call.nodes, 1) : NULL;
+        ParserNode* impure = NULL;
+        if ((argc != 1 && argc != 2) || def->type != P_FUNCTION_DEFINITION)
+        {
+            msg = "memo takes function definition";
+            help = "use [memo [def ...]] or [memo capacity [def ...]]";
+        }
+        else if (capacity && (capacity->type != P_VALUE_INTEGER || capacity->token->integer <= 0))
+        {
+            msg = "memo capacity must be positive integer literal";
+            help = "use [memo capacity [def ...]]";
+        }
+        else if ((impure = _parFindSideEffect(def)))
+        {
+            // cached calls would skip the side effect
+            at = impure->token;
+            msg = "memoized function cannot call function with side effects";
+            help = "remove the memo";
+        }
+        break;
+    }
+    case P_IMPORT:
+        // the modules are found before the program runs
+        if (argc != 1 || ((ParserNode*)listGetP(call.nodes, 1))->type != P_VALUE_STRING)
+        {
+            msg = "import takes string literal";
+            help = "use [import \"file\"]";
+        }
+        break;
     default:
-        _parErrAddP(errors, errCreateErrorToken(E_ERROR, t, "expected [, ], function identifier, def, set or _", "use one of the above"));
-        _parNothing(tokens, i, errors);
+        break;
+    }
+
+    if (msg)
+    {
+        _parErrAddP(errors, errCreateErrorToken(E_ERROR, tokenCreate(T_ERROR, at->pos), msg, help));
+        ptFreeNode(call, 1);
         return ptCreateNode(P_ERROR);
     }
+
+    // the head is not needed, the arguments are the childs
+    ptFreeNode(*head, 1);
+    ParserNode form = ptCreateNode(type);
+    for (size_t j = 1; j < call.nodes.length; j++)
+    {
+        ParserNode n = listGet(call.nodes, j, ParserNode);
+        if (type != P_COND)
+        {
+            ptNodeAdd(&form, n);
+            continue;
+        }
+        // the clauses are flattened to pairs of condition and value,
+        // literal cannot be head of call so [else x] stands for [true x]
+        ParserNode c = listGet(n.nodes, 0, ParserNode);
+        if (c.type == P_IDENTIFIER && strcmp(c.token->string.c, "else") == 0)
+        {
+            FilePos pos = c.token->pos;
+            ptFreeNode(c, 1);
+            c = ptTokenNode(P_VALUE_BOOL, tokenBool(T_LITERAL_BOOL, 1, pos));
+        }
+        ptNodeAdd(&form, c);
+        ptNodeAdd(&form, listGet(n.nodes, 1, ParserNode));
+        listFree(n.nodes);
+    }
+    listFree(call.nodes);
+    return form;
 }
 
-ParserNode _parDef(List* tokens, size_t* i, List* errors)
+ParserNode* _parFindSideEffect(ParserNode* def)
+{
+    List pending = listNew(ParserNode*);
+    listAdd(pending, listGetP(def->nodes, def->nodes.length - 1), ParserNode*);
+    while (pending.length)
+    {
+        ParserNode* n = listGet(pending, --pending.length, ParserNode*);
+        if (n->type == P_IDENTIFIER && bifHasSideEffects(n->token->string.c))
+        {
+            listFree(pending);
+            return n;
+        }
+        for (size_t i = 0; i < n->nodes.length; i++)
+            listAdd(pending, listGetP(n->nodes, i), ParserNode*);
+    }
+    listFree(pending);
+    return NULL;
+}
+
+void _parFunctionCall(List* stack, ParserNode function)
+{
+    ParserNode call = ptCreateNode(P_FUNCTION_CALL);
+    ptNodeAdd(&call, function);
+    _parPush(stack, PAR_CALL, call, NULL);
+}
+
+_Bool _parEvaluate(List* stack, List *tokens, size_t *i, List* errors, ParserNode* out)
+{
+    while (1)
+    {
+        Token t;
+        _parNextTokenP(tokens, i, t,
+            _parErrAddP(errors, errCreateErrorToken(E_ERROR, tokenCreate(T_ERROR, listGet(*tokens, tokens->length - 1, Token).pos), "unexpected end", "add function call"));
+            *out = ptCreateNode(P_ERROR);
+            return 1;
+        );
+        switch (t.type)
+        {
+        case T_PUNCTUATION_BRACKET_OPEN:
+            // the nested value is the head of the call
+            _parPush(stack, PAR_HEAD, (ParserNode){ .type = P_NOTHING }, NULL);
+            continue;
+        case T_PUNCTUATION_BRACKET_CLOSE:
+            *out = ptCreateNode(P_NOTHING);
+            return 1;
+        case T_IDENTIFIER_FUNCTION:
+            _parFunctionCall(stack, ptTokenNode(P_IDENTIFIER, t));
+            return 0;
+        case T_KEYWORD_DEF:
+            return _parDef(stack, tokens, i, errors, out);
+        case T_KEYWORD_SET:
+            return _parSet(stack, tokens, i, errors, out);
+        case T_OPERATOR_NOTHING:
+            _parErrAddP(errors, errCreateErrorToken(E_WARNING, t, "call with nothing", "did you forget to remove _?"));
+            *out = _parNothing(tokens, i, errors);
+            return 1;
+        default:
+            _parErrAddP(errors, errCreateErrorToken(E_ERROR, t, "expected [, ], function identifier, def, set or _", "use one of the above"));
+            _parNothing(tokens, i, errors);
+            *out = ptCreateNode(P_ERROR);
+            return 1;
+        }
+    }
+}
+
+_Bool _parDef(List* stack, List* tokens, size_t* i, List* errors, ParserNode* out)
 {
     Token t;
     _parNextTokenP(tokens, i, t,
         _parErrAddP(errors, errCreateErrorToken(E_ERROR, tokenCreate(T_ERROR, listGet(*tokens, tokens->length - 1, Token).pos), "expected function definition", "consider adding function parameters and its body"));
-        return ptCreateNode(P_ERROR);
+        *out = ptCreateNode(P_ERROR);
+        return 1;
     )
     if (t.type != T_PUNCTUATION_BRACKET_OPEN)
     {
@@ -216,10 +641,12 @@ ParserNode _parDef(List* tokens, size_t* i, List* errors)
             tokenFree(t);
             _parNextTokenP(tokens, i, t,
                 _parErrAddP(errors, errCreateErrorToken(E_ERROR, tokenCreate(T_ERROR, listGet(*tokens, tokens->length - 1, Token).pos), "expected ]", "consider closing the function body"));
-                return ptCreateNode(P_ERROR);
+                *out = ptCreateNode(P_ERROR);
+                return 1;
             )
         }
-        return ptCreateNode(P_ERROR);
+        *out = ptCreateNode(P_ERROR);
+        return 1;
     }
 
     ParserNode node = ptCreateNode(P_FUNCTION_DEFINITION);
@@ -244,32 +671,22 @@ ParserNode _parDef(List* tokens, size_t* i, List* errors)
         };
     }
 
-    ParserNode n;
-    switch (_parValue(tokens, i, errors, &n))
-    {
-        case -2:
-            return node;
-        case 1:
-            ptNodeAdd(&node, n);
-            break;
-        default:
-            break;
-    }
+    // the body is read by _parStep
+    _parPush(stack, PAR_DEF, node, NULL);
+    return 0;
+}
+
+_Bool _parDefEnd(List* stack, List* tokens, size_t* i, List* errors, ParserNode* out)
+{
+    *out = listGet(*stack, --stack->length, _ParFrame).node;
 
+    Token t;
     _parNextTokenP(tokens, i, t,
         _parErrAddP(errors, errCreateErrorToken(E_ERROR, tokenCreate(T_ERROR, listGet(*tokens, tokens->length - 1, Token).pos), "expected ]", "try closing the function body"));
-        return node;
+        return 1;
     )
-
-    while (t.type != T_PUNCTUATION_BRACKET_CLOSE)
-    {
-        _parErrAddP(errors, errCreateErrorToken(E_ERROR, t, "expected ]", "function body can only contain one statement"));
-        _parNextTokenP(tokens, i, t,
-            _parErrAddP(errors, errCreateErrorToken(E_ERROR, tokenCreate(T_ERROR, listGet(*tokens, tokens->length - 1, Token).pos), "expected ]", "try closing the function body"));
-            return node;
-        )
-    }
-    return node;
+    _parSkipToClose(tokens, i, errors, t);
+    return 1;
 }
 
 ParserNode _parStruct(List *tokens, size_t *i, List *errors)
@@ -278,12 +695,13 @@ ParserNode _parStruct(List *tokens, size_t *i, List *errors)
     return ptCreateNode(P_ERROR);
 }
 
-ParserNode _parSet(List* tokens, size_t* i, List* errors)
+_Bool _parSet(List* stack, List* tokens, size_t* i, List* errors, ParserNode* out)
 {
     Token t;
     _parNextTokenP(tokens, i, t,
         _parErrAddP(errors, errCreateErrorToken(E_ERROR, tokenCreate(T_ERROR, listGet(*tokens, tokens->length - 1, Token).pos), "unexpected end", "add a variable name"));
-        return ptCreateNode(P_ERROR);
+        *out = ptCreateNode(P_ERROR);
+        return 1;
     )
 
     if (t.type != T_IDENTIFIER_VARIABLE)
@@ -292,60 +710,43 @@ ParserNode _parSet(List* tokens, size_t* i, List* errors)
         if (t.type == T_PUNCTUATION_BRACKET_CLOSE)
         {
             _parErrAddP(errors, errCreateErrorToken(E_ERROR, t, "expected value before ]", "try adding here a value"));
-            return ptCreateNode(P_ERROR);
+            *out = ptCreateNode(P_ERROR);
+            return 1;
         }
     }
 
-    ParserNode set;
-    ParserNode n;
-    switch (_parValue(tokens, i, errors, &n))
-    {
-    case 0:
-        _parErrAddP(errors, errCreateErrorToken(E_WARNING, t, "variable is nothing", "if this is intentional set it to _"));
-        set = ptTokenNode(P_VARIABLE_SETTER, t);
-        ptNodeAdd(&set, ptCreateNode(P_NOTHING));
-        _parNextTokenP(tokens, i, t,
-            _parErrAddP(errors, errCreateErrorToken(E_ERROR, tokenCreate(T_ERROR, listGet(*tokens, tokens->length - 1, Token).pos), "expected ]", "try closing the function body"));
-            return ptCreateNode(P_ERROR);
-        )
-        while (t.type != T_PUNCTUATION_BRACKET_CLOSE)
-        {
-            _parErrAddP(errors, errCreateErrorToken(E_ERROR, t, "expected ]", "function body can only contain one statement"));
-            _parNextTokenP(tokens, i, t,
-                _parErrAddP(errors, errCreateErrorToken(E_ERROR, tokenCreate(T_ERROR, listGet(*tokens, tokens->length - 1, Token).pos), "expected ]", "try closing the function body"));
-                return ptCreateNode(P_ERROR);
-            )
-        }
-        return set;
-    case 1:
-        set = ptTokenNode(n.type == P_FUNCTION_DEFINITION ? P_FUNCTION_SETTER : P_VARIABLE_SETTER, t);
-        ptNodeAdd(&set, n);
-        _parNextTokenP(tokens, i, t,
-            _parErrAddP(errors, errCreateErrorToken(E_ERROR, tokenCreate(T_ERROR, listGet(*tokens, tokens->length - 1, Token).pos), "expected ]", "try closing the function body"));
-            return ptCreateNode(P_ERROR);
-        )
-        while (t.type != T_PUNCTUATION_BRACKET_CLOSE)
-        {
-            _parErrAddP(errors, errCreateErrorToken(E_ERROR, t, "expected ]", "function body can only contain one statement"));
-            _parNextTokenP(tokens, i, t,
-                _parErrAddP(errors, errCreateErrorToken(E_ERROR, tokenCreate(T_ERROR, listGet(*tokens, tokens->length - 1, Token).pos), "expected ]", "try closing the function body"));
-                return ptCreateNode(P_ERROR);
-            )
-        }
-        return set;
-    default:
-        break;
-    }
-    
+    // the value is read by _parStep
+    _parPush(stack, PAR_SET, (ParserNode){ .type = P_NOTHING }, &t);
+    return 0;
+}
+
+_Bool _parSetEnd(List* stack, List* tokens, size_t* i, List* errors, ParserNode* n)
+{
+    Token name = listGet(*stack, --stack->length, _ParFrame).token;
+    ParserNode set = ptTokenNode(n->type == P_FUNCTION_DEFINITION ? P_FUNCTION_SETTER : P_VARIABLE_SETTER, name);
+    ptNodeAdd(&set, *n);
+
+    Token t;
+    _parNextTokenP(tokens, i, t,
+        _parErrAddP(errors, errCreateErrorToken(E_ERROR, tokenCreate(T_ERROR, listGet(*tokens, tokens->length - 1, Token).pos), "expected ]", "try closing the function body"));
+        *n = ptCreateNode(P_ERROR);
+        return 1;
+    )
+    *n = _parSkipToClose(tokens, i, errors, t) ? set : ptCreateNode(P_ERROR);
+    return 1;
+}
+
+_Bool _parSkipToClose(List* tokens, size_t* i, List* errors, Token t)
+{
     while (t.type != T_PUNCTUATION_BRACKET_CLOSE)
     {
         _parErrAddP(errors, errCreateErrorToken(E_ERROR, t, "expected ]", "function body can only contain one statement"));
         _parNextTokenP(tokens, i, t,
             _parErrAddP(errors, errCreateErrorToken(E_ERROR, tokenCreate(T_ERROR, listGet(*tokens, tokens->length - 1, Token).pos), "expected ]", "try closing the function body"));
-            return ptCreateNode(P_ERROR);
+            return 0;
         )
     }
-    return ptCreateNode(P_ERROR);
+    return 1;
 }
 
 ParserNode _parSign(List* tokens, size_t* i, List* errors)
@@ -378,7 +779,7 @@ ParserNode _parNothing(List* tokens, size_t* i, List* errors)
     return ptCreateNode(P_NOTHING);
 }
 
-int _parValue(List* tokens, size_t* i, List* errors, ParserNode* out)
+int _parValue(List* stack, List* tokens, size_t* i, List* errors, ParserNode* out)
 {
     Token t;
     _parNextTokenP(tokens, i, t,
@@ -388,8 +789,13 @@ int _parValue(List* tokens, size_t* i, List* errors, ParserNode* out)
     switch (t.type)
     {
     case T_PUNCTUATION_BRACKET_OPEN:
-        *out = _parEvaluate(tokens, i, errors);
-        return 1;
+    {
+        size_t frames = stack->length;
+        _Bool done = _parEvaluate(stack, tokens, i, errors, out);
+        if (stack->length == frames)
+            return 1;
+        return done ? 3 : 2;
+    }
     case T_PUNCTUATION_BRACKET_CLOSE:
         return 0;
     case T_IDENTIFIER_VARIABLE:
@@ -398,6 +804,9 @@ int _parValue(List* tokens, size_t* i, List* errors, ParserNode* out)
     case T_LITERAL_INTEGER:
         *out = ptTokenNode(P_VALUE_INTEGER, t);
         return 1;
+    case T_LITERAL_BIGINT:
+        *out = ptTokenNode(P_VALUE_BIGINT, t);
+        return 1;
     case T_LITERAL_FLOAT:
         *out = ptTokenNode(P_VALUE_FLOAT, t);
         return 1;
@@ -7,6 +7,8 @@
 #include "Token.h"
 #include "List.h"
 #include "Stream.h"
+#include "ConstantPool.h"
+#include "Jit.h"
 
 /**
  * @brief prints the given parser node
@@ -23,6 +25,8 @@ ParserTree ptCreate()
     {
         .nodes = listNew(ParserNode),
         .filename = NULL,
+        .constants = NULL,
+        .slots = 0,
     };
     return tree;
 }
@@ -40,11 +44,30 @@ void _ptPrintNode(Stream* out, ParserNode node, size_t depth, const char* filena
     for (size_t i = 0; i < depth; i++)
         stPrintf(out, "\x1b[9%zum|", i % 8 + 1);
 
-    switch (node.type)
+    // specialized calls are printed as their specialization
+    switch (node.type == P_FUNCTION_CALL ? node.feedback.specialized : node.type)
     {
     case P_FUNCTION_CALL:
         stPrintf(out, "FUNCTION_CALL\n");
         break;
+    case P_INT_ADD:
+        stPrintf(out, "INT_ADD\n");
+        break;
+    case P_INT_SUBTRACT:
+        stPrintf(out, "INT_SUBTRACT\n");
+        break;
+    case P_INT_MULTIPLY:
+        stPrintf(out, "INT_MULTIPLY\n");
+        break;
+    case P_FLOAT_ADD:
+        stPrintf(out, "FLOAT_ADD\n");
+        break;
+    case P_FLOAT_SUBTRACT:
+        stPrintf(out, "FLOAT_SUBTRACT\n");
+        break;
+    case P_FLOAT_MULTIPLY:
+        stPrintf(out, "FLOAT_MULTIPLY\n");
+        break;
     case P_IDENTIFIER:
         stPrintf(out, "IDENTIFIER(");
         tokenPrint(out, *node.token);
@@ -61,6 +84,11 @@ void _ptPrintNode(Stream* out, ParserNode node, size_t depth, const char* filena
         tokenPrint(out, *node.token);
         stPrintf(out, ")\n");
         break;
+    case P_VALUE_BIGINT:
+        stPrintf(out, "VALUE_BIGINT(");
+        tokenPrint(out, *node.token);
+        stPrintf(out, ")\n");
+        break;
     case P_VALUE_FLOAT:
         stPrintf(out, "VALUE_FLOAT(");
         tokenPrint(out, *node.token);
@@ -84,6 +112,27 @@ void _ptPrintNode(Stream* out, ParserNode node, size_t depth, const char* filena
     case P_FUNCTION_DEFINITION:
         stPrintf(out, "FUNCTION_DEFINITION\n");
         break;
+    case P_LAZY:
+        stPrintf(out, "LAZY\n");
+        break;
+    case P_IF:
+        stPrintf(out, "IF\n");
+        break;
+    case P_AND:
+        stPrintf(out, "AND\n");
+        break;
+    case P_OR:
+        stPrintf(out, "OR\n");
+        break;
+    case P_COND:
+        stPrintf(out, "COND\n");
+        break;
+    case P_MEMO:
+        stPrintf(out, "MEMO\n");
+        break;
+    case P_IMPORT:
+        stPrintf(out, "IMPORT\n");
+        break;
     case P_VARIABLE_SETTER:
         stPrintf(out, "VARIABLE_SETTER(");
         tokenPrint(out, *node.token);
@@ -108,16 +157,20 @@ void _ptPrintNode(Stream* out, ParserNode node, size_t depth, const char* filena
 void ptFree(ParserTree tree)
 {
     listDeepFree(tree.nodes, ParserNode, n, ptFreeNode(n, true));
+    cpFree(tree.constants);
 }
 
 ParserNode ptTokenNode(ParserNodeType type, Token token)
 {
     ParserNode node =
     {
-        .nodes = listNew(ParserNode),
+        .nodes = listNewEmpty(ParserNode),
         .type = type,
-        .token = malloc(sizeof(Token))
+        .token = malloc(sizeof(Token)),
+        .value = NULL,
     };
+    if (type == P_FUNCTION_CALL)
+        node.feedback.specialized = P_FUNCTION_CALL;
     assert(node.token);
     *node.token = token;
     return node;
@@ -127,18 +180,46 @@ ParserNode ptCreateNode(ParserNodeType type)
 {
     ParserNode node =
     {
-        .nodes = listNew(ParserNode),
+        .nodes = listNewEmpty(ParserNode),
         .type = type,
         .token = NULL,
+        .value = NULL,
     };
+    if (type == P_FUNCTION_CALL)
+        node.feedback.specialized = P_FUNCTION_CALL;
     return node;
 }
 
 void ptFreeNode(ParserNode node, bool recursive)
 {
-    listDeepFree(node.nodes, ParserNode, n, ptFreeNode(n, true));
-    if (node.token)
-        tokenFree(*node.token);
+    // explicit stack so that deeply nested trees don't overflow the C stack
+    List pending = listNew(ParserNode);
+    listAdd(pending, node, ParserNode);
+    while (pending.length)
+    {
+        ParserNode n = listGet(pending, --pending.length, ParserNode);
+        for (size_t i = 0; i < n.nodes.length; i++)
+            listAddP(&pending, listGetP(n.nodes, i));
+        listFree(n.nodes);
+        if (n.token)
+        {
+            tokenFree(*n.token);
+            free(n.token);
+        }
+        FrameLayout* frame = ptFrame(&n);
+        if (frame)
+        {
+            jitFree(frame);
+            listFree(frame->captures);
+            free(frame);
+        }
+    }
+    listFree(pending);
+}
+
+FrameLayout* ptFrame(const ParserNode* node)
+{
+    return node->type == P_FUNCTION_DEFINITION || node->type == P_LAZY ? node->frame : NULL;
 }
 
 void ptAdd(ParserTree* tree, ParserNode node)
@@ -18,6 +18,8 @@ typedef enum ParserNodeType
     P_STORAGE_FLOAT,
     P_STORAGE_BOOL,
     P_VALUE_INTEGER,
+    // integer literal that doesn't fit into int, the token has its decimal digits
+    P_VALUE_BIGINT,
     P_VALUE_FLOAT,
     P_VALUE_CHAR,
     P_VALUE_STRING,
@@ -30,19 +32,123 @@ typedef enum ParserNodeType
     P_VARIABLE,
     P_NOTHING,
     P_ERROR,
+    // [lazy x], the single child is evaluated when its value is needed
+    P_LAZY,
+    // [if c a b], only the selected branch is evaluated
+    P_IF,
+    // [and ...] and [or ...], evaluation stops at the first value that decides the result
+    P_AND,
+    P_OR,
+    // [cond [c a] ...], the childs are the conditions and the values of the clauses
+    P_COND,
+    // [memo capacity def], the function caches its results, capacity is optional
+    P_MEMO,
+    // [import "file"], the module runs before the program that imports it
+    // so the node itself evaluates to nothing
+    P_IMPORT,
+    // specializations of function call chosen by the evaluator based on type
+    // feedback, they are kept in NodeFeedback.specialized and the type of the
+    // node stays P_FUNCTION_CALL
+    P_INT_ADD,
+    P_INT_SUBTRACT,
+    P_INT_MULTIPLY,
+    P_FLOAT_ADD,
+    P_FLOAT_SUBTRACT,
+    P_FLOAT_MULTIPLY,
 } ParserNodeType;
 
+struct Variable;
+struct ConstantPool;
+
+/**
+ * @brief argument types seen by the evaluator in a function call
+ *
+ */
+typedef struct NodeFeedback
+{
+    unsigned hits;
+    unsigned deopts;
+    int seen;
+    // P_FUNCTION_CALL or the specialization of the call
+    ParserNodeType specialized;
+} NodeFeedback;
+
+typedef enum SlotType
+{
+    // variable looked up by name in the global variables
+    S_GLOBAL,
+    // variable in the frame of the running function
+    S_LOCAL,
+    // variable captured by the closure of the running function
+    S_CAPTURED,
+} SlotType;
+
+/**
+ * @brief where the variable of identifier or setter lives, set by the resolver
+ *
+ */
+typedef struct Slot
+{
+    SlotType type;
+    // S_LOCAL and S_CAPTURED: index of the variable
+    // S_GLOBAL: slot of the node in its tree (see rsNumber), the runtimes
+    // remember the variable of every slot so that the tree may be shared
+    // by them, 0 if the node wasn't resolved
+    size_t index;
+} Slot;
+
+/**
+ * @brief layout of the frame of function definition or lazy expression,
+ * set by the resolver
+ *
+ */
+typedef struct FrameLayout
+{
+    // number of variables in the frame, parameters are first
+    size_t size;
+    // where the captured variables are in the enclosing frame, List of Slot
+    List captures;
+    // index of the variable with the function itself plus one, 0 if it isn't used
+    size_t self;
+    // index of the first captured variable in the enclosing frame plus one
+    // if the function never escapes the call that creates it, 0 if the
+    // captured variables are in heap allocated closure
+    size_t env;
+    // calls of the function counted until it is compiled to machine code
+    unsigned calls;
+    // JitState of the function, the runtimes that share the tree compile
+    // it only once
+    int jit;
+    // machine code of the function, NULL until it is compiled
+    struct JitCode* code;
+} FrameLayout;
+
 typedef struct ParserNode
 {
+    // allocated only when the first child is added
     List nodes;
     ParserNodeType type;
     Token* token;
+    struct Variable* value;
+    // only the nodes of the type that uses the field pay for it
+    union
+    {
+        // function calls: the argument types
+        NodeFeedback feedback;
+        // identifiers and setters: the resolved variable
+        Slot slot;
+        // function definitions and lazy: the frame layout, owned by the node
+        FrameLayout* frame;
+    };
 } ParserNode;
 
 typedef struct ParserTree
 {
     List nodes;
     const char* filename;
+    struct ConstantPool* constants;
+    // the largest slot of global identifier or setter (see rsNumber)
+    size_t slots;
 } ParserTree;
 
 /**
@@ -108,4 +214,12 @@ void ptAdd(ParserTree* tree, ParserNode node);
  */
 void ptNodeAdd(ParserNode* node, ParserNode n);
 
+/**
+ * @brief gets the frame layout of the node
+ * 
+ * @param node node to check
+ * @return FrameLayout* frame of function definition or lazy, NULL for other nodes
+ */
+FrameLayout* ptFrame(const ParserNode* node);
+
 #endif // PARSER_TREE_INCLUDED
\ No newline at end of file
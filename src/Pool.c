@@ -0,0 +1,277 @@
+#include "Pool.h"
+
+#include <assert.h>
+#include <stdatomic.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "Thread.h"
+
+/**
+ * @brief range of indices that weren't processed yet
+ *
+ */
+typedef struct _PoolTask
+{
+    size_t start;
+    size_t end;
+} _PoolTask;
+
+/**
+ * @brief thread of the pool with its deque
+ *
+ */
+typedef struct _PoolWorker
+{
+    Pool* pool;
+    size_t index;
+    Thread thread;
+    // guards the deque, the owner takes the tasks from the bottom and the
+    // other threads from the top
+    Mutex lock;
+    _PoolTask tasks[pool_DEQUE_SIZE];
+    size_t top;
+    size_t bottom;
+    // the last run the thread joined
+    size_t generation;
+} _PoolWorker;
+
+struct Pool
+{
+    _PoolWorker* workers;
+    size_t threads;
+    // guards generation and stop
+    Mutex lock;
+    // signaled when new run starts or the pool stops
+    Condition wake;
+    // incremented by every run
+    size_t generation;
+    _Bool stop;
+    // the current run
+    PoolAction action;
+    void* context;
+    // number of indices of the current run that weren't processed yet
+    atomic_size_t remaining;
+};
+
+/**
+ * @brief waits for runs and helps with them until the pool stops
+ *
+ * @param context the worker of the thread
+ */
+void _poolThread(void* context);
+
+/**
+ * @brief processes the tasks of the current run until all of its indices
+ * are done
+ *
+ * @param w worker of the calling thread
+ */
+void _poolWork(_PoolWorker* w);
+
+/**
+ * @brief adds task to the bottom of the deque of the worker
+ *
+ * @param w worker that owns the deque
+ * @param t the task
+ */
+void _poolPush(_PoolWorker* w, _PoolTask t);
+
+/**
+ * @brief takes task from the bottom of the deque of the worker
+ *
+ * @param w worker that owns the deque
+ * @param t set to the task
+ * @return true task was taken
+ * @return false the deque is empty
+ */
+_Bool _poolPop(_PoolWorker* w, _PoolTask* t);
+
+/**
+ * @brief takes task from the top of the deque of some other worker
+ *
+ * @param w worker of the calling thread
+ * @param t set to the task
+ * @return true task was stolen
+ * @return false all deques are empty
+ */
+_Bool _poolSteal(_PoolWorker* w, _PoolTask* t);
+
+Pool* poolCreate(size_t threads)
+{
+    assert(threads > 0);
+
+    Pool* p = malloc(sizeof(Pool));
+    assert(p);
+    p->workers = malloc(sizeof(_PoolWorker) * threads);
+    assert(p->workers);
+    p->threads = threads;
+    thrMutexInit(&p->lock);
+    thrConditionInit(&p->wake);
+    p->generation = 0;
+    p->stop = 0;
+    p->action = NULL;
+    p->context = NULL;
+    atomic_init(&p->remaining, 0);
+
+    for (size_t i = 0; i < threads; i++)
+    {
+        _PoolWorker* w = p->workers + i;
+        w->pool = p;
+        w->index = i;
+        thrMutexInit(&w->lock);
+        w->top = 0;
+        w->bottom = 0;
+        w->generation = 0;
+    }
+
+    // the pool works with the threads that the system gave it
+    for (size_t i = 1; i < threads; i++)
+    {
+        if (!thrCreateStack(&p->workers[i].thread, _poolThread, p->workers + i, pool_STACK_SIZE))
+        {
+            for (size_t j = i; j < threads; j++)
+                thrMutexFree(&p->workers[j].lock);
+            p->threads = i;
+            break;
+        }
+    }
+    return p;
+}
+
+void poolFree(Pool* p)
+{
+    thrLock(&p->lock);
+    p->stop = 1;
+    thrBroadcast(&p->wake);
+    thrUnlock(&p->lock);
+
+    for (size_t i = 1; i < p->threads; i++)
+        thrJoin(&p->workers[i].thread);
+    for (size_t i = 0; i < p->threads; i++)
+        thrMutexFree(&p->workers[i].lock);
+    thrConditionFree(&p->wake);
+    thrMutexFree(&p->lock);
+    free(p->workers);
+    free(p);
+}
+
+size_t poolThreads(Pool* p)
+{
+    return p->threads;
+}
+
+void poolRun(Pool* p, PoolAction action, void* context, size_t count)
+{
+    assert(atomic_load(&p->remaining) == 0);
+    if (count == 0)
+        return;
+
+    // the other threads read the run after they take its task
+    p->action = action;
+    p->context = context;
+    atomic_store(&p->remaining, count);
+    _PoolTask all = { .start = 0, .end = count };
+    _poolPush(p->workers, all);
+
+    if (p->threads > 1)
+    {
+        thrLock(&p->lock);
+        p->generation++;
+        thrBroadcast(&p->wake);
+        thrUnlock(&p->lock);
+    }
+    _poolWork(p->workers);
+}
+
+void _poolThread(void* context)
+{
+    _PoolWorker* w = context;
+    Pool* p = w->pool;
+    while (1)
+    {
+        thrLock(&p->lock);
+        while (!p->stop && p->generation == w->generation)
+            thrWait(&p->wake, &p->lock);
+        _Bool stop = p->stop;
+        w->generation = p->generation;
+        thrUnlock(&p->lock);
+
+        if (stop)
+            return;
+        _poolWork(w);
+    }
+}
+
+void _poolWork(_PoolWorker* w)
+{
+    Pool* p = w->pool;
+    while (atomic_load(&p->remaining))
+    {
+        _PoolTask t;
+        if (!_poolPop(w, &t) && !_poolSteal(w, &t))
+        {
+            // the last ranges are still processed by other threads
+            thrYield();
+            continue;
+        }
+
+        // the upper halves are left for the threads that run out of work
+        while (t.end - t.start > 1)
+        {
+            _PoolTask upper = { .start = t.start + (t.end - t.start) / 2, .end = t.end };
+            _poolPush(w, upper);
+            t.end = upper.start;
+        }
+
+        p->action(p->context, w->index, t.start);
+        atomic_fetch_sub(&p->remaining, 1);
+    }
+}
+
+void _poolPush(_PoolWorker* w, _PoolTask t)
+{
+    thrLock(&w->lock);
+    if (w->bottom == pool_DEQUE_SIZE)
+    {
+        // the stolen tasks left space at the top
+        memmove(w->tasks, w->tasks + w->top, sizeof(_PoolTask) * (w->bottom - w->top));
+        w->bottom -= w->top;
+        w->top = 0;
+    }
+    assert(w->bottom < pool_DEQUE_SIZE);
+    w->tasks[w->bottom++] = t;
+    thrUnlock(&w->lock);
+}
+
+_Bool _poolPop(_PoolWorker* w, _PoolTask* t)
+{
+    thrLock(&w->lock);
+    _Bool found = w->bottom > w->top;
+    if (found)
+        *t = w->tasks[--w->bottom];
+    if (w->bottom == w->top)
+    {
+        w->top = 0;
+        w->bottom = 0;
+    }
+    thrUnlock(&w->lock);
+    return found;
+}
+
+_Bool _poolSteal(_PoolWorker* w, _PoolTask* t)
+{
+    Pool* p = w->pool;
+    for (size_t i = 1; i < p->threads; i++)
+    {
+        _PoolWorker* victim = p->workers + (w->index + i) % p->threads;
+        thrLock(&victim->lock);
+        _Bool found = victim->bottom > victim->top;
+        if (found)
+            *t = victim->tasks[victim->top++];
+        thrUnlock(&victim->lock);
+        if (found)
+            return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,76 @@
+#ifndef pool_POOL_INCLUDED
+#define pool_POOL_INCLUDED
+
+#include <stddef.h>
+
+#ifndef pool_MAX_THREADS
+// largest number of threads of pool, every thread has its own heap and the
+// heaps are told apart by one byte id
+#define pool_MAX_THREADS 64
+#endif // pool_MAX_THREADS
+
+#ifndef pool_DEQUE_SIZE
+// capacity of the deque of each thread, ranges are split in halves so the
+// deque never holds more tasks than the number of bits of the range length
+#define pool_DEQUE_SIZE 64
+#endif // pool_DEQUE_SIZE
+
+#ifndef pool_STACK_SIZE
+// size of the stacks of the threads of the pool, compiled functions that
+// the threads run recurse on them, the memory is committed only as the
+// stacks grow
+#define pool_STACK_SIZE ((size_t)8 << 20)
+#endif // pool_STACK_SIZE
+
+/**
+ * @brief processes one unit of work of pool run
+ *
+ */
+typedef void (*PoolAction)(void* context, size_t thread, size_t index);
+
+/**
+ * @brief threads that process units of work, every thread has deque of
+ * ranges of units, it splits the range it takes in halves and leaves the
+ * upper halves in its deque for the threads that run out of work, they
+ * steal the largest ranges from the other end of the deque
+ *
+ */
+typedef struct Pool Pool;
+
+/**
+ * @brief creates pool, the thread that calls poolRun is one of its threads
+ * so one less thread is started
+ *
+ * @param threads number of threads, at least 1
+ * @return Pool* new instance
+ */
+Pool* poolCreate(size_t threads);
+
+/**
+ * @brief stops the threads of the pool and frees it
+ *
+ * @param p pool to free
+ */
+void poolFree(Pool* p);
+
+/**
+ * @brief returns the number of threads of the pool
+ *
+ * @param p the pool
+ * @return size_t number of threads including the one that calls poolRun
+ */
+size_t poolThreads(Pool* p);
+
+/**
+ * @brief calls action for every index from 0 to count - 1 and returns when
+ * all of them are done, the calling thread is thread 0, the calls on the
+ * same thread never overlap, it must not be called from the action
+ *
+ * @param p the pool
+ * @param action what to do with each index
+ * @param context passed to action
+ * @param count number of the indices
+ */
+void poolRun(Pool* p, PoolAction action, void* context, size_t count);
+
+#endif // pool_POOL_INCLUDED
@@ -0,0 +1,261 @@
+#include "Program.h"
+
+#include <assert.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "List.h"
+#include "Lexer.h"
+#include "Parser.h"
+#include "Errors.h"
+#include "ConstantPool.h"
+#include "Optimizer.h"
+#include "Resolver.h"
+#include "Evaluator.h"
+#include "Image.h"
+#include "StringBuilder.h"
+
+/**
+ * @brief prints the number of errors, warnings and infos
+ *
+ * @param messages where to print, may be NULL
+ * @param counts number of errors, warnings and infos
+ */
+void _progPrintCounts(Stream* messages, size_t counts[3]);
+
+/**
+ * @brief reads the whole stream
+ *
+ * @param in stream to read
+ * @param length set to the number of read bytes
+ * @return char* the bytes, must be freed
+ */
+char* _progReadAll(Stream* in, size_t* length);
+
+/**
+ * @brief checks whether the program already ran on the runtime as module
+ *
+ * @param r the runtime
+ * @param p the program
+ * @return true the program ran or is running on the runtime
+ * @return false the program didn't run on the runtime
+ */
+_Bool _progRan(Runtime* r, Program* p);
+
+/**
+ * @brief runs the imports of the program that didn't run on the runtime
+ * yet, every module is marked before its own imports run so that cyclic
+ * imports end
+ *
+ * @param p the program
+ * @param r the runtime
+ * @return Variable nothing or the first uncaught exception
+ */
+Variable _progRunImports(Program* p, Runtime* r);
+
+Program* progCompile(Stream* in, const char* filename, _Bool optimize, Stream* messages)
+{
+    Program* p = malloc(sizeof(Program));
+    assert(p);
+    p->filename = strC(filename);
+    p->imports = listNew(Program*);
+
+    // indexed by ErrorLevel
+    size_t counts[3] = { 0 };
+    size_t msgs = 0;
+
+    List errs;
+    List tokens = lexLex(in, &errs, &p->filename);
+    listForEach(errs, ErrorSpan, t,
+        if (messages)
+        {
+            errPrintErrorSpan(messages, t);
+            stPrintf(messages, "\n");
+        }
+        msgs++;
+        counts[t.level]++;
+    );
+    listDeepFree(errs, ErrorSpan, t, errFreeErrorSpan(t));
+
+    if (counts[E_ERROR] != 0)
+    {
+        _progPrintCounts(messages, counts);
+        listDeepFree(tokens, Token, t, tokenFree(t));
+        strFree(p->filename);
+        free(p);
+        return NULL;
+    }
+
+    p->tree = parParse(tokens, &errs);
+    listFree(tokens);
+    p->tree.filename = p->filename.c;
+
+    listForEach(errs, ErrorToken, t,
+        if (messages)
+        {
+            errPrintErrorToken(messages, t, filename);
+            stPrintf(messages, "\n");
+        }
+        msgs++;
+        counts[t.level]++;
+    );
+    listDeepFree(errs, ErrorToken, t, errFreeErrorToken(t));
+
+    if (msgs != 0)
+        _progPrintCounts(messages, counts);
+    if (counts[E_ERROR] != 0)
+    {
+        progFree(p);
+        return NULL;
+    }
+
+    cpBuild(&p->tree);
+    if (optimize)
+        optOptimize(&p->tree);
+    rsResolve(&p->tree);
+    return p;
+}
+
+Program* progCompileCached(Stream* in, const char* filename, _Bool optimize, Stream* messages)
+{
+    size_t length;
+    char* source = _progReadAll(in, &length);
+
+    // the source is identified by its hash and name because the positions
+    // in the tree point to the name
+    char hash[17];
+    snprintf(hash, sizeof(hash), "%016llx", (unsigned long long)imgChecksum(source, length));
+    StringBuilder sb = sbCreate();
+    sbAppend(&sb, prog_COMPILER_VERSION);
+    sbAppend(&sb, optimize ? ";O;" : ";-;");
+    sbAppend(&sb, hash);
+    sbAdd(&sb, ';');
+    sbAppend(&sb, filename);
+    String key = sbGet(&sb);
+
+    sbClear(&sb);
+    sbAppend(&sb, filename);
+    sbAppend(&sb, prog_CACHE_SUFFIX);
+    String cache = sbGet(&sb);
+    sbClear(&sb);
+
+    String text;
+    Program* p = imgLoadProgram(cache.c, key, &text);
+    if (p)
+    {
+        if (messages && text.length)
+            stWrite(messages, text.c, text.length);
+        strFree(text);
+        free(source);
+        strFree(cache);
+        strFree(key);
+        sbFree(&sb);
+        return p;
+    }
+
+    Stream src;
+    stBufferStream(&src, source, length, stREAD);
+    Stream msgs;
+    stStringBuilderStream(&msgs, &sb, stWRITE);
+
+    p = progCompile(&src, filename, optimize, &msgs);
+    stClose(&msgs);
+    stClose(&src);
+
+    text = sbGet(&sb);
+    if (messages && text.length)
+        stWrite(messages, text.c, text.length);
+    // failing to write the cache only means that the source is compiled
+    // again next time
+    if (p)
+        imgSaveProgram(cache.c, p, key, text);
+
+    strFree(text);
+    sbFree(&sb);
+    free(source);
+    strFree(cache);
+    strFree(key);
+    return p;
+}
+
+Variable progRun(Program* p, Runtime* r)
+{
+    if (!_progRan(r, p))
+        listAdd(r->modules, &p->tree, ParserTree*);
+
+    Variable v = _progRunImports(p, r);
+    if (v.type == V_EXCEPTION)
+        return v;
+    rtFreeVariable(v);
+    return evRun(&p->tree, r);
+}
+
+void progFree(Program* p)
+{
+    ptFree(p->tree);
+    strFree(p->filename);
+    listFree(p->imports);
+    free(p);
+}
+
+void _progPrintCounts(Stream* messages, size_t counts[3])
+{
+    if (messages)
+        stPrintf(messages, "#Errors: %zu\n#Warnings: %zu\n#Infos: %zu\n", counts[E_ERROR], counts[E_WARNING], counts[E_INFO]);
+}
+
+char* _progReadAll(Stream* in, size_t* length)
+{
+    size_t allocated = 4096;
+    size_t l = 0;
+    char* buffer = malloc(allocated);
+    assert(buffer);
+
+    size_t r;
+    while ((r = stRead(in, buffer + l, allocated - l)) && r != st_UNSUPPORTED)
+    {
+        l += r;
+        if (l == allocated)
+        {
+            allocated *= 2;
+            buffer = realloc(buffer, allocated);
+            assert(buffer);
+        }
+    }
+    *length = l;
+    return buffer;
+}
+
+_Bool _progRan(Runtime* r, Program* p)
+{
+    for (size_t i = 0; i < r->modules.length; i++)
+    {
+        if (listGet(r->modules, i, ParserTree*) == &p->tree)
+            return 1;
+    }
+    return 0;
+}
+
+Variable _progRunImports(Program* p, Runtime* r)
+{
+    for (size_t i = 0; i < p->imports.length; i++)
+    {
+        Program* module = listGet(p->imports, i, Program*);
+        if (_progRan(r, module))
+            continue;
+        listAdd(r->modules, &module->tree, ParserTree*);
+
+        Variable v = _progRunImports(module, r);
+        if (v.type != V_EXCEPTION)
+        {
+            rtFreeVariable(v);
+            v = evRun(&module->tree, r);
+        }
+        if (v.type == V_EXCEPTION)
+            return v;
+        rtFreeVariable(v);
+    }
+    return rtCreateNothingVariable();
+}
@@ -0,0 +1,90 @@
+#ifndef prog_PROGRAM_INCLUDED
+#define prog_PROGRAM_INCLUDED
+
+#include "List.h"
+#include "ParserTree.h"
+#include "Runtime.h"
+#include "Stream.h"
+#include "String.h"
+
+#ifndef prog_COMPILER_VERSION
+// identifies the compiler in the keys of cached programs, every build
+// makes the old caches invalid
+#define prog_COMPILER_VERSION __DATE__ " " __TIME__
+#endif // prog_COMPILER_VERSION
+
+#ifndef prog_CACHE_SUFFIX
+// appended to the name of the source to get the name of its cache
+#define prog_CACHE_SUFFIX "c"
+#endif // prog_CACHE_SUFFIX
+
+/**
+ * @brief compiled source that can be run many times by many runtimes, the
+ * tokens are freed and only the optimized and resolved tree is kept
+ *
+ */
+typedef struct Program
+{
+    // name of the source, the positions in the tree point to it
+    String filename;
+    // resolved tree with constant pool, running the program changes only
+    // the type feedback of its calls
+    ParserTree tree;
+    // programs of the modules the program imports in the order of the
+    // imports, filled by modLoad, they aren't owned by the program
+    List imports;
+} Program;
+
+/**
+ * @brief compiles source into program, source in memory can be read
+ * trough stBufferStream, the modules the source imports aren't loaded,
+ * use modLoad to load them
+ *
+ * @param in where to read the source from
+ * @param filename name of the source used in messages
+ * @param optimize if true the program is optimized
+ * @param messages where to print the errors and warnings, NULL to not
+ * print them
+ * @return Program* new instance or NULL if the source has errors
+ */
+Program* progCompile(Stream* in, const char* filename, _Bool optimize, Stream* messages);
+
+/**
+ * @brief compiles source like progCompile but first tries to load it from
+ * cache file next to the source (filename with prog_CACHE_SUFFIX), the
+ * cache is used only if it was made from the same source by the same
+ * compiler with the same optimize flag, otherwise the source is compiled
+ * and the cache is replaced, the messages of the compilation are stored in
+ * the cache and printed again when it is used
+ *
+ * @param in where to read the source from
+ * @param filename name of the source used in messages and for the cache
+ * @param optimize if true the program is optimized
+ * @param messages where to print the errors and warnings, NULL to not
+ * print them
+ * @return Program* new instance or NULL if the source has errors
+ */
+Program* progCompileCached(Stream* in, const char* filename, _Bool optimize, Stream* messages);
+
+/**
+ * @brief runs the program on the runtime, the globals of the runtime are
+ * its inputs, the program may run on many runtimes at the same time,
+ * the imported modules that haven't run on the runtime yet run first so
+ * their globals are set before the program starts
+ *
+ * @param p program to run
+ * @param r the runtime, usually created by rtCreateFrom
+ * @return Variable value of the last expression of the program or
+ * the uncaught exception, its heap objects are valid until the runtime
+ * evaluates again
+ */
+Variable progRun(Program* p, Runtime* r);
+
+/**
+ * @brief frees the program, the runtimes that ran it must be freed first
+ *
+ * @param p program to free
+ */
+void progFree(Program* p);
+
+#endif // prog_PROGRAM_INCLUDED
@@ -0,0 +1,347 @@
+#include "Reduce.h"
+
+#include <assert.h>
+
+#if red_X86
+#include <immintrin.h>
+#include <cpuid.h>
+#endif // red_X86
+
+// instruction set detected by the first call of redIsa, the detection
+// always gives the same result so it doesn't matter which thread stores it,
+// the accesses are atomic so that runtimes on different threads may detect
+// it at the same time
+static RedIsa _redDetected = RED_ISA_UNKNOWN;
+
+/**
+ * @brief adds the lane sums and the remaining ints to the accumulator
+ *
+ * @param lanes partial sums of the vector loop
+ * @param values ints that weren't added by the vector loop
+ * @param count number of the remaining ints
+ * @param acc the accumulator, it is not changed if the sum overflows
+ * @return true the sum fits into int
+ * @return false the sum overflowed
+ */
+_Bool _redFinishSumInt(const long long lanes[4], const Variable* values, size_t count, long long* acc);
+
+/**
+ * @brief adds the floats of the run that weren't added by the vector loop
+ * to their partial sums or products
+ *
+ * @param lanes the partial results
+ * @param values the whole run
+ * @param start index of the first value that wasn't reduced
+ * @param count length of the run
+ * @param multiply if true the partial results are products
+ */
+void _redFinishFloat(double lanes[4], const Variable* values, size_t start, size_t count, _Bool multiply);
+
+#if red_X86
+
+/**
+ * @brief sums ints in 4 lanes of two SSE2 registers
+ *
+ * @param values variables of type V_INT
+ * @param count number of the variables
+ * @param acc the accumulator, it is not changed if the sum overflows
+ * @return true the sum fits into int
+ * @return false the sum overflowed
+ */
+_Bool _redSumIntSse2(const Variable* values, size_t count, long long* acc);
+
+/**
+ * @brief sums ints in 4 lanes of AVX2 register
+ *
+ * @param values variables of type V_INT
+ * @param count number of the variables
+ * @param acc the accumulator, it is not changed if the sum overflows
+ * @return true the sum fits into int
+ * @return false the sum overflowed
+ */
+_Bool _redSumIntAvx2(const Variable* values, size_t count, long long* acc);
+
+/**
+ * @brief sums or multiplies groups of 4 floats in two SSE2 registers
+ *
+ * @param values variables of type V_FLOAT
+ * @param count number of the variables
+ * @param lanes the partial results
+ * @param multiply if true the values are multiplied
+ * @return size_t number of the reduced values
+ */
+size_t _redFloatSse2(const Variable* values, size_t count, double lanes[4], _Bool multiply);
+
+/**
+ * @brief sums or multiplies groups of 4 floats in AVX2 register
+ *
+ * @param values variables of type V_FLOAT
+ * @param count number of the variables
+ * @param lanes the partial results
+ * @param multiply if true the values are multiplied
+ * @return size_t number of the reduced values
+ */
+size_t _redFloatAvx2(const Variable* values, size_t count, double lanes[4], _Bool multiply);
+
+#endif // red_X86
+
+/**
+ * @brief reduces floats, see redSumFloat
+ *
+ * @param acc the accumulator
+ * @param values variables of type V_FLOAT
+ * @param count number of the variables
+ * @param multiply if true the values are multiplied
+ * @return double the result
+ */
+double _redFloat(double acc, const Variable* values, size_t count, _Bool multiply);
+
+RedIsa redIsa(void)
+{
+    RedIsa detected = __atomic_load_n(&_redDetected, __ATOMIC_RELAXED);
+    if (detected != RED_ISA_UNKNOWN)
+        return detected;
+
+#if red_X86
+    RedIsa isa = RED_ISA_SSE2;
+    unsigned a, b, c, d;
+    // AVX2 needs also the system to save the ymm registers
+    if (__get_cpuid(1, &a, &b, &c, &d) && (c & bit_OSXSAVE) && (c & bit_AVX))
+    {
+        unsigned lo, hi;
+        __asm__("xgetbv" : "=a"(lo), "=d"(hi) : "c"(0));
+        if ((lo & 6) == 6 && __get_cpuid_count(7, 0, &a, &b, &c, &d) && (b & bit_AVX2))
+            isa = RED_ISA_AVX2;
+    }
+#else
+    RedIsa isa = RED_ISA_SCALAR;
+#endif // red_X86
+
+    __atomic_store_n(&_redDetected, isa, __ATOMIC_RELAXED);
+    return isa;
+}
+
+size_t redRun(const Variable* values, size_t count)
+{
+    assert(count);
+
+    VariableType type = values[0].type;
+    if (type != V_INT && type != V_FLOAT)
+        return 1;
+
+    size_t run = 1;
+    while (run < count && values[run].type == type)
+        run++;
+    return run;
+}
+
+_Bool redSumInt(const Variable* values, size_t count, long long* acc)
+{
+    if (count >= red_VECTOR_MIN)
+    {
+        switch (redIsa())
+        {
+#if red_X86
+        case RED_ISA_AVX2:
+            return _redSumIntAvx2(values, count, acc);
+        case RED_ISA_SSE2:
+            return _redSumIntSse2(values, count, acc);
+#endif // red_X86
+        default:
+            break;
+        }
+    }
+
+    long long lanes[4] = { 0 };
+    return _redFinishSumInt(lanes, values, count, acc);
+}
+
+_Bool redProductInt(const Variable* values, size_t count, long long* acc)
+{
+    // there is no vector multiplication of 64 bit ints that would report
+    // overflow, the loop at least doesn't create the intermediate values
+    long long res = *acc;
+    for (size_t i = 0; i < count; i++)
+    {
+        if (__builtin_mul_overflow(res, values[i].integer, &res))
+            return 0;
+    }
+    *acc = res;
+    return 1;
+}
+
+double redSumFloat(double acc, const Variable* values, size_t count)
+{
+    return _redFloat(acc, values, count, 0);
+}
+
+double redProductFloat(double acc, const Variable* values, size_t count)
+{
+    return _redFloat(acc, values, count, 1);
+}
+
+double _redFloat(double acc, const Variable* values, size_t count, _Bool multiply)
+{
+    if (count < red_REASSOCIATE_MIN)
+    {
+        for (size_t i = 0; i < count; i++)
+        {
+            if (multiply)
+                acc *= values[i].decimal;
+            else
+                acc += values[i].decimal;
+        }
+        return acc;
+    }
+
+    double lanes[4] = { multiply, multiply, multiply, multiply };
+    size_t done = 0;
+    switch (redIsa())
+    {
+#if red_X86
+    case RED_ISA_AVX2:
+        done = _redFloatAvx2(values, count, lanes, multiply);
+        break;
+    case RED_ISA_SSE2:
+        done = _redFloatSse2(values, count, lanes, multiply);
+        break;
+#endif // red_X86
+    default:
+        break;
+    }
+    _redFinishFloat(lanes, values, done, count, multiply);
+
+    if (multiply)
+        return acc * ((lanes[0] * lanes[1]) * (lanes[2] * lanes[3]));
+    return acc + ((lanes[0] + lanes[1]) + (lanes[2] + lanes[3]));
+}
+
+_Bool _redFinishSumInt(const long long lanes[4], const Variable* values, size_t count, long long* acc)
+{
+    long long res = *acc;
+    for (size_t i = 0; i < 4; i++)
+    {
+        if (__builtin_add_overflow(res, lanes[i], &res))
+            return 0;
+    }
+    for (size_t i = 0; i < count; i++)
+    {
+        if (__builtin_add_overflow(res, values[i].integer, &res))
+            return 0;
+    }
+    *acc = res;
+    return 1;
+}
+
+void _redFinishFloat(double lanes[4], const Variable* values, size_t start, size_t count, _Bool multiply)
+{
+    for (size_t i = start; i < count; i++)
+    {
+        if (multiply)
+            lanes[i % 4] *= values[i].decimal;
+        else
+            lanes[i % 4] += values[i].decimal;
+    }
+}
+
+#if red_X86
+
+_Bool _redSumIntSse2(const Variable* values, size_t count, long long* acc)
+{
+    __m128i low = _mm_setzero_si128();
+    __m128i high = _mm_setzero_si128();
+    __m128i overflow = _mm_setzero_si128();
+
+    size_t i = 0;
+    for (; i + 4 <= count; i += 4)
+    {
+        __m128i x = _mm_set_epi64x(values[i + 1].integer, values[i].integer);
+        __m128i y = _mm_set_epi64x(values[i + 3].integer, values[i + 2].integer);
+        __m128i sx = _mm_add_epi64(low, x);
+        __m128i sy = _mm_add_epi64(high, y);
+        // the addition overflowed if the result has different sign than both operands
+        overflow = _mm_or_si128(overflow, _mm_and_si128(_mm_xor_si128(low, sx), _mm_xor_si128(x, sx)));
+        overflow = _mm_or_si128(overflow, _mm_and_si128(_mm_xor_si128(high, sy), _mm_xor_si128(y, sy)));
+        low = sx;
+        high = sy;
+    }
+    if (_mm_movemask_pd(_mm_castsi128_pd(overflow)))
+        return 0;
+
+    long long lanes[4];
+    _mm_storeu_si128((__m128i*)lanes, low);
+    _mm_storeu_si128((__m128i*)(lanes + 2), high);
+    return _redFinishSumInt(lanes, values + i, count - i, acc);
+}
+
+__attribute__((target("avx2")))
+_Bool _redSumIntAvx2(const Variable* values, size_t count, long long* acc)
+{
+    // the ints are members of the variables so they are gathered
+    const long long stride = sizeof(Variable);
+    __m256i index = _mm256_setr_epi64x(0, stride, 2 * stride, 3 * stride);
+    __m256i sum = _mm256_setzero_si256();
+    __m256i overflow = _mm256_setzero_si256();
+
+    size_t i = 0;
+    for (; i + 4 <= count; i += 4)
+    {
+        __m256i x = _mm256_i64gather_epi64((const long long*)&values[i].integer, index, 1);
+        __m256i s = _mm256_add_epi64(sum, x);
+        overflow = _mm256_or_si256(overflow, _mm256_and_si256(_mm256_xor_si256(sum, s), _mm256_xor_si256(x, s)));
+        sum = s;
+    }
+    if (_mm256_movemask_pd(_mm256_castsi256_pd(overflow)))
+        return 0;
+
+    long long lanes[4];
+    _mm256_storeu_si256((__m256i*)lanes, sum);
+    return _redFinishSumInt(lanes, values + i, count - i, acc);
+}
+
+size_t _redFloatSse2(const Variable* values, size_t count, double lanes[4], _Bool multiply)
+{
+    __m128d low = _mm_loadu_pd(lanes);
+    __m128d high = _mm_loadu_pd(lanes + 2);
+
+    size_t i = 0;
+    for (; i + 4 <= count; i += 4)
+    {
+        __m128d x = _mm_set_pd(values[i + 1].decimal, values[i].decimal);
+        __m128d y = _mm_set_pd(values[i + 3].decimal, values[i + 2].decimal);
+        if (multiply)
+        {
+            low = _mm_mul_pd(low, x);
+            high = _mm_mul_pd(high, y);
+        }
+        else
+        {
+            low = _mm_add_pd(low, x);
+            high = _mm_add_pd(high, y);
+        }
+    }
+
+    _mm_storeu_pd(lanes, low);
+    _mm_storeu_pd(lanes + 2, high);
+    return i;
+}
+
+__attribute__((target("avx2")))
+size_t _redFloatAvx2(const Variable* values, size_t count, double lanes[4], _Bool multiply)
+{
+    const long long stride = sizeof(Variable);
+    __m256i index = _mm256_setr_epi64x(0, stride, 2 * stride, 3 * stride);
+    __m256d acc = _mm256_loadu_pd(lanes);
+
+    size_t i = 0;
+    for (; i + 4 <= count; i += 4)
+    {
+        __m256d x = _mm256_i64gather_pd(&values[i].decimal, index, 1);
+        acc = multiply ? _mm256_mul_pd(acc, x) : _mm256_add_pd(acc, x);
+    }
+
+    _mm256_storeu_pd(lanes, acc);
+    return i;
+}
+
+#endif // red_X86
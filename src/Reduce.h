@@ -0,0 +1,106 @@
+#ifndef red_REDUCE_INCLUDED
+#define red_REDUCE_INCLUDED
+
+#include <stddef.h>
+
+#include "Runtime.h"
+
+#ifndef red_SIMD
+// if 0 the reductions never use the vector instructions
+#define red_SIMD 1
+#endif // red_SIMD
+
+#ifndef red_VECTOR_MIN
+// shorter runs are reduced by simple loop
+#define red_VECTOR_MIN 8
+#endif // red_VECTOR_MIN
+
+#ifndef red_REASSOCIATE_MIN
+// runs of floats with at least this many values are reduced in 4 partial
+// results, shorter runs are reduced from left to right
+#define red_REASSOCIATE_MIN 16
+#endif // red_REASSOCIATE_MIN
+
+#if red_SIMD && (defined(__x86_64__) || defined(_M_X64)) && (defined(__GNUC__) || defined(__clang__))
+// the vector kernels are compiled
+#define red_X86 1
+#else
+#define red_X86 0
+#endif
+
+typedef enum RedIsa
+{
+    RED_ISA_UNKNOWN,
+    RED_ISA_SCALAR,
+    RED_ISA_SSE2,
+    RED_ISA_AVX2,
+} RedIsa;
+
+/**
+ * @brief returns the best instruction set that the processor and the
+ * system support, it is detected on the first call
+ *
+ * @return RedIsa the instruction set, RED_ISA_SCALAR if the vector
+ * kernels aren't compiled
+ */
+RedIsa redIsa(void);
+
+/**
+ * @brief counts how many variables at the start have the type of the first
+ * one, only ints and floats form runs
+ *
+ * @param values the variables
+ * @param count number of the variables, must be at least 1
+ * @return size_t length of the run, 1 if the first variable isn't int or float
+ */
+size_t redRun(const Variable* values, size_t count);
+
+/**
+ * @brief adds ints to the accumulator, the result is exact so it is the
+ * same as if they were added from left to right
+ *
+ * @param values variables of type V_INT
+ * @param count number of the variables
+ * @param acc the accumulator, it is not changed if the sum overflows
+ * @return true the sum fits into int
+ * @return false the sum overflowed
+ */
+_Bool redSumInt(const Variable* values, size_t count, long long* acc);
+
+/**
+ * @brief multiplies the accumulator by ints
+ *
+ * @param values variables of type V_INT
+ * @param count number of the variables
+ * @param acc the accumulator, it is not changed if the product overflows
+ * @return true the product fits into int
+ * @return false the product overflowed
+ */
+_Bool redProductInt(const Variable* values, size_t count, long long* acc);
+
+/**
+ * @brief adds floats to the accumulator, runs shorter than
+ * red_REASSOCIATE_MIN are added from left to right, in longer runs the
+ * value at index i is added to partial sum i % 4 and the result is
+ * acc + ((p0 + p1) + (p2 + p3)), the grouping is the same with every
+ * instruction set
+ *
+ * @param acc the accumulator
+ * @param values variables of type V_FLOAT
+ * @param count number of the variables
+ * @return double the sum
+ */
+double redSumFloat(double acc, const Variable* values, size_t count);
+
+/**
+ * @brief multiplies the accumulator by floats, the values are grouped
+ * the same way as by redSumFloat
+ *
+ * @param acc the accumulator
+ * @param values variables of type V_FLOAT
+ * @param count number of the variables
+ * @return double the product
+ */
+double redProductFloat(double acc, const Variable* values, size_t count);
+
+#endif // red_REDUCE_INCLUDED
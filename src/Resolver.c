@@ -0,0 +1,422 @@
+#include "Resolver.h"
+
+#include <stdlib.h>
+#include <assert.h>
+
+#include "ParserTree.h"
+#include "List.h"
+#include "String.h"
+#include "Jit.h"
+
+/**
+ * @brief variables of function definition or lazy expression
+ *
+ */
+typedef struct _RsScope
+{
+    // names of the variables in the order of their slots, List of String
+    List names;
+    // name of the local variable the function is set to, references to
+    // it are resolved to the function itself
+    String self;
+    // true if the function never escapes the call that creates it
+    _Bool stack;
+    ParserNode* body;
+    FrameLayout* frame;
+} _RsScope;
+
+typedef struct _RsPending
+{
+    ParserNode* node;
+    // true if the scope of the node ends here
+    _Bool leave;
+    // true if the value of the node is called right away
+    _Bool head;
+    // name of the local variable the node is set to
+    String self;
+} _RsPending;
+
+typedef struct _RsUse
+{
+    ParserNode* node;
+    // true if the node is the head of call
+    _Bool head;
+    // true if the node is inside function definition or lazy expression
+    _Bool nested;
+} _RsUse;
+
+typedef struct _RsContext
+{
+    // scopes of the enclosing functions, List of _RsScope
+    List scopes;
+    // nodes to resolve, List of _RsPending
+    List pending;
+} _RsContext;
+
+
+/**
+ * @brief resolves the node and all of its childs
+ *
+ * @param rc context
+ * @param node node to resolve
+ */
+void _rsNode(_RsContext* rc, ParserNode* node);
+
+/**
+ * @brief creates the frame layout of function definition or lazy
+ * expression and starts its scope
+ *
+ * @param rc context
+ * @param node function definition or lazy node
+ * @param self name of the local variable the function is set to or empty string
+ * @param stack true if the function never escapes the call that creates it
+ */
+void _rsEnter(_RsContext* rc, ParserNode* node, String self, _Bool stack);
+
+/**
+ * @brief ends the innermost scope, variables captured by function that
+ * doesn't escape get slots in the enclosing frame
+ *
+ * @param rc context
+ */
+void _rsLeave(_RsContext* rc);
+
+/**
+ * @brief checks whether function set to local variable may outlive the
+ * call that creates it, this is true if the variable is used other way
+ * than called or if it is used inside other function or lazy expression
+ *
+ * @param body body of the function that sets the variable
+ * @param def definition of the function
+ * @param name name of the variable
+ * @return true the function may escape
+ * @return false the function is only called
+ */
+_Bool _rsEscapes(ParserNode* body, ParserNode* def, String name);
+
+/**
+ * @brief adds variables set in the body to the scope, nested function
+ * definitions and lazy expressions are skipped
+ *
+ * @param scope scope of the body
+ * @param body body to search
+ */
+void _rsCollect(_RsScope* scope, ParserNode* body);
+
+/**
+ * @brief finds variable visible from the innermost scope, the functions
+ * between the variable and the innermost scope capture it
+ *
+ * @param rc context
+ * @param name name of the variable
+ * @return Slot where the variable is when the innermost scope runs
+ */
+Slot _rsLookup(_RsContext* rc, String name);
+
+/**
+ * @brief finds variable in the scope
+ *
+ * @param scope scope to search
+ * @param name name of the variable
+ * @return size_t index of the variable plus one, 0 if it isn't in the scope
+ */
+size_t _rsFind(_RsScope* scope, String name);
+
+/**
+ * @brief adds variable of the enclosing frame to the captures
+ *
+ * @param frame layout of the capturing frame
+ * @param from where the variable is in the enclosing frame
+ * @return size_t index of the captured variable
+ */
+size_t _rsCapture(FrameLayout* frame, Slot from);
+
+void rsResolve(ParserTree* tree)
+{
+    _RsContext context =
+    {
+        .scopes = listNew(_RsScope),
+        .pending = listNew(_RsPending),
+    };
+
+    for (size_t i = 0; i < tree->nodes.length; i++)
+        _rsNode(&context, listGetP(tree->nodes, i));
+
+    assert(context.scopes.length == 0);
+    listFree(context.scopes);
+    listFree(context.pending);
+    rsNumber(tree, 0);
+}
+
+void rsNumber(ParserTree* tree, size_t first)
+{
+    tree->slots = first;
+    List pending = listNew(ParserNode*);
+    for (size_t i = 0; i < tree->nodes.length; i++)
+        listAdd(pending, listGetP(tree->nodes, i), ParserNode*);
+    while (pending.length)
+    {
+        ParserNode* n = listGet(pending, --pending.length, ParserNode*);
+        _Bool named = n->type == P_IDENTIFIER || n->type == P_VARIABLE_SETTER || n->type == P_FUNCTION_SETTER;
+        if (named && n->slot.type == S_GLOBAL)
+            n->slot.index = ++tree->slots;
+        for (size_t i = 0; i < n->nodes.length; i++)
+            listAdd(pending, listGetP(n->nodes, i), ParserNode*);
+    }
+    listFree(pending);
+}
+
+void _rsNode(_RsContext* rc, ParserNode* node)
+{
+    _RsPending start = { .node = node, .leave = 0, .head = 0, .self = strEmpty() };
+    listAdd(rc->pending, start, _RsPending);
+    while (rc->pending.length)
+    {
+        _RsPending p = listGet(rc->pending, --rc->pending.length, _RsPending);
+        if (p.leave)
+        {
+            _rsLeave(rc);
+            continue;
+        }
+
+        ParserNode* n = p.node;
+        _RsPending next = { .node = NULL, .leave = 0, .head = 0, .self = strEmpty() };
+        switch (n->type)
+        {
+        case P_IDENTIFIER:
+            n->slot = _rsLookup(rc, n->token->string);
+            continue;
+        case P_VARIABLE_SETTER:
+        case P_FUNCTION_SETTER:
+            // variables set inside function were collected to its scope
+            n->slot = _rsLookup(rc, n->token->string);
+            next.node = listGetP(n->nodes, 0);
+            next.head = p.head;
+            if (n->slot.type == S_LOCAL && (next.node->type == P_FUNCTION_DEFINITION || next.node->type == P_MEMO))
+                next.self = n->token->string;
+            listAdd(rc->pending, next, _RsPending);
+            continue;
+        case P_FUNCTION_DEFINITION:
+        case P_LAZY:
+        {
+            // function that is only called can keep the captured variables
+            // in the frame of its creator, thunks may always outlive it
+            _Bool stack = n->type == P_FUNCTION_DEFINITION && rc->scopes.length && p.head;
+            if (stack && p.self.c)
+            {
+                _RsScope* scope = listGetP(rc->scopes, rc->scopes.length - 1);
+                stack = !_rsEscapes(scope->body, n, p.self);
+            }
+
+            // the parameters don't need resolving, only the body
+            _rsEnter(rc, n, p.self, stack);
+            next.leave = 1;
+            listAdd(rc->pending, next, _RsPending);
+            next.leave = 0;
+            next.node = listGetP(n->nodes, n->nodes.length - 1);
+            listAdd(rc->pending, next, _RsPending);
+            continue;
+        }
+        case P_MEMO:
+            // the definition is resolved as if it escaped, the capacity is literal
+            next.node = listGetP(n->nodes, n->nodes.length - 1);
+            next.self = p.self;
+            listAdd(rc->pending, next, _RsPending);
+            continue;
+        default:
+            for (size_t i = n->nodes.length; i > 0; i--)
+            {
+                next.node = listGetP(n->nodes, i - 1);
+                next.head = n->type == P_FUNCTION_CALL && i == 1;
+                listAdd(rc->pending, next, _RsPending);
+            }
+            continue;
+        }
+    }
+}
+
+void _rsEnter(_RsContext* rc, ParserNode* node, String self, _Bool stack)
+{
+    assert(node->nodes.length > 0);
+
+    if (node->frame)
+    {
+        jitFree(node->frame);
+        listFree(node->frame->captures);
+        free(node->frame);
+    }
+    node->frame = malloc(sizeof(FrameLayout));
+    assert(node->frame);
+    node->frame->size = 0;
+    node->frame->captures = listNew(Slot);
+    node->frame->self = 0;
+    node->frame->env = 0;
+    node->frame->calls = 0;
+    node->frame->jit = JIT_INTERPRETED;
+    node->frame->code = NULL;
+
+    _RsScope scope =
+    {
+        .names = listNew(String),
+        .self = self,
+        .stack = stack,
+        .body = listGetP(node->nodes, node->nodes.length - 1),
+        .frame = node->frame,
+    };
+
+    // all but the last child of definition are parameters, the argument
+    // of _ parameter has slot without name
+    if (node->type == P_FUNCTION_DEFINITION)
+    {
+        for (size_t i = 0; i + 1 < node->nodes.length; i++)
+        {
+            ParserNode* p = listGetP(node->nodes, i);
+            listAdd(scope.names, p->type == P_IDENTIFIER ? p->token->string : strEmpty(), String);
+        }
+    }
+    _rsCollect(&scope, scope.body);
+
+    listAdd(rc->scopes, scope, _RsScope);
+}
+
+void _rsLeave(_RsContext* rc)
+{
+    _RsScope scope = listGet(rc->scopes, --rc->scopes.length, _RsScope);
+    scope.frame->size = scope.names.length;
+    listFree(scope.names);
+
+    if (!scope.stack || scope.frame->captures.length == 0)
+        return;
+
+    _RsScope* outer = listGetP(rc->scopes, rc->scopes.length - 1);
+    scope.frame->env = outer->names.length + 1;
+    for (size_t i = 0; i < scope.frame->captures.length; i++)
+        listAdd(outer->names, strEmpty(), String);
+}
+
+_Bool _rsEscapes(ParserNode* body, ParserNode* def, String name)
+{
+    List pending = listNew(_RsUse);
+    listAdd(pending, ((_RsUse){ .node = body, .head = 0, .nested = 0 }), _RsUse);
+    while (pending.length)
+    {
+        _RsUse u = listGet(pending, --pending.length, _RsUse);
+        ParserNode* n = u.node;
+        switch (n->type)
+        {
+        case P_IDENTIFIER:
+            // the function itself may call the variable, other functions
+            // would copy it
+            if (strEquals(n->token->string, name) && (!u.head || u.nested))
+            {
+                listFree(pending);
+                return 1;
+            }
+            continue;
+        case P_FUNCTION_DEFINITION:
+        case P_LAZY:
+        {
+            _RsUse b = { .node = listGetP(n->nodes, n->nodes.length - 1), .head = 0, .nested = u.nested || n != def };
+            listAdd(pending, b, _RsUse);
+            continue;
+        }
+        default:
+            for (size_t i = 0; i < n->nodes.length; i++)
+            {
+                _RsUse c = { .node = listGetP(n->nodes, i), .head = n->type == P_FUNCTION_CALL && i == 0, .nested = u.nested };
+                listAdd(pending, c, _RsUse);
+            }
+            continue;
+        }
+    }
+    listFree(pending);
+    return 0;
+}
+
+void _rsCollect(_RsScope* scope, ParserNode* body)
+{
+    List pending = listNew(ParserNode*);
+    listAdd(pending, body, ParserNode*);
+    while (pending.length)
+    {
+        ParserNode* n = listGet(pending, --pending.length, ParserNode*);
+        switch (n->type)
+        {
+        case P_FUNCTION_DEFINITION:
+        case P_LAZY:
+            // these have their own scope
+            continue;
+        case P_VARIABLE_SETTER:
+        case P_FUNCTION_SETTER:
+            if (!_rsFind(scope, n->token->string))
+                listAdd(scope->names, n->token->string, String);
+            break;
+        default:
+            break;
+        }
+
+        for (size_t i = 0; i < n->nodes.length; i++)
+            listAdd(pending, listGetP(n->nodes, i), ParserNode*);
+    }
+    listFree(pending);
+}
+
+Slot _rsLookup(_RsContext* rc, String name)
+{
+    Slot slot = { .type = S_GLOBAL, .index = 0 };
+
+    size_t depth = rc->scopes.length;
+    size_t index = 0;
+    for (; depth > 0; depth--)
+    {
+        _RsScope* scope = listGetP(rc->scopes, depth - 1);
+        index = _rsFind(scope, name);
+        if (!index && scope->self.c && strEquals(scope->self, name))
+        {
+            // the function gets slot with itself only if it uses it
+            listAdd(scope->names, name, String);
+            index = scope->names.length;
+            scope->frame->self = index;
+        }
+        if (index)
+            break;
+    }
+    // the global slots are numbered once the whole tree is resolved
+    if (depth == 0)
+        return slot;
+
+    slot.type = S_LOCAL;
+    slot.index = index - 1;
+    // each function between the scope of the variable and the innermost
+    // scope copies it from the frame that encloses it
+    for (; depth < rc->scopes.length; depth++)
+    {
+        _RsScope* scope = listGetP(rc->scopes, depth);
+        slot.index = _rsCapture(scope->frame, slot);
+        slot.type = S_CAPTURED;
+    }
+    return slot;
+}
+
+size_t _rsFind(_RsScope* scope, String name)
+{
+    for (size_t i = 0; i < scope->names.length; i++)
+    {
+        String s = listGet(scope->names, i, String);
+        if (s.c && strEquals(s, name))
+            return i + 1;
+    }
+    return 0;
+}
+
+size_t _rsCapture(FrameLayout* frame, Slot from)
+{
+    for (size_t i = 0; i < frame->captures.length; i++)
+    {
+        Slot s = listGet(frame->captures, i, Slot);
+        if (s.type == from.type && s.index == from.index)
+            return i;
+    }
+    listAdd(frame->captures, from, Slot);
+    return frame->captures.length - 1;
+}
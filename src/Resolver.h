@@ -0,0 +1,31 @@
+#ifndef rs_RESOLVER_INCLUDED
+#define rs_RESOLVER_INCLUDED
+
+#include <stddef.h>
+
+#include "ParserTree.h"
+
+/**
+ * @brief resolves every variable to its slot so that the evaluator doesn't
+ * have to search for variables by name, parameters and variables set inside
+ * function live in its frame, variables of enclosing functions are captured
+ * by the closure when the function is created and other variables are global
+ *
+ * @param tree tree to resolve, this must be the last pass that changes the tree
+ */
+void rsResolve(ParserTree* tree);
+
+/**
+ * @brief gives every global identifier and setter of resolved tree its own
+ * slot, the runtimes cache the called function in the slot of the head of
+ * call too, rsResolve numbers the
+ * slots from 1 and Modules number the trees of the modules one after
+ * another so that runtime that runs all of them keeps their globals in
+ * one table
+ *
+ * @param tree resolved tree, its slots are set to the largest slot
+ * @param first the slots start after this one
+ */
+void rsNumber(ParserTree* tree, size_t first);
+
+#endif // rs_RESOLVER_INCLUDED
@@ -2,34 +2,190 @@
 
 #include <assert.h>
 #include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
 
 #include "List.h"
 #include "DebugTools.h"
 #include "Terminal.h"
+#include "Thread.h"
 
-Runtime rtCreate(List *errors)
+// the main runtime has heap 1 and the threads of its pool heaps from 2
+#define _RT_MAIN_HEAP 1
+
+/**
+ * @brief frees all locals of the runtime and the values in its heap
+ *
+ * @param r the runtime
+ */
+void _rtClear(Runtime* r);
+
+/**
+ * @brief finds the entry of the name in the table of global variables
+ * found by names
+ *
+ * @param r the runtime, its table has at least one empty entry
+ * @param name the name
+ * @return size_t* entry of the name or the empty entry where it belongs
+ */
+size_t* _rtName(Runtime* r, String name);
+
+/**
+ * @brief adds the global variables that aren't in the table of names yet,
+ * the table grows if it is half full, the first of variables with the same
+ * name stays in the table
+ *
+ * @param r the runtime, it must not be runtime of thread of the pool
+ */
+void _rtAddNames(Runtime* r);
+
+Runtime rtCreate(List *errors, FILE* out)
 {
     Runtime r =
         {
             .variables = listNew(Variable),
+            .locals = listNew(Variable),
+            .frame = 0,
+            .closure = NULL,
+            .env = 0,
             .errors = liCreate(errors),
+            .version = 1,
+            .gc = gcCreate(_RT_MAIN_HEAP),
+            .pool = NULL,
+            .workers = NULL,
+            .threads = 1,
+            .worker = 0,
+            .jit = 1,
+            .memoDepth = 0,
+            .out = out,
+            .globals = NULL,
+            .globalCapacity = 0,
+            .names = NULL,
+            .nameCapacity = 0,
+            .nameCount = 0,
+            .modules = listNew(ParserTree*),
         };
 
     return r;
 }
 
+Runtime rtCreateFrom(List globals, List *errors, FILE* out)
+{
+    Runtime r = rtCreate(errors, out);
+    for (size_t i = 0; i < globals.length; i++)
+    {
+        Variable* v = listGetP(globals, i);
+        assert(v->constant);
+        listAddP(&r.variables, v);
+    }
+    return r;
+}
+
+Pool* rtPool(Runtime* r)
+{
+    assert(!r->worker);
+
+    if (!r->pool)
+    {
+        size_t threads = r->threads ? r->threads : thrCpuCount();
+        if (threads > pool_MAX_THREADS)
+            threads = pool_MAX_THREADS;
+        r->pool = poolCreate(threads);
+        threads = poolThreads(r->pool);
+
+        r->workers = malloc(sizeof(Runtime) * threads);
+        assert(r->workers);
+        for (size_t i = 0; i < threads; i++)
+        {
+            Runtime w =
+            {
+                .locals = listNew(Variable),
+                .frame = 0,
+                .closure = NULL,
+                .env = 0,
+                .errors = r->errors,
+                .gc = gcCreate((unsigned char)(_RT_MAIN_HEAP + 1 + i)),
+                .pool = NULL,
+                .workers = NULL,
+                .threads = 1,
+                .worker = 1,
+                .jit = r->jit,
+                .memoDepth = 0,
+                .out = r->out,
+                .globals = NULL,
+                .globalCapacity = 0,
+                .modules = listNew(ParserTree*),
+            };
+            r->workers[i] = w;
+        }
+    }
+
+    // the globals may have changed since the last parallel call
+    _rtAddNames(r);
+    for (size_t i = 0; i < poolThreads(r->pool); i++)
+    {
+        r->workers[i].variables = r->variables;
+        r->workers[i].version = r->version;
+        r->workers[i].names = r->names;
+        r->workers[i].nameCapacity = r->nameCapacity;
+        r->workers[i].nameCount = r->nameCount;
+    }
+    return r->pool;
+}
+
+void rtReleaseWorkers(Runtime* r)
+{
+    for (size_t i = 0; r->pool && i < poolThreads(r->pool); i++)
+        _rtClear(r->workers + i);
+}
+
 void rtFree(Runtime r)
 {
-    listDeepFree(r.variables, Variable, v, rtFreeVariable(v));
+    if (r.pool)
+    {
+        for (size_t i = 0; i < poolThreads(r.pool); i++)
+        {
+            _rtClear(r.workers + i);
+            listFree(r.workers[i].locals);
+            free(r.workers[i].globals);
+            listFree(r.workers[i].modules);
+            gcFree(&r.workers[i].gc);
+        }
+        poolFree(r.pool);
+        free(r.workers);
+    }
+    // runtime of thread of the pool doesn't own the globals
+    if (!r.worker)
+    {
+        listDeepFree(r.variables, Variable, v, rtFreeVariable(v));
+        free(r.names);
+    }
+    listDeepFree(r.locals, Variable, v, rtFreeVariable(v));
+    listFree(r.modules);
+    free(r.globals);
+    gcFree(&r.gc);
+}
+
+void _rtClear(Runtime* r)
+{
+    for (size_t i = 0; i < r->locals.length; i++)
+        rtFreeVariable(listGet(r->locals, i, Variable));
+    r->locals.length = 0;
+    r->frame = 0;
+    r->closure = NULL;
+    r->env = 0;
+    gcClear(&r->gc);
 }
 
 void rtFreeVariable(Variable v)
 {
+    if (v.constant)
+        return;
     strFree(v.name);
     switch (v.type)
     {
     case V_EXCEPTION:
-    case V_STRING:
         strFree(v.str);
         return;
     case V_FUNCTION:
@@ -152,13 +308,56 @@ Variable rtCopyVariable(String name, Variable var)
     case V_FLOAT:
         return rtCreateFloatVariable(name, var.decimal);
     case V_CHAR:
-        return rtCreateFloatVariable(name, var.character);
+        return rtCreateCharVariable(name, var.character);
     case V_STRING:
-        return rtCreateStringVariable(name, strCopy(var.str));
+        return rtCreateStringVariable(name, var.str);
     case V_EXCEPTION:
-        return rtException(name, var.str);
-    /*case V_FUNCTION:
-        return createFunctionVariable(name, var.function);*/
+        // name of exception is its kind
+        strFree(name);
+        return rtException(strCopy(var.name), strCopy(var.str));
+    case V_FUNCTION:
+    {
+        List parameters = listNew(String);
+        listForEach(var.function.parameters, String, s, listAdd(parameters, strCopy(s), String));
+        Function f = rtCreateFunction(var.function.action, parameters);
+        f.body = var.function.body;
+        f.frame = var.function.frame;
+        f.closure = var.function.closure;
+        f.env = var.function.env;
+        f.memo = var.function.memo;
+        return rtCreateFunctionVariable(name, f);
+    }
+    case V_NOTHING:
+    {
+        Variable v = rtCreateNothingVariable();
+        v.name = name;
+        return v;
+    }
+    case V_THUNK:
+    {
+        // copies share the thunk so that it is forced only once
+        Variable v =
+        {
+            .type = V_THUNK,
+            .name = name,
+            .thunk = var.thunk,
+        };
+        return v;
+    }
+    case V_BIGINT:
+    {
+        // bigints are immutable so the copies share them
+        Variable v = rtBigIntVariable(var.big);
+        v.name = name;
+        return v;
+    }
+    case V_ARRAY:
+    {
+        // arrays are immutable so the copies share them
+        Variable v = rtArrayVariable(var.array.items, var.array.offset, var.array.length);
+        v.name = name;
+        return v;
+    }
     default:
         dtExcept("copyVariable: invalid variable type");
         return rtCreateBoolVariable(strEmpty(), 0);
@@ -171,13 +370,18 @@ Function rtCreateFunction(Action action, List parameters)
     {
         .action = action,
         .parameters = parameters,
+        .body = NULL,
+        .frame = NULL,
+        .closure = NULL,
+        .env = 0,
+        .memo = NULL,
     };
     return f;
 }
 
-Variable rtInvokeFunction(Function f, Runtime* r, List par)
+Variable rtInvokeFunction(Function* f, Runtime* r, List par)
 {
-    return f.action(f, r, par);
+    return f->action(f, r, par);
 }
 
 Variable rtCreateNothingVariable()
@@ -192,18 +396,98 @@ Variable rtCreateNothingVariable()
 
 _Bool rtGet(Runtime* r, String name, Variable* v)
 {
-    ListIterator li = liCreate(&r->variables);
-    while (liCan(&li))
+    Variable* var = rtFind(r, name);
+    if (!var)
+        return 0;
+    *v = *var;
+    return 1;
+}
+
+Variable* rtFind(Runtime* r, String name)
+{
+    // the pool shares the table only after all globals were added to it
+    if (!r->worker)
+        _rtAddNames(r);
+    if (!r->nameCapacity)
+        return NULL;
+
+    size_t index = *_rtName(r, name);
+    return index ? listGetP(r->variables, index - 1) : NULL;
+}
+
+Variable* rtFindGlobal(Runtime* r, const ParserNode* node)
+{
+    size_t slot = node->slot.index;
+    if (slot < r->globalCapacity && r->globals[slot].node == node)
+        return listGetP(r->variables, r->globals[slot].index);
+
+    // node of other tree with the same slot is replaced
+    Variable* var = rtFind(r, node->token->string);
+    if (var && slot)
     {
-        Variable var = liGet(&li, Variable);
-        liMove(&li);
-        if (strEquals(var.name, name))
-        {
-            *v = var;
-            return 1;
-        }
+        rtReserveGlobals(r, slot);
+        r->globals[slot] = (GlobalSlot){ .node = node, .index = var - (Variable*)r->variables.data, .version = 0 };
+    }
+    return var;
+}
+
+void rtReserveGlobals(Runtime* r, size_t slots)
+{
+    if (slots < r->globalCapacity)
+        return;
+
+    // at least doubles, the slots of the trees that didn't reserve them
+    // are added one by one
+    size_t capacity = r->globalCapacity * 2 > slots + 1 ? r->globalCapacity * 2 : slots + 1;
+    GlobalSlot* globals = realloc(r->globals, capacity * sizeof(GlobalSlot));
+    assert(globals);
+    memset(globals + r->globalCapacity, 0, (capacity - r->globalCapacity) * sizeof(GlobalSlot));
+    r->globals = globals;
+    r->globalCapacity = capacity;
+}
+
+Variable* rtSetGlobal(Runtime* r, const ParserNode* node, Variable value)
+{
+    Variable* var = rtFindGlobal(r, node);
+    if (!var)
+    {
+        rtSet(r, strCopy(node->token->string), value);
+        return rtFindGlobal(r, node);
+    }
+
+    // the pooled constants cannot be owned by the runtime
+    if (value.constant)
+        value = rtCopyVariable(strEmpty(), value);
+    strFree(value.name);
+    value.name = strCopy(node->token->string);
+
+    r->version++;
+    rtFreeVariable(*var);
+    *var = value;
+    return var;
+}
+
+Variable* rtSet(Runtime* r, String name, Variable value)
+{
+    // the pooled constants cannot be owned by the runtime
+    if (value.constant)
+        value = rtCopyVariable(strEmpty(), value);
+    strFree(value.name);
+    value.name = name;
+
+    r->version++;
+
+    Variable* var = rtFind(r, name);
+    if (var)
+    {
+        rtFreeVariable(*var);
+        *var = value;
+        return var;
     }
-    return 0;
+
+    listAdd(r->variables, value, Variable);
+    _rtAddNames(r);
+    return listGetP(r->variables, r->variables.length - 1);
 }
 
 Variable rtBoolVariable(_Bool value)
@@ -221,6 +505,33 @@ Variable rtFloatVariable(double value)
     return rtCreateFloatVariable(strEmpty(), value);
 }
 
+Variable rtBigIntVariable(BigInt* value)
+{
+    Variable v =
+    {
+        .type = V_BIGINT,
+        .name = strEmpty(),
+        .big = value,
+    };
+    return v;
+}
+
+Variable rtArrayVariable(Array* items, size_t offset, size_t length)
+{
+    Variable v =
+    {
+        .type = V_ARRAY,
+        .name = strEmpty(),
+        .array =
+        {
+            .items = items,
+            .offset = offset,
+            .length = length,
+        },
+    };
+    return v;
+}
+
 Variable rtCharVariable(char value)
 {
     return rtCreateCharVariable(strEmpty(), value);
@@ -234,4 +545,73 @@ Variable rtStringVariable(String value)
 Variable rtFunctionVariable(Function value)
 {
     return rtCreateFunctionVariable(strEmpty(), value);
-}
\ No newline at end of file
+}
+
+Variable rtThunkVariable(Runtime* r, ParserNode* node, FrameLayout* frame, Closure* closure)
+{
+    Thunk* thunk = gcAlloc(&r->gc, GC_THUNK, sizeof(Thunk));
+    thunk->node = node;
+    thunk->frame = frame;
+    thunk->closure = closure;
+    thunk->forced = 0;
+
+    Variable v =
+    {
+        .type = V_THUNK,
+        .name = strEmpty(),
+        .thunk = thunk,
+    };
+    return v;
+}
+
+Closure* rtCreateClosure(Runtime* r, size_t length)
+{
+    Closure* c = gcAlloc(&r->gc, GC_CLOSURE, sizeof(Closure) + sizeof(Variable) * length);
+    c->length = length;
+    return c;
+}
+
+size_t* _rtName(Runtime* r, String name)
+{
+    // FNV-1a of the name
+    uint64_t h = 0xcbf29ce484222325ull;
+    for (size_t i = 0; i < name.length; i++)
+        h = (h ^ (unsigned char)name.c[i]) * 0x100000001b3ull;
+
+    size_t mask = r->nameCapacity - 1;
+    for (size_t i = (size_t)h & mask;; i = (i + 1) & mask)
+    {
+        if (!r->names[i])
+            return r->names + i;
+        Variable* var = listGetP(r->variables, r->names[i] - 1);
+        if (var->name.length == name.length && memcmp(var->name.c, name.c, name.length) == 0)
+            return r->names + i;
+    }
+}
+
+void _rtAddNames(Runtime* r)
+{
+    assert(!r->worker);
+
+    for (; r->nameCount < r->variables.length; r->nameCount++)
+    {
+        if ((r->nameCount + 1) * 2 > r->nameCapacity)
+        {
+            size_t* old = r->names;
+            size_t oldCapacity = r->nameCapacity;
+            r->nameCapacity = oldCapacity ? oldCapacity * 2 : rt_NAMES_START;
+            r->names = calloc(r->nameCapacity, sizeof(size_t));
+            assert(r->names);
+            for (size_t i = 0; i < oldCapacity; i++)
+            {
+                if (old[i])
+                    *_rtName(r, ((Variable*)listGetP(r->variables, old[i] - 1))->name) = old[i];
+            }
+            free(old);
+        }
+
+        size_t* entry = _rtName(r, ((Variable*)listGetP(r->variables, r->nameCount))->name);
+        if (!*entry)
+            *entry = r->nameCount + 1;
+    }
+}
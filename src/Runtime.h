@@ -5,6 +5,9 @@
 
 #include "List.h"
 #include "String.h"
+#include "ParserTree.h"
+#include "Gc.h"
+#include "Pool.h"
 
 typedef enum VariableType
 {
@@ -17,30 +20,141 @@ typedef enum VariableType
     V_FUNCTION,
     V_NOTHING,
     V_EXCEPTION,
+    V_THUNK,
+    // integer that doesn't fit into int, arithmetic switches to it on overflow
+    V_BIGINT,
+    // packed array of ints or floats, or slice of it
+    V_ARRAY,
 } VariableType;
 
 typedef struct Function Function;
 typedef struct Variable Variable;
 typedef struct Runtime Runtime;
+typedef struct Thunk Thunk;
+typedef struct Closure Closure;
+typedef struct Memo Memo;
+typedef struct BigInt BigInt;
+typedef struct Array Array;
 
-typedef Variable (*Action)(Function fun, Runtime* r, List variables);
+typedef Variable (*Action)(Function* fun, Runtime* r, List variables);
+
+#ifndef rt_NAMES_START
+// number of entries of the table of global variables found by names when
+// the first of them is added, the table doubles when it is half full
+#define rt_NAMES_START 64
+#endif // rt_NAMES_START
+
+/**
+ * @brief global variable found by identifier or setter, the slots of the
+ * nodes are unique only in their tree (or in the trees of Modules) so the
+ * node is kept to tell them apart, identifier that is head of call also
+ * caches the called function
+ *
+ */
+typedef struct GlobalSlot
+{
+    // the node that found the variable, NULL if the slot wasn't used yet
+    const ParserNode* node;
+    // index of the variable, global variables are never removed
+    size_t index;
+    // runtime version when the function was cached, 0 if it wasn't
+    size_t version;
+    Function* function;
+} GlobalSlot;
 
 struct Runtime
 {
     List variables;
+    // frames of the running functions, the variables are accessed by their slot
+    List locals;
+    // index of the first local of the currently running function
+    size_t frame;
+    // variables captured by the currently running function, may be NULL
+    Closure* closure;
+    // index of the captured variables in locals plus one if they are in
+    // frame of the caller instead of the closure
+    size_t env;
     ListIterator errors;
+    // incremented whenever any variable is added or changed
+    size_t version;
+    // owns strings, closures, thunks and memo caches of the values
+    Gc gc;
+    // threads of the parallel builtins, NULL until the first of them runs
+    Pool* pool;
+    // runtimes of the threads of the pool, each of them has its own heap
+    Runtime* workers;
+    // number of threads of the pool, 0 for one thread for every processor
+    size_t threads;
+    // true for runtime of thread of the pool, it shares the globals and the
+    // parser tree with the runtime that started the pool and only reads them
+    _Bool worker;
+    // false if all user functions run in the interpreter, otherwise the hot
+    // ones run as machine code, see Jit.h
+    _Bool jit;
+    // number of running calls of memoized functions whose results will be
+    // cached, print and println are SideEffect errors while it isn't 0
+    size_t memoDepth;
+    // where print and println write and where uncaught exceptions are reported
+    FILE* out;
+    // the global variable of every slot of global identifier or setter
+    // (see rsNumber), the runtime remembers them instead of the nodes so
+    // that the parser tree may be shared by many runtimes, the trees must
+    // outlive the runtime like the functions they define
+    GlobalSlot* globals;
+    // number of entries of globals, 0 if it wasn't allocated
+    size_t globalCapacity;
+    // hash table of the indices of the global variables plus one found by
+    // their names, 0 for empty entry, the threads of the pool share it
+    size_t* names;
+    // number of entries of names, power of two or 0 if it wasn't allocated
+    size_t nameCapacity;
+    // number of the global variables in names, the variables added directly
+    // to variables are added to names before the next search
+    size_t nameCount;
+    // trees of the modules that ran on the runtime, each module runs on the
+    // runtime at most once
+    List modules;
 };
 
 struct Function
 {
     List parameters;
     Action action;
+    // body of user defined function, NULL for builtins
+    ParserNode* body;
+    // layout of the frame of user defined function, NULL for builtins
+    FrameLayout* frame;
+    // variables captured by user defined function, may be NULL
+    Closure* closure;
+    // index of the captured variables in the locals plus one if the
+    // function doesn't escape the frame that created it, 0 otherwise
+    size_t env;
+    // cached results of memoized function, NULL if it isn't memoized
+    Memo* memo;
 };
 
+/**
+ * @brief value of array variable, the slices of array are views of the
+ * same items
+ *
+ */
+typedef struct ArrayView
+{
+    Array* items;
+    // index of the first item of the view
+    size_t offset;
+    size_t length;
+} ArrayView;
+
 struct Variable
 {
     String name;
     VariableType type;
+    // constants are owned by the constant pool or by the shared builtins and
+    // are never freed by rtFreeVariable
+    _Bool constant;
+    // string, closure, thunk, memo cache, bigint and array are heap objects
+    // shared by all copies of the value, they are freed by the collector
     union
     {
         _Bool boolean;
@@ -49,16 +163,66 @@ struct Variable
         char character;
         String str;
         Function function;
+        Thunk* thunk;
+        // only values outside of the range of int are bigints
+        BigInt* big;
+        ArrayView array;
     };
 };
 
 /**
- * @brief Create a Runtime object
+ * @brief delayed computation shared by all copies of the variable,
+ * the value is computed at most once
+ *
+ */
+struct Thunk
+{
+    GcObject header;
+    // expression that computes the value
+    ParserNode* node;
+    // layout of the frame in which the expression is evaluated
+    FrameLayout* frame;
+    // variables used by the expression, may be NULL
+    Closure* closure;
+    _Bool forced;
+    // the computed value if forced is true
+    Variable value;
+};
+
+/**
+ * @brief variables captured by function or thunk, shared by all their copies
+ *
+ */
+struct Closure
+{
+    GcObject header;
+    size_t length;
+    // copies of the captured variables in the order of FrameLayout.captures
+    Variable variables[];
+};
+
+/**
+ * @brief Create a Runtime object, the runtime doesn't share any mutable
+ * state with the other runtimes so each of them may run on its own thread
  *
  * @param errors error output
+ * @param out where the program prints
  * @return Runtime new instance
  */
-Runtime rtCreate(List *errors);
+Runtime rtCreate(List *errors, FILE* out);
+
+/**
+ * @brief Create a Runtime object whose globals are the given constant
+ * variables, the variables are shared by all runtimes created from them
+ * so creating runtime doesn't create them again
+ *
+ * @param globals constants such as the ones from bifCreateBuiltins, they
+ * must outlive the runtime
+ * @param errors error output
+ * @param out where the program prints
+ * @return Runtime new instance
+ */
+Runtime rtCreateFrom(List globals, List *errors, FILE* out);
 
 /**
  * @brief creates esception variable
@@ -127,7 +291,7 @@ Variable rtCreateCharVariable(String name, char value);
  * @brief Create a String Variable object
  *
  * @param name name of the variable
- * @param value value of the variable
+ * @param value value of the variable, must be created by gcString
  * @return Variable new instance
  */
 Variable rtCreateStringVariable(String name, String value);
@@ -165,6 +329,24 @@ Variable rtIntVariable(long long value);
  */
 Variable rtFloatVariable(double value);
 
+/**
+ * @brief Create a Bigint Variable object
+ *
+ * @param value value of the variable, must not fit into int
+ * @return Variable new instance
+ */
+Variable rtBigIntVariable(BigInt* value);
+
+/**
+ * @brief Create a Array Variable object
+ *
+ * @param items the array
+ * @param offset index of the first item of the view
+ * @param length number of items of the view
+ * @return Variable new instance
+ */
+Variable rtArrayVariable(Array* items, size_t offset, size_t length);
+
 /**
  * @brief Create a Char Variable object
  *
@@ -176,7 +358,7 @@ Variable rtCharVariable(char value);
 /**
  * @brief Create a String Variable object
  *
- * @param value value of the variable
+ * @param value value of the variable, must be created by gcString
  * @return Variable new instance
  */
 Variable rtStringVariable(String value);
@@ -189,6 +371,26 @@ Variable rtStringVariable(String value);
  */
 Variable rtFunctionVariable(Function fun);
 
+/**
+ * @brief Create a Thunk Variable object
+ *
+ * @param r runtime whose heap owns the thunk
+ * @param node expression to evaluate when the value is needed
+ * @param frame layout of the frame of the expression
+ * @param closure variables used by the expression, may be NULL
+ * @return Variable new instance
+ */
+Variable rtThunkVariable(Runtime* r, ParserNode* node, FrameLayout* frame, Closure* closure);
+
+/**
+ * @brief Create a Closure object
+ *
+ * @param r runtime whose heap owns the closure
+ * @param length number of the captured variables, the caller sets them
+ * @return Closure* new instance
+ */
+Closure* rtCreateClosure(Runtime* r, size_t length);
+
 /**
  * @brief Create a Nothing Variable object
  * 
@@ -197,7 +399,7 @@ Variable rtFunctionVariable(Function fun);
 Variable rtCreateNothingVariable();
 
 /**
- * @brief copies a variable
+ * @brief copies a variable, the copy shares the heap objects of the variable
  *
  * @param name name of the new variable
  * @param var variable to copy
@@ -215,6 +417,23 @@ Variable rtCopyVariable(String name, Variable var);
  */
 Function rtCreateFunction(Action action, List parameters);
 
+/**
+ * @brief starts the threads of the parallel builtins if they don't run yet
+ * and gives their runtimes the current globals
+ *
+ * @param r runtime that isn't runtime of thread of the pool
+ * @return Pool* the pool, its thread i uses runtime r->workers[i]
+ */
+Pool* rtPool(Runtime* r);
+
+/**
+ * @brief frees all values of the runtimes of the threads of the pool,
+ * called when the results of parallel builtin were copied
+ *
+ * @param r runtime that started the pool
+ */
+void rtReleaseWorkers(Runtime* r);
+
 /**
  * @brief frees runtime
  *
@@ -223,7 +442,8 @@ Function rtCreateFunction(Action action, List parameters);
 void rtFree(Runtime r);
 
 /**
- * @brief frees variable
+ * @brief frees variable, does nothing for constants, heap objects are
+ * left to the collector
  *
  * @param v variable to free
  */
@@ -244,7 +464,7 @@ void rtFreeFunction(Function f);
  * @param par parameters
  * @return VarFun result of the function
  */
-Variable rtInvokeFunction(Function f, Runtime* r, List par);
+Variable rtInvokeFunction(Function* f, Runtime* r, List par);
 
 /**
  * @brief finds variable with the given name
@@ -257,4 +477,57 @@ Variable rtInvokeFunction(Function f, Runtime* r, List par);
  */
 _Bool rtGet(Runtime* r, String name, Variable* v);
 
+/**
+ * @brief finds global variable with the given name trough hash table of
+ * their names, the pointer is valid until the runtime version changes
+ *
+ * @param r runtime context
+ * @param name name of the variable
+ * @return Variable* the variable or NULL if it doesn't exist
+ */
+Variable* rtFind(Runtime* r, String name);
+
+/**
+ * @brief finds global variable with the name of the identifier node, the
+ * runtime remembers the index of the variable for the slot of the node,
+ * global variables are never removed so the index stays valid, the pointer
+ * is valid until the runtime version changes
+ *
+ * @param r runtime context
+ * @param node the identifier
+ * @return Variable* the variable or NULL if it doesn't exist
+ */
+Variable* rtFindGlobal(Runtime* r, const ParserNode* node);
+
+/**
+ * @brief makes the table of global variables large enough for the slots
+ * of tree, called before the tree runs so that the table doesn't grow
+ * while it runs
+ *
+ * @param r runtime context
+ * @param slots the largest slot of the tree
+ */
+void rtReserveGlobals(Runtime* r, size_t slots);
+
+/**
+ * @brief sets global variable with the name of the setter node like rtSet,
+ * existing variable is found trough the slot of the node
+ *
+ * @param r runtime context
+ * @param node the setter
+ * @param value the new value, it is owned by the runtime
+ * @return Variable* the variable, valid until the runtime version changes
+ */
+Variable* rtSetGlobal(Runtime* r, const ParserNode* node, Variable value);
+
+/**
+ * @brief sets value of the variable, the variable is created if it doesn't exist
+ *
+ * @param r runtime context
+ * @param name name of the variable, the runtime takes its ownership
+ * @param value new value of the variable, the runtime takes its ownership
+ * @return Variable* the stored variable
+ */
+Variable* rtSet(Runtime* r, String name, Variable value);
+
 #endif // RUNTIME_INCLUDED
\ No newline at end of file
@@ -9,8 +9,6 @@
 #include "StringBuilder.h"
 #include "DebugTools.h"
 
-static char buffer[st_BUFFER_SIZE];
-
 typedef struct _StBufferStream
 {
     char* buffer;
@@ -184,8 +182,34 @@ int stStringBuilderStream(Stream* st, StringBuilder* sb, StreamFlags flags)
 
 int stVPrintf(Stream* st, const char* format, va_list args)
 {
-    int len = vsprintf_s(buffer, st_BUFFER_SIZE, format, args);
-    return stWrite(st, buffer, len);
+    // every call has its own buffer so streams may be used from many threads
+    char buffer[st_BUFFER_SIZE];
+    va_list copy;
+    va_copy(copy, args);
+    int len = vsnprintf(buffer, st_BUFFER_SIZE, format, args);
+    if (len < 0)
+    {
+        va_end(copy);
+        return len;
+    }
+    if (len < st_BUFFER_SIZE)
+    {
+        va_end(copy);
+        return stWrite(st, buffer, len);
+    }
+
+    // longer text is formatted into allocated buffer
+    char* big = malloc(len + 1);
+    if (!big)
+    {
+        va_end(copy);
+        return -1;
+    }
+    vsnprintf(big, len + 1, format, copy);
+    va_end(copy);
+    int res = stWrite(st, big, len);
+    free(big);
+    return res;
 }
 
 int stPrintf(Stream* st, const char* format, ...)
@@ -302,22 +326,26 @@ size_t _stSBWrite(void* stream, const char* data, size_t length)
     if (sb->pos == sb->sb->length)
     {
         sbAppendL(sb->sb, data, length);
+        sb->pos += length;
         return length;
     }
 
     size_t l = sb->pos + length;
-    if (l < sb->sb->allocated)
+    if (l <= sb->sb->allocated)
     {
         memcpy_s(sb->sb->buffer + sb->pos, sb->sb->allocated - sb->pos, data, length);
         if (l > sb->sb->length)
             sb->sb->length = l;
+        sb->pos = l;
         return length;
     }
 
-    size_t w = l - sb->sb->allocated;
-    memcpy_s(sb->sb->buffer + sb->pos, sb->sb->allocated - sb->pos, data, length);
+    // overwrite to the end of the buffer and append the rest
+    size_t w = sb->sb->allocated - sb->pos;
+    memcpy_s(sb->sb->buffer + sb->pos, w, data, w);
     sb->sb->length = sb->sb->allocated;
-    sbAppendL(sb->sb, data + w, l - w);
+    sbAppendL(sb->sb, data + w, length - w);
+    sb->pos = l;
     return length;
 }
 
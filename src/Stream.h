@@ -9,6 +9,8 @@
 #define st_UNSUPPORTED (EOF - 1)
 
 #ifndef st_BUFFER_SIZE
+// size of the buffer on the stack used by stPrintf, longer text is formatted
+// into allocated buffer
 #define st_BUFFER_SIZE 4096
 #endif // st_BUFFER_SIZE
 
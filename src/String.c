@@ -24,6 +24,8 @@ void strFree(String s)
 
 String strCopy(String s)
 {
+    if (!s.c)
+        return strEmpty();
     return strCLen(s.c, s.length);
 }
 
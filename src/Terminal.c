@@ -1,40 +1,81 @@
 #include "Terminal.h"
 
+#include <stdio.h>
+
 #include "Stream.h"
 
-// FILE* stream functions defined in Stream.c
-size_t _stFRead(void* stream, char* buffer, size_t length);
-size_t _stFWrite(void* stream, const char* data, size_t length);
-size_t _stFSeek(void* stream, long offset, int pos);
+// the terminal streams are initialized statically and never change so all
+// threads may use them, the FILE* is chosen by the function because the
+// standard streams aren't constants
+
+/**
+ * @brief reads from stdin
+ *
+ * @param stream unused
+ * @param buffer where to read to
+ * @param length maximum number of characters to read
+ * @return size_t number of characters that was readed
+ */
+size_t _termInRead(void* stream, char* buffer, size_t length);
+
+/**
+ * @brief writes to stdout
+ *
+ * @param stream unused
+ * @param data what to write
+ * @param length length of data
+ * @return size_t number of written characters
+ */
+size_t _termOutWrite(void* stream, const char* data, size_t length);
 
-Stream _termCreate(FILE* str, StreamFlags flags);
+/**
+ * @brief writes to stderr
+ *
+ * @param stream unused
+ * @param data what to write
+ * @param length length of data
+ * @return size_t number of written characters
+ */
+size_t _termErrWrite(void* stream, const char* data, size_t length);
+
+/**
+ * @brief terminal streams cannot be closed
+ *
+ * @param p unused
+ * @return int always 0
+ */
 int _nothing(void* p) { return 0; }
 
+static Stream _termInStream = { .flags = stREAD, .read = _termInRead, .close = _nothing };
+static Stream _termOutStream = { .flags = stWRITE, .write = _termOutWrite, .close = _nothing };
+static Stream _termErrStream = { .flags = stWRITE, .write = _termErrWrite, .close = _nothing };
+
 Stream* _termIn()
 {
-    static Stream s = { .flags = stNONE };
-    if (s.flags == stNONE)
-        s = _termCreate(stdin, stREAD);
-    return &s;
+    return &_termInStream;
 }
 
 Stream* _termOut()
 {
-    static Stream s = { .flags = stNONE };
-    if (s.flags == stNONE)
-        s = _termCreate(stdout, stWRITE);
-    return &s;
+    return &_termOutStream;
 }
 
 Stream* _termErr()
 {
-    static Stream s = { .flags = stNONE };
-    if (s.flags == stNONE)
-        s = _termCreate(stderr, stWRITE);
-    return &s;
+    return &_termErrStream;
+}
+
+size_t _termInRead(void* stream, char* buffer, size_t length)
+{
+    return fread(buffer, sizeof(char), length, stdin);
+}
+
+size_t _termOutWrite(void* stream, const char* data, size_t length)
+{
+    return fwrite(data, sizeof(char), length, stdout);
 }
 
-Stream _termCreate(FILE* str, StreamFlags flags)
+size_t _termErrWrite(void* stream, const char* data, size_t length)
 {
-    return stCreate(flags, str, _stFWrite, _stFRead, _stFSeek, _nothing);
+    return fwrite(data, sizeof(char), length, stderr);
 }
\ No newline at end of file
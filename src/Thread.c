@@ -0,0 +1,179 @@
+#include "Thread.h"
+
+#include <assert.h>
+
+#ifndef _WIN32
+#include <sched.h>
+#include <unistd.h>
+#endif // _WIN32
+
+#ifdef _WIN32
+
+/**
+ * @brief entry of new thread, runs its start function
+ *
+ * @param context the thread
+ * @return DWORD always 0
+ */
+DWORD WINAPI _thrRun(LPVOID context);
+
+#else
+
+/**
+ * @brief entry of new thread, runs its start function
+ *
+ * @param context the thread
+ * @return void* always NULL
+ */
+void* _thrRun(void* context);
+
+#endif // _WIN32
+
+_Bool thrCreate(Thread* t, ThreadStart start, void* context)
+{
+    return thrCreateStack(t, start, context, 0);
+}
+
+_Bool thrCreateStack(Thread* t, ThreadStart start, void* context, size_t stack)
+{
+    t->start = start;
+    t->context = context;
+#ifdef _WIN32
+    t->handle = CreateThread(NULL, stack, _thrRun, t, stack ? STACK_SIZE_PARAM_IS_A_RESERVATION : 0, NULL);
+    return t->handle != NULL;
+#else
+    pthread_attr_t attr;
+    if (pthread_attr_init(&attr) != 0)
+        return 0;
+    _Bool started = (!stack || pthread_attr_setstacksize(&attr, stack) == 0)
+        && pthread_create(&t->handle, &attr, _thrRun, t) == 0;
+    pthread_attr_destroy(&attr);
+    return started;
+#endif // _WIN32
+}
+
+void thrJoin(Thread* t)
+{
+#ifdef _WIN32
+    WaitForSingleObject(t->handle, INFINITE);
+    CloseHandle(t->handle);
+#else
+    pthread_join(t->handle, NULL);
+#endif // _WIN32
+}
+
+void thrYield(void)
+{
+#ifdef _WIN32
+    SwitchToThread();
+#else
+    sched_yield();
+#endif // _WIN32
+}
+
+size_t thrCpuCount(void)
+{
+#ifdef _WIN32
+    DWORD count = GetActiveProcessorCount(ALL_PROCESSOR_GROUPS);
+#else
+    long count = sysconf(_SC_NPROCESSORS_ONLN);
+#endif // _WIN32
+    return count > 0 ? (size_t)count : 1;
+}
+
+void thrMutexInit(Mutex* m)
+{
+#ifdef _WIN32
+    InitializeSRWLock(m);
+#else
+    int res = pthread_mutex_init(m, NULL);
+    assert(res == 0);
+    (void)res;
+#endif // _WIN32
+}
+
+void thrMutexFree(Mutex* m)
+{
+#ifdef _WIN32
+    // slim locks don't own any resources
+    (void)m;
+#else
+    pthread_mutex_destroy(m);
+#endif // _WIN32
+}
+
+void thrLock(Mutex* m)
+{
+#ifdef _WIN32
+    AcquireSRWLockExclusive(m);
+#else
+    pthread_mutex_lock(m);
+#endif // _WIN32
+}
+
+void thrUnlock(Mutex* m)
+{
+#ifdef _WIN32
+    ReleaseSRWLockExclusive(m);
+#else
+    pthread_mutex_unlock(m);
+#endif // _WIN32
+}
+
+void thrConditionInit(Condition* c)
+{
+#ifdef _WIN32
+    InitializeConditionVariable(c);
+#else
+    int res = pthread_cond_init(c, NULL);
+    assert(res == 0);
+    (void)res;
+#endif // _WIN32
+}
+
+void thrConditionFree(Condition* c)
+{
+#ifdef _WIN32
+    (void)c;
+#else
+    pthread_cond_destroy(c);
+#endif // _WIN32
+}
+
+void thrWait(Condition* c, Mutex* m)
+{
+#ifdef _WIN32
+    SleepConditionVariableSRW(c, m, INFINITE, 0);
+#else
+    pthread_cond_wait(c, m);
+#endif // _WIN32
+}
+
+void thrBroadcast(Condition* c)
+{
+#ifdef _WIN32
+    WakeAllConditionVariable(c);
+#else
+    pthread_cond_broadcast(c);
+#endif // _WIN32
+}
+
+#ifdef _WIN32
+
+DWORD WINAPI _thrRun(LPVOID context)
+{
+    Thread* t = context;
+    t->start(t->context);
+    return 0;
+}
+
+#else
+
+void* _thrRun(void* context)
+{
+    Thread* t = context;
+    t->start(t->context);
+    return NULL;
+}
+
+#endif // _WIN32
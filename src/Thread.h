@@ -0,0 +1,143 @@
+#ifndef thr_THREAD_INCLUDED
+#define thr_THREAD_INCLUDED
+
+#include <stddef.h>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <pthread.h>
+#endif // _WIN32
+
+/**
+ * @brief function run by new thread
+ *
+ */
+typedef void (*ThreadStart)(void* context);
+
+/**
+ * @brief system thread, it must not move while it runs
+ *
+ */
+typedef struct Thread
+{
+#ifdef _WIN32
+    HANDLE handle;
+#else
+    pthread_t handle;
+#endif // _WIN32
+    ThreadStart start;
+    void* context;
+} Thread;
+
+#ifdef _WIN32
+typedef SRWLOCK Mutex;
+typedef CONDITION_VARIABLE Condition;
+#else
+typedef pthread_mutex_t Mutex;
+typedef pthread_cond_t Condition;
+#endif // _WIN32
+
+/**
+ * @brief starts new thread
+ *
+ * @param t where to store the thread, must stay valid until it is joined
+ * @param start function run by the thread
+ * @param context passed to start
+ * @return true the thread was started
+ * @return false the system couldn't start the thread
+ */
+_Bool thrCreate(Thread* t, ThreadStart start, void* context);
+
+/**
+ * @brief starts new thread with stack of the given size, the memory of the
+ * stack is only reserved and it is committed as the stack grows
+ *
+ * @param t where to store the thread, must stay valid until it is joined
+ * @param start function run by the thread
+ * @param context passed to start
+ * @param stack size of the stack in bytes, 0 for the default size
+ * @return true the thread was started
+ * @return false the system couldn't start the thread
+ */
+_Bool thrCreateStack(Thread* t, ThreadStart start, void* context, size_t stack);
+
+/**
+ * @brief waits until the thread ends and frees it
+ *
+ * @param t the thread
+ */
+void thrJoin(Thread* t);
+
+/**
+ * @brief lets other threads run
+ *
+ */
+void thrYield(void);
+
+/**
+ * @brief returns the number of processors the program can run on
+ *
+ * @return size_t number of processors, at least 1
+ */
+size_t thrCpuCount(void);
+
+/**
+ * @brief initializes mutex
+ *
+ * @param m the mutex
+ */
+void thrMutexInit(Mutex* m);
+
+/**
+ * @brief frees mutex that isn't locked
+ *
+ * @param m the mutex
+ */
+void thrMutexFree(Mutex* m);
+
+/**
+ * @brief locks mutex, waits if other thread holds it
+ *
+ * @param m the mutex
+ */
+void thrLock(Mutex* m);
+
+/**
+ * @brief unlocks mutex held by this thread
+ *
+ * @param m the mutex
+ */
+void thrUnlock(Mutex* m);
+
+/**
+ * @brief initializes condition variable
+ *
+ * @param c the condition variable
+ */
+void thrConditionInit(Condition* c);
+
+/**
+ * @brief frees condition variable that no thread waits on
+ *
+ * @param c the condition variable
+ */
+void thrConditionFree(Condition* c);
+
+/**
+ * @brief unlocks the mutex, waits until the condition is signaled and
+ * locks the mutex again, it may also wake up without signal
+ *
+ * @param c the condition variable
+ * @param m mutex held by this thread
+ */
+void thrWait(Condition* c, Mutex* m);
+
+/**
+ * @brief wakes all threads waiting on the condition
+ *
+ * @param c the condition variable
+ */
+void thrBroadcast(Condition* c);
+
+#endif // thr_THREAD_INCLUDED
@@ -21,6 +21,7 @@ void tokenFree(Token token)
     case T_IDENTIFIER_FUNCTION:
     case T_IDENTIFIER_STRUCT:
     case T_LITERAL_STRING:
+    case T_LITERAL_BIGINT:
     case T_IDENTIFIER_PARAMETER:
     case T_INVALID:
         strFree(token.string);
@@ -166,6 +167,9 @@ void tokenPrint(Stream* out, Token token)
     case T_LITERAL_INTEGER:
         stPrintf(out, "integer(%zu)\n", token.integer);
         return;
+    case T_LITERAL_BIGINT:
+        stPrintf(out, "bigint(%s)\n", token.string.c);
+        return;
     case T_LITERAL_FLOAT:
         stPrintf(out, "float(%lf)\n", token.decimal);
         return;
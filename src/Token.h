@@ -32,6 +32,7 @@ typedef enum T_TokenType
     T_STORAGE_BOOL, // bool
     T_IDENTIFIER_PARAMETER, // value
     T_LITERAL_INTEGER, // 123
+    T_LITERAL_BIGINT, // 123456789012345678901234567890
     T_LITERAL_FLOAT, // 123.0
     T_LITERAL_CHAR, // 'C'
     T_LITERAL_STRING, // "hello"
@@ -1,96 +1,156 @@
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include <accctrl.h>
 
 #include "List.h"
-#include "Lexer.h"
-#include "Token.h"
-#include "Errors.h"
-#include "ParserTree.h"
-#include "Parser.h"
 #include "String.h"
-#include "Evaluator.h"
 #include "Stream.h"
 #include "Terminal.h"
+#include "FileSpan.h"
+#include "Runtime.h"
+#include "BuiltinFunctions.h"
+#include "Program.h"
+#include "Image.h"
+#include "Module.h"
+#include "Emitter.h"
 
 int main(int argc, char** argv)
 {
-    if (argc != 2)
+    const char* filename = NULL;
+    _Bool optimize = 0;
+    _Bool stats = 0;
+    // compiled programs are cached next to their sources by default
+    _Bool cache = 1;
+    // one thread for every processor by default
+    size_t threads = 0;
+    // image whose globals the program starts with and where to save the
+    // globals after the program ran
+    const char* image = NULL;
+    const char* save = NULL;
+    // the program is translated to C source instead of running it
+    _Bool emit = 0;
+    // hot functions are compiled to machine code by default
+    _Bool jit = 1;
+
+    for (int i = 1; i < argc; i++)
+    {
+        if (strcmp(argv[i], "-O") == 0)
+        {
+            optimize = 1;
+            continue;
+        }
+        if (strcmp(argv[i], "-S") == 0)
+        {
+            stats = 1;
+            continue;
+        }
+        if (strcmp(argv[i], "--emit-c") == 0)
+        {
+            emit = 1;
+            continue;
+        }
+        if (strcmp(argv[i], "-C") == 0)
+        {
+            cache = 0;
+            continue;
+        }
+        if (strcmp(argv[i], "-J") == 0)
+        {
+            jit = 0;
+            continue;
+        }
+        if (strcmp(argv[i], "-j") == 0)
+        {
+            char* end = NULL;
+            if (i + 1 < argc)
+                threads = strtoull(argv[++i], &end, 10);
+            if (!end || *end || threads == 0)
+            {
+                printf("Error: -j takes positive number of threads");
+                return EXIT_FAILURE;
+            }
+            continue;
+        }
+        if (strcmp(argv[i], "-i") == 0 || strcmp(argv[i], "-o") == 0)
+        {
+            if (i + 1 >= argc)
+            {
+                printf("Error: %s takes name of image", argv[i]);
+                return EXIT_FAILURE;
+            }
+            if (argv[i][1] == 'i')
+                image = argv[++i];
+            else
+                save = argv[++i];
+            continue;
+        }
+        if (filename)
+        {
+            printf("Error: invalid number of arguments");
+            return EXIT_FAILURE;
+        }
+        filename = argv[i];
+    }
+
+    if (!filename)
     {
         printf("Error: invalid number of arguments");
         return EXIT_FAILURE;
     }
 
-    const char* filename = argv[1];
-    String fn = strC(filename);
-    Stream in;
-    if (stFileStream(&in, filename, "r")) {
-      printf("Error: couldn't open file %s", filename);
-      return EXIT_FAILURE;
+    // the modules are compiled on as many threads as the parallel builtins use
+    Modules* modules = modCreate(optimize, cache, threads);
+    // the C source is written to stdout so the messages go to stderr
+    Program* program = modLoad(modules, filename, emit ? term_err : term_out);
+    if (!program)
+    {
+        modFree(modules);
+        return EXIT_FAILURE;
     }
 
-    List errs;
-    List tokens = lexLex(&in, &errs, &fn);
-    stClose(&in);
+    if (emit)
+    {
+        int res = emitProgram(program, term_out, term_err) ? EXIT_SUCCESS : EXIT_FAILURE;
+        modFree(modules);
+        return res;
+    }
 
-    size_t errors = 0;
-    size_t warnings = 0;
-    size_t infos = 0;
-    size_t msgs = 0;
-    listForEach(errs, ErrorSpan, t,
-        errPrintErrorSpan(term_out, t);
-        printf("\n");
-        msgs++;
-        switch (t.level)
-        {
-        case E_ERROR:
-            errors++;
-            break;
-        case E_WARNING:
-            warnings++;
-            break;
-        case E_INFO:
-            infos++;
-            break;
-        }
-    );
+    List builtins = bifCreateBuiltins();
+    List errors = listNew(FileSpan);
+    Runtime r = rtCreateFrom(builtins, &errors, stdout);
+    r.threads = threads;
+    r.jit = jit;
 
-    if (errors != 0)
+    Program* prelude = NULL;
+    if (image && !(prelude = imgLoad(image, builtins, &r, term_out)))
     {
-        printf("#Errors: %zu\n#Warnings: %zu\n#Infos: %zu\n", errors, warnings, infos);
+        rtFree(r);
+        listFree(errors);
+        bifFreeBuiltins(builtins);
+        modFree(modules);
         return EXIT_FAILURE;
     }
-    listDeepFree(errs, ErrorSpan, t, errFreeErrorSpan(t));
 
-    ParserTree tree = parParse(tokens, &errs);
-    listFree(tokens);
-    tree.filename = filename;
-
-    listForEach(errs, ErrorToken, t,
-        errPrintErrorToken(term_out, t, filename);
-        printf("\n");
-        msgs++;
-        switch (t.level)
-        {
-        case E_ERROR:
-            errors++;
-            break;
-        case E_WARNING:
-            warnings++;
-            break;
-        case E_INFO:
-            infos++;
-            break;
-        }
-    );
-    if (msgs != 0)
-        printf("#Errors: %zu\n#Warnings: %zu\n#Infos: %zu\n", errors, warnings, infos);
-    if (errors != 0)
-        return EXIT_FAILURE;
-    listDeepFree(errs, ErrorToken, t, errFreeErrorToken(t));
+    int res = EXIT_SUCCESS;
+    Variable v = progRun(program, &r);
+    if (v.type == V_EXCEPTION)
+    {
+        rtPrintException(stdout, v);
+        res = EXIT_FAILURE;
+    }
+    rtFreeVariable(v);
 
-    listFree(evEvaluate(tree));
-    ptFree(tree);
+    if (save && res == EXIT_SUCCESS && !imgSave(save, program, &r, builtins, term_out))
+        res = EXIT_FAILURE;
 
-    return EXIT_SUCCESS;
+    if (stats)
+        gcPrintStats(stderr, &r.gc);
+    rtFree(r);
+    listFree(errors);
+    bifFreeBuiltins(builtins);
+    modFree(modules);
+    if (prelude)
+        imgFree(prelude);
+    return res;
 }
\ No newline at end of file
@@ -0,0 +1,49 @@
+#!/bin/sh
+# runs every program in testing and the programs generated by jitGen.py
+# with and without the JIT and compares their output:
+# > sh testing/jitDiff.sh bin/SLang.exe 200
+# the second argument is the number of generated programs (100 by default),
+# programs that run longer than 20 seconds are skipped if timeout exists
+slang=${1:-bin/SLang.exe}
+count=${2:-100}
+dir=$(dirname "$0")
+tmp=$(mktemp -d)
+trap 'rm -rf "$tmp"' EXIT
+
+python=python3
+command -v $python > /dev/null || python=python
+limit=
+command -v timeout > /dev/null && limit="timeout 20"
+
+failed=0
+skipped=0
+
+# compare FILE NAME
+compare()
+{
+    $limit "$slang" -C "$1" > "$tmp/jit.out" 2>&1
+    jit=$?
+    $limit "$slang" -C -J "$1" > "$tmp/interpreter.out" 2>&1
+    interpreter=$?
+    if [ $jit -eq 124 ] || [ $interpreter -eq 124 ]; then
+        echo "timed out: $2"
+        skipped=$((skipped + 1))
+    elif [ $jit -ne $interpreter ] || ! cmp -s "$tmp/jit.out" "$tmp/interpreter.out"; then
+        echo "different output: $2"
+        failed=$((failed + 1))
+    fi
+}
+
+for f in "$dir"/*.sla; do
+    compare "$f" "$f"
+done
+
+i=1
+while [ $i -le $count ]; do
+    $python "$dir/jitGen.py" $i > "$tmp/generated.sla"
+    compare "$tmp/generated.sla" "$python $dir/jitGen.py $i"
+    i=$((i + 1))
+done
+
+echo "$failed different, $skipped skipped"
+[ $failed -eq 0 ]
@@ -0,0 +1,103 @@
+# generates random programs for the comparison of the JIT with the
+# interpreter, the same seed always gives the same program:
+# > python testing/jitGen.py 42 > program.sla
+#
+# the functions use mostly what the JIT compiles (int literals, parameters,
+# if, and, or, cond, arithmetic, comparisons and calls of the functions
+# defined before them), but also ints that don't fit into 64 bits, floats,
+# strings and division by zero so that the code bails out, every function
+# is called by a driver with different arguments until it gets hot
+import random
+import sys
+
+# calls of every function, more than the threshold of the JIT
+CALLS = 1500
+# nesting of the generated expressions
+DEPTH = 4
+
+
+def leaf(r, params):
+    if params and r.random() < 0.6:
+        return r.choice(params)
+    return str(r.choice([0, 1, 2, 3, -1, 7, 100, r.randint(-1000, 1000),
+                         4611686018427387904, -9223372036854775807]))
+
+
+def condition(r, params, fns, depth):
+    if depth <= 0 or r.random() < 0.25:
+        return '[%s %s %s]' % (r.choice(['<', '=']), leaf(r, params), leaf(r, params))
+    if r.random() < 0.2:
+        count = r.randint(1, 3)
+        return '[%s %s]' % (r.choice(['and', 'or']),
+                            ' '.join(condition(r, params, fns, depth - 1) for _ in range(count)))
+    return '[%s %s %s]' % (r.choice(['<', '<=', '>', '>=', '=']),
+                           value(r, params, fns, depth - 1), value(r, params, fns, depth - 1))
+
+
+def value(r, params, fns, depth):
+    if depth <= 0 or r.random() < 0.25:
+        return leaf(r, params)
+    k = r.random()
+    if k < 0.35:
+        op = r.choice(['+', '*', '-', '/', '%', '+', '-'])
+        count = 2 if op in '-/%' else r.randint(1, 4)
+        if op == '-' and r.random() < 0.2:
+            count = 1
+        return '[%s %s]' % (op, ' '.join(value(r, params, fns, depth - 1) for _ in range(count)))
+    if k < 0.55:
+        # if without else gives _ which bails out
+        e = '[if %s %s' % (condition(r, params, fns, depth - 1), value(r, params, fns, depth - 1))
+        if r.random() < 0.9:
+            e += ' ' + value(r, params, fns, depth - 1)
+        return e + ']'
+    if k < 0.65:
+        clauses = ' '.join('[%s %s]' % (condition(r, params, fns, depth - 1), value(r, params, fns, depth - 1))
+                           for _ in range(r.randint(1, 3)))
+        if r.random() < 0.7:
+            clauses += ' [else %s]' % value(r, params, fns, depth - 1)
+        return '[cond %s]' % clauses
+    if k < 0.8 and fns:
+        name, argc, recursive = r.choice(fns)
+        args = [value(r, params, fns, depth - 1) for _ in range(argc)]
+        if recursive:
+            # the recursion stops in time
+            args[0] = '[%% %s 30]' % args[0]
+        return '[%s %s]' % (name, ' '.join(args))
+    if k < 0.83:
+        # values the JIT doesn't compile
+        return r.choice(['[+ 1.5 %s]' % leaf(r, params),
+                         '[if [= %s 0] "s" 1]' % leaf(r, params),
+                         '9223372036854775807'])
+    return leaf(r, params)
+
+
+def program(seed):
+    r = random.Random(seed)
+    fns = []
+    lines = []
+    for i in range(r.randint(2, 5)):
+        argc = r.randint(1, 3)
+        params = ['p%d' % j for j in range(argc)]
+        name = 'f%d' % i
+        recursive = r.random() < 0.5
+        if recursive:
+            # recursion bounded by the first parameter, the other arguments
+            # don't grow with every call
+            args = ['[- p0 1]'] + ['[%% %s 1000000007]' % value(r, params, fns, DEPTH - 2) for _ in range(argc - 1)]
+            body = '[if [<= p0 0] %s [%s %s]]' % (value(r, params, fns, DEPTH - 1), name, ' '.join(args))
+        else:
+            body = value(r, params, fns, DEPTH)
+        lines.append('[set %s [def [%s] %s]]' % (name, ' '.join(params), body))
+        fns.append((name, argc, recursive))
+
+        # the driver prints every result so it isn't compiled itself
+        driver = 'd%d' % i
+        args = ['[%% n %d]' % r.randint(1, 40)] + ['[- n %d]' % r.randint(0, 2000) for _ in range(argc - 1)]
+        lines.append('[set %s [def [n printed] [if [= n 0] _ [%s [- n 1] [println [%s %s]]]]]]'
+                     % (driver, driver, name, ' '.join(args)))
+        lines.append('[%s %d _]' % (driver, CALLS))
+    return '\n'.join(lines) + '\n'
+
+
+if __name__ == '__main__':
+    sys.stdout.write(program(int(sys.argv[1])))